@@ -0,0 +1,294 @@
+﻿#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "http_bench.h"
+
+int BenchHttpHandler::do_close()
+{
+    if (HttpBenchApp::instance().running_.load(std::memory_order_relaxed)) {
+        ++stats_->closed_;
+    }
+    return 0;
+}
+
+int BenchHttpHandler::do_message()
+{
+    HttpBenchApp &app = HttpBenchApp::instance();
+    if (!app.running_.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+
+    //pipelining时同一批请求的延迟都从该批的发送时间算起
+    stats_->histogram_.record(TscClock::instance().tsc2ns(TscClock::rdtsc() - batch_tsc_));
+    stats_->requests_.store(stats_->requests_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (response_.status_code_ >= HttpStatusCode::k400) {
+        ++stats_->errors_;
+    }
+
+    if (--in_flight_ == 0) {
+        return send_batch();
+    }
+    return 0;
+}
+
+int BenchHttpHandler::start(BenchStats *stats, uint_t template_index)
+{
+    stats_          = stats;
+    template_index_ = template_index;
+    head_           = (HttpBenchApp::instance().method_id_ == HttpMethodId::kHEAD);
+    return send_batch();
+}
+
+int BenchHttpHandler::send_batch()
+{
+    HttpBenchApp &app = HttpBenchApp::instance();
+    static thread_local ByteBuffer out;
+    out.reset();
+    uint_t count = static_cast<uint_t>(app.requests_.size());
+    for (uint_t i = 0; i < app.pipeline_; ++i) {
+        const std::string &request = app.requests_[template_index_];
+        out.write(request.data(), static_cast<uint_t>(request.size()));
+        if (++template_index_ == count) {
+            template_index_ = 0;
+        }
+    }
+    in_flight_ = app.pipeline_;
+    batch_tsc_ = TscClock::rdtsc();
+    return (send(out.data(), out.data_size()) >= 0) ? 0 : -1;
+}
+
+int BenchTimer::handle_timeout()
+{
+    HttpBenchApp &app = HttpBenchApp::instance();
+    uint64_t requests = 0;
+    for (auto stats : app.stats_) {
+        requests += stats->requests_.load(std::memory_order_relaxed);
+    }
+    ++app.elapsed_s_;
+    printf("  %3us  %llu requests/s\n", app.elapsed_s_, static_cast<unsigned long long>(requests - app.last_requests_));
+    app.last_requests_ = requests;
+
+    if (app.elapsed_s_ >= app.duration_s_) {
+        timer_type_ = Timer::TimerType::ONCE;
+        app.stop();
+    }
+    return 0;
+}
+
+static void usage()
+{
+    printf("usage: http_bench [options] server port [uri ...]\n"
+        "  -c connections   total connections (default 100)\n"
+        "  -t threads       event loop threads (default 2)\n"
+        "  -p pipeline      requests per batch on each connection (default 1)\n"
+        "  -d duration      test duration in seconds (default 10)\n"
+        "  -m method        request method (default GET)\n"
+        "  -H header        request header \"Name: value\" (repeatable)\n"
+        "  -b body          request body\n"
+        "  uri ...          request templates sent in turn (default /)\n"
+        "e.g.: http_bench -c 100 -t 4 -p 16 -d 10 127.0.0.1 8080 /hello\n");
+}
+
+int HttpBenchApp::parse_args(int argc, char *argv[])
+{
+    std::vector<const char *> positional;
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (('-' != arg[0]) || ('\0' == arg[1])) {
+            positional.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return -1;
+        }
+        const char *value = argv[++i];
+        switch (arg[1]) {
+        case 'c':
+            connections_ = static_cast<uint_t>(atoi(value));
+            break;
+        case 't':
+            threads_ = static_cast<uint_t>(atoi(value));
+            break;
+        case 'p':
+            pipeline_ = static_cast<uint_t>(atoi(value));
+            break;
+        case 'd':
+            duration_s_ = static_cast<uint_t>(atoi(value));
+            break;
+        case 'm':
+            {
+                std::string method = value;
+                method_id_ = HttpMessage::find_http_method_id(method);
+                if (HttpMethodId::kUNKNOWN == method_id_) {
+                    return -1;
+                }
+            }
+            break;
+        case 'H':
+            headers_.push_back(value);
+            break;
+        case 'b':
+            body_ = value;
+            break;
+        default:
+            return -1;
+        }
+    }
+
+    if (positional.size() < 2) {
+        return -1;
+    }
+    server_ = positional[0];
+    port_   = static_cast<zrsocket::ushort_t>(atoi(positional[1]));
+    for (size_t i = 2; i < positional.size(); ++i) {
+        uris_.push_back(positional[i]);
+    }
+    if (uris_.empty()) {
+        uris_.push_back("/");
+    }
+    if ((connections_ < 1) || (threads_ < 1) || (pipeline_ < 1) || (duration_s_ < 1)) {
+        return -1;
+    }
+    if (threads_ > connections_) {
+        threads_ = connections_;
+    }
+    return 0;
+}
+
+int HttpBenchApp::init()
+{
+    main_event_loop_.open(1024, 1024);
+
+    //请求模板预先编码, 测试期间只拷贝
+    bool has_host = false;
+    for (auto &header : headers_) {
+        has_host |= (header.size() >= 5) && HttpStringView::equals_ignore_case(header.c_str(), "Host:", 5);
+    }
+    for (auto &uri : uris_) {
+        HttpRequest request;
+        request.method_id_ = method_id_;
+        request.uri_ = uri;
+        if (!has_host) {
+            request.headers_.emplace("Host", server_.c_str());
+        }
+        for (auto &header : headers_) {
+            size_t pos = header.find(':');
+            if (std::string::npos == pos) {
+                continue;
+            }
+            size_t value_pos = header.find_first_not_of(' ', pos + 1);
+            std::string value = (std::string::npos == value_pos) ? std::string() : header.substr(value_pos);
+            request.headers_.emplace(header.substr(0, pos), value);
+        }
+        if (!body_.empty()) {
+            request.body_.write(body_.data(), static_cast<uint_t>(body_.size()));
+        }
+        ByteBuffer out;
+        request.encode(out);
+        requests_.emplace_back(out.data(), out.data_size());
+    }
+
+    decoder_config_.max_header_length_ = 8192;
+    decoder_config_.max_body_length_   = 1024 * 1024;
+    decoder_config_.update();
+    sub_event_loop_.init(threads_, 10000, 2);
+    sub_event_loop_.open(1024, 1024);
+    for (uint_t i = 0; i < threads_; ++i) {
+        stats_.push_back(new BenchStats());
+    }
+
+    //阻塞连接: 全部连接建立后再同时开始
+    clients_.reserve(connections_);
+    for (uint_t i = 0; i < connections_; ++i) {
+        BENCH_CLIENT *client = new BENCH_CLIENT();
+        client->set_config(true, false, 65536);
+        client->set_interface(sub_event_loop_.get_event_loop(i % threads_), &decoder_config_);
+        if (client->open(server_.c_str(), port_) < 0) {
+            ++connect_errors_;
+            delete client;
+            continue;
+        }
+        clients_.push_back(client);
+    }
+    if (clients_.empty()) {
+        printf("connect %s:%d failed\n", server_.c_str(), port_);
+        return -1;
+    }
+
+    printf("Running %us test @ %s:%d\n", duration_s_, server_.c_str(), port_);
+    printf("  %u threads and %u connections, pipeline %u, %u request template(s)\n",
+        threads_, static_cast<uint_t>(clients_.size()), pipeline_, static_cast<uint_t>(requests_.size()));
+
+    running_.store(true);
+    start_tsc_ = TscClock::rdtsc();
+    for (uint_t i = 0; i < clients_.size(); ++i) {
+        clients_[i]->handler()->start(stats_[i % threads_], i % static_cast<uint_t>(requests_.size()));
+    }
+    sub_event_loop_.loop_thread_start();
+
+    timer_.interval(1000000);
+    main_event_loop_.add_timer(&timer_);
+
+    init_flag_ = true;
+    return 0;
+}
+
+int HttpBenchApp::do_fini()
+{
+    sub_event_loop_.loop_thread_stop();
+    sub_event_loop_.loop_wakeup();
+    sub_event_loop_.loop_thread_join();
+    report();
+
+    for (auto client : clients_) {
+        client->close();
+        delete client;
+    }
+    clients_.clear();
+    for (auto stats : stats_) {
+        delete stats;
+    }
+    stats_.clear();
+    return 0;
+}
+
+void HttpBenchApp::report()
+{
+    LatencyHistogram histogram;
+    uint64_t errors = 0;
+    uint64_t closed = 0;
+    for (auto stats : stats_) {
+        histogram.merge(stats->histogram_);
+        errors += stats->errors_;
+        closed += stats->closed_;
+    }
+
+    double seconds = TscClock::instance().tsc2ns(stop_tsc_ - start_tsc_) / 1e9;
+    uint64_t requests = histogram.total_count();
+    printf("  Latency(us)  min:%.1f  mean:%.1f  p50:%.1f  p90:%.1f  p99:%.1f  p999:%.1f  max:%.1f\n",
+        histogram.min() / 1e3,
+        histogram.mean() / 1e3,
+        histogram.value_at_percentile(50.0) / 1e3,
+        histogram.value_at_percentile(90.0) / 1e3,
+        histogram.value_at_percentile(99.0) / 1e3,
+        histogram.value_at_percentile(99.9) / 1e3,
+        histogram.max() / 1e3);
+    printf("  %llu requests in %.2fs, errors(status>=400):%llu, closed:%llu, connect errors:%u\n",
+        static_cast<unsigned long long>(requests),
+        seconds,
+        static_cast<unsigned long long>(errors),
+        static_cast<unsigned long long>(closed),
+        connect_errors_);
+    printf("Requests/sec: %.2f\n", (seconds > 0) ? requests / seconds : 0.0);
+}
+
+int main(int argc, char *argv[])
+{
+    HttpBenchApp &app = HttpBenchApp::instance();
+    printf("zrsocket version:%s\n", ZRSOCKET_VERSION_STR);
+    if (app.parse_args(argc, argv) < 0) {
+        usage();
+        return -1;
+    }
+    return app.run();
+}
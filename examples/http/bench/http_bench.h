@@ -0,0 +1,233 @@
+﻿#ifndef HTTP_BENCH_H
+#define HTTP_BENCH_H
+#include <string>
+#include <vector>
+#include "zrsocket/zrsocket.h"
+
+using namespace zrsocket;
+
+//HDR风格的延迟直方图: 按2的幂分桶, 桶内再线性分为SUB_BUCKET_HALF个子桶(3位有效数字)
+//  记录值单位为ns, 超过MAX_VALUE的按MAX_VALUE记录
+class LatencyHistogram
+{
+public:
+    enum
+    {
+        SUB_BUCKET_BITS  = 11,
+        SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS,
+        SUB_BUCKET_HALF  = SUB_BUCKET_COUNT / 2,
+        MAX_VALUE_BITS   = 40,     //约1099秒
+        COUNTS_SIZE      = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 2) * SUB_BUCKET_HALF,
+    };
+
+    LatencyHistogram()
+        : counts_(COUNTS_SIZE, 0)
+    {
+    }
+
+    inline void record(uint64_t value)
+    {
+        if (value >= (1ULL << MAX_VALUE_BITS)) {
+            value = (1ULL << MAX_VALUE_BITS) - 1;
+        }
+        ++counts_[index(value)];
+        ++total_count_;
+        sum_ += value;
+        if (value < min_) {
+            min_ = value;
+        }
+        if (value > max_) {
+            max_ = value;
+        }
+    }
+
+    void merge(const LatencyHistogram &other)
+    {
+        for (uint_t i = 0; i < COUNTS_SIZE; ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        total_count_ += other.total_count_;
+        sum_ += other.sum_;
+        min_ = std::min<uint64_t>(min_, other.min_);
+        max_ = std::max<uint64_t>(max_, other.max_);
+    }
+
+    //百分位(0 < percentile <= 100)对应的值: 所在子桶的最大值
+    uint64_t value_at_percentile(double percentile) const
+    {
+        if (0 == total_count_) {
+            return 0;
+        }
+        uint64_t target = static_cast<uint64_t>(percentile / 100.0 * total_count_ + 0.5);
+        if (target < 1) {
+            target = 1;
+        }
+        uint64_t count = 0;
+        for (uint_t i = 0; i < COUNTS_SIZE; ++i) {
+            count += counts_[i];
+            if (count >= target) {
+                return std::min<uint64_t>(highest_value(i), max_);
+            }
+        }
+        return max_;
+    }
+
+    inline uint64_t total_count() const
+    {
+        return total_count_;
+    }
+
+    inline uint64_t min() const
+    {
+        return (total_count_ > 0) ? min_ : 0;
+    }
+
+    inline uint64_t max() const
+    {
+        return max_;
+    }
+
+    inline double mean() const
+    {
+        return (total_count_ > 0) ? static_cast<double>(sum_) / total_count_ : 0.0;
+    }
+
+private:
+    //[0, SUB_BUCKET_COUNT)直接索引; 之后每个2的幂区间保留最高SUB_BUCKET_BITS位
+    static inline uint_t index(uint64_t value)
+    {
+        if (value < SUB_BUCKET_COUNT) {
+            return static_cast<uint_t>(value);
+        }
+        uint_t msb = floor_log2(value);
+        uint_t shift = msb - (SUB_BUCKET_BITS - 1);
+        return (shift + 1) * SUB_BUCKET_HALF + static_cast<uint_t>((value >> shift) - SUB_BUCKET_HALF);
+    }
+
+    static inline uint_t floor_log2(uint64_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return static_cast<uint_t>(index);
+#else
+        return 63 - static_cast<uint_t>(__builtin_clzll(value));
+#endif
+    }
+
+    static inline uint64_t highest_value(uint_t index)
+    {
+        if (index < SUB_BUCKET_COUNT) {
+            return index;
+        }
+        uint_t shift = index / SUB_BUCKET_HALF - 1;
+        uint64_t sub = index % SUB_BUCKET_HALF + SUB_BUCKET_HALF;
+        return (sub << shift) + ((1ULL << shift) - 1);
+    }
+
+private:
+    std::vector<uint64_t> counts_;
+    uint64_t total_count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t min_ = UINT64_MAX;
+    uint64_t max_ = 0;
+};
+
+//每个event_loop线程的统计(只由所属event_loop线程更新)
+struct BenchStats
+{
+    LatencyHistogram histogram_;
+    AtomicUInt64     requests_{ 0 };    //测试期间完成的请求数(每秒打印进度时由主线程读取)
+    uint64_t         errors_ = 0;       //状态码>=400的回复数
+    uint64_t         closed_ = 0;       //测试期间被关闭的连接数
+};
+
+class BenchHttpHandler : public HttpResponseHandler<ByteBuffer, NullMutex>
+{
+public:
+    int do_close();
+    int do_message();
+
+    bool head_request()
+    {
+        return head_;
+    }
+
+    //发送第一批请求(在event_loop线程启动之前调用)
+    int start(BenchStats *stats, uint_t template_index);
+
+private:
+    //发送一批(pipeline个)请求, 记录发送时的tsc
+    int send_batch();
+
+private:
+    BenchStats *stats_          = nullptr;
+    uint_t      template_index_ = 0;
+    uint_t      in_flight_      = 0;
+    uint64_t    batch_tsc_      = 0;
+    bool        head_           = false;
+};
+
+class BenchTimer : public zrsocket::Timer
+{
+public:
+    int handle_timeout();
+};
+
+class HttpBenchApp : public Application<HttpBenchApp, SpinMutex>
+{
+public:
+    int parse_args(int argc, char *argv[]);
+    int init();
+    int do_fini();
+    void report();
+
+    int do_signal(int signum)
+    {
+        printf("do_signal signum:%d\n", signum);
+        stop();
+        return 0;
+    }
+
+    void stop()
+    {
+        if (running_.exchange(false)) {
+            stop_tsc_ = TscClock::rdtsc();
+        }
+        stop_flag_.store(true, std::memory_order_relaxed);
+        main_event_loop_.loop_wakeup();
+    }
+
+public:
+    typedef zrsocket_default_event_loop<zrsocket::SpinMutex> BASE_EVENT_LOOP;
+    typedef zrsocket::TcpClient<BenchHttpHandler> BENCH_CLIENT;
+
+    EventLoopGroup<BASE_EVENT_LOOP> sub_event_loop_;
+    std::vector<BENCH_CLIENT *>     clients_;
+    std::vector<BenchStats *>       stats_;         //每个event_loop一个
+    HttpDecoderConfig               decoder_config_;
+    BenchTimer                      timer_;
+
+    //请求模板: 每个uri编码为一个完整请求, 连接按顺序轮流发送
+    std::vector<std::string>        requests_;
+
+    std::string                     server_ = "127.0.0.1";
+    zrsocket::ushort_t              port_   = 8080;
+    uint_t                          connections_ = 100;
+    uint_t                          threads_     = 2;
+    uint_t                          pipeline_    = 1;
+    uint_t                          duration_s_  = 10;
+    HttpMethodId                    method_id_   = HttpMethodId::kGET;
+    std::vector<std::string>        headers_;       //"Name: value"
+    std::string                     body_;
+    std::vector<std::string>        uris_;
+
+    AtomicBool                      running_{ false };
+    uint64_t                        start_tsc_  = 0;
+    uint64_t                        stop_tsc_   = 0;
+    uint_t                          elapsed_s_  = 0;
+    uint64_t                        last_requests_ = 0;
+    uint_t                          connect_errors_ = 0;
+};
+
+#endif
@@ -8,7 +8,7 @@ int ClientHttpHandler::do_message()
     printf("http version:%d, status_code:%d desc:%s\n", 
         response_.version_id_, response_.status_code_, response_.reason_phrase_.c_str());
     for (auto &iter : response_.headers_) {
-        printf("%s:%s\n", iter.first.c_str(), iter.second.c_str());
+        printf("%.*s:%.*s\n", static_cast<int>(iter.name_.len_), iter.name_.data_, static_cast<int>(iter.value_.len_), iter.value_.data_);
     }
     //printf("body:%s\n", response_.body_ptr_);
     
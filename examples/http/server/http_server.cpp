@@ -9,7 +9,7 @@ int ServerHttpHandler::do_message()
 
     //printf("http method:%d, uri:%s, version:%d\n", context_.request_.method_id_, context_.request_ .uri_.c_str(), context_.request_.version_id_);
     //for (auto &iter : context_.request_.headers_) {
-    //    printf("%s:%s\n", iter.first.c_str(), iter.second.c_str());
+    //    printf("%.*s:%.*s\n", static_cast<int>(iter.name_.len_), iter.name_.data_, static_cast<int>(iter.value_.len_), iter.value_.data_);
     //}
     //context_.request_.body_.write('\0');
     //printf("body:%s\n", context_.request_.body_.data());
@@ -23,17 +23,25 @@ int ServerHttpHandler::do_message()
     //context_.response_.body_.write("hello world!", sizeof("hello world!") - 1);
     context_.response_.headers_.emplace("Connection", "keep-alive");
 
-    if (context_.request_.uri_ == "/hello") {
-        context_.response_.body_.write("hello world!\n");
-    }
-    else {
-        context_.response_.body_.write("uri is invalid!\n");
-    }
+    return ServerHttpApp::instance().router_.dispatch(*this, context_);
 
     //ByteBuffer out;
     //context_.response_.encode(out);
     //context_.response_.send<EchoHttpHandler, ByteBuffer>(out);
+}
+
+int ServerHttpHandler::on_hello(ServerHttpHandler &handler, HttpContext &context, const HttpRouteParams &params)
+{
+    context.response_.body_.write("hello world!\n");
+    return 0;
+}
 
+int ServerHttpHandler::on_user(ServerHttpHandler &handler, HttpContext &context, const HttpRouteParams &params)
+{
+    HttpStringView id = params.get("id", 2);
+    context.response_.body_.write("user:");
+    context.response_.body_.write(id.data_, id.len_);
+    context.response_.body_.write("\n");
     return 0;
 }
 
@@ -58,6 +66,9 @@ int ServerHttpApp::init()
 
     handler_object_pool_.init(10000, 100, 10);
     decoder_config_.update();
+    router_.add(HttpMethodId::kGET, "/hello", ServerHttpHandler::on_hello);
+    router_.add(HttpMethodId::kGET, "/users/:id", ServerHttpHandler::on_user);
+    router_.build();
     http_server_.set_config(std::thread::hardware_concurrency(), 1000000, 4096);
     http_server_.set_interface(&handler_object_pool_, &sub_event_loop_, &decoder_config_, &main_event_loop_);
     http_server_.open(port_, 1024, nullptr);
@@ -24,6 +24,9 @@ public:
     }
 
     int do_message();
+
+    static int on_hello(ServerHttpHandler &handler, HttpContext &context, const HttpRouteParams &params);
+    static int on_user(ServerHttpHandler &handler, HttpContext &context, const HttpRouteParams &params);
 };
 
 class HttpAppTimer : public zrsocket::Timer
@@ -72,6 +75,7 @@ public:
     zrsocket::ushort_t event_loops_num_ = 2;
     AtomicUInt64       recv_messge_count_;
     HttpDecoderConfig  decoder_config_;
+    HttpRouter<ServerHttpHandler> router_;
 };
 
 #endif
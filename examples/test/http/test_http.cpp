@@ -0,0 +1,808 @@
+﻿#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "test_http.h"
+
+//HTTP协议解析测试: 各场景结果确定, 打印ok/FAILED, 返回失败的场景数
+
+int test_report(const char *name, bool ok, const std::string &detail)
+{
+    printf("%-28s %s %s\n", name, ok ? "ok" : "FAILED", detail.c_str());
+    return ok ? 0 : 1;
+}
+
+//把data按chunk_len分多次交给一个新连接解码
+//  requests: 解码出的请求; response: 连接上发出的全部回复
+//  返回值 <0: 连接被关闭(非法请求)
+int run_requests(zrsocket::HttpDecoderConfig &config, const std::string &data, std::size_t chunk_len,
+    std::vector<std::string> *requests = nullptr, std::string *response = nullptr)
+{
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        return -1;
+    }
+
+    TestHttpSource source(&config);
+    TestHttpHandler handler;
+    handler.init(sv[0], &source, nullptr, zrsocket::EventHandler::STATE_CONNECTED);
+    handler.handle_open();
+
+    int ret = 0;
+    for (std::size_t offset = 0; offset < data.size(); offset += chunk_len) {
+        ret = handler.feed(data.data() + offset, static_cast<zrsocket::uint_t>(std::min(chunk_len, data.size() - offset)));
+        if (ret < 0) {
+            break;
+        }
+    }
+
+    if (nullptr != response) {
+        char buf[4096];
+        ssize_t n;
+        response->clear();
+        while ((n = recv(sv[1], buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+            response->append(buf, n);
+        }
+    }
+    if (nullptr != requests) {
+        *requests = handler.requests_;
+    }
+    close(sv[0]);
+    close(sv[1]);
+    return ret;
+}
+
+//回复的状态码(第一个状态行), 没有回复时返回0
+int response_status(const std::string &response)
+{
+    if ((response.size() < 12) || (0 != response.compare(0, 5, "HTTP/"))) {
+        return 0;
+    }
+    return std::atoi(response.c_str() + 9);
+}
+
+//分多次到达的请求(含pipelining)与一次到达时解析结果相同
+int test_parser_split()
+{
+    zrsocket::HttpDecoderConfig config;
+    config.max_body_length_ = 100000;
+    config.update();
+
+    std::string data = "GET /index.html?a=1 HTTP/1.1\r\nHost: example.com\r\nUser-Agent:  wrk \t\r\nAccept: */*\r\n\r\n"
+        "\r\nPOST /p HTTP/1.0\r\nContent-Length: 11\r\nX-Empty:\r\n\r\nhello world"
+        "DELETE /d HTTP/1.1\r\n\r\n"
+        "PUT /u HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc"
+        "HEAD / HTTP/1.1\r\nX-Tab: a\tb\r\n\r\n";
+    const std::size_t REQUEST_COUNT = 5;
+
+    int failed = 0;
+    std::vector<std::string> expected;
+    int ret = run_requests(config, data, data.size(), &expected);
+    failed += test_report("parser.single_read", (ret >= 0) && (REQUEST_COUNT == expected.size()),
+        "requests:" + std::to_string(expected.size()));
+
+    std::string detail;
+    bool ok = true;
+    for (std::size_t chunk_len : { 1, 2, 3, 5, 17, 64 }) {
+        std::vector<std::string> requests;
+        ret = run_requests(config, data, chunk_len, &requests);
+        if ((ret < 0) || (requests != expected)) {
+            ok = false;
+            detail += " chunk:" + std::to_string(chunk_len);
+        }
+    }
+    failed += test_report("parser.split_read", ok, detail.empty() ? "chunks:1,2,3,5,17,64" : "mismatch" + detail);
+
+    //请求头的任一前缀都是不完整(返回0), 完整时返回请求头长度
+    zrsocket::HttpParser parser;
+    const std::string header = "GET /index.html?a=1 HTTP/1.1\r\nHost: example.com\r\n\r\n";
+    ok = true;
+    for (std::size_t len = 0; len < header.size(); ++len) {
+        if (0 != parser.parse_request(header.data(), static_cast<zrsocket::uint_t>(len))) {
+            ok = false;
+            detail = "prefix:" + std::to_string(len);
+            break;
+        }
+    }
+    ret = parser.parse_request(header.data(), static_cast<zrsocket::uint_t>(header.size()));
+    if (ok) {
+        ok = (static_cast<int>(header.size()) == ret);
+        detail = "header_len:" + std::to_string(ret);
+    }
+    failed += test_report("parser.partial_header", ok, detail);
+
+    return failed;
+}
+
+//检查非法请求: 连接被关闭, 回复status, 不调用do_message(一次到达与逐字节到达)
+int check_rejected(zrsocket::HttpDecoderConfig &config, const std::string &data, int status, std::string &detail)
+{
+    for (std::size_t chunk_len : { data.size(), static_cast<std::size_t>(1) }) {
+        std::vector<std::string> requests;
+        std::string response;
+        int ret = run_requests(config, data, chunk_len, &requests, &response);
+        int response_code = response_status(response);
+        if ((ret >= 0) || !requests.empty() || (response_code != status)) {
+            detail += " [" + std::to_string(chunk_len) + "]" + std::to_string(response_code);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//非法请求行回复400
+int test_parser_bad_request_line()
+{
+    zrsocket::HttpDecoderConfig config;
+    config.update();
+
+    const char *requests[] = {
+        "GETX / HTTP/1.1\r\n\r\n",          //未知method
+        "get / HTTP/1.1\r\n\r\n",           //method区分大小写
+        "GET / HTTP/1.2\r\n\r\n",           //未知version
+        "GET / HTTP/1.1\n\r\n",             //请求行没有CR
+        "GET  HTTP/1.1\r\n\r\n",            //缺少uri
+        "GET /\r\n\r\n",                    //缺少version
+        "GET / HTTP/1.1\r\nNoColon\r\n\r\n",
+        "GET / HTTP/1.1\r\n: v\r\n\r\n",    //空的header名
+    };
+
+    int errors = 0;
+    std::string detail;
+    for (auto request : requests) {
+        errors += check_rejected(config, request, 400, detail);
+    }
+    return test_report("parser.bad_request_line", 0 == errors, "errors:" + std::to_string(errors) + detail);
+}
+
+//uri与header值中的控制字符(HTAB除外)回复400
+int test_parser_ctl()
+{
+    zrsocket::HttpDecoderConfig config;
+    config.update();
+
+    const std::string requests[] = {
+        std::string("GET /a\x01" "b HTTP/1.1\r\n\r\n"),
+        std::string("GET /a\rb HTTP/1.1\r\n\r\n"),
+        std::string("GET /a\x7f" "b HTTP/1.1\r\n\r\n"),
+        std::string("GET / HTTP/1.1\r\nX: a\x01" "b\r\n\r\n"),
+        std::string("GET / HTTP/1.1\r\nX: a\x1f" "b\r\n\r\n"),
+        std::string("GET / HTTP/1.1\r\nX: a\x7f" "b\r\n\r\n"),
+        std::string("GET / HTTP/1.1\r\nX: a\rb\r\n\r\n"),
+        std::string("GET / HTTP/1.1\r\nX: a\0b\r\n\r\n", sizeof("GET / HTTP/1.1\r\nX: a\0b\r\n\r\n") - 1),
+    };
+
+    int errors = 0;
+    std::string detail;
+    for (auto &request : requests) {
+        errors += check_rejected(config, request, 400, detail);
+    }
+    return test_report("parser.ctl", 0 == errors, "errors:" + std::to_string(errors) + detail);
+}
+
+//请求头超过max_header_length_/header数超过MAX_HEADER_NUM回复431, uri超过max_uri_length_回复414
+int test_parser_too_large()
+{
+    zrsocket::HttpDecoderConfig config;
+    config.update();
+
+    int errors = 0;
+    std::string detail;
+
+    std::string request = "GET / HTTP/1.1\r\nX: " + std::string(config.max_header_length_ + 100, 'a') + "\r\n\r\n";
+    errors += check_rejected(config, request, 431, detail);
+
+    //请求头不完整但已超过max_header_length_
+    request = "GET / HTTP/1.1\r\nX: " + std::string(config.max_header_length_ + 100, 'a');
+    errors += check_rejected(config, request, 431, detail);
+
+    request = "GET / HTTP/1.1\r\n";
+    for (int i = 0; i <= zrsocket::HttpParser::MAX_HEADER_NUM; ++i) {
+        request += "A:b\r\n";
+    }
+    request += "\r\n";
+    errors += check_rejected(config, request, 431, detail);
+
+    request = "GET /" + std::string(config.max_uri_length_, 'u') + " HTTP/1.1\r\n\r\n";
+    errors += check_rejected(config, request, 414, detail);
+
+    //未超过限制的请求正常处理
+    request = "GET / HTTP/1.1\r\nX: " + std::string(config.max_header_length_ / 2, 'a') + "\r\n\r\n";
+    std::vector<std::string> requests;
+    std::string response;
+    if ((run_requests(config, request, 7, &requests, &response) < 0) || (1 != requests.size()) || (200 != response_status(response))) {
+        ++errors;
+        detail += " [in_limit]";
+    }
+
+    return test_report("parser.too_large", 0 == errors, "errors:" + std::to_string(errors) + detail);
+}
+
+//按split_len分段解码chunked body, 返回值: 1完整 0不完整 -1格式错误
+int chunked_decode(const std::string &data, std::size_t split_len, std::string &body, std::size_t &consumed)
+{
+    zrsocket::HttpChunkedDecoder decoder;
+    const char *chunk;
+    zrsocket::uint_t chunk_len;
+    body.clear();
+    consumed = 0;
+    for (std::size_t offset = 0; offset < data.size(); offset += split_len) {
+        const char *p   = data.data() + offset;
+        const char *end = p + std::min(split_len, data.size() - offset);
+        while (p < end) {
+            int ret = decoder.decode(p, end, chunk, chunk_len);
+            if (zrsocket::HttpChunkedDecoder::kData == ret) {
+                body.append(chunk, chunk_len);
+            }
+            else if (zrsocket::HttpChunkedDecoder::kComplete == ret) {
+                consumed = p - data.data();
+                return 1;
+            }
+            else if (zrsocket::HttpChunkedDecoder::kError == ret) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+//HttpChunkedEncoder编码的body由HttpChunkedDecoder按任意分段还原
+int test_chunked_round_trip()
+{
+    std::string body;
+    for (int i = 0; i < 10000; ++i) {
+        body += static_cast<char>('a' + (i * 7) % 26);
+    }
+
+    int errors = 0;
+    std::string detail;
+    for (std::size_t chunk_size : { 1, 7, 256, 4096, 10000 }) {
+        zrsocket::ByteBuffer out;
+        for (std::size_t offset = 0; offset < body.size(); offset += chunk_size) {
+            zrsocket::HttpChunkedEncoder::write_chunk(out, body.data() + offset, static_cast<zrsocket::uint_t>(std::min(chunk_size, body.size() - offset)));
+        }
+        zrsocket::HttpChunkedEncoder::write_last_chunk(out);
+        //之后是下一个请求的数据, 不应被消费
+        std::string encoded = std::string(out.data(), out.data_size()) + "GET";
+
+        for (std::size_t split_len : { static_cast<std::size_t>(1), static_cast<std::size_t>(3), static_cast<std::size_t>(64), encoded.size() }) {
+            std::string decoded;
+            std::size_t consumed;
+            if ((1 != chunked_decode(encoded, split_len, decoded, consumed)) || (decoded != body) || (consumed != encoded.size() - 3)) {
+                ++errors;
+                detail += " [" + std::to_string(chunk_size) + "/" + std::to_string(split_len) + "]";
+            }
+        }
+    }
+    return test_report("chunked.round_trip", 0 == errors, "errors:" + std::to_string(errors) + detail);
+}
+
+//chunk扩展/大写16进制/trailer被正确跳过, 格式错误返回kError
+int test_chunked_format()
+{
+    int errors = 0;
+    std::string detail;
+
+    const std::string data = "5;name=value\r\nhello\r\nA \t;x\r\n0123456789\r\n0\r\nX-Trailer: 1\r\nY: 2\r\n\r\n";
+    for (std::size_t split_len : { static_cast<std::size_t>(1), static_cast<std::size_t>(2), data.size() }) {
+        std::string decoded;
+        std::size_t consumed;
+        if ((1 != chunked_decode(data, split_len, decoded, consumed)) || (decoded != "hello0123456789") || (consumed != data.size())) {
+            ++errors;
+            detail += " [valid/" + std::to_string(split_len) + "]";
+        }
+    }
+
+    const std::string invalid[] = {
+        "\r\n",                                 //没有长度
+        "g\r\n",                                //非16进制
+        "-1\r\n",
+        "1000000000000000\r\n",                 //超过15位
+        "5\n",                                  //没有CR
+        "5\r\nhelloXX",                         //数据后没有CRLF
+        "5\r\nhello\rX",
+        "0\r\n\rX",                             //结束空行没有LF
+        "1;" + std::string(zrsocket::HttpChunkedDecoder::MAX_LINE_LENGTH + 1, 'e') + "\r\n",
+        "0\r\nX: " + std::string(zrsocket::HttpChunkedDecoder::MAX_LINE_LENGTH + 1, 't') + "\r\n\r\n",
+    };
+    int index = 0;
+    for (auto &item : invalid) {
+        for (std::size_t split_len : { static_cast<std::size_t>(1), item.size() }) {
+            std::string decoded;
+            std::size_t consumed;
+            if (-1 != chunked_decode(item, split_len, decoded, consumed)) {
+                ++errors;
+                detail += " [invalid" + std::to_string(index) + "/" + std::to_string(split_len) + "]";
+            }
+        }
+        ++index;
+    }
+    return test_report("chunked.format", 0 == errors, "errors:" + std::to_string(errors) + detail);
+}
+
+//连接上的chunked请求: body拼接后回调do_message, 之后的pipelining请求正常解析
+int test_chunked_request()
+{
+    zrsocket::HttpDecoderConfig config;
+    config.update();
+
+    int errors = 0;
+    std::string detail;
+
+    const std::string data = "POST /c HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n6;ext\r\n world\r\n0\r\nX-Trailer: 1\r\n\r\n"
+        "GET /next HTTP/1.1\r\n\r\n";
+    std::vector<std::string> expected;
+    if ((run_requests(config, data, data.size(), &expected) < 0) || (2 != expected.size()) ||
+        (std::string::npos == expected[0].find("|body:hello world"))) {
+        ++errors;
+        detail += " [single]";
+    }
+    for (std::size_t split_len : { 1, 2, 5, 13 }) {
+        std::vector<std::string> requests;
+        if ((run_requests(config, data, split_len, &requests) < 0) || (requests != expected)) {
+            ++errors;
+            detail += " [" + std::to_string(split_len) + "]";
+        }
+    }
+
+    //同时带Content-Length(请求走私)回复400, body格式错误关闭连接
+    errors += check_rejected(config, "POST /c HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Length: 5\r\n\r\n0\r\n\r\n", 400, detail);
+    errors += check_rejected(config, "POST /c HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n0\r\n\r\n", 400, detail);
+    std::vector<std::string> requests;
+    if ((run_requests(config, "POST /c HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n", 1, &requests) >= 0) || !requests.empty()) {
+        ++errors;
+        detail += " [bad_body]";
+    }
+
+    //chunked body超过max_body_length_关闭连接
+    std::string large = "POST /c HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n";
+    zrsocket::ByteBuffer out;
+    std::string chunk(1000, 'x');
+    for (zrsocket::uint_t len = 0; len <= config.max_body_length_; len += 1000) {
+        zrsocket::HttpChunkedEncoder::write_chunk(out, chunk.data(), 1000);
+    }
+    zrsocket::HttpChunkedEncoder::write_last_chunk(out);
+    large.append(out.data(), out.data_size());
+    if ((run_requests(config, large, 100, &requests) >= 0) || !requests.empty()) {
+        ++errors;
+        detail += " [too_large]";
+    }
+
+    return test_report("chunked.request", 0 == errors, "errors:" + std::to_string(errors) + detail);
+}
+
+typedef std::vector<std::pair<std::string, std::string> > TestHeaderList;
+
+//16进制字符串(可含空格)转为字节
+std::string from_hex(const char *hex)
+{
+    std::string out;
+    int value = -1;
+    for (; '\0' != *hex; ++hex) {
+        if (' ' == *hex) {
+            continue;
+        }
+        int digit = (*hex <= '9') ? (*hex - '0') : ((*hex | 0x20) - 'a' + 10);
+        if (value < 0) {
+            value = digit;
+        }
+        else {
+            out += static_cast<char>((value << 4) | digit);
+            value = -1;
+        }
+    }
+    return out;
+}
+
+int hpack_decode(zrsocket::HpackDecoder &decoder, const std::string &block, TestHeaderList &headers)
+{
+    headers.clear();
+    return decoder.decode(block.data(), static_cast<zrsocket::uint_t>(block.size()),
+        [&headers](const char *name, zrsocket::uint_t name_len, const char *value, zrsocket::uint_t value_len) {
+            headers.emplace_back(std::string(name, name_len), std::string(value, value_len));
+        });
+}
+
+//Huffman编码往返, RFC 7541 C.4.1的编码结果, 非法填充
+int test_hpack_huffman()
+{
+    int errors = 0;
+    std::string detail;
+
+    std::string all;
+    for (int i = 0; i < 256; ++i) {
+        all += static_cast<char>(i);
+    }
+    const std::string inputs[] = { "", "a", "www.example.com", "no-cache", "custom-value", all, all + all };
+    for (auto &input : inputs) {
+        zrsocket::uint_t len = zrsocket::HpackHuffman::encoded_length(input.data(), static_cast<zrsocket::uint_t>(input.size()));
+        std::string encoded(len, '\0');
+        zrsocket::HpackHuffman::encode(input.data(), static_cast<zrsocket::uint_t>(input.size()), &encoded[0]);
+        std::string decoded;
+        if ((zrsocket::HpackHuffman::decode(encoded.data(), len, decoded) < 0) || (decoded != input)) {
+            ++errors;
+            detail += " [round_trip:" + std::to_string(input.size()) + "]";
+        }
+    }
+
+    const std::string input = "www.example.com";
+    std::string encoded(zrsocket::HpackHuffman::encoded_length(input.data(), static_cast<zrsocket::uint_t>(input.size())), '\0');
+    zrsocket::HpackHuffman::encode(input.data(), static_cast<zrsocket::uint_t>(input.size()), &encoded[0]);
+    if (encoded != from_hex("f1e3 c2e5 f23a 6ba0 ab90 f4ff")) {
+        ++errors;
+        detail += " [rfc]";
+    }
+
+    //填充不全为1 / 填充超过7位
+    const std::string invalid[] = { from_hex("00"), from_hex("ffff ffff") };
+    for (auto &item : invalid) {
+        std::string decoded;
+        if (zrsocket::HpackHuffman::decode(item.data(), static_cast<zrsocket::uint_t>(item.size()), decoded) >= 0) {
+            ++errors;
+            detail += " [invalid]";
+        }
+    }
+
+    return test_report("hpack.huffman", 0 == errors, "errors:" + std::to_string(errors) + detail);
+}
+
+//RFC 7541 C.3/C.4: 同一连接上连续的请求header block, 检查解码结果与动态表大小
+int test_hpack_rfc_vectors()
+{
+    struct Block
+    {
+        const char *hex;
+        TestHeaderList headers;
+        zrsocket::uint_t table_size;
+    };
+    const TestHeaderList request1 = { { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" }, { ":authority", "www.example.com" } };
+    TestHeaderList request2 = request1;
+    request2.emplace_back("cache-control", "no-cache");
+    const TestHeaderList request3 = { { ":method", "GET" }, { ":scheme", "https" }, { ":path", "/index.html" },
+        { ":authority", "www.example.com" }, { "custom-key", "custom-value" } };
+
+    const Block plain[] = {
+        { "8286 8441 0f77 7777 2e65 7861 6d70 6c65 2e63 6f6d", request1, 57 },
+        { "8286 84be 5808 6e6f 2d63 6163 6865", request2, 110 },
+        { "8287 85bf 400a 6375 7374 6f6d 2d6b 6579 0c63 7573 746f 6d2d 7661 6c75 65", request3, 164 },
+    };
+    const Block huffman[] = {
+        { "8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff", request1, 57 },
+        { "8286 84be 5886 a8eb 1064 9cbf", request2, 110 },
+        { "8287 85bf 4088 25a8 49e9 5ba9 7d7f 8925 a849 e95b b8e8 b4bf", request3, 164 },
+    };
+
+    int errors = 0;
+    std::string detail;
+    for (auto blocks : { plain, huffman }) {
+        zrsocket::HpackDecoder decoder;
+        decoder.init(4096, 65536);
+        for (int i = 0; i < 3; ++i) {
+            TestHeaderList headers;
+            int ret = hpack_decode(decoder, from_hex(blocks[i].hex), headers);
+            if ((zrsocket::HpackDecoder::kOk != ret) || (headers != blocks[i].headers) || (decoder.table().size() != blocks[i].table_size)) {
+                ++errors;
+                detail += std::string(" [") + ((blocks == plain) ? "plain" : "huffman") + std::to_string(i + 1) + "]";
+            }
+        }
+    }
+    return test_report("hpack.rfc_vectors", 0 == errors, "errors:" + std::to_string(errors) + detail);
+}
+
+//HpackEncoder编码的连续header block由HpackDecoder还原, 动态表在两端保持同步
+int test_hpack_round_trip()
+{
+    const TestHeaderList blocks[] = {
+        { { ":status", "200" }, { "content-type", "text/html" }, { "server", "zrsocket" }, { "content-length", "123" }, { "x-request-id", "1" } },
+        { { ":status", "200" }, { "content-type", "text/html" }, { "server", "zrsocket" }, { "content-length", "456" }, { "x-request-id", "2" } },
+        { { ":status", "404" }, { "set-cookie", "id=secret" }, { "etag", "\"abc\"" }, { "x-long", std::string(300, 'v') } },
+        { { ":status", "302" }, { "location", "/other" }, { "server", "zrsocket" }, { "x-request-id", "3" } },
+        { { ":status", "200" }, { "content-type", "text/html" }, { "server", "zrsocket" } },
+    };
+
+    int errors = 0;
+    std::string detail;
+    zrsocket::HpackEncoder encoder;
+    zrsocket::HpackDecoder decoder;
+    encoder.reset();
+    decoder.init(4096, 65536);
+    std::size_t block_len[5];
+    for (int i = 0; i < 5; ++i) {
+        if (3 == i) {
+            //对端缩小SETTINGS_HEADER_TABLE_SIZE: 下一个block开头输出Dynamic Table Size Update
+            encoder.set_max_table_size(256);
+        }
+        zrsocket::ByteBuffer out;
+        encoder.begin(out);
+        for (auto &header : blocks[i]) {
+            if (":status" == header.first) {
+                encoder.encode_status(out, std::atoi(header.second.c_str()));
+            }
+            else {
+                encoder.encode(out, header.first.data(), static_cast<zrsocket::uint_t>(header.first.size()),
+                    header.second.data(), static_cast<zrsocket::uint_t>(header.second.size()));
+            }
+        }
+        block_len[i] = out.data_size();
+
+        TestHeaderList headers;
+        int ret = hpack_decode(decoder, std::string(out.data(), out.data_size()), headers);
+        if ((zrsocket::HpackDecoder::kOk != ret) || (headers != blocks[i])) {
+            ++errors;
+            detail += " [block" + std::to_string(i) + "]";
+        }
+    }
+
+    //重复的header引用动态表, 编码明显变短
+    if (block_len[1] * 2 > block_len[0]) {
+        ++errors;
+        detail += " [no_reuse:" + std::to_string(block_len[0]) + "/" + std::to_string(block_len[1]) + "]";
+    }
+    if (decoder.table().max_size() != 256) {
+        ++errors;
+        detail += " [table_size:" + std::to_string(decoder.table().max_size()) + "]";
+    }
+
+    return test_report("hpack.round_trip", 0 == errors, "errors:" + std::to_string(errors) + detail);
+}
+
+//非法header block返回kCompressionError, 超过max_header_list_size返回kTooLarge且动态表仍同步
+int test_hpack_errors()
+{
+    int errors = 0;
+    std::string detail;
+
+    const char *invalid[] = {
+        "80",               //索引0
+        "be",               //索引62, 动态表为空
+        "82 20",            //Dynamic Table Size Update不在block开头
+        "3f e1 3f",         //Size Update 8192超过本端上限4096
+        "40 05 61 62",      //字符串不完整
+        "ff ff ff ff ff ff",//整数不完整
+    };
+    for (auto hex : invalid) {
+        zrsocket::HpackDecoder decoder;
+        decoder.init(4096, 65536);
+        TestHeaderList headers;
+        if (zrsocket::HpackDecoder::kCompressionError != hpack_decode(decoder, from_hex(hex), headers)) {
+            ++errors;
+            detail += std::string(" [") + hex + "]";
+        }
+    }
+
+    zrsocket::HpackDecoder decoder;
+    decoder.init(4096, 64);
+    TestHeaderList headers;
+    int ret = hpack_decode(decoder, from_hex("400a 6375 7374 6f6d 2d6b 6579 0c63 7573 746f 6d2d 7661 6c75 65 4001 7801 79"), headers);
+    if ((zrsocket::HpackDecoder::kTooLarge != ret) || (1 != headers.size()) || (2 != decoder.table().count())) {
+        ++errors;
+        detail += " [too_large]";
+    }
+    //未回调的header也已加入动态表
+    ret = hpack_decode(decoder, from_hex("be"), headers);
+    if ((zrsocket::HpackDecoder::kOk != ret) || (1 != headers.size()) || (headers[0].first != "x")) {
+        ++errors;
+        detail += " [after_too_large]";
+    }
+    ret = hpack_decode(decoder, from_hex("bf"), headers);
+    if ((zrsocket::HpackDecoder::kOk != ret) || (1 != headers.size()) || (headers[0].first != "custom-key")) {
+        ++errors;
+        detail += " [after_too_large]";
+    }
+
+    return test_report("hpack.errors", 0 == errors, "errors:" + std::to_string(errors) + detail);
+}
+
+//WebSocket帧头编解码, 掩码, 握手accept key, UTF-8与关闭码校验
+int test_websocket_frame()
+{
+    int errors = 0;
+    std::string detail;
+
+    for (uint64_t payload_length : { 0ULL, 125ULL, 126ULL, 65535ULL, 65536ULL, 1ULL << 32 }) {
+        char header[zrsocket::WebSocketFrame::MAX_HEADER_LENGTH];
+        zrsocket::uint_t header_length = zrsocket::WebSocketFrame::write_header(header, zrsocket::WebSocketOpcode::kBinary, false, payload_length);
+        zrsocket::WebSocketFrameHeader frame_header;
+        bool ok = (header_length == zrsocket::WebSocketFrame::header_length(payload_length));
+        for (zrsocket::uint_t len = 0; ok && (len < header_length); ++len) {
+            ok = (0 == zrsocket::WebSocketFrame::parse_header(header, len, frame_header));
+        }
+        ok = ok && (static_cast<int>(header_length) == zrsocket::WebSocketFrame::parse_header(header, header_length, frame_header))
+            && !frame_header.fin_ && !frame_header.masked_ && (0 == frame_header.rsv_)
+            && (static_cast<uint8_t>(zrsocket::WebSocketOpcode::kBinary) == frame_header.opcode_)
+            && (payload_length == frame_header.payload_length_);
+        if (!ok) {
+            ++errors;
+            detail += " [length:" + std::to_string(payload_length) + "]";
+        }
+    }
+
+    //RFC 6455 5.7: 带掩码的"Hello"
+    std::string frame = from_hex("8185 37fa 213d 7f9f 4d51 58");
+    zrsocket::WebSocketFrameHeader frame_header;
+    int header_length = zrsocket::WebSocketFrame::parse_header(frame.data(), static_cast<zrsocket::uint_t>(frame.size()), frame_header);
+    if ((6 != header_length) || !frame_header.fin_ || !frame_header.masked_ || (5 != frame_header.payload_length_)) {
+        ++errors;
+        detail += " [masked]";
+    }
+    else {
+        zrsocket::Simd::xor_mask(&frame[header_length], 5, frame_header.mask_);
+        if (frame.compare(header_length, 5, "Hello") != 0) {
+            ++errors;
+            detail += " [unmask]";
+        }
+    }
+
+    //64位长度的最高位须为0
+    frame = from_hex("827f 8000 0000 0000 0000");
+    if (zrsocket::WebSocketFrame::parse_header(frame.data(), static_cast<zrsocket::uint_t>(frame.size()), frame_header) >= 0) {
+        ++errors;
+        detail += " [length_msb]";
+    }
+
+    //RFC 6455 1.3
+    char accept[zrsocket::WebSocketFrame::ACCEPT_LENGTH];
+    zrsocket::WebSocketFrame::accept_key("dGhlIHNhbXBsZSBub25jZQ==", 24, accept);
+    if (std::string(accept, sizeof(accept)) != "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") {
+        ++errors;
+        detail += " [accept_key]";
+    }
+
+    const std::string valid_utf8[] = { "", "Hello-\xc2\xb5@\xc3\x9f\xc3\xb6\xc3\xa4-UTF-8!!", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "\xf4\x8f\xbf\xbf" };
+    const std::string invalid_utf8[] = { "\xc0\xaf", "\xe0\x80\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\xe2\x82", "abcdefgh\x80", "\xff" };
+    for (auto &item : valid_utf8) {
+        if (!zrsocket::WebSocketFrame::valid_utf8(item.data(), static_cast<zrsocket::uint_t>(item.size()))) {
+            ++errors;
+            detail += " [utf8_valid]";
+        }
+    }
+    for (auto &item : invalid_utf8) {
+        if (zrsocket::WebSocketFrame::valid_utf8(item.data(), static_cast<zrsocket::uint_t>(item.size()))) {
+            ++errors;
+            detail += " [utf8_invalid]";
+        }
+    }
+
+    for (uint16_t code : { 1000, 1001, 1011, 3000, 4999 }) {
+        if (!zrsocket::WebSocketFrame::valid_close_code(code)) {
+            ++errors;
+            detail += " [close:" + std::to_string(code) + "]";
+        }
+    }
+    for (uint16_t code : { 0, 999, 1004, 1005, 1006, 1015, 2999, 5000 }) {
+        if (zrsocket::WebSocketFrame::valid_close_code(code)) {
+            ++errors;
+            detail += " [close:" + std::to_string(code) + "]";
+        }
+    }
+
+    return test_report("websocket.frame", 0 == errors, "errors:" + std::to_string(errors) + detail);
+}
+
+typedef zrsocket::HttpRouter<TestHttpHandler> TestHttpRouter;
+
+int on_route_hello(TestHttpHandler &, zrsocket::HttpContext &, const zrsocket::HttpRouteParams &)
+{
+    return 1;
+}
+
+int on_route_me(TestHttpHandler &, zrsocket::HttpContext &, const zrsocket::HttpRouteParams &)
+{
+    return 2;
+}
+
+int on_route_user(TestHttpHandler &, zrsocket::HttpContext &, const zrsocket::HttpRouteParams &)
+{
+    return 3;
+}
+
+int on_route_post(TestHttpHandler &, zrsocket::HttpContext &, const zrsocket::HttpRouteParams &)
+{
+    return 4;
+}
+
+int on_route_static(TestHttpHandler &, zrsocket::HttpContext &, const zrsocket::HttpRouteParams &)
+{
+    return 5;
+}
+
+//静态/参数/通配路由的匹配与优先级, 405/404, 非法模式(build前后结果相同)
+int test_router()
+{
+    TestHttpRouter router;
+    int errors = 0;
+    std::string detail;
+
+    if ((router.add(zrsocket::HttpMethodId::kGET, "/hello", on_route_hello) < 0) ||
+        (router.add(zrsocket::HttpMethodId::kGET, "/users/me", on_route_me) < 0) ||
+        (router.add(zrsocket::HttpMethodId::kGET, "/users/:id", on_route_user) < 0) ||
+        (router.add(zrsocket::HttpMethodId::kPOST, "/users/:id", on_route_user) < 0) ||
+        (router.add(zrsocket::HttpMethodId::kGET, "/users/:id/posts/:post", on_route_post) < 0) ||
+        (router.add(zrsocket::HttpMethodId::kGET, "/static/*path", on_route_static) < 0)) {
+        ++errors;
+        detail += " [add]";
+    }
+
+    const char *invalid[] = { "", "hello", "/a/:", "/a/*", "/a/*path/b" };
+    for (auto pattern : invalid) {
+        if (router.add(zrsocket::HttpMethodId::kGET, pattern, on_route_hello) >= 0) {
+            ++errors;
+            detail += std::string(" [invalid:") + pattern + "]";
+        }
+    }
+
+    struct Case
+    {
+        zrsocket::HttpMethodId method;
+        const char *uri;
+        int proc;                           //期望的处理函数返回值, 0: 未找到
+        zrsocket::HttpRouteResult result;
+        const char *param_name;
+        const char *param_value;
+    };
+    const Case cases[] = {
+        { zrsocket::HttpMethodId::kGET,    "/hello",               1, zrsocket::HttpRouteResult::kFound, nullptr, nullptr },
+        { zrsocket::HttpMethodId::kGET,    "/hello?a=1",           1, zrsocket::HttpRouteResult::kFound, nullptr, nullptr },
+        { zrsocket::HttpMethodId::kGET,    "/users/me",            2, zrsocket::HttpRouteResult::kFound, nullptr, nullptr },
+        { zrsocket::HttpMethodId::kGET,    "/users/42",            3, zrsocket::HttpRouteResult::kFound, "id", "42" },
+        { zrsocket::HttpMethodId::kPOST,   "/users/42?x=y",        3, zrsocket::HttpRouteResult::kFound, "id", "42" },
+        { zrsocket::HttpMethodId::kGET,    "/users/42/posts/7",    4, zrsocket::HttpRouteResult::kFound, "post", "7" },
+        { zrsocket::HttpMethodId::kGET,    "/static/css/a.css",    5, zrsocket::HttpRouteResult::kFound, "path", "css/a.css" },
+        { zrsocket::HttpMethodId::kDELETE, "/hello",               0, zrsocket::HttpRouteResult::kMethodNotAllowed, nullptr, nullptr },
+        { zrsocket::HttpMethodId::kDELETE, "/users/42",            0, zrsocket::HttpRouteResult::kMethodNotAllowed, nullptr, nullptr },
+        { zrsocket::HttpMethodId::kGET,    "/users/",              0, zrsocket::HttpRouteResult::kNotFound, nullptr, nullptr },
+        { zrsocket::HttpMethodId::kGET,    "/users/42/posts",      0, zrsocket::HttpRouteResult::kNotFound, nullptr, nullptr },
+        { zrsocket::HttpMethodId::kGET,    "/hello/",              0, zrsocket::HttpRouteResult::kNotFound, nullptr, nullptr },
+        { zrsocket::HttpMethodId::kGET,    "/nope",                0, zrsocket::HttpRouteResult::kNotFound, nullptr, nullptr },
+    };
+
+    TestHttpHandler handler;
+    zrsocket::HttpContext context;
+    zrsocket::HttpRouteParams params;
+    for (int built = 0; built < 2; ++built) {
+        if (built && (router.build() < 0)) {
+            ++errors;
+            detail += " [build]";
+        }
+        for (auto &item : cases) {
+            zrsocket::HttpRouteResult result;
+            TestHttpRouter::RouteProc proc = router.find(item.method, item.uri, static_cast<zrsocket::uint_t>(std::strlen(item.uri)), params, result);
+            int ret = (nullptr != proc) ? proc(handler, context, params) : 0;
+            bool ok = (ret == item.proc) && (result == item.result);
+            if (ok && (nullptr != item.param_name)) {
+                zrsocket::HttpStringView value = params.get(item.param_name, static_cast<zrsocket::uint_t>(std::strlen(item.param_name)));
+                ok = (value.to_string() == item.param_value);
+            }
+            if (!ok) {
+                ++errors;
+                detail += std::string(" [") + (built ? "built:" : "") + item.uri + "]";
+            }
+        }
+    }
+
+    return test_report("router.match", 0 == errors, "errors:" + std::to_string(errors) + detail);
+}
+
+int main(int argc, char* argv[])
+{
+    int failed = 0;
+    failed += test_parser_split();
+    failed += test_parser_bad_request_line();
+    failed += test_parser_ctl();
+    failed += test_parser_too_large();
+    failed += test_chunked_round_trip();
+    failed += test_chunked_format();
+    failed += test_chunked_request();
+    failed += test_hpack_huffman();
+    failed += test_hpack_rfc_vectors();
+    failed += test_hpack_round_trip();
+    failed += test_hpack_errors();
+    failed += test_websocket_frame();
+    failed += test_router();
+
+    printf("test_http failed:%d\n", failed);
+    return failed;
+}
@@ -0,0 +1,45 @@
+﻿#pragma once
+
+#ifndef TEST_HTTP_H
+#define TEST_HTTP_H
+#include <string>
+#include <vector>
+#include "zrsocket/zrsocket.h"
+
+//测试用的连接来源: 只提供解码配置
+class TestHttpSource : public zrsocket::EventSource
+{
+public:
+    TestHttpSource(zrsocket::HttpDecoderConfig *config)
+    {
+        message_decoder_config_ = config;
+    }
+};
+
+//记录解码出的请求, 回复由基类自动完成
+class TestHttpHandler : public zrsocket::HttpRequestHandler<zrsocket::ByteBuffer, zrsocket::NullMutex>
+{
+public:
+    int do_message()
+    {
+        auto &request = context_.request_;
+        std::string s = std::to_string(static_cast<int>(request.method_id_)) + "|" + request.uri_ + "|" + std::to_string(static_cast<int>(request.version_id_));
+        for (auto &iter : request.headers_) {
+            s += "|" + iter.name_.to_string() + "=" + iter.value_.to_string();
+        }
+        if (request.content_length_ > 0) {
+            s += "|body:" + std::string(request.body_ptr_, request.content_length_);
+        }
+        requests_.push_back(s);
+        return 0;
+    }
+
+    inline int feed(const char *data, zrsocket::uint_t len)
+    {
+        return decode(data, len);
+    }
+
+    std::vector<std::string> requests_;
+};
+
+#endif
@@ -1,3 +1,5 @@
+#include <chrono>
+#include <thread>
 #include "biz_stage_handler.h"
 #include "test_seda.h"
 
@@ -112,3 +114,50 @@ int BizStageHandler::handle_event(const zrsocket::SedaEvent *event)
 
     return 0;
 }
+
+int FeatureStageHandler::handle_event(const zrsocket::SedaEvent *event)
+{
+    TestApp &app = TestApp::instance();
+
+    int type = event->type();
+    if ((type != TestEventType::EVENT_TEST8) && (type != TestEventType::EVENT_TEST_TIMESTAMP)) {
+        return 0;
+    }
+
+    app.feature_entered_.fetch_add(1, std::memory_order_relaxed);
+    while (!app.feature_gate_.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+
+    if (type == TestEventType::EVENT_TEST8) {
+        const Test8SedaEvent *test8_event = static_cast<const Test8SedaEvent *>(event);
+        int key = test8_event->command;
+        if ((key >= 0) && (key < TestApp::FEATURE_KEY_COUNT)) {
+            int thread_index = static_cast<int>(stage_thread_->get_thread_index());
+            int key_thread = app.feature_key_thread_[key].load(std::memory_order_relaxed);
+            if (key_thread < 0) {
+                app.feature_key_thread_[key].store(thread_index, std::memory_order_relaxed);
+            }
+            else if (key_thread != thread_index) {
+                app.feature_order_errors_.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (test8_event->sequence != app.feature_last_sequence_[key].load(std::memory_order_relaxed) + 1) {
+                app.feature_order_errors_.fetch_add(1, std::memory_order_relaxed);
+            }
+            app.feature_last_sequence_[key].store(test8_event->sequence, std::memory_order_relaxed);
+        }
+    }
+
+    zrsocket::uint_t sleep_us = app.feature_sleep_us_.load(std::memory_order_relaxed);
+    if (sleep_us > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(sleep_us));
+    }
+    app.feature_handled_.fetch_add(1, std::memory_order_release);
+    return 0;
+}
+
+int FeatureStageHandler::handle_expired(const zrsocket::SedaEvent *event, uint64_t age_ns)
+{
+    TestApp::instance().feature_expired_.fetch_add(1, std::memory_order_release);
+    return 0;
+}
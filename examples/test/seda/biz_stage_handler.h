@@ -1,4 +1,4 @@
-#pragma once
+﻿#pragma once
 #include "zrsocket/zrsocket.h"
 
 class BizStageHandler : public zrsocket::SedaStageHandler
@@ -16,3 +16,15 @@ private:
 
     zrsocket::uint_t handle_num_ = 0;
 };
+
+//扩展功能测试(test_seda features)的handler
+//  EVENT_TEST8: command >= 0时为按键分派的key, sequence为该key内的序号
+class FeatureStageHandler : public zrsocket::SedaStageHandler
+{
+public:
+    FeatureStageHandler() = default;
+    virtual ~FeatureStageHandler() = default;
+
+    virtual int handle_event(const zrsocket::SedaEvent *event);
+    virtual int handle_expired(const zrsocket::SedaEvent *event, uint64_t age_ns);
+};
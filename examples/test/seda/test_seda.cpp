@@ -8,6 +8,7 @@
 #include <thread>
 #include <vector>
 #include <chrono>
+#include <cstring>
 #include <sstream>
 #include "test_seda.h"
 
@@ -168,8 +169,325 @@ int send_to_remote(void *context, const char *log, zrsocket::uint_t len)
     return 0;
 }
 
+//////////////////////////////////////////////////////////////////////////
+//扩展功能测试: test_seda features
+//  各场景结果确定, 打印ok/FAILED, 返回失败的场景数
+
+void TestApp::feature_reset()
+{
+    feature_gate_.store(true);
+    feature_entered_.store(0);
+    feature_handled_.store(0);
+    feature_expired_.store(0);
+    feature_order_errors_.store(0);
+    feature_sleep_us_.store(0);
+    for (int i = 0; i < FEATURE_KEY_COUNT; ++i) {
+        feature_last_sequence_[i].store(-1);
+        feature_key_thread_[i].store(-1);
+    }
+}
+
+//等待条件成立, 超时(5s)返回false
+template <typename TPred>
+bool feature_wait(TPred pred)
+{
+    for (int i = 0; i < 5000; ++i) {
+        if (pred()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return pred();
+}
+
+int feature_report(const char *name, bool ok, const std::string &detail)
+{
+    printf("%-28s %s %s\n", name, ok ? "ok" : "FAILED", detail.c_str());
+    return ok ? 0 : 1;
+}
+
+//work stealing: 一批事件放入一个线程的共享队列, 空闲的兄弟线程窃取分担; 关闭时共享队列中剩余的事件仍被处理
+int test_work_stealing()
+{
+    TestApp &app = TestApp::instance();
+    int failed = 0;
+    {
+        app.feature_reset();
+        app.feature_sleep_us_.store(100);
+        zrsocket::SedaStage<FeatureStageHandler> stage;
+        stage.enable_work_stealing(8, 2);
+        stage.open(4, 4096, 32);
+
+        const int BATCH = 64;
+        std::vector<Test8SedaEvent> events(BATCH);
+        std::vector<const zrsocket::SedaEvent *> ptrs(BATCH);
+        for (int i = 0; i < BATCH; ++i) {
+            events[i].command  = -1;
+            events[i].sequence = i;
+            ptrs[i] = &events[i];
+        }
+        int pushed = stage.push_events(ptrs.data(), BATCH);
+        feature_wait([&] { return app.feature_handled_.load() >= static_cast<zrsocket::uint_t>(pushed); });
+
+        std::ostringstream detail;
+        detail << "pushed:" << pushed << " handled:" << app.feature_handled_.load() << " stolen:" << stage.stolen_count();
+        failed += feature_report("work_stealing.steal", (BATCH == pushed) && (app.feature_handled_.load() == BATCH) && (stage.stolen_count() > 0), detail.str());
+        stage.close();
+    }
+    {
+        app.feature_reset();
+        app.feature_sleep_us_.store(20);
+        zrsocket::SedaStage<FeatureStageHandler> stage;
+        stage.enable_work_stealing(8, 2);
+        stage.open(4, 4096, 32);
+
+        Test8SedaEvent event;
+        event.command = -1;
+        int pushed = 0;
+        for (int i = 0; i < 2000; ++i) {
+            event.sequence = i;
+            if (stage.push_event(&event) >= 0) {
+                ++pushed;
+            }
+        }
+        stage.close();
+
+        std::ostringstream detail;
+        detail << "pushed:" << pushed << " handled:" << app.feature_handled_.load();
+        failed += feature_report("work_stealing.close_drain", app.feature_handled_.load() == static_cast<zrsocket::uint_t>(pushed), detail.str());
+    }
+    return failed;
+}
+
+//按键分派: 相同key的事件总在同一线程按放入顺序处理(work stealing模式下也不被窃取)
+int test_key_affinity()
+{
+    TestApp &app = TestApp::instance();
+    app.feature_reset();
+    zrsocket::SedaStage<FeatureStageHandler> stage;
+    stage.enable_work_stealing(8, 2);
+    stage.open(4, 4096, 32);
+
+    const int TIMES = 4000;
+    int sequence[TestApp::FEATURE_KEY_COUNT] = { 0 };
+    Test8SedaEvent event;
+    for (int i = 0; i < TIMES; ++i) {
+        int key = i % TestApp::FEATURE_KEY_COUNT;
+        event.command  = static_cast<short>(key);
+        event.sequence = sequence[key]++;
+        while (stage.push_event_by_key(&event, static_cast<uint64_t>(key)) < 0) {
+            std::this_thread::yield();
+        }
+    }
+    feature_wait([&] { return app.feature_handled_.load() >= TIMES; });
+
+    std::ostringstream detail;
+    detail << "handled:" << app.feature_handled_.load() << " order_errors:" << app.feature_order_errors_.load() << " stolen:" << stage.stolen_count();
+    int failed = feature_report("key_affinity.order", (app.feature_handled_.load() == TIMES) && (0 == app.feature_order_errors_.load()), detail.str());
+    stage.close();
+    return failed;
+}
+
+//park/wake: 队列为空时线程停放(条件等待, 最长1s), 放入事件须立即唤醒线程
+//  唤醒丢失时事件要等到停放超时才被处理: 以200ms为界判断
+//  竞争: 每个事件处理完后间隔0~49us再放入, 使放入落在线程进入停放的不同阶段
+int test_park_wake(const char *name, bool work_stealing)
+{
+    TestApp &app = TestApp::instance();
+    app.feature_reset();
+    zrsocket::SedaStage<FeatureStageHandler> stage;
+    if (work_stealing) {
+        stage.enable_work_stealing(8, 2);
+    }
+    stage.open(work_stealing ? 2 : 1, 4096, 32, 1000000);
+
+    auto wait_handled = [&](zrsocket::uint_t count) -> bool {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+        while (app.feature_handled_.load() < count) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    };
+
+    //线程停放后放入
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    Test8SedaEvent event;
+    event.command = -1;
+    stage.push_event(&event);
+    bool woken = wait_handled(1);
+
+    const int TIMES = 2000;
+    int lost = 0;
+    for (int i = 0; (i < TIMES) && (0 == lost); ++i) {
+        auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(i % 50);
+        while (std::chrono::steady_clock::now() < until) {
+        }
+        stage.push_event(&event);
+        if (!wait_handled(2 + i)) {
+            ++lost;
+            feature_wait([&] { return app.feature_handled_.load() >= static_cast<zrsocket::uint_t>(2 + i); });
+        }
+    }
+
+    std::ostringstream detail;
+    detail << "woken:" << woken << " handled:" << app.feature_handled_.load() << " lost_wakeups:" << lost;
+    int failed = feature_report(name, woken && (0 == lost) && (app.feature_handled_.load() == 1 + TIMES), detail.str());
+    stage.close();
+    return failed;
+}
+
+//批量放入: 队列剩余空间不足时只放入能容纳的部分, 返回放入的个数; 队列满时返回0
+int test_batch_partial()
+{
+    TestApp &app = TestApp::instance();
+    app.feature_reset();
+    app.feature_gate_.store(false);
+    zrsocket::SedaStage<FeatureStageHandler> stage;
+    stage.open(1, 16, 32);
+
+    //首个事件阻塞在handler中, 之后的事件积压在队列
+    Test8SedaEvent first;
+    first.command = -1;
+    stage.push_event(&first);
+    feature_wait([&] { return app.feature_entered_.load() >= 1; });
+
+    const int BATCH = 64;
+    std::vector<Test8SedaEvent> events(BATCH);
+    std::vector<const zrsocket::SedaEvent *> ptrs(BATCH);
+    for (int i = 0; i < BATCH; ++i) {
+        events[i].command  = -1;
+        events[i].sequence = i;
+        ptrs[i] = &events[i];
+    }
+    int partial = stage.push_events(ptrs.data(), BATCH);
+    int full    = stage.push_events(ptrs.data(), BATCH);
+
+    app.feature_gate_.store(true);
+    feature_wait([&] { return app.feature_handled_.load() >= static_cast<zrsocket::uint_t>(1 + partial); });
+
+    std::ostringstream detail;
+    detail << "partial:" << partial << " full:" << full << " handled:" << app.feature_handled_.load();
+    int failed = feature_report("batch.partial_fill", (partial > 0) && (partial < BATCH) && (0 == full) &&
+        (app.feature_handled_.load() == static_cast<zrsocket::uint_t>(1 + partial)), detail.str());
+    stage.close();
+    return failed;
+}
+
+//pipeline背压: 下游积压超过高水位时, REJECT策略返回REJECTED, SHED策略丢弃非高优先级事件, BLOCK策略等待超时后返回TIMEOUT
+//  下游恢复(积压低于低水位)后放入成功
+int test_pipeline_policy(const char *name, int policy, int expected)
+{
+    TestApp &app = TestApp::instance();
+    app.feature_reset();
+    app.feature_gate_.store(false);
+    zrsocket::SedaStage<FeatureStageHandler> stage;
+    stage.open(1, 4096, 32);
+
+    zrsocket::SedaPipeline pipeline;
+    int stage_id = pipeline.add_stage("downstream", &stage);
+    int edge_id  = pipeline.add_edge(zrsocket::SedaPipeline::SOURCE, stage_id, policy, 8, 0, 20);
+    int ret = pipeline.validate();
+
+    Test8SedaEvent event;
+    event.command = -1;
+    int accepted = 0;
+    for (int i = 0; (0 == ret) && (i < 100); ++i) {
+        ret = pipeline.push_event(edge_id, &event, zrsocket::SedaPriority::LOW_PRIORITY);
+        if (ret >= 0) {
+            ++accepted;
+        }
+    }
+    int high = pipeline.push_event(edge_id, &event, zrsocket::SedaPriority::HIGH_PRIORITY);
+
+    app.feature_gate_.store(true);
+    feature_wait([&] { return 0 == stage.event_count(); });
+    int recovered = pipeline.push_event(edge_id, &event, zrsocket::SedaPriority::LOW_PRIORITY);
+
+    const zrsocket::SedaPipeline::Edge *edge = pipeline.edge(edge_id);
+    std::ostringstream detail;
+    detail << "accepted:" << accepted << " ret:" << ret << " high:" << high << " recovered:" << recovered
+        << " rejected:" << edge->rejected_.load() << " shed:" << edge->shed_.load() << " blocked:" << edge->blocked_.load();
+    bool ok = (expected == ret) && (accepted >= 8) && (recovered >= 0);
+    switch (policy) {
+    case zrsocket::SedaOverloadPolicy::REJECT:
+        ok = ok && (zrsocket::SedaPushResult::REJECTED == high) && (2 == edge->rejected_.load());
+        break;
+    case zrsocket::SedaOverloadPolicy::SHED:
+        ok = ok && (high >= 0) && (1 == edge->shed_.load());
+        break;
+    default:
+        ok = ok && (zrsocket::SedaPushResult::TIMEOUT == high) && (2 == edge->blocked_.load()) && (2 == edge->rejected_.load());
+        break;
+    }
+    int failed = feature_report(name, ok, detail.str());
+    stage.close();
+    return failed;
+}
+
+int test_pipeline()
+{
+    int failed = 0;
+    failed += test_pipeline_policy("pipeline.reject", zrsocket::SedaOverloadPolicy::REJECT, zrsocket::SedaPushResult::REJECTED);
+    failed += test_pipeline_policy("pipeline.shed",   zrsocket::SedaOverloadPolicy::SHED,   zrsocket::SedaPushResult::SHED);
+    failed += test_pipeline_policy("pipeline.block",  zrsocket::SedaOverloadPolicy::BLOCK,  zrsocket::SedaPushResult::TIMEOUT);
+    return failed;
+}
+
+//事件过期: 排队超过截止时间的事件交由handle_expired处理, expired_count计数
+int test_expired()
+{
+    TestApp &app = TestApp::instance();
+    app.feature_reset();
+    app.feature_gate_.store(false);
+    zrsocket::SedaStage<FeatureStageHandler> stage;
+    stage.set_event_deadline(TestEventType::EVENT_TEST_TIMESTAMP, 1000);
+    stage.open(1, 4096, 32);
+
+    //首个事件阻塞在handler中, 之后的事件排队超过1ms
+    TestTimestampSedaEvent event;
+    stage.push_event(&event);
+    feature_wait([&] { return app.feature_entered_.load() >= 1; });
+    const int EXPIRED = 10;
+    for (int i = 0; i < EXPIRED; ++i) {
+        event.sequence = i + 1;
+        stage.push_event(&event);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    app.feature_gate_.store(true);
+    feature_wait([&] { return app.feature_handled_.load() + app.feature_expired_.load() >= 1 + EXPIRED; });
+
+    std::ostringstream detail;
+    detail << "handled:" << app.feature_handled_.load() << " expired:" << app.feature_expired_.load() << " expired_count:" << stage.expired_count();
+    int failed = feature_report("event_age.expired", (1 == app.feature_handled_.load()) && (EXPIRED == app.feature_expired_.load()) &&
+        (EXPIRED == stage.expired_count()), detail.str());
+    stage.close();
+    return failed;
+}
+
+int test_seda_features()
+{
+    int failed = 0;
+    failed += test_work_stealing();
+    failed += test_key_affinity();
+    failed += test_park_wake("park_wake.single", false);
+    failed += test_park_wake("park_wake.work_stealing", true);
+    failed += test_batch_partial();
+    failed += test_pipeline();
+    failed += test_expired();
+    printf("features failed:%d\n", failed);
+    return failed;
+}
+
 int main(int argc, char* argv[])
 {
+    //test_seda features: 运行扩展功能测试
+    if ((argc > 1) && (0 == std::strcmp(argv[1], "features"))) {
+        return test_seda_features();
+    }
+
 #if 1    
     ZRSOCKET_NANOLOG_BODY(zrsocket::LogLevel::kDEBUG, "{},{}", "name", 100);
 
@@ -14,6 +14,7 @@ struct TestEventType
     {
         EVENT_TEST8  = zrsocket::SedaEventTypeId::USER_START_NUMBER,
         EVENT_TEST16,
+        EVENT_TEST_TIMESTAMP,
     };
 };
 
@@ -44,6 +45,20 @@ struct Test16SedaEvent : public zrsocket::SedaEvent
     inline ~Test16SedaEvent() = default;
 };
 
+//带时间戳的事件(SedaStage::set_event_deadline跟踪排队时延)
+struct TestTimestampSedaEvent : public zrsocket::TimestampEventType
+{
+    int sequence = 0;
+
+    inline TestTimestampSedaEvent()
+        : zrsocket::TimestampEventType(TestEventType::EVENT_TEST_TIMESTAMP)
+    {
+        len_ = sizeof(TestTimestampSedaEvent);
+    }
+
+    inline ~TestTimestampSedaEvent() = default;
+};
+
 //#pragma pack(pop)   //恢复对齐状态
 
 class TestApp : public zrsocket::Application<TestApp, zrsocket::SpinMutex>
@@ -92,6 +107,19 @@ public:
     int num_times_          = 10000000;
 
     zrsocket::SteadyClockCounter test_counter_;
+
+    //扩展功能测试(test_seda features)的状态, 由FeatureStageHandler更新
+    static constexpr int FEATURE_KEY_COUNT = 8;
+    void feature_reset();
+
+    zrsocket::AtomicBool feature_gate_          = ATOMIC_VAR_INIT(true);  //false: 事件处理前等待(使队列积压)
+    zrsocket::AtomicUInt feature_entered_       = ATOMIC_VAR_INIT(0);     //进入handle_event的事件数
+    zrsocket::AtomicUInt feature_handled_       = ATOMIC_VAR_INIT(0);
+    zrsocket::AtomicUInt feature_expired_       = ATOMIC_VAR_INIT(0);     //交由handle_expired处理的事件数
+    zrsocket::AtomicUInt feature_order_errors_  = ATOMIC_VAR_INIT(0);     //按键分派: 乱序或线程不一致的事件数
+    zrsocket::AtomicUInt feature_sleep_us_      = ATOMIC_VAR_INIT(0);     //每个事件的处理时间
+    zrsocket::AtomicInt  feature_last_sequence_[FEATURE_KEY_COUNT];
+    zrsocket::AtomicInt  feature_key_thread_[FEATURE_KEY_COUNT];
 };
 
 #endif
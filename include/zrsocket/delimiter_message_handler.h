@@ -0,0 +1,219 @@
+﻿// Some compilers (e.g. VC++) benefit significantly from using this. 
+// We've measured 3-4% build speed improvements in apps as a result 
+#pragma once
+
+#ifndef ZRSOCKET_DELIMITER_MESSAGE_HANDLER
+#define ZRSOCKET_DELIMITER_MESSAGE_HANDLER
+#include <string>
+#include "message_common.h"
+#include "message_handler.h"
+#include "simd.h"
+
+ZRSOCKET_NAMESPACE_BEGIN
+
+class DelimiterMessageDecoderConfig : public MessageDecoderConfig
+{
+public:
+    DelimiterMessageDecoderConfig() = default;
+    virtual ~DelimiterMessageDecoderConfig() = default;
+
+    int update()
+    {
+        if (delimiter_.empty()) {
+            delimiter_ = "\r\n";
+        }
+        return 0;
+    }
+
+public:
+    //分隔符(可多字节, 如"\r\n")
+    std::string delimiter_          = "\r\n";
+    //最大帧长度(不含分隔符), 超过时关闭连接
+    uint_t      max_frame_length_   = 4096;
+    //回调的消息是否去掉分隔符
+    bool        strip_delimiter_    = true;
+};
+
+//按分隔符切分消息
+//  分隔符查找使用SIMD(AVX2/SSE2, 不支持时退化为标量)
+//  完整落在本次接收数据中的帧直接以指针回调(零拷贝), 只有跨越多次接收的帧才拷贝到消息缓存
+//TDerived: 为void时通过虚函数回调do_message(s);
+//  为派生类类型时(CRTP)直接调用TDerived::do_messages/do_message(非虚调用, 可内联)
+template <class TSendBuffer, class TMutex, class TDerived = void>
+class DelimiterMessageHandler : public MessageHandler<TSendBuffer, TMutex>
+{
+public:
+    virtual int do_open()
+    {
+        return 0;
+    }
+
+    virtual int do_close()
+    {
+        return 0;
+    }
+
+    virtual int do_connect()
+    {
+        return 0;
+    }
+
+    virtual int do_message(const char *message, uint_t len)
+    {
+        return 0;
+    }
+
+    //批量回调: 一次接收中解码出的所有完整帧(每批最多MessageCommon::MESSAGE_BATCH_SIZE条)
+    //  缺省逐条调用do_message
+    //  返回值 <0: 出现异常关闭连接
+    virtual int do_messages(const MessageView *msgs, uint_t count)
+    {
+        for (uint_t i = 0; i < count; ++i) {
+            if (dispatch_message(msgs[i].data_, msgs[i].len_, std::is_void<TDerived>()) < 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    int handle_open()
+    {
+        super::release_message_buffer();
+        super::queue1_.clear();
+        super::queue2_.clear();
+        return do_open();
+    }
+
+protected:
+    int decode(const char *data, uint_t len)
+    {
+        DelimiterMessageDecoderConfig *config = static_cast<DelimiterMessageDecoderConfig *>(super::source_->message_decoder_config());
+        const char *delimiter   = config->delimiter_.data();
+        uint_t delimiter_len    = static_cast<uint_t>(config->delimiter_.size());
+        uint_t strip_len        = config->strip_delimiter_ ? delimiter_len : 0;
+        const char *remain      = data;
+        const char *data_end    = data + len;
+
+        if (!super::message_buffer_.empty()) { //begin: 有半帧
+            ByteBuffer &message_buffer = super::message_buffer_;
+            uint_t last_len = message_buffer.data_size();
+            uint_t consume_len = 0;
+
+            //分隔符可能跨越两次接收: 半帧尾部是分隔符前k个字节, 本次数据以分隔符余下字节开头
+            uint_t k = std::min<uint_t>(delimiter_len - 1, last_len);
+            for (; k > 0; --k) {
+                if ((len >= delimiter_len - k) &&
+                    (std::memcmp(message_buffer.data() + last_len - k, delimiter, k) == 0) &&
+                    (std::memcmp(data, delimiter + k, delimiter_len - k) == 0)) {
+                    consume_len = delimiter_len - k;
+                    break;
+                }
+            }
+
+            if (0 == consume_len) {
+                const char *pos = Simd::find(data, data_end, delimiter, delimiter_len);
+                if (nullptr == pos) {
+                    if (last_len + len > config->max_frame_length_ + delimiter_len) {
+                        super::last_errno_ = EventHandler::ERROR_CLOSE_ACTIVE;
+                        return -1;
+                    }
+                    message_buffer.write(data, len);
+                    return 0;
+                }
+                consume_len = static_cast<uint_t>(pos - data) + delimiter_len;
+            }
+
+            message_buffer.write(data, consume_len);
+            uint_t frame_len = message_buffer.data_size() - delimiter_len;
+            if (frame_len > config->max_frame_length_) {
+                super::last_errno_ = EventHandler::ERROR_CLOSE_ACTIVE;
+                return -1;
+            }
+            MessageView view = { message_buffer.data(), frame_len + delimiter_len - strip_len };
+            if (dispatch_messages(&view, 1) < 0) {
+                return -1;
+            }
+            remain += consume_len;
+            super::release_message_buffer();
+        } //end: 有半帧
+
+        //直接在接收数据中切分完整帧, 攒批后一次回调do_messages
+        MessageView views[MessageCommon::MESSAGE_BATCH_SIZE];
+        uint_t views_count = 0;
+        const char *pos;
+        while (remain < data_end) {
+            pos = Simd::find(remain, data_end, delimiter, delimiter_len);
+            if (nullptr == pos) {
+                break;
+            }
+
+            uint_t frame_len = static_cast<uint_t>(pos - remain);
+            if (frame_len > config->max_frame_length_) {
+                if (views_count > 0) {
+                    dispatch_messages(views, views_count);
+                }
+                super::last_errno_ = EventHandler::ERROR_CLOSE_ACTIVE;
+                return -1;
+            }
+            views[views_count].data_ = remain;
+            views[views_count].len_  = frame_len + delimiter_len - strip_len;
+            remain = pos + delimiter_len;
+            if (++views_count == MessageCommon::MESSAGE_BATCH_SIZE) {
+                if (dispatch_messages(views, views_count) < 0) {
+                    return -1;
+                }
+                views_count = 0;
+            }
+        }
+
+        if ((views_count > 0) && (dispatch_messages(views, views_count) < 0)) {
+            return -1;
+        }
+        if (remain < data_end) {
+            uint_t remain_len = static_cast<uint_t>(data_end - remain);
+            if (remain_len > config->max_frame_length_ + delimiter_len) {
+                super::last_errno_ = EventHandler::ERROR_CLOSE_ACTIVE;
+                return -1;
+            }
+            super::write_message_buffer(remain, remain_len, remain_len + delimiter_len);
+        }
+
+        return 0;
+    }
+
+    inline int dispatch_messages(const MessageView *msgs, uint_t count)
+    {
+        if (dispatch_messages(msgs, count, std::is_void<TDerived>()) < 0) {
+            super::last_errno_ = EventHandler::ERROR_CLOSE_ACTIVE;
+            return -1;
+        }
+        return 0;
+    }
+
+    inline int dispatch_messages(const MessageView *msgs, uint_t count, std::true_type)
+    {
+        return do_messages(msgs, count);
+    }
+
+    inline int dispatch_messages(const MessageView *msgs, uint_t count, std::false_type)
+    {
+        return static_cast<TDerived *>(this)->TDerived::do_messages(msgs, count);
+    }
+
+    inline int dispatch_message(const char *message, uint_t len, std::true_type)
+    {
+        return do_message(message, len);
+    }
+
+    inline int dispatch_message(const char *message, uint_t len, std::false_type)
+    {
+        return static_cast<TDerived *>(this)->TDerived::do_message(message, len);
+    }
+
+protected:
+    using super = MessageHandler<TSendBuffer, TMutex>;
+};
+
+ZRSOCKET_NAMESPACE_END
+
+#endif
@@ -48,7 +48,7 @@ public:
     }
 
     int init(uint_t num = 1, uint_t max_events = 10000, int event_mode = EPOLL_MODE::LT, 
-        uint_t event_queue_max_size = 100000, uint_t event_type_len = 8)
+        uint_t event_queue_max_size = 100000, uint_t event_type_len = 16)
     {
         max_events_ = max_events;
         epoll_mode_ = event_mode;
@@ -156,15 +156,19 @@ public:
             add_event_mask |= EventHandler::WRITE_EVENT_MASK;
         }
 
+        //先设置再加入: 加入后event_loop线程可能立即回调handler(接入线程与event_loop线程不同时)
+        handler->in_event_loop_ = true;
+        handler->event_loop_    = this;
+        handler->event_mask_    = add_event_mask;
         if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, handler->fd_, &ee) < 0) {
+            handler->in_event_loop_ = false;
+            handler->event_loop_    = nullptr;
+            handler->event_mask_    = EventHandler::NULL_EVENT_MASK;
             mutex_.unlock();
             return -2;
         }
 
         ++current_handle_size_;
-        handler->in_event_loop_ = true;
-        handler->event_loop_    = this;
-        handler->event_mask_    = add_event_mask;
         mutex_.unlock();
 
         return 0;
@@ -184,6 +188,7 @@ public:
             --current_handle_size_;
             mutex_.unlock();
 
+            handler->generation_.fetch_add(1, std::memory_order_release);
             handler->handle_close();
             handler->source_->free_handler(handler);
         }
@@ -336,11 +341,19 @@ public:
         return 0;
     }
 
+    int push_loop_call(LoopCallTask *task)
+    {
+        event_queue_.push_loop_call(task);
+        loop_wakeup();
+        return 0;
+    }
+
     int loop(int64_t timeout_us = -1)
     {   
         int64_t min_interval = timer_queue_.min_interval();
-        if (min_interval > 0) {
-            timeout_us = std::min<int64_t>(min_interval, timeout_us);
+        if ((min_interval > 0) && ((timeout_us < 0) || (min_interval < timeout_us))) {
+            //有定时器时等待时间不超过最小定时间隔(timeout_us < 0表示无限等待)
+            timeout_us = min_interval;
         }
         int timeout_ms = (timeout_us >= 0) ? (timeout_us / 1000) : (-1);
         int ready = epoll_wait(epoll_fd_, events_, max_events_, timeout_ms);
@@ -376,9 +389,10 @@ public:
                 }
             }
         }
+        //先恢复唤醒标志再处理事件队列: 处理期间及之后投递的事件都能唤醒下一轮loop(不会丢失唤醒)
+        wakeup_flag_.store(true);
         event_queue_.loop(event_queue_.capacity());
         timer_queue_.loop(Time::instance().current_timestamp_us());
-        wakeup_flag_.store(true);
 
         return ready;
     }
@@ -448,7 +462,7 @@ private:
     NotifyHandler       wakeup_handler_;
     AtomicBool          wakeup_flag_;
 
-    EventLoopQueue<TQueue, EventTypeHandler> event_queue_;
+    EventLoopQueue<TQueue, TEventTypeHandler> event_queue_;
     TLoopData loop_data_;
 };
 
@@ -583,15 +597,19 @@ public:
             add_event_mask |= EventHandler::WRITE_EVENT_MASK;
         }
 
+        //先设置再加入: 加入后event_loop线程可能立即回调handler(接入线程与event_loop线程不同时)
+        handler->in_event_loop_ = true;
+        handler->event_loop_    = this;
+        handler->event_mask_    = add_event_mask;
         if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, handler->fd_, &ee) < 0) {
+            handler->in_event_loop_ = false;
+            handler->event_loop_    = nullptr;
+            handler->event_mask_    = EventHandler::NULL_EVENT_MASK;
             mutex_.unlock();
             return -2;
         }
 
         ++current_handle_size_;
-        handler->in_event_loop_ = true;
-        handler->event_loop_    = this;
-        handler->event_mask_    = add_event_mask;
         mutex_.unlock();
 
         return 0;
@@ -612,6 +630,7 @@ public:
             --current_handle_size_;
             mutex_.unlock();
 
+            handler->generation_.fetch_add(1, std::memory_order_release);
             handler->handle_close();
             handler->source_->free_handler(handler);
         }
@@ -714,11 +733,19 @@ public:
         return 0;
     }
 
+    int push_loop_call(LoopCallTask *task)
+    {
+        event_queue_.push_loop_call(task);
+        loop_wakeup();
+        return 0;
+    }
+
     int loop(int64_t timeout_us = -1)
     {
         int64_t min_interval = timer_queue_.min_interval();
-        if (min_interval > 0) {
-            timeout_us = std::min<int64_t>(min_interval, timeout_us);
+        if ((min_interval > 0) && ((timeout_us < 0) || (min_interval < timeout_us))) {
+            //有定时器时等待时间不超过最小定时间隔(timeout_us < 0表示无限等待)
+            timeout_us = min_interval;
         }
         int timeout_ms = (timeout_us >= 0) ? (timeout_us / 1000) : (-1);
         int ready = epoll_wait(epoll_fd_, events_, max_events_, timeout_ms);
@@ -754,9 +781,10 @@ public:
                 }
             }
         }
+        //先恢复唤醒标志再处理事件队列: 处理期间及之后投递的事件都能唤醒下一轮loop(不会丢失唤醒)
+        wakeup_flag_.store(true);
         event_queue_.loop(event_queue_.capacity());
         timer_queue_.loop(Time::instance().current_timestamp_us());
-        wakeup_flag_.store(true);
 
         return ready;
     }
@@ -826,7 +854,7 @@ private:
     NotifyHandler       wakeup_handler_;
     AtomicBool          wakeup_flag_;
 
-    EventLoopQueue<TQueue, EventTypeHandler> event_queue_;
+    EventLoopQueue<TQueue, TEventTypeHandler> event_queue_;
     TLoopData loop_data_;
 };
 
@@ -4,6 +4,7 @@
 
 #ifndef ZRSOCKET_EVENT_HANDLER_H
 #define ZRSOCKET_EVENT_HANDLER_H
+#include <atomic>
 #include "config.h"
 #include "base_type.h"
 #include "byte_buffer.h"
@@ -86,6 +87,7 @@ public:
         , state_(STATE_CLOSED)
         , in_event_loop_(false)
         , in_object_pool_(true)
+        , generation_(0)
     {
     }
 
@@ -121,6 +123,13 @@ public:
         return event_mask_;
     }
 
+    //连接代数: event_loop关闭连接(delete_handler)时加1
+    //  跨线程投递的任务记录投递时的代数, 在event_loop线程中执行时不一致则说明连接已关闭(或已被对象池复用)
+    inline uint64_t generation() const
+    {
+        return generation_.load(std::memory_order_acquire);
+    }
+
     void init(ZRSOCKET_SOCKET fd, EventSource *source, EventLoop *event_loop, HANDLER_STATE state)
     {
         fd_ = fd;
@@ -158,6 +167,12 @@ public:
         return 0;
     }
 
+    //在所属event_loop线程中发送一批共享缓存(广播/跨线程发送等内置事件回调)
+    virtual int handle_send_buffers(SharedBuffer *buffers, uint_t count)
+    {
+        return -1;
+    }
+
     virtual void close()
     {
         if (ZRSOCKET_INVALID_SOCKET != fd_) {
@@ -184,6 +199,7 @@ protected:
 
 private:
     bool            in_object_pool_;    //是否在object_pool中(上层不能修改)
+    std::atomic<uint64_t> generation_;  //连接代数(上层不能修改)
 
     template <class TMutex, class TLoopData, class TEventTypeHandler, class TQueue> friend class SelectEventLoop;
     template <class TMutex, class TLoopData, class TEventTypeHandler, class TQueue> friend class WEpollEventLoop;
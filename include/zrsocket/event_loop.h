@@ -12,6 +12,8 @@
 
 ZRSOCKET_NAMESPACE_BEGIN
 
+struct LoopCallTask;
+
 class ZRSOCKET_EXPORT EventLoop
 {
 public:
@@ -72,6 +74,8 @@ public:
     virtual int add_timer(ITimer *timer) = 0;
     virtual int delete_timer(ITimer *timer) = 0;
     virtual int push_event(const EventType *event) = 0;
+    //投递LoopCallTask(在event_loop线程中调用task->proc_): 事件队列满时不等待也不失败, 返回值<0: 不支持
+    virtual int push_loop_call(LoopCallTask *task) = 0;
 
     virtual int loop(int64_t timeout_us) = 0;
     virtual int loop_wakeup() = 0;
@@ -8,6 +8,7 @@
 #include "config.h"
 #include "event_handler.h"
 #include "event_loop.h"
+#include "send_event.h"
 
 ZRSOCKET_NAMESPACE_BEGIN
 
@@ -39,7 +40,17 @@ public:
         }
     }
 
-    int init(uint_t num = 2, uint_t max_events = 10000, int event_mode = 1, uint_t event_queue_max_size = 100000, uint_t event_type_len = 8)
+    inline uint_t event_loop_size() const
+    {
+        return static_cast<uint_t>(event_loops_.size());
+    }
+
+    inline TEventLoop * get_event_loop(uint_t index)
+    {
+        return event_loops_[index];
+    }
+
+    int init(uint_t num = 2, uint_t max_events = 10000, int event_mode = 1, uint_t event_queue_max_size = 100000, uint_t event_type_len = 16)
     {
         if (num < 1) {
             num = 1;
@@ -143,6 +154,11 @@ public:
         return 0;
     }
 
+    int push_loop_call(LoopCallTask *task)
+    {
+        return -1;
+    }
+
     int loop(int64_t timeout_us)
     {
         return 0;
@@ -180,6 +196,51 @@ public:
         return 0;
     }
 
+    //广播: 同一个SharedBuffer发送给一组handler(handler可分布在不同event_loop上)
+    //  按所属event_loop分组, 每个event_loop只投递一个事件(只唤醒一次),
+    //  在各自event_loop线程中将buffer的引用(引用计数)加入每个连接的发送队列(期间已关闭的连接跳过)
+    //  返回值: 成功投递的handler数
+    template <class THandler>
+    int broadcast(SharedBuffer &buffer, THandler * const *handlers, uint_t handler_count)
+    {
+        size_t loops_size = event_loops_.size();
+        std::vector<BroadcastTask *> tasks(loops_size, nullptr);
+        for (uint_t i = 0; i < handler_count; ++i) {
+            EventHandler *handler = static_cast<EventHandler *>(handlers[i]);
+            for (size_t j = 0; j < loops_size; ++j) {
+                if (handler->event_loop_ == event_loops_[j]) {
+                    if (nullptr == tasks[j]) {
+                        tasks[j] = new BroadcastTask{ buffer, {} };
+                    }
+                    tasks[j]->targets_.push_back({ handler, handler->generation() });
+                    break;
+                }
+            }
+        }
+
+        int count = 0;
+        for (size_t j = 0; j < loops_size; ++j) {
+            BroadcastTask *task = tasks[j];
+            if (nullptr != task) {
+                int task_size = static_cast<int>(task->targets_.size());
+                TcpBroadcastEvent event(task);
+                if (event_loops_[j]->push_event(&event) > 0) {
+                    count += task_size;
+                }
+                else {
+                    delete task;
+                }
+            }
+        }
+        return count;
+    }
+
+    template <class THandler>
+    inline int broadcast(SharedBuffer &buffer, const std::vector<THandler *> &handlers)
+    {
+        return broadcast(buffer, handlers.data(), static_cast<uint_t>(handlers.size()));
+    }
+
     uint_t handler_size()
     {
         uint_t handler_size = 0;
@@ -8,6 +8,7 @@
 #include "event_type_handler.h"
 #include "event_type_queue.h"
 #include "mutex.h"
+#include "send_event.h"
 
 ZRSOCKET_NAMESPACE_BEGIN
 
@@ -18,22 +19,38 @@ public:
     EventLoopQueue() = default;
     virtual ~EventLoopQueue() = default;
 
-    int init(uint_t queue_max_size, uint16_t event_type_len = 8)
+    int init(uint_t queue_max_size, uint16_t event_type_len = 16)
     {
         queue_.init(queue_max_size, event_type_len);
+        event_type_len_ = event_type_len;
         return 0;
     }
 
     inline int push_event(const EventType *event)
     {
+        //事件长度超过队列槽长度时拒绝入队(否则会覆盖相邻事件)
+        if (event->event_len() > event_type_len_) {
+            return 0;
+        }
         return queue_.push(event);
     }
 
+    //投递LoopCallTask: 事件队列满时链入溢出链表, 不会失败
+    inline void push_loop_call(LoopCallTask *task)
+    {
+        LoopCallEvent event(task);
+        if (queue_.push(&event) <= 0) {
+            loop_call_overflow_.push(task);
+        }
+    }
+
     inline int loop(int times = 10000)
     {
+        loop_call_overflow_.run();
+
         EventType *event;
         for (int i = 0; i<times; ++i) {
-            event = queue_.pop(handler_);
+            event = queue_.pop(dispatcher_);
             if (nullptr != event) {
                 if (EventTypeId::QUIT_EVENT == event->type()) {
                     break;
@@ -54,9 +71,16 @@ public:
         return static_cast<uint_t>(queue_.capacity());
     }
 
+    inline TEventTypeHandler & handler()
+    {
+        return dispatcher_.handler();
+    }
+
 private:
     TQueue queue_;
-    TEventTypeHandler handler_;
+    SendEventDispatcher<TEventTypeHandler> dispatcher_;
+    LoopCallOverflow loop_call_overflow_;
+    uint16_t event_type_len_ = 16;
 };
 
 ZRSOCKET_NAMESPACE_END
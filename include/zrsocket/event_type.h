@@ -105,11 +105,13 @@ public:
 
     inline void timestamp(int64_t timestamp)
     {
+        timestamp_ = timestamp;
     }
 
 protected:
 
     //¼ʱ(ʱ䵥λ:us, ж) ڿ̴̫߳,¼ڶеȴʱʱ,ٴ¼)
+    //  SedaStage˽ֹʱ¼, ʱдΪǰTSC
     uint64_t timestamp_;
 };
 
@@ -140,6 +142,11 @@ struct EventTypeId
         RPC_MESSAGE  = 13,             //rpc(֧thriftprotobufϢʽ)
         RPC_MESSAGE2 = 14,             //rpc(֧thriftprotobufϢʽ)
 
+        TCP_BROADCAST = 15,            //㲥: һSharedBufferȳͬһevent_loopϵĶ
+        TCP_POST_SEND = 16,            //̷߳: event_loop߳ɷ
+        LOOP_CALL = 17,                //event_loopִ߳лص(SEDA stageɺصevent_loop)
+        HTTP_OFFLOAD = 18,             //HTTPתSEDA stage
+
         USER_START = 32,
         USER_START_NUMBER = 32,
     };
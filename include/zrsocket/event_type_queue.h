@@ -85,6 +85,35 @@ public:
         return active_buf_->pop(handler);
     }
 
+    //批量放入: 一次加锁, 返回放入的个数(空间不足时只放入前面部分)
+    inline uint_t push(const EventType * const *events, uint_t count)
+    {
+        uint_t ret;
+        mutex_.lock();
+        ret = standby_buf_->push(events, count);
+        mutex_.unlock();
+        return ret;
+    }
+
+    //批量取出并处理: 最多处理max_count个事件, 返回处理的个数
+    template <typename THandler>
+    uint_t pop(THandler &handler, uint_t max_count)
+    {
+        return active_buf_->pop(handler, max_count);
+    }
+
+
+    //近似值(未加锁读取)
+    inline uint64_t size() const
+    {
+        return active_buf_->size() + standby_buf_->size();
+    }
+
+    //只能在消费者线程调用: 只检查active_buf_, 待处理的standby_buf_由swap_buffer检查
+    inline bool empty() const
+    {
+        return active_buf_->empty();
+    }
 
     //只能在消费者线程且active_buf_.empty()==true时调用
     inline bool swap_buffer()
@@ -198,6 +227,32 @@ private:
             return nullptr;
         }
 
+        inline uint_t push(const EventType * const *events, uint_t count)
+        {
+            uint64_t capacity    = capacity_;
+            uint64_t write_index = write_index_;
+            uint64_t push_count  = std::min<uint64_t>(count, capacity - (write_index - read_index_));
+            for (uint64_t i = 0; i < push_count; ++i) {
+                uint64_t offset = ((write_index + i) & (capacity - 1)) << type_len_mask_;
+                zrsocket_memcpy((buffer_ + offset), events[i]->event_ptr(), events[i]->event_len());
+            }
+            write_index_ = write_index + push_count;
+            return static_cast<uint_t>(push_count);
+        }
+
+        template <typename THandler>
+        uint_t pop(THandler &handler, uint_t max_count)
+        {
+            uint64_t read_index = read_index_;
+            uint64_t pop_count  = std::min<uint64_t>(write_index_ - read_index, max_count);
+            for (uint64_t i = 0; i < pop_count; ++i) {
+                uint64_t offset = ((read_index + i) & (capacity_ - 1)) << type_len_mask_;
+                handler.handle_event((EventType *)(buffer_ + offset));
+            }
+            read_index_ = read_index + pop_count;
+            return static_cast<uint_t>(pop_count);
+        }
+
     public:
         char       *buffer_         = nullptr;  //事件类型缓冲
         uint64_t    capacity_       = 0;        //队列容量(只能是2的N次方)
@@ -214,6 +269,147 @@ private:
     TMutex  mutex_;
 };
 
+// 可窃取队列: work stealing event_type_queue
+//  多生产者push; 所属线程与窃取线程(空闲的兄弟线程)均通过pop(buffer, max_count)
+//  从队首批量取出事件(拷贝到调用者的缓冲, 出锁后槽位可被复用)
+template <typename TMutex>
+class StealableEventTypeQueue
+{
+public:
+    inline StealableEventTypeQueue() = default;
+    inline ~StealableEventTypeQueue()
+    {
+        clear();
+    }
+
+    inline int init(uint_t capacity, uint_t event_type_len = 8)
+    {
+        if (capacity < 1) {
+            return 0;
+        }
+        clear();
+
+        //将取模(求余数%)转换为 算术位运算与(&)
+        //计算大于等于capacity的最小 2的N次方整数
+        auto log2x = std::log2(capacity);
+        capacity = static_cast<uint_t>(std::pow(2, std::ceil(log2x)));
+
+        //将对event_type_len乘法转换为 移位掩码<<
+        type_len_mask_ = static_cast<uint8_t>(std::ceil(std::log2(event_type_len)));
+
+        uint_t buffer_size = capacity << type_len_mask_;
+        buffer_ = (char *)zrsocket_malloc(buffer_size);
+        if (nullptr != buffer_) {
+            capacity_ = capacity;
+            return 1;
+        }
+        return 0;
+    }
+
+    inline void clear()
+    {
+        if (nullptr != buffer_) {
+            zrsocket_free(buffer_);
+            buffer_ = nullptr;
+        }
+        capacity_    = 0;
+        read_index_  = 0;
+        write_index_ = 0;
+        size_.store(0, std::memory_order_relaxed);
+    }
+
+    inline uint64_t capacity() const
+    {
+        return capacity_;
+    }
+
+    //近似值(无锁读取), 用于选择窃取对象
+    inline uint64_t size() const
+    {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+    inline bool empty() const
+    {
+        return size_.load(std::memory_order_relaxed) == 0;
+    }
+
+    //每个事件在缓冲中占用的长度(2的N次方)
+    inline uint_t slot_len() const
+    {
+        return static_cast<uint_t>(1) << type_len_mask_;
+    }
+
+    inline int push(const EventType *event)
+    {
+        int ret = 0;
+        mutex_.lock();
+        uint64_t write_index = write_index_;
+        if (write_index - read_index_ < capacity_) {
+            uint64_t offset = (write_index & (capacity_ - 1)) << type_len_mask_;
+            zrsocket_memcpy((buffer_ + offset), event->event_ptr(), event->event_len());
+            write_index_ = write_index + 1;
+            size_.store(write_index_ - read_index_, std::memory_order_relaxed);
+            ret = 1;
+        }
+        mutex_.unlock();
+        return ret;
+    }
+
+    //批量放入: 一次加锁, 返回放入的个数(空间不足时只放入前面部分)
+    inline uint_t push(const EventType * const *events, uint_t count)
+    {
+        mutex_.lock();
+        uint64_t write_index = write_index_;
+        uint64_t push_count  = std::min<uint64_t>(count, capacity_ - (write_index - read_index_));
+        for (uint64_t i = 0; i < push_count; ++i) {
+            uint64_t offset = ((write_index + i) & (capacity_ - 1)) << type_len_mask_;
+            zrsocket_memcpy((buffer_ + offset), events[i]->event_ptr(), events[i]->event_len());
+        }
+        write_index_ = write_index + push_count;
+        size_.store(write_index_ - read_index_, std::memory_order_relaxed);
+        mutex_.unlock();
+        return static_cast<uint_t>(push_count);
+    }
+
+    //从队首最多取出max_count个事件, 按slot_len()间隔依次拷贝到buffer, 返回取出个数
+    inline uint_t pop(char *buffer, uint_t max_count)
+    {
+        mutex_.lock();
+        uint64_t read_index = read_index_;
+        uint64_t count = write_index_ - read_index;
+        if (count > max_count) {
+            count = max_count;
+        }
+        if (count > 0) {
+            //环形缓冲: 最多分两段拷贝
+            uint64_t start = read_index & (capacity_ - 1);
+            uint64_t first = std::min<uint64_t>(count, capacity_ - start);
+            zrsocket_memcpy(buffer, buffer_ + (start << type_len_mask_), first << type_len_mask_);
+            if (count > first) {
+                zrsocket_memcpy(buffer + (first << type_len_mask_), buffer_, (count - first) << type_len_mask_);
+            }
+            read_index_ = read_index + count;
+            size_.store(write_index_ - read_index_, std::memory_order_relaxed);
+        }
+        mutex_.unlock();
+        return static_cast<uint_t>(count);
+    }
+
+private:
+    static constexpr const int PADDING_SIZE = (CACHE_LINE_SIZE - sizeof(AtomicUInt64));
+
+    AtomicUInt64    size_           = { 0 };    //当前事件个数(供窃取线程无锁读取)
+    char            padding1_[PADDING_SIZE];
+
+    char           *buffer_         = nullptr;  //事件类型缓冲
+    uint64_t        capacity_       = 0;        //队列容量(只能是2的N次方)
+    uint64_t        read_index_     = 0;        //读位置(单调递增:只增不减)
+    uint64_t        write_index_    = 0;        //写位置(单调递增:只增不减)
+    uint8_t         type_len_mask_  = 0;        //类型长度掩码N(类型长度只能是 2的N次方)
+    TMutex          mutex_;
+};
+
 // 单生产者单消费者 队列
 //  signle producer single consumer event_type_queue
 
@@ -338,6 +534,33 @@ public:
         return nullptr;
     }
 
+    //批量放入: 一次更新写下标, 返回放入的个数(空间不足时只放入前面部分)
+    inline uint_t push(const EventType * const *events, uint_t count)
+    {
+        uint_t write_index = write_index_;
+        uint_t push_count  = std::min<uint_t>(count, capacity_ - 1 - size());
+        for (uint_t i = 0; i < push_count; ++i) {
+            uint_t offset = ((write_index + i) & (capacity_ - 1)) << type_len_mask_;
+            zrsocket_memcpy((buffer_ + offset), events[i]->event_ptr(), events[i]->event_len());
+        }
+        write_index_ = (write_index + push_count) & (capacity_ - 1);
+        return push_count;
+    }
+
+    //批量取出并处理: 一次更新读下标, 返回处理的个数
+    template <typename THandler>
+    uint_t pop(THandler &handler, uint_t max_count)
+    {
+        uint_t read_index = read_index_;
+        uint_t pop_count  = std::min<uint_t>(size(), max_count);
+        for (uint_t i = 0; i < pop_count; ++i) {
+            uint_t offset = ((read_index + i) & (capacity_ - 1)) << type_len_mask_;
+            handler.handle_event((EventType *)(buffer_ + offset));
+        }
+        read_index_ = (read_index + pop_count) & (capacity_ - 1);
+        return pop_count;
+    }
+
     inline int pop(SPSCNormalEventTypeQueue *push_queue, uint_t batch_size)
     {
         auto queue_size = size();
@@ -469,6 +692,34 @@ public:
         return nullptr;
     }
 
+    //批量放入: 一次更新写下标, 返回放入的个数(空间不足时只放入前面部分)
+    inline uint_t push(const EventType * const *events, uint_t count)
+    {
+        uint64_t capacity    = capacity_;
+        uint64_t write_index = write_index_;
+        uint64_t push_count  = std::min<uint64_t>(count, capacity - (write_index - read_index_));
+        for (uint64_t i = 0; i < push_count; ++i) {
+            uint64_t offset = ((write_index + i) & (capacity - 1)) << type_len_mask_;
+            zrsocket_memcpy((buffer_ + offset), events[i]->event_ptr(), events[i]->event_len());
+        }
+        write_index_ = write_index + push_count;
+        return static_cast<uint_t>(push_count);
+    }
+
+    //批量取出并处理: 一次更新读下标, 返回处理的个数
+    template <typename THandler>
+    uint_t pop(THandler &handler, uint_t max_count)
+    {
+        uint64_t read_index = read_index_;
+        uint64_t pop_count  = std::min<uint64_t>(write_index_ - read_index, max_count);
+        for (uint64_t i = 0; i < pop_count; ++i) {
+            uint64_t offset = ((read_index + i) & (capacity_ - 1)) << type_len_mask_;
+            handler.handle_event((EventType *)(buffer_ + offset));
+        }
+        read_index_ = read_index + pop_count;
+        return static_cast<uint_t>(pop_count);
+    }
+
     inline bool swap_buffer() const
     {
         return false;
@@ -587,6 +838,36 @@ public:
         return nullptr;
     }
 
+    //批量放入: 一次发布写位置, 返回放入的个数(空间不足时只放入前面部分)
+    inline uint_t push(const EventType * const *events, uint_t count)
+    {
+        uint64_t capacity    = capacity_;
+        uint64_t write_index = write_index_.load(std::memory_order_relaxed);
+        uint64_t push_count  = std::min<uint64_t>(count, 
+            capacity - (write_index - read_index_.load(std::memory_order_acquire)));
+        for (uint64_t i = 0; i < push_count; ++i) {
+            uint64_t offset = ((write_index + i) & (capacity - 1)) << type_len_mask_;
+            zrsocket_memcpy((buffer_ + offset), events[i]->event_ptr(), events[i]->event_len());
+        }
+        write_index_.store(write_index + push_count, std::memory_order_release);
+        return static_cast<uint_t>(push_count);
+    }
+
+    //批量取出并处理: 一次发布读位置, 返回处理的个数
+    template <typename THandler>
+    uint_t pop(THandler &handler, uint_t max_count)
+    {
+        uint64_t read_index = read_index_.load(std::memory_order_relaxed);
+        uint64_t pop_count  = std::min<uint64_t>(
+            write_index_.load(std::memory_order_acquire) - read_index, max_count);
+        for (uint64_t i = 0; i < pop_count; ++i) {
+            uint64_t offset = ((read_index + i) & (capacity_ - 1)) << type_len_mask_;
+            handler.handle_event((EventType *)(buffer_ + offset));
+        }
+        read_index_.store(read_index + pop_count, std::memory_order_release);
+        return static_cast<uint_t>(pop_count);
+    }
+
     inline bool swap_buffer() const
     {
         return false;
@@ -692,8 +973,12 @@ public:
                     zrsocket_memcpy((buffer + offset), event->event_ptr(), event->event_len());
 
                     //发布刚写入数据的位置(更新最大读位置)
-                    while (!max_read_index_.compare_exchange_weak(write_index, write_index + 1, 
-                        std::memory_order_relaxed, std::memory_order_relaxed));
+                    //  须等待之前预留的位置发布完成(CAS失败会改写expected, 故每次重置)
+                    uint64_t expected = write_index;
+                    while (!max_read_index_.compare_exchange_weak(expected, write_index + 1, 
+                        std::memory_order_release, std::memory_order_relaxed)) {
+                        expected = write_index;
+                    }
 
                     return 1;
                 }
@@ -722,6 +1007,58 @@ public:
         return nullptr;
     }
 
+    //批量放入: 一次CAS预留count个位置(空间不足时只预留剩余空间), 写入后一次发布
+    //  返回放入的个数
+    inline uint_t push(const EventType * const *events, uint_t count)
+    {
+        char    *buffer   = buffer_;
+        uint64_t capacity = capacity_;
+        uint16_t type_len_mask = type_len_mask_;
+        uint64_t write_index;
+        uint64_t push_count;
+
+        for (int i = 0; i < SPIN_LOOP_TIMES; ++i) {
+            write_index = write_index_.load(std::memory_order_relaxed);
+            push_count  = std::min<uint64_t>(count, capacity - (write_index - read_index_));
+            if (0 == push_count) {
+                return 0;
+            }
+            if (write_index_.compare_exchange_weak(write_index, write_index + push_count, 
+                std::memory_order_relaxed, std::memory_order_relaxed)) {
+
+                for (uint64_t j = 0; j < push_count; ++j) {
+                    uint64_t offset = ((write_index + j) & (capacity - 1)) << type_len_mask;
+                    zrsocket_memcpy((buffer + offset), events[j]->event_ptr(), events[j]->event_len());
+                }
+
+                uint64_t expected = write_index;
+                while (!max_read_index_.compare_exchange_weak(expected, write_index + push_count, 
+                    std::memory_order_release, std::memory_order_relaxed)) {
+                    expected = write_index;
+                }
+
+                return static_cast<uint_t>(push_count);
+            }
+        }
+
+        return 0;
+    }
+
+    //批量取出并处理: 一次更新读位置, 返回处理的个数
+    template <typename THandler>
+    uint_t pop(THandler &handler, uint_t max_count)
+    {
+        uint64_t read_index = read_index_;
+        uint64_t pop_count  = std::min<uint64_t>(
+            max_read_index_.load(std::memory_order_acquire) - read_index, max_count);
+        for (uint64_t i = 0; i < pop_count; ++i) {
+            uint64_t offset = ((read_index + i) & (capacity_ - 1)) << type_len_mask_;
+            handler.handle_event((EventType *)(buffer_ + offset));
+        }
+        read_index_ = read_index + pop_count;
+        return static_cast<uint_t>(pop_count);
+    }
+
     inline bool swap_buffer() const
     {
         return false;
@@ -838,8 +1175,12 @@ public:
                     zrsocket_memcpy((buffer + offset), event->event_ptr(), event->event_len());
 
                     //发布刚写入数据的位置(更新最大读位置)
-                    while (!max_read_index_.compare_exchange_weak(write_index, write_index + 1, 
-                        std::memory_order_relaxed, std::memory_order_relaxed));
+                    //  须等待之前预留的位置发布完成(CAS失败会改写expected, 故每次重置)
+                    uint64_t expected = write_index;
+                    while (!max_read_index_.compare_exchange_weak(expected, write_index + 1, 
+                        std::memory_order_release, std::memory_order_relaxed)) {
+                        expected = write_index;
+                    }
 
                     return 1;
                 }
@@ -871,8 +1212,11 @@ public:
                     handler.handle_event(event);
 
                     //发布刚读数据的位置(更新最小写位置)                                             
-                    while (!min_write_index_.compare_exchange_weak(read_index, read_index + 1, 
-                        std::memory_order_relaxed));
+                    uint64_t expected = read_index;
+                    while (!min_write_index_.compare_exchange_weak(expected, read_index + 1, 
+                        std::memory_order_release, std::memory_order_relaxed)) {
+                        expected = read_index;
+                    }
 
                     return event;
                 }
@@ -885,6 +1229,81 @@ public:
         return nullptr;
     }
 
+    //批量放入: 一次CAS预留count个位置(空间不足时只预留剩余空间), 写入后一次发布
+    //  返回放入的个数
+    inline uint_t push(const EventType * const *events, uint_t count)
+    {
+        char    *buffer   = buffer_;
+        uint64_t capacity = capacity_;
+        uint16_t type_len_mask = type_len_mask_;
+        uint64_t write_index;
+        uint64_t push_count;
+
+        for (int i = 0; i < SPIN_LOOP_TIMES; ++i) {
+            write_index = write_index_.load(std::memory_order_relaxed);
+            push_count  = std::min<uint64_t>(count, capacity - (write_index - min_write_index_.load(std::memory_order_acquire)));
+            if (0 == push_count) {
+                return 0;
+            }
+            if (write_index_.compare_exchange_weak(write_index, write_index + push_count, 
+                std::memory_order_relaxed, std::memory_order_relaxed)) {
+
+                for (uint64_t j = 0; j < push_count; ++j) {
+                    uint64_t offset = ((write_index + j) & (capacity - 1)) << type_len_mask;
+                    zrsocket_memcpy((buffer + offset), events[j]->event_ptr(), events[j]->event_len());
+                }
+
+                uint64_t expected = write_index;
+                while (!max_read_index_.compare_exchange_weak(expected, write_index + push_count, 
+                    std::memory_order_release, std::memory_order_relaxed)) {
+                    expected = write_index;
+                }
+
+                return static_cast<uint_t>(push_count);
+            }
+        }
+
+        return 0;
+    }
+
+    //批量取出并处理: 一次CAS预留最多max_count个位置, 处理后一次发布, 返回处理的个数
+    template <typename THandler>
+    uint_t pop(THandler &handler, uint_t max_count)
+    {
+        char *buffer = buffer_;
+        uint64_t capacity = capacity_;
+        uint16_t type_len_mask = type_len_mask_;
+        uint64_t read_index;
+        uint64_t pop_count;
+
+        for (int i = 0; i < SPIN_LOOP_TIMES; ++i) {
+            read_index = read_index_.load(std::memory_order_relaxed);
+            pop_count  = std::min<uint64_t>(
+                max_read_index_.load(std::memory_order_acquire) - read_index, max_count);
+            if (0 == pop_count) {
+                return 0;
+            }
+            if (read_index_.compare_exchange_weak(read_index, read_index + pop_count, 
+                std::memory_order_relaxed, std::memory_order_relaxed)) {
+
+                for (uint64_t j = 0; j < pop_count; ++j) {
+                    uint64_t offset = ((read_index + j) & (capacity - 1)) << type_len_mask;
+                    handler.handle_event((EventType *)(buffer + offset));
+                }
+
+                uint64_t expected = read_index;
+                while (!min_write_index_.compare_exchange_weak(expected, read_index + pop_count, 
+                    std::memory_order_release, std::memory_order_relaxed)) {
+                    expected = read_index;
+                }
+
+                return static_cast<uint_t>(pop_count);
+            }
+        }
+
+        return 0;
+    }
+
     inline bool swap_buffer() const
     {
         return false;
@@ -994,6 +1413,21 @@ public:
         return 0;
     }
 
+    //批量放入: 一次更新写位置, 返回放入的个数(空间不足时只放入前面部分)
+    inline uint_t push(const EventType * const *events, uint_t count)
+    {
+        uint64_t capacity    = capacity_;
+        uint64_t write_index = write_index_;
+        uint64_t push_count  = std::min<uint64_t>(count, 
+            capacity - (write_index - min_write_index_.load(std::memory_order_acquire)));
+        for (uint64_t i = 0; i < push_count; ++i) {
+            uint64_t offset = ((write_index + i) & (capacity - 1)) << type_len_mask_;
+            zrsocket_memcpy((buffer_ + offset), events[i]->event_ptr(), events[i]->event_len());
+        }
+        write_index_ = write_index + push_count;
+        return static_cast<uint_t>(push_count);
+    }
+
     template <typename THandler>
     EventType * pop(THandler &handler)
     {
@@ -1016,8 +1450,11 @@ public:
                     handler.handle_event(event);
 
                     //发布刚读数据的位置
-                    while (!min_write_index_.compare_exchange_weak(read_index, read_index + 1, 
-                        std::memory_order_relaxed));
+                    uint64_t expected = read_index;
+                    while (!min_write_index_.compare_exchange_weak(expected, read_index + 1, 
+                        std::memory_order_release, std::memory_order_relaxed)) {
+                        expected = read_index;
+                    }
 
                     return event;
                 }
@@ -4,6 +4,7 @@
 
 #ifndef ZRSOCKET_FIXED_LENGTH_MESSAGE_HANDLER
 #define ZRSOCKET_FIXED_LENGTH_MESSAGE_HANDLER
+#include "message_common.h"
 #include "message_handler.h"
 
 ZRSOCKET_NAMESPACE_BEGIN
@@ -23,7 +24,9 @@ public:
     uint_t message_length_ = sizeof(int);
 };
 
-template <class TSendBuffer, class TMutex>
+//TDerived: 为void时通过虚函数回调do_message(s);
+//  为派生类类型时(CRTP)直接调用TDerived::do_messages/do_message(非虚调用, 可内联)
+template <class TSendBuffer, class TMutex, class TDerived = void>
 class FixedLengthMessageHandler : public MessageHandler<TSendBuffer, TMutex>
 {
 public:
@@ -47,11 +50,22 @@ public:
         return 0;
     }
 
+    //批量回调: 一次接收中解码出的所有完整消息(每批最多MessageCommon::MESSAGE_BATCH_SIZE条)
+    //  缺省逐条调用do_message
+    //  返回值 <0: 出现异常关闭连接
+    virtual int do_messages(const MessageView *msgs, uint_t count)
+    {
+        for (uint_t i = 0; i < count; ++i) {
+            if (dispatch_message(msgs[i].data_, msgs[i].len_, std::is_void<TDerived>()) < 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
     int handle_open()
     {
-        super::message_buffer_.reset();
-        super::message_buffer_.reserve(static_cast<FixedLengthMessageDecoderConfig *>(
-            super::source_->message_decoder_config())->message_length_);
+        super::release_message_buffer();
         super::queue1_.clear();
         super::queue2_.clear();
         return do_open();
@@ -62,60 +76,81 @@ protected:
     {
         uint_t  message_length = 
             static_cast<FixedLengthMessageDecoderConfig*>(super::source_->message_decoder_config())->message_length_;
-        char   *remain         = const_cast<char *>(data);
+        const char *remain     = data;
         uint_t  remain_len     = len;
 
-        if (super::message_buffer_.empty()) {
-            while (remain_len >= message_length) {
-                if (do_message(remain, message_length) >= 0) {
-                    remain     += message_length;
-                    remain_len -= message_length;
-                }
-                else {
-                    super::last_errno_ = EventHandler::ERROR_CLOSE_ACTIVE;
-                    return -1;
-                }
-            }
-            if (remain_len > 0) {
+        if (!super::message_buffer_.empty()) {
+            uint_t need_len = message_length - super::message_buffer_.data_size();
+            if (remain_len < need_len) {
                 super::message_buffer_.write(remain, remain_len);
+                return 0;
             }
+
+            super::message_buffer_.write(remain, need_len);
+            MessageView view = { super::message_buffer_.data(), message_length };
+            if (dispatch_messages(&view, 1) < 0) {
+                return -1;
+            }
+            remain     += need_len;
+            remain_len -= need_len;
+            super::release_message_buffer();
         }
-        else {
-            uint_t need_len = message_length - super::message_buffer_.data_size();
-            if (remain_len >= need_len) {
-                super::message_buffer_.write(remain, need_len);
-                if (do_message(super::message_buffer_.data(), message_length) >= 0) {
-                    remain     += need_len;
-                    remain_len -= need_len;
-                    super::message_buffer_.reset();
-                }
-                else {
-                    super::last_errno_ = EventHandler::ERROR_CLOSE_ACTIVE;
-                    return -1;
-                }
 
-                while (remain_len >= message_length) {
-                    if (do_message(remain, message_length) >= 0) {
-                        remain     += message_length;
-                        remain_len -= message_length;
-                    }
-                    else {
-                        super::last_errno_ = EventHandler::ERROR_CLOSE_ACTIVE;
-                        return -1;
-                    }
-                }
-                if (remain_len > 0) {
-                    super::message_buffer_.write(remain, remain_len);
+        //直接在接收数据中解码完整的消息, 攒批后一次回调do_messages
+        MessageView views[MessageCommon::MESSAGE_BATCH_SIZE];
+        uint_t views_count = 0;
+        while (remain_len >= message_length) {
+            views[views_count].data_ = remain;
+            views[views_count].len_  = message_length;
+            remain     += message_length;
+            remain_len -= message_length;
+            if (++views_count == MessageCommon::MESSAGE_BATCH_SIZE) {
+                if (dispatch_messages(views, views_count) < 0) {
+                    return -1;
                 }
-            }
-            else {
-                super::message_buffer_.write(remain, remain_len);
+                views_count = 0;
             }
         }
 
+        if ((views_count > 0) && (dispatch_messages(views, views_count) < 0)) {
+            return -1;
+        }
+        if (remain_len > 0) {
+            super::write_message_buffer(remain, remain_len, message_length);
+        }
+
+        return 0;
+    }
+
+    inline int dispatch_messages(const MessageView *msgs, uint_t count)
+    {
+        if (dispatch_messages(msgs, count, std::is_void<TDerived>()) < 0) {
+            super::last_errno_ = EventHandler::ERROR_CLOSE_ACTIVE;
+            return -1;
+        }
         return 0;
     }
 
+    inline int dispatch_messages(const MessageView *msgs, uint_t count, std::true_type)
+    {
+        return do_messages(msgs, count);
+    }
+
+    inline int dispatch_messages(const MessageView *msgs, uint_t count, std::false_type)
+    {
+        return static_cast<TDerived *>(this)->TDerived::do_messages(msgs, count);
+    }
+
+    inline int dispatch_message(const char *message, uint_t len, std::true_type)
+    {
+        return do_message(message, len);
+    }
+
+    inline int dispatch_message(const char *message, uint_t len, std::false_type)
+    {
+        return static_cast<TDerived *>(this)->TDerived::do_message(message, len);
+    }
+
 protected:
     using super = MessageHandler<TSendBuffer, TMutex>;
 };
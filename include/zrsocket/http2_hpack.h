@@ -0,0 +1,838 @@
+﻿// Some compilers (e.g. VC++) benefit significantly from using this. 
+// We've measured 3-4% build speed improvements in apps as a result 
+#pragma once
+
+#ifndef ZRSOCKET_HTTP2_HPACK_H
+#define ZRSOCKET_HTTP2_HPACK_H
+#include <cstring>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "base_type.h"
+
+ZRSOCKET_NAMESPACE_BEGIN
+
+//HPACK(RFC 7541) Huffman编码
+//  码表为规范Huffman码(同长度的码连续递增), 解码按长度逐级比较上界, 不需要建树
+class HpackHuffman
+{
+public:
+    //编码后的长度(字节)
+    static uint_t encoded_length(const char *data, uint_t len)
+    {
+        const uint8_t *code_lens = lens();
+        uint64_t bits = 0;
+        for (uint_t i = 0; i < len; ++i) {
+            bits += code_lens[static_cast<uint8_t>(data[i])];
+        }
+        return static_cast<uint_t>((bits + 7) >> 3);
+    }
+
+    //编码到dst(长度须不小于encoded_length()), 末尾不足一字节时以EOS的高位(全1)填充
+    static void encode(const char *data, uint_t len, char *dst)
+    {
+        const uint32_t *huffman_codes = codes();
+        const uint8_t  *code_lens     = lens();
+        uint64_t bits  = 0;
+        uint_t   nbits = 0;
+        for (uint_t i = 0; i < len; ++i) {
+            uint8_t symbol = static_cast<uint8_t>(data[i]);
+            bits   = (bits << code_lens[symbol]) | huffman_codes[symbol];
+            nbits += code_lens[symbol];
+            while (nbits >= 8) {
+                nbits -= 8;
+                *dst++ = static_cast<char>(bits >> nbits);
+            }
+        }
+        if (nbits > 0) {
+            *dst = static_cast<char>((bits << (8 - nbits)) | (0xFF >> nbits));
+        }
+    }
+
+    //解码追加到out, 返回值<0: 编码非法(含EOS/填充超过7位或不全为1)
+    static int decode(const char *data, uint_t len, std::string &out)
+    {
+        const uint32_t *code_limits  = limits();
+        const int64_t  *code_offsets = offsets();
+        const uint16_t *code_symbols = symbols();
+        const uint8_t *p   = reinterpret_cast<const uint8_t *>(data);
+        const uint8_t *end = p + len;
+        uint64_t bits  = 0;
+        uint_t   nbits = 0;
+
+        for (;;) {
+            //保持至少30位(最长码)
+            while ((nbits <= 56) && (p < end)) {
+                bits   = (bits << 8) | *p++;
+                nbits += 8;
+            }
+            if (0 == nbits) {
+                return 0;
+            }
+
+            uint_t code_len = 5;
+            for (; (code_len <= 30) && (code_len <= nbits); ++code_len) {
+                uint32_t code = static_cast<uint32_t>((bits >> (nbits - code_len)) & ((1ULL << code_len) - 1));
+                if (code < code_limits[code_len]) {
+                    break;
+                }
+            }
+            if (code_len > 30) {
+                return -1;
+            }
+            if (code_len > nbits) {
+                //剩余位不足一个码: 只能是不超过7位的全1填充
+                if ((nbits > 7) || ((bits & ((1ULL << nbits) - 1)) != ((1ULL << nbits) - 1))) {
+                    return -1;
+                }
+                return 0;
+            }
+
+            uint32_t code = static_cast<uint32_t>((bits >> (nbits - code_len)) & ((1ULL << code_len) - 1));
+            uint16_t symbol = code_symbols[code_offsets[code_len] + code];
+            if (256 == symbol) {
+                return -1;
+            }
+            out.push_back(static_cast<char>(symbol));
+            nbits -= code_len;
+        }
+    }
+
+private:
+    static const uint32_t * codes()
+    {
+        static const uint32_t huffman_codes[257] = {
+            0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+            0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+            0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+            0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+            0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+            0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+            0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+            0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+            0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+            0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+            0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+            0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+            0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+            0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+            0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+            0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+            0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+            0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+            0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+            0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+            0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+            0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+            0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+            0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+            0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+            0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+            0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+            0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+            0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+            0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+            0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+            0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+            0x3fffffff,
+        };
+        return huffman_codes;
+    }
+
+    static const uint8_t * lens()
+    {
+        static const uint8_t code_lens[257] = {
+            13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+            28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+            6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+            5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+            13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+            7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+            15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+            6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+            20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+            24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+            22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+            21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+            26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+            19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+            20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+            26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+            30,
+        };
+        return code_lens;
+    }
+
+    //按(码长, 码)排序的符号
+    static const uint16_t * symbols()
+    {
+        static const uint16_t code_symbols[257] = {
+            48, 49, 50, 97, 99, 101, 105, 111, 115, 116, 32, 37, 45, 46, 47, 51,
+            52, 53, 54, 55, 56, 57, 61, 65, 95, 98, 100, 102, 103, 104, 108, 109,
+            110, 112, 114, 117, 58, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76,
+            77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 89, 106, 107, 113, 118,
+            119, 120, 121, 122, 38, 42, 44, 59, 88, 90, 33, 34, 40, 41, 63, 39,
+            43, 124, 35, 62, 0, 36, 64, 91, 93, 126, 94, 125, 60, 96, 123, 92,
+            195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161, 167, 172, 176, 177,
+            179, 209, 216, 217, 227, 229, 230, 129, 132, 133, 134, 136, 146, 154, 156, 160,
+            163, 164, 169, 170, 173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+            233, 1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150, 151, 152, 155, 157,
+            158, 165, 166, 168, 174, 175, 180, 182, 183, 188, 191, 197, 231, 239, 9, 142,
+            144, 145, 148, 159, 171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+            200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243, 255, 203, 204, 211,
+            212, 214, 221, 222, 223, 241, 244, 245, 246, 247, 248, 250, 251, 252, 253, 254,
+            2, 3, 4, 5, 6, 7, 8, 11, 12, 14, 15, 16, 17, 18, 19, 20,
+            21, 23, 24, 25, 26, 27, 28, 29, 30, 31, 127, 220, 249, 10, 13, 22,
+            256,
+        };
+        return code_symbols;
+    }
+
+    //各码长的码上界(不含): 码长为n的前缀值小于limits[n]时即为一个码
+    static const uint32_t * limits()
+    {
+        static const uint32_t code_limits[31] = {
+            0x0, 0x0, 0x0, 0x0, 0x0, 0xa, 0x2e, 0x7c,
+            0xfe, 0x0, 0x3fd, 0x7fd, 0xffc, 0x1ffe, 0x3ffe, 0x7fff,
+            0x0, 0x0, 0x0, 0x7fff3, 0xfffee, 0x1fffe9, 0x3fffec, 0x7ffff5,
+            0xfffff6, 0x1fffff0, 0x3ffffef, 0x7fffff1, 0xfffffff, 0x0, 0x40000000,
+        };
+        return code_limits;
+    }
+
+    //各码长的码在symbols()中的下标偏移(符号下标 = offsets[n] + 码)
+    static const int64_t * offsets()
+    {
+        static const int64_t code_offsets[31] = {
+            0, 0, 0, 0, 0, 0, -10, -56,
+            -180, 0, -942, -1963, -4008, -8100, -16290, -32672,
+            0, 0, 0, -524177, -1048452, -2097010, -4194139, -8388423,
+            -16777020, -33554226, -67108642, -134217489, -268435202, 0, -1073741567,
+        };
+        return code_offsets;
+    }
+};
+
+//HPACK静态表项
+struct HpackTableEntry
+{
+    const char *name_;
+    uint_t      name_len_;
+    const char *value_;
+    uint_t      value_len_;
+};
+
+//HPACK静态表(RFC 7541 附录A, 索引从1开始)
+class HpackStaticTable
+{
+public:
+    enum
+    {
+        SIZE = 61,
+    };
+
+    //index: 1 ~ SIZE
+    static inline const HpackTableEntry & get(uint_t index)
+    {
+        return entries()[index - 1];
+    }
+
+    //查找(name须为小写): 返回完全匹配的索引; 否则返回名称匹配的索引(name_index), 都没有返回0
+    static uint_t find(const char *name, uint_t name_len, const char *value, uint_t value_len, uint_t &name_index)
+    {
+        const HpackTableEntry *table = entries();
+        name_index = 0;
+        for (uint_t i = 0; i < SIZE; ++i) {
+            const HpackTableEntry &entry = table[i];
+            if ((entry.name_len_ != name_len) || (std::memcmp(entry.name_, name, name_len) != 0)) {
+                continue;
+            }
+            if ((entry.value_len_ == value_len) && (std::memcmp(entry.value_, value, value_len) == 0)) {
+                return i + 1;
+            }
+            if (0 == name_index) {
+                name_index = i + 1;
+            }
+        }
+        return 0;
+    }
+
+private:
+    static const HpackTableEntry * entries()
+    {
+        static const HpackTableEntry table[SIZE] = {
+            { ":authority", 10, "", 0 },
+            { ":method", 7, "GET", 3 },
+            { ":method", 7, "POST", 4 },
+            { ":path", 5, "/", 1 },
+            { ":path", 5, "/index.html", 11 },
+            { ":scheme", 7, "http", 4 },
+            { ":scheme", 7, "https", 5 },
+            { ":status", 7, "200", 3 },
+            { ":status", 7, "204", 3 },
+            { ":status", 7, "206", 3 },
+            { ":status", 7, "304", 3 },
+            { ":status", 7, "400", 3 },
+            { ":status", 7, "404", 3 },
+            { ":status", 7, "500", 3 },
+            { "accept-charset", 14, "", 0 },
+            { "accept-encoding", 15, "gzip, deflate", 13 },
+            { "accept-language", 15, "", 0 },
+            { "accept-ranges", 13, "", 0 },
+            { "accept", 6, "", 0 },
+            { "access-control-allow-origin", 27, "", 0 },
+            { "age", 3, "", 0 },
+            { "allow", 5, "", 0 },
+            { "authorization", 13, "", 0 },
+            { "cache-control", 13, "", 0 },
+            { "content-disposition", 19, "", 0 },
+            { "content-encoding", 16, "", 0 },
+            { "content-language", 16, "", 0 },
+            { "content-length", 14, "", 0 },
+            { "content-location", 16, "", 0 },
+            { "content-range", 13, "", 0 },
+            { "content-type", 12, "", 0 },
+            { "cookie", 6, "", 0 },
+            { "date", 4, "", 0 },
+            { "etag", 4, "", 0 },
+            { "expect", 6, "", 0 },
+            { "expires", 7, "", 0 },
+            { "from", 4, "", 0 },
+            { "host", 4, "", 0 },
+            { "if-match", 8, "", 0 },
+            { "if-modified-since", 17, "", 0 },
+            { "if-none-match", 13, "", 0 },
+            { "if-range", 8, "", 0 },
+            { "if-unmodified-since", 19, "", 0 },
+            { "last-modified", 13, "", 0 },
+            { "link", 4, "", 0 },
+            { "location", 8, "", 0 },
+            { "max-forwards", 12, "", 0 },
+            { "proxy-authenticate", 18, "", 0 },
+            { "proxy-authorization", 19, "", 0 },
+            { "range", 5, "", 0 },
+            { "referer", 7, "", 0 },
+            { "refresh", 7, "", 0 },
+            { "retry-after", 11, "", 0 },
+            { "server", 6, "", 0 },
+            { "set-cookie", 10, "", 0 },
+            { "strict-transport-security", 25, "", 0 },
+            { "transfer-encoding", 17, "", 0 },
+            { "user-agent", 10, "", 0 },
+            { "vary", 4, "", 0 },
+            { "via", 3, "", 0 },
+            { "www-authenticate", 16, "", 0 },
+        };
+        return table;
+    }
+};
+
+//HPACK动态表
+//  表项以环形数组存放, 淘汰的表项保留字符串容量供新表项复用(稳定后不再分配内存)
+class HpackDynamicTable
+{
+public:
+    enum
+    {
+        ENTRY_OVERHEAD = 32,    //每个表项的额外计算长度(RFC 7541 4.1)
+    };
+
+    struct Entry
+    {
+        std::string name_;
+        std::string value_;
+    };
+
+    HpackDynamicTable() = default;
+    ~HpackDynamicTable() = default;
+
+    inline void clear()
+    {
+        count_ = 0;
+        size_  = 0;
+    }
+
+    inline uint_t count() const
+    {
+        return count_;
+    }
+
+    inline uint_t size() const
+    {
+        return size_;
+    }
+
+    inline uint_t max_size() const
+    {
+        return max_size_;
+    }
+
+    inline void set_max_size(uint_t max_size)
+    {
+        max_size_ = max_size;
+        evict(0);
+    }
+
+    //index: 0为最新加入的表项
+    inline const Entry & get(uint_t index) const
+    {
+        return entries_[(head_ + index) & (entries_.size() - 1)];
+    }
+
+    void add(const char *name, uint_t name_len, const char *value, uint_t value_len)
+    {
+        uint_t entry_size = name_len + value_len + ENTRY_OVERHEAD;
+        if (entry_size > max_size_) {
+            //大于表容量: 清空表且不加入(RFC 7541 4.4)
+            clear();
+            return;
+        }
+        evict(entry_size);
+        if (count_ == entries_.size()) {
+            grow();
+        }
+
+        head_ = (head_ - 1) & (entries_.size() - 1);
+        Entry &entry = entries_[head_];
+        entry.name_.assign(name, name_len);
+        entry.value_.assign(value, value_len);
+        ++count_;
+        size_ += entry_size;
+    }
+
+    //查找: 返回完全匹配的索引+1; 否则返回名称匹配的索引+1(name_index), 都没有返回0
+    uint_t find(const char *name, uint_t name_len, const char *value, uint_t value_len, uint_t &name_index) const
+    {
+        name_index = 0;
+        for (uint_t i = 0; i < count_; ++i) {
+            const Entry &entry = get(i);
+            if ((entry.name_.size() != name_len) || (std::memcmp(entry.name_.data(), name, name_len) != 0)) {
+                continue;
+            }
+            if ((entry.value_.size() == value_len) && (std::memcmp(entry.value_.data(), value, value_len) == 0)) {
+                return i + 1;
+            }
+            if (0 == name_index) {
+                name_index = i + 1;
+            }
+        }
+        return 0;
+    }
+
+private:
+    //淘汰最旧的表项, 直到还能容纳need_size
+    inline void evict(uint_t need_size)
+    {
+        while ((count_ > 0) && (size_ + need_size > max_size_)) {
+            const Entry &entry = get(--count_);
+            size_ -= static_cast<uint_t>(entry.name_.size() + entry.value_.size()) + ENTRY_OVERHEAD;
+        }
+    }
+
+    void grow()
+    {
+        std::vector<Entry> entries(entries_.empty() ? 16 : entries_.size() * 2);
+        for (uint_t i = 0; i < count_; ++i) {
+            entries[i] = std::move(entries_[(head_ + i) & (entries_.size() - 1)]);
+        }
+        entries_.swap(entries);
+        head_ = 0;
+    }
+
+private:
+    std::vector<Entry>  entries_;           //环形数组, 容量为2的幂
+    uint_t              head_     = 0;      //最新表项的位置
+    uint_t              count_    = 0;
+    uint_t              size_     = 0;      //按RFC 7541计算的表大小
+    uint_t              max_size_ = 4096;
+};
+
+//HPACK整数与字符串的基本编解码
+class HpackCodec
+{
+public:
+    //解码prefix_bits位前缀的整数, 返回值<0: 数据不完整或溢出
+    static int decode_integer(const uint8_t *&p, const uint8_t *end, uint_t prefix_bits, uint_t &value)
+    {
+        if (p >= end) {
+            return -1;
+        }
+        uint_t prefix_max = (1U << prefix_bits) - 1;
+        value = *p++ & prefix_max;
+        if (value < prefix_max) {
+            return 0;
+        }
+
+        uint_t shift = 0;
+        while (p < end) {
+            uint8_t b = *p++;
+            if (shift > 28) {
+                return -1;
+            }
+            uint64_t add = static_cast<uint64_t>(b & 0x7F) << shift;
+            if (value + add > 0xFFFFFFFFULL) {
+                return -1;
+            }
+            value += static_cast<uint_t>(add);
+            if (0 == (b & 0x80)) {
+                return 0;
+            }
+            shift += 7;
+        }
+        return -1;
+    }
+
+    //编码整数, first_byte为前缀以外的高位标志
+    template <class TBuffer>
+    static void encode_integer(TBuffer &out, uint8_t first_byte, uint_t prefix_bits, uint_t value)
+    {
+        char buf[8];
+        uint_t len = 0;
+        uint_t prefix_max = (1U << prefix_bits) - 1;
+        if (value < prefix_max) {
+            buf[len++] = static_cast<char>(first_byte | value);
+        }
+        else {
+            buf[len++] = static_cast<char>(first_byte | prefix_max);
+            value -= prefix_max;
+            while (value >= 0x80) {
+                buf[len++] = static_cast<char>((value & 0x7F) | 0x80);
+                value >>= 7;
+            }
+            buf[len++] = static_cast<char>(value);
+        }
+        out.write(buf, len);
+    }
+
+    //编码字符串: Huffman编码更短时使用Huffman
+    template <class TBuffer>
+    static void encode_string(TBuffer &out, const char *data, uint_t len, std::string &scratch)
+    {
+        uint_t huffman_len = HpackHuffman::encoded_length(data, len);
+        if (huffman_len < len) {
+            encode_integer(out, 0x80, 7, huffman_len);
+            scratch.resize(huffman_len);
+            HpackHuffman::encode(data, len, &scratch[0]);
+            out.write(scratch.data(), huffman_len);
+        }
+        else {
+            encode_integer(out, 0, 7, len);
+            out.write(data, len);
+        }
+    }
+
+    //解码字符串: 非Huffman时直接指向输入数据, Huffman时解码到scratch
+    static int decode_string(const uint8_t *&p, const uint8_t *end, uint_t max_len, std::string &scratch,
+        const char *&str, uint_t &len)
+    {
+        if (p >= end) {
+            return -1;
+        }
+        bool huffman = (*p & 0x80) != 0;
+        uint_t raw_len;
+        if ((decode_integer(p, end, 7, raw_len) < 0) || (raw_len > static_cast<uint_t>(end - p))) {
+            return -1;
+        }
+        if (!huffman) {
+            if (raw_len > max_len) {
+                return -1;
+            }
+            str = reinterpret_cast<const char *>(p);
+            len = raw_len;
+            p  += raw_len;
+            return 0;
+        }
+
+        scratch.clear();
+        if (HpackHuffman::decode(reinterpret_cast<const char *>(p), raw_len, scratch) < 0) {
+            return -1;
+        }
+        if (scratch.size() > max_len) {
+            return -1;
+        }
+        p  += raw_len;
+        str = scratch.data();
+        len = static_cast<uint_t>(scratch.size());
+        return 0;
+    }
+};
+
+//HPACK解码器(每个连接一个, 解码对端发来的header block)
+class HpackDecoder
+{
+public:
+    enum Result
+    {
+        kCompressionError = -1, //连接错误COMPRESSION_ERROR
+        kOk               = 0,
+        kTooLarge         = 1,  //header列表超过max_header_list_size: 表状态已同步, 可只拒绝该流
+    };
+
+    HpackDecoder() = default;
+    ~HpackDecoder() = default;
+
+    //max_table_size: 本端SETTINGS_HEADER_TABLE_SIZE
+    inline void init(uint_t max_table_size, uint_t max_header_list_size)
+    {
+        max_table_size_       = max_table_size;
+        max_header_list_size_ = max_header_list_size;
+        table_.clear();
+        table_.set_max_size(max_table_size);
+    }
+
+    inline const HpackDynamicTable & table() const
+    {
+        return table_;
+    }
+
+    //解码一个完整的header block, 每个header回调emit(name, name_len, value, value_len)
+    //  超过max_header_list_size后不再回调, 但仍解码完整个block以保持动态表同步
+    template <class TEmit>
+    int decode(const char *data, uint_t len, TEmit &&emit)
+    {
+        const uint8_t *p   = reinterpret_cast<const uint8_t *>(data);
+        const uint8_t *end = p + len;
+        bool   size_update_allowed = true;
+        uint_t list_size = 0;
+        uint_t index;
+        const char *name;
+        const char *value;
+        uint_t name_len;
+        uint_t value_len;
+
+        while (p < end) {
+            uint8_t b = *p;
+            if (b & 0x80) {
+                //Indexed Header Field
+                if ((HpackCodec::decode_integer(p, end, 7, index) < 0) || (lookup(index, name, name_len, value, value_len) < 0)) {
+                    return kCompressionError;
+                }
+                size_update_allowed = false;
+                emit_header(emit, list_size, name, name_len, value, value_len);
+                continue;
+            }
+            if ((b & 0xE0) == 0x20) {
+                //Dynamic Table Size Update: 只能出现在block开头
+                if (!size_update_allowed || (HpackCodec::decode_integer(p, end, 5, index) < 0) || (index > max_table_size_)) {
+                    return kCompressionError;
+                }
+                table_.set_max_size(index);
+                continue;
+            }
+
+            //Literal Header Field: 01 带索引, 0000 不索引, 0001 永不索引
+            size_update_allowed = false;
+            bool incremental = (b & 0x40) != 0;
+            if (HpackCodec::decode_integer(p, end, incremental ? 6 : 4, index) < 0) {
+                return kCompressionError;
+            }
+            if (index > 0) {
+                if (lookup(index, name, name_len, value, value_len) < 0) {
+                    return kCompressionError;
+                }
+                if (incremental && (index > HpackStaticTable::SIZE)) {
+                    //名称来自动态表, 加入新表项时可能被淘汰, 先拷贝
+                    name_scratch_.assign(name, name_len);
+                    name = name_scratch_.data();
+                }
+            }
+            else if (HpackCodec::decode_string(p, end, max_header_list_size_, name_scratch_, name, name_len) < 0) {
+                return kCompressionError;
+            }
+            if (HpackCodec::decode_string(p, end, max_header_list_size_, value_scratch_, value, value_len) < 0) {
+                return kCompressionError;
+            }
+            emit_header(emit, list_size, name, name_len, value, value_len);
+            if (incremental) {
+                table_.add(name, name_len, value, value_len);
+            }
+        }
+
+        return (list_size > max_header_list_size_) ? kTooLarge : kOk;
+    }
+
+private:
+    int lookup(uint_t index, const char *&name, uint_t &name_len, const char *&value, uint_t &value_len) const
+    {
+        if (0 == index) {
+            return -1;
+        }
+        if (index <= HpackStaticTable::SIZE) {
+            const HpackTableEntry &entry = HpackStaticTable::get(index);
+            name      = entry.name_;
+            name_len  = entry.name_len_;
+            value     = entry.value_;
+            value_len = entry.value_len_;
+            return 0;
+        }
+        index -= HpackStaticTable::SIZE + 1;
+        if (index >= table_.count()) {
+            return -1;
+        }
+        const HpackDynamicTable::Entry &entry = table_.get(index);
+        name      = entry.name_.data();
+        name_len  = static_cast<uint_t>(entry.name_.size());
+        value     = entry.value_.data();
+        value_len = static_cast<uint_t>(entry.value_.size());
+        return 0;
+    }
+
+    template <class TEmit>
+    inline void emit_header(TEmit &emit, uint_t &list_size, const char *name, uint_t name_len, const char *value, uint_t value_len)
+    {
+        list_size += name_len + value_len + HpackDynamicTable::ENTRY_OVERHEAD;
+        if (list_size <= max_header_list_size_) {
+            emit(name, name_len, value, value_len);
+        }
+    }
+
+private:
+    HpackDynamicTable   table_;
+    std::string         name_scratch_;
+    std::string         value_scratch_;
+    uint_t              max_table_size_       = 4096;
+    uint_t              max_header_list_size_ = 65536;
+};
+
+//HPACK编码器(每个连接一个, 编码发往对端的header block)
+//  完全匹配静态表/动态表时输出索引; 否则输出带索引的字面量(名称尽量引用表项)
+//  内容每次都变化的header(如content-length)不加入动态表, 敏感header以"永不索引"输出
+class HpackEncoder
+{
+public:
+    enum
+    {
+        MAX_TABLE_SIZE = 4096,  //本端使用的动态表上限(对端允许更大时也不超过此值)
+    };
+
+    HpackEncoder() = default;
+    ~HpackEncoder() = default;
+
+    inline void reset()
+    {
+        table_.clear();
+        table_.set_max_size(MAX_TABLE_SIZE);
+        pending_size_update_ = false;
+    }
+
+    //对端SETTINGS_HEADER_TABLE_SIZE变化: 下一个header block开头输出Dynamic Table Size Update
+    inline void set_max_table_size(uint_t size)
+    {
+        uint_t max_size = (size < MAX_TABLE_SIZE) ? size : MAX_TABLE_SIZE;
+        if (max_size != table_.max_size()) {
+            table_.set_max_size(max_size);
+            pending_size_update_ = true;
+        }
+    }
+
+    //每个header block开始时调用
+    template <class TBuffer>
+    inline void begin(TBuffer &out)
+    {
+        if (pending_size_update_) {
+            HpackCodec::encode_integer(out, 0x20, 5, table_.max_size());
+            pending_size_update_ = false;
+        }
+    }
+
+    //name须为小写
+    template <class TBuffer>
+    void encode(TBuffer &out, const char *name, uint_t name_len, const char *value, uint_t value_len)
+    {
+        uint_t name_index;
+        uint_t index = HpackStaticTable::find(name, name_len, value, value_len, name_index);
+        if (index > 0) {
+            HpackCodec::encode_integer(out, 0x80, 7, index);
+            return;
+        }
+        uint_t dynamic_name_index;
+        index = table_.find(name, name_len, value, value_len, dynamic_name_index);
+        if (index > 0) {
+            HpackCodec::encode_integer(out, 0x80, 7, index + HpackStaticTable::SIZE);
+            return;
+        }
+        if ((0 == name_index) && (dynamic_name_index > 0)) {
+            name_index = dynamic_name_index + HpackStaticTable::SIZE;
+        }
+
+        uint8_t first_byte;
+        uint_t  prefix_bits;
+        bool    indexing = false;
+        if (is_sensitive(name, name_len)) {
+            first_byte  = 0x10;
+            prefix_bits = 4;
+        }
+        else if (is_volatile(name, name_len)) {
+            first_byte  = 0x00;
+            prefix_bits = 4;
+        }
+        else {
+            first_byte  = 0x40;
+            prefix_bits = 6;
+            indexing    = true;
+        }
+
+        HpackCodec::encode_integer(out, first_byte, prefix_bits, name_index);
+        if (0 == name_index) {
+            HpackCodec::encode_string(out, name, name_len, scratch_);
+        }
+        HpackCodec::encode_string(out, value, value_len, scratch_);
+        if (indexing) {
+            table_.add(name, name_len, value, value_len);
+        }
+    }
+
+    //:status伪header
+    template <class TBuffer>
+    void encode_status(TBuffer &out, int status)
+    {
+        //静态表: 200(8) 204(9) 206(10) 304(11) 400(12) 404(13) 500(14)
+        uint_t index = 0;
+        switch (status) {
+        case 200: index = 8;  break;
+        case 204: index = 9;  break;
+        case 206: index = 10; break;
+        case 304: index = 11; break;
+        case 400: index = 12; break;
+        case 404: index = 13; break;
+        case 500: index = 14; break;
+        default: break;
+        }
+        if (index > 0) {
+            HpackCodec::encode_integer(out, 0x80, 7, index);
+            return;
+        }
+        char value[3] = {
+            static_cast<char>('0' + (status / 100) % 10),
+            static_cast<char>('0' + (status / 10) % 10),
+            static_cast<char>('0' + status % 10),
+        };
+        encode(out, ":status", 7, value, 3);
+    }
+
+private:
+    static inline bool is_sensitive(const char *name, uint_t name_len)
+    {
+        return ((13 == name_len) && (std::memcmp(name, "authorization", 13) == 0))
+            || ((10 == name_len) && (std::memcmp(name, "set-cookie", 10) == 0))
+            || ((6 == name_len) && (std::memcmp(name, "cookie", 6) == 0));
+    }
+
+    static inline bool is_volatile(const char *name, uint_t name_len)
+    {
+        return ((14 == name_len) && (std::memcmp(name, "content-length", 14) == 0))
+            || ((13 == name_len) && (std::memcmp(name, "content-range", 13) == 0))
+            || ((4 == name_len) && (std::memcmp(name, "etag", 4) == 0))
+            || ((13 == name_len) && (std::memcmp(name, "last-modified", 13) == 0))
+            || ((5 == name_len) && (std::memcmp(name, ":path", 5) == 0));
+    }
+
+private:
+    HpackDynamicTable   table_;
+    std::string         scratch_;
+    bool                pending_size_update_ = false;
+};
+
+ZRSOCKET_NAMESPACE_END
+
+#endif
@@ -0,0 +1,1235 @@
+﻿// Some compilers (e.g. VC++) benefit significantly from using this. 
+// We've measured 3-4% build speed improvements in apps as a result 
+#pragma once
+
+#ifndef ZRSOCKET_HTTP2_REQUEST_HANDLER_H
+#define ZRSOCKET_HTTP2_REQUEST_HANDLER_H
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "config.h"
+#include "base_type.h"
+#include "byte_buffer.h"
+#include "buffer_pool.h"
+#include "http_common.h"
+#include "http_request_handler.h"
+#include "http_static_file.h"
+#include "http2_frame.h"
+#include "http2_hpack.h"
+
+ZRSOCKET_NAMESPACE_BEGIN
+
+class Http2DecoderConfig : public HttpDecoderConfig
+{
+public:
+    Http2DecoderConfig() = default;
+    virtual ~Http2DecoderConfig() = default;
+
+    //是否接受HTTP/2明文连接(h2c): 以客户端序言开头的连接(prior knowledge)及"Upgrade: h2c"请求
+    bool   http2_enable_            = true;
+    uint_t max_concurrent_streams_  = 128;
+    uint_t initial_window_size_     = 1048576;      //每个流的接收窗口
+    uint_t connection_window_size_  = 16777216;     //连接的接收窗口
+    uint_t max_header_list_size_    = 16384;        //解压后header列表的最大长度
+    uint_t header_table_size_       = Http2Frame::DEFAULT_HEADER_TABLE_SIZE;    //本端HPACK解码的动态表大小
+};
+
+//HTTP/2(h2c)服务端: 在HttpRequestHandler上增加HTTP/2, 同一个handler同时服务HTTP/1.x与HTTP/2连接
+//  每个流的请求接收完整后填充到context_, 与HTTP/1.x一样调用do_message; response_.sequence_为流ID
+//  do_message返回0时自动回复; 返回>0时由send_response/send_chunked_*/send_file异步回复(须在所属event_loop线程中调用)
+//  流之间互不阻塞: 异步回复不需要按请求顺序, 哪个流完成就发送哪个
+//  回复body按对端的连接/流窗口分帧发送, 窗口不足时缓存在流中, 收到WINDOW_UPDATE后继续
+//  请求body按HttpDecoderConfig::max_body_length_限制整体接收(HTTP/2连接不回调do_body_chunk)
+//  需使用Http2DecoderConfig作为message_decoder_config
+//  TBase为HTTP/1.x的处理(HttpRequestHandler或叠加了分层的HttpRequestHandler, 如HttpOffloadHandler<HttpRequestHandler<...> >)
+//  HTTP/1.x连接上的send_file需要TBase包含HttpStaticFileHandler
+template <class TBuffer, class TMutex, class TBase = HttpRequestHandler<TBuffer, TMutex> >
+class Http2RequestHandler : public TBase
+{
+public:
+    using super = TBase;
+
+    Http2RequestHandler() = default;
+
+    virtual ~Http2RequestHandler()
+    {
+        clear_streams();
+        for (auto stream : free_streams_) {
+            delete stream;
+        }
+        free_streams_.clear();
+    }
+
+    //连接是否为HTTP/2
+    inline bool http2() const
+    {
+        return h2_;
+    }
+
+    //以下接口与HttpRequestHandler相同, HTTP/2连接时按流回复
+    int send(HttpContext &context, ByteBuffer &out, bool out_owned = true)
+    {
+        if (!h2_) {
+            return super::send(context, out, out_owned);
+        }
+        return send_response(context);
+    }
+
+    int send_response(HttpContext &context)
+    {
+        if (!h2_) {
+            return super::send_response(context);
+        }
+        Http2Stream *stream = find_stream(context.response_.sequence_);
+        if ((nullptr == stream) || stream->headers_sent_) {
+            return -1;
+        }
+        ByteBuffer &out = super::stream_out();
+        write_response(*stream, context, out);
+        output(out);
+        return 0;
+    }
+
+    int send_chunked_begin(HttpContext &context)
+    {
+        if (!h2_) {
+            return super::send_chunked_begin(context);
+        }
+        Http2Stream *stream = find_stream(context.response_.sequence_);
+        if ((nullptr == stream) || stream->headers_sent_) {
+            return -1;
+        }
+        ByteBuffer &out = super::stream_out();
+        write_headers(*stream, context.response_, -1, nullptr, 0, false, out);
+        stream->streaming_ = true;
+        output(out);
+        return 0;
+    }
+
+    int send_chunk(HttpContext &context, const char *data, uint_t len)
+    {
+        if (!h2_) {
+            return super::send_chunk(context, data, len);
+        }
+        Http2Stream *stream = find_stream(context.response_.sequence_);
+        if ((nullptr == stream) || !stream->streaming_) {
+            return -1;
+        }
+        if (stream->head_ || (0 == len)) {
+            return 0;
+        }
+        if (nullptr == stream->data_.buffer()) {
+            BufferPool::instance().acquire(stream->data_, len);
+        }
+        stream->data_.write(data, len);
+        ByteBuffer &out = super::stream_out();
+        write_stream_data(*stream, out);
+        output(out);
+        return 0;
+    }
+
+    int send_chunked_end(HttpContext &context)
+    {
+        if (!h2_) {
+            return super::send_chunked_end(context);
+        }
+        Http2Stream *stream = find_stream(context.response_.sequence_);
+        if ((nullptr == stream) || !stream->streaming_) {
+            return -1;
+        }
+        stream->streaming_   = false;
+        stream->end_pending_ = true;
+        ByteBuffer &out = super::stream_out();
+        write_stream_data(*stream, out);
+        output(out);
+        return 0;
+    }
+
+    //文件内容由pread读取后分帧发送(HTTP/2需要分帧, 不能使用sendfile); HTTP/1.x连接由TBase(HttpStaticFileHandler)发送
+    int send_file(HttpContext &context, const HttpStaticFileConfig &config)
+    {
+        if (!h2_) {
+            return super::send_file(context, config);
+        }
+        Http2Stream *stream = find_stream(context.response_.sequence_);
+        if ((nullptr == stream) || stream->headers_sent_) {
+            return -1;
+        }
+
+        HttpFileEntry *entry;
+        HttpStatusCode status_code;
+        uint64_t offset;
+        uint64_t length;
+        if (HttpStaticFile::open_file(context, config, entry, status_code, offset, length) > 0) {
+            return 1;
+        }
+
+        static thread_local std::string file_headers;
+        file_headers.assign(entry->headers_);
+        if (HttpStatusCode::k206 == status_code) {
+            char line[96];
+            int len = std::snprintf(line, sizeof(line), "Content-Range: bytes %llu-%llu/%llu\r\n",
+                static_cast<unsigned long long>(offset),
+                static_cast<unsigned long long>(offset + length - 1),
+                static_cast<unsigned long long>(entry->info_.size_));
+            file_headers.append(line, static_cast<size_t>(len));
+        }
+
+        bool body = !stream->head_ && (length > 0);
+        context.response_.status_code_ = status_code;
+        ByteBuffer &out = super::stream_out();
+        write_headers(*stream, context.response_, static_cast<int64_t>(length),
+            file_headers.data(), static_cast<uint_t>(file_headers.size()), !body, out);
+        if (body && entry->memory_) {
+            BufferPool::instance().acquire(stream->data_, static_cast<uint_t>(length));
+            stream->data_.write(entry->content_.data() + offset, static_cast<uint_t>(length));
+            HttpFileCache::instance().release(entry);
+        }
+        else if (body) {
+            stream->file_        = entry;
+            stream->file_offset_ = offset;
+            stream->file_remain_ = length;
+        }
+        else {
+            HttpFileCache::instance().release(entry);
+        }
+        if (body) {
+            stream->end_pending_ = true;
+            write_stream_data(*stream, out);
+        }
+        else {
+            close_stream(stream);
+        }
+        output(out);
+        return 0;
+    }
+
+    int handle_open()
+    {
+        clear_streams();
+        h2_               = false;
+        protocol_checked_ = false;
+        return super::handle_open();
+    }
+
+protected:
+    //流
+    struct Http2Stream
+    {
+        uint32_t        id_ = 0;
+        HttpRequest     request_;                   //接收中的请求
+        int64_t         send_window_  = 0;          //对端的流窗口
+        uint_t          recv_unacked_ = 0;          //已接收但未发送WINDOW_UPDATE的字节数
+        ByteBuffer      data_;                      //待发送的body
+        HttpFileEntry  *file_ = nullptr;            //data_之后待发送的文件内容
+        uint64_t        file_offset_ = 0;
+        uint64_t        file_remain_ = 0;
+        bool            recv_closed_  = false;      //已收到END_STREAM
+        bool            headers_sent_ = false;      //已发送回复的HEADERS
+        bool            end_pending_  = false;      //待发送的body发送完后结束流
+        bool            streaming_    = false;      //流式回复进行中
+        bool            head_         = false;      //HEAD请求: 不发送body
+    };
+
+    enum
+    {
+        FILE_BATCH_SIZE = 262144,   //一次输出的文件内容上限(其余等待socket可写后继续)
+    };
+
+    int decode(const char *data, uint_t len)
+    {
+        if (!protocol_checked_) {
+            ByteBuffer &message_buffer = super::message_handler::message_buffer_;
+            if (!message_buffer.empty()) {
+                //连接的前几个字节不足以区分协议: 与之前缓存的数据合并后再判断
+                std::string joined(message_buffer.data(), message_buffer.data_size());
+                joined.append(data, len);
+                super::message_handler::release_message_buffer();
+                return decode(joined.data(), static_cast<uint_t>(joined.size()));
+            }
+
+            Http2DecoderConfig *config = static_cast<Http2DecoderConfig *>(super::source_->message_decoder_config());
+            uint_t check_len = std::min<uint_t>(len, Http2Frame::PREFACE_LENGTH);
+            if (config->http2_enable_ && (std::memcmp(data, Http2Frame::preface(), check_len) == 0)) {
+                if (check_len < 4) {
+                    //"P"/"PR"/"PRI"也可能是HTTP/1.x的方法
+                    super::message_handler::write_message_buffer(data, len, 16);
+                    return 1;
+                }
+                //prior knowledge: 客户端直接以HTTP/2开始
+                ByteBuffer &out = super::batch_buffer();
+                out.reset();
+                start_http2(out);
+                super::upgraded_ = true;
+                super::message_handler::send(out.data(), out.data_size());
+            }
+            protocol_checked_ = true;
+        }
+
+        int ret = super::decode(data, len);
+        if (h2_ && (ret >= 0)) {
+            send_pending_data();
+        }
+        return ret;
+    }
+
+    //socket可写: 继续发送文件内容
+    int handle_write()
+    {
+        int ret = super::handle_write();
+        if (h2_ && (ret >= 0)) {
+            send_pending_data();
+        }
+        return ret;
+    }
+
+    int handle_close()
+    {
+        int ret = super::handle_close();
+        clear_streams();
+        return ret;
+    }
+
+    //"Upgrade: h2c": 回复101后转为HTTP/2, 升级请求本身作为流1处理
+    //  带body的升级请求不升级(按HTTP/1.1处理)
+    int do_upgrade()
+    {
+        Http2DecoderConfig *config = static_cast<Http2DecoderConfig *>(super::source_->message_decoder_config());
+        HttpRequest &request = super::context_.request_;
+        const HttpHeader *upgrade = request.headers_.known(HttpKnownHeader::kUpgrade);
+        if (!config->http2_enable_ || !upgrade->value_.has_token("h2c", 3) || (request.content_length_ > 0) || request.chunked_) {
+            return 0;
+        }
+
+        //HTTP2-Settings: base64url编码的SETTINGS帧payload
+        HttpStringView settings_header = request.header("HTTP2-Settings", sizeof("HTTP2-Settings") - 1);
+        static thread_local std::string settings;
+        settings.clear();
+        if (settings_header.empty() ||
+            (Http2Frame::base64url_decode(settings_header.data_, settings_header.len_, settings) < 0) ||
+            (settings.size() % 6 != 0)) {
+            return 0;
+        }
+
+        ByteBuffer &out = *super::batch_out_;
+        static const char switching[] = "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+        out.write(switching, sizeof(switching) - 1);
+        start_http2(out);
+        if (apply_settings(settings.data(), static_cast<uint_t>(settings.size())) != Http2ErrorCode::kNoError) {
+            return -1;
+        }
+
+        //流1: 请求已完整接收(half-closed remote)
+        Http2Stream *stream = open_stream(1);
+        stream->recv_closed_ = true;
+        return (dispatch(*stream, out) < 0) ? -1 : 1;
+    }
+
+    //HTTP/2帧接收
+    int decode_upgraded(const char *data, uint_t len)
+    {
+        if (!h2_) {
+            return -1;
+        }
+        ByteBuffer &out = *super::batch_out_;
+        if (preface_remain_ > 0) {
+            uint_t check_len = std::min<uint_t>(len, preface_remain_);
+            if (std::memcmp(data, Http2Frame::preface() + Http2Frame::PREFACE_LENGTH - preface_remain_, check_len) != 0) {
+                return -1;
+            }
+            preface_remain_ -= check_len;
+            data += check_len;
+            len  -= check_len;
+            if (preface_remain_ > 0) {
+                return 1;
+            }
+        }
+
+        Http2FrameHeader header;
+        ByteBuffer &message_buffer = super::message_handler::message_buffer_;
+        if (!message_buffer.empty()) {
+            //上次接收剩余的半个帧
+            uint_t last_len = message_buffer.data_size();
+            if (last_len < Http2Frame::HEADER_LENGTH) {
+                uint_t need_len = std::min<uint_t>(len, Http2Frame::HEADER_LENGTH - last_len);
+                message_buffer.write(data, need_len);
+                data += need_len;
+                len  -= need_len;
+                if (message_buffer.data_size() < Http2Frame::HEADER_LENGTH) {
+                    return 1;
+                }
+                last_len = Http2Frame::HEADER_LENGTH;
+            }
+            Http2Frame::parse_header(message_buffer.data(), header);
+            if (header.length_ > Http2Frame::DEFAULT_MAX_FRAME_SIZE) {
+                return connection_error(out, Http2ErrorCode::kFrameSizeError);
+            }
+            uint_t need_len = std::min<uint_t>(len, Http2Frame::HEADER_LENGTH + header.length_ - last_len);
+            message_buffer.write(data, need_len);
+            data += need_len;
+            len  -= need_len;
+            if (message_buffer.data_size() < Http2Frame::HEADER_LENGTH + header.length_) {
+                return 1;
+            }
+            Http2ErrorCode error_code = process_frame(header, message_buffer.data() + Http2Frame::HEADER_LENGTH, out);
+            super::message_handler::release_message_buffer();
+            if (Http2ErrorCode::kNoError != error_code) {
+                return connection_error(out, error_code);
+            }
+        }
+
+        while (len >= Http2Frame::HEADER_LENGTH) {
+            Http2Frame::parse_header(data, header);
+            if (header.length_ > Http2Frame::DEFAULT_MAX_FRAME_SIZE) {
+                return connection_error(out, Http2ErrorCode::kFrameSizeError);
+            }
+            if (len < Http2Frame::HEADER_LENGTH + header.length_) {
+                break;
+            }
+            Http2ErrorCode error_code = process_frame(header, data + Http2Frame::HEADER_LENGTH, out);
+            if (Http2ErrorCode::kNoError != error_code) {
+                return connection_error(out, error_code);
+            }
+            data += Http2Frame::HEADER_LENGTH + header.length_;
+            len  -= Http2Frame::HEADER_LENGTH + header.length_;
+        }
+        if (len > 0) {
+            super::message_handler::write_message_buffer(data, len, Http2Frame::HEADER_LENGTH + Http2Frame::DEFAULT_MAX_FRAME_SIZE);
+        }
+        return 1;
+    }
+
+    //连接转为HTTP/2: 输出本端SETTINGS及连接窗口的WINDOW_UPDATE
+    void start_http2(ByteBuffer &out)
+    {
+        Http2DecoderConfig *config = static_cast<Http2DecoderConfig *>(super::source_->message_decoder_config());
+        h2_                  = true;
+        preface_remain_      = Http2Frame::PREFACE_LENGTH;
+        settings_received_   = false;
+        settings_acked_      = false;
+        last_stream_id_      = 0;
+        continuation_stream_id_ = 0;
+        send_window_         = Http2Frame::DEFAULT_WINDOW_SIZE;
+        recv_window_         = Http2Frame::DEFAULT_WINDOW_SIZE;
+        peer_initial_window_ = Http2Frame::DEFAULT_WINDOW_SIZE;
+        peer_max_frame_size_ = Http2Frame::DEFAULT_MAX_FRAME_SIZE;
+        hpack_decoder_.init(config->header_table_size_, config->max_header_list_size_);
+        hpack_encoder_.reset();
+
+        Http2SettingsId ids[4] = {
+            Http2SettingsId::kMaxConcurrentStreams,
+            Http2SettingsId::kInitialWindowSize,
+            Http2SettingsId::kMaxHeaderListSize,
+            Http2SettingsId::kHeaderTableSize,
+        };
+        uint32_t values[4] = {
+            config->max_concurrent_streams_,
+            config->initial_window_size_,
+            config->max_header_list_size_,
+            config->header_table_size_,
+        };
+        Http2Frame::write_settings(out, ids, values,
+            (Http2Frame::DEFAULT_HEADER_TABLE_SIZE != config->header_table_size_) ? 4 : 3);
+        if (config->connection_window_size_ > Http2Frame::DEFAULT_WINDOW_SIZE) {
+            Http2Frame::write_window_update(out, 0, config->connection_window_size_ - Http2Frame::DEFAULT_WINDOW_SIZE);
+            recv_window_ = config->connection_window_size_;
+        }
+    }
+
+    //返回值: 连接错误码(kNoError: 正常)
+    Http2ErrorCode process_frame(const Http2FrameHeader &header, const char *payload, ByteBuffer &out)
+    {
+        Http2FrameType type = static_cast<Http2FrameType>(header.type_);
+        if ((0 != continuation_stream_id_) &&
+            ((Http2FrameType::kContinuation != type) || (header.stream_id_ != continuation_stream_id_))) {
+            return Http2ErrorCode::kProtocolError;
+        }
+        if (!settings_received_ && (Http2FrameType::kSettings != type)) {
+            //序言之后的第一个帧须为SETTINGS
+            return Http2ErrorCode::kProtocolError;
+        }
+
+        switch (type) {
+        case Http2FrameType::kData:
+            return on_data(header, payload, out);
+        case Http2FrameType::kHeaders:
+            return on_headers(header, payload, out);
+        case Http2FrameType::kPriority:
+            if (0 == header.stream_id_) {
+                return Http2ErrorCode::kProtocolError;
+            }
+            if (header.length_ != 5) {
+                reset_stream(header.stream_id_, Http2ErrorCode::kFrameSizeError, out);
+            }
+            return Http2ErrorCode::kNoError;
+        case Http2FrameType::kRstStream:
+            if (0 == header.stream_id_) {
+                return Http2ErrorCode::kProtocolError;
+            }
+            if (header.length_ != 4) {
+                return Http2ErrorCode::kFrameSizeError;
+            }
+            if (header.stream_id_ > last_stream_id_) {
+                return Http2ErrorCode::kProtocolError;
+            }
+            close_stream(find_stream(header.stream_id_));
+            return Http2ErrorCode::kNoError;
+        case Http2FrameType::kSettings:
+            return on_settings(header, payload, out);
+        case Http2FrameType::kPushPromise:
+            return Http2ErrorCode::kProtocolError;
+        case Http2FrameType::kPing:
+            if (0 != header.stream_id_) {
+                return Http2ErrorCode::kProtocolError;
+            }
+            if (header.length_ != 8) {
+                return Http2ErrorCode::kFrameSizeError;
+            }
+            if (0 == (header.flags_ & HTTP2_FLAG_ACK)) {
+                Http2Frame::write_ping_ack(out, payload);
+            }
+            return Http2ErrorCode::kNoError;
+        case Http2FrameType::kGoaway:
+            //对端不再发起新流: 已有的流继续完成
+            return (0 != header.stream_id_) ? Http2ErrorCode::kProtocolError : Http2ErrorCode::kNoError;
+        case Http2FrameType::kWindowUpdate:
+            return on_window_update(header, payload, out);
+        case Http2FrameType::kContinuation:
+            if (0 == continuation_stream_id_) {
+                return Http2ErrorCode::kProtocolError;
+            }
+            return append_header_block(header, payload, header.length_, out);
+        default:
+            //未知类型的帧忽略
+            return Http2ErrorCode::kNoError;
+        }
+    }
+
+    Http2ErrorCode on_data(const Http2FrameHeader &header, const char *payload, ByteBuffer &out)
+    {
+        if (0 == header.stream_id_) {
+            return Http2ErrorCode::kProtocolError;
+        }
+        uint_t data_len = header.length_;
+        if (header.flags_ & HTTP2_FLAG_PADDED) {
+            if ((0 == data_len) || (static_cast<uint8_t>(payload[0]) >= data_len)) {
+                return Http2ErrorCode::kProtocolError;
+            }
+            data_len -= 1 + static_cast<uint8_t>(payload[0]);
+            ++payload;
+        }
+
+        //连接窗口: 整个帧(含填充)计入
+        Http2DecoderConfig *config = static_cast<Http2DecoderConfig *>(super::source_->message_decoder_config());
+        if (static_cast<int64_t>(header.length_) > recv_window_) {
+            return Http2ErrorCode::kFlowControlError;
+        }
+        recv_window_ -= header.length_;
+        uint_t window_size = std::max<uint_t>(config->connection_window_size_, Http2Frame::DEFAULT_WINDOW_SIZE);
+        if (recv_window_ <= static_cast<int64_t>(window_size / 2)) {
+            Http2Frame::write_window_update(out, 0, static_cast<uint32_t>(window_size - recv_window_));
+            recv_window_ = window_size;
+        }
+
+        Http2Stream *stream = find_stream(header.stream_id_);
+        if ((nullptr == stream) || stream->recv_closed_) {
+            if (header.stream_id_ > last_stream_id_) {
+                return Http2ErrorCode::kProtocolError;
+            }
+            reset_stream(header.stream_id_, Http2ErrorCode::kStreamClosed, out);
+            return Http2ErrorCode::kNoError;
+        }
+
+        //流窗口(RFC 9113 6.9): 超过本端SETTINGS_INITIAL_WINDOW_SIZE时重置流
+        //  本端SETTINGS被确认前对端可能仍按默认窗口发送
+        uint_t stream_window = settings_acked_ ? config->initial_window_size_ :
+            std::max<uint_t>(config->initial_window_size_, Http2Frame::DEFAULT_WINDOW_SIZE);
+        if (stream->recv_unacked_ + header.length_ > stream_window) {
+            reset_stream(header.stream_id_, Http2ErrorCode::kFlowControlError, out);
+            return Http2ErrorCode::kNoError;
+        }
+
+        if ((data_len > 0) && (stream->request_.append_body(payload, data_len, config->max_body_length_) < 0)) {
+            reset_stream(header.stream_id_, Http2ErrorCode::kCancel, out);
+            return Http2ErrorCode::kNoError;
+        }
+        if (header.flags_ & HTTP2_FLAG_END_STREAM) {
+            stream->recv_closed_ = true;
+            return (receive_complete(*stream, out) < 0) ? Http2ErrorCode::kInternalError : Http2ErrorCode::kNoError;
+        }
+        stream->recv_unacked_ += header.length_;
+        if (stream->recv_unacked_ >= config->initial_window_size_ / 2) {
+            Http2Frame::write_window_update(out, header.stream_id_, stream->recv_unacked_);
+            stream->recv_unacked_ = 0;
+        }
+        return Http2ErrorCode::kNoError;
+    }
+
+    Http2ErrorCode on_headers(const Http2FrameHeader &header, const char *payload, ByteBuffer &out)
+    {
+        if ((0 == header.stream_id_) || (0 == (header.stream_id_ & 1))) {
+            return Http2ErrorCode::kProtocolError;
+        }
+        uint_t block_len = header.length_;
+        uint_t pad_len   = 0;
+        if (header.flags_ & HTTP2_FLAG_PADDED) {
+            if (0 == block_len) {
+                return Http2ErrorCode::kProtocolError;
+            }
+            pad_len = static_cast<uint8_t>(payload[0]);
+            ++payload;
+            --block_len;
+        }
+        if (header.flags_ & HTTP2_FLAG_PRIORITY) {
+            if (block_len < 5) {
+                return Http2ErrorCode::kFrameSizeError;
+            }
+            payload   += 5;
+            block_len -= 5;
+        }
+        if (pad_len > block_len) {
+            return Http2ErrorCode::kProtocolError;
+        }
+
+        header_block_.clear();
+        headers_flags_ = header.flags_;
+        continuation_stream_id_ = header.stream_id_;
+        Http2FrameHeader block_header = header;
+        block_header.flags_ &= HTTP2_FLAG_END_HEADERS;
+        return append_header_block(block_header, payload, block_len - pad_len, out);
+    }
+
+    //HEADERS/CONTINUATION的header块, END_HEADERS时解码
+    Http2ErrorCode append_header_block(const Http2FrameHeader &header, const char *block, uint_t block_len, ByteBuffer &out)
+    {
+        Http2DecoderConfig *config = static_cast<Http2DecoderConfig *>(super::source_->message_decoder_config());
+        if (header_block_.size() + block_len > config->max_header_list_size_) {
+            return Http2ErrorCode::kEnhanceYourCalm;
+        }
+        header_block_.append(block, block_len);
+        if (0 == (header.flags_ & HTTP2_FLAG_END_HEADERS)) {
+            return Http2ErrorCode::kNoError;
+        }
+
+        uint32_t stream_id = continuation_stream_id_;
+        continuation_stream_id_ = 0;
+        bool end_stream = (headers_flags_ & HTTP2_FLAG_END_STREAM) != 0;
+        Http2Stream *stream = find_stream(stream_id);
+        if (nullptr != stream) {
+            //trailer: 解码(保持HPACK状态)后忽略
+            if (decode_header_block(nullptr) < 0) {
+                return Http2ErrorCode::kCompressionError;
+            }
+            if (stream->recv_closed_ || !end_stream) {
+                reset_stream(stream_id, stream->recv_closed_ ? Http2ErrorCode::kStreamClosed : Http2ErrorCode::kProtocolError, out);
+                return Http2ErrorCode::kNoError;
+            }
+            stream->recv_closed_ = true;
+            return (receive_complete(*stream, out) < 0) ? Http2ErrorCode::kInternalError : Http2ErrorCode::kNoError;
+        }
+
+        if (stream_id <= last_stream_id_) {
+            return Http2ErrorCode::kStreamClosed;
+        }
+        last_stream_id_ = stream_id;
+        if (streams_.size() >= config->max_concurrent_streams_) {
+            if (decode_header_block(nullptr) < 0) {
+                return Http2ErrorCode::kCompressionError;
+            }
+            reset_stream(stream_id, Http2ErrorCode::kRefusedStream, out);
+            return Http2ErrorCode::kNoError;
+        }
+
+        stream = open_stream(stream_id);
+        int ret = decode_header_block(&stream->request_);
+        if (ret < 0) {
+            return Http2ErrorCode::kCompressionError;
+        }
+        if (ret > 0) {
+            reset_stream(stream_id, Http2ErrorCode::kProtocolError, out);
+            return Http2ErrorCode::kNoError;
+        }
+        if (end_stream) {
+            stream->recv_closed_ = true;
+            return (receive_complete(*stream, out) < 0) ? Http2ErrorCode::kInternalError : Http2ErrorCode::kNoError;
+        }
+        return Http2ErrorCode::kNoError;
+    }
+
+    //解码header_block_到request(nullptr时只解码)
+    //返回值 <0: 连接错误(COMPRESSION_ERROR); >0: 请求格式错误或超过长度(流错误)
+    int decode_header_block(HttpRequest *request)
+    {
+        bool regular   = false;     //已出现普通header(伪header须在其前)
+        bool malformed = false;
+        bool has_method = false;
+        bool has_path   = false;
+        int ret = hpack_decoder_.decode(header_block_.data(), static_cast<uint_t>(header_block_.size()),
+            [&](const char *name, uint_t name_len, const char *value, uint_t value_len) {
+            if ((nullptr == request) || malformed) {
+                return;
+            }
+            if ((name_len > 0) && (':' == name[0])) {
+                if (regular) {
+                    malformed = true;
+                }
+                else if ((7 == name_len) && (std::memcmp(name, ":method", 7) == 0)) {
+                    request->method_id_ = HttpParser::parse_method(value, value_len);
+                    has_method = (HttpMethodId::kUNKNOWN != request->method_id_);
+                    malformed  = !has_method;
+                }
+                else if ((5 == name_len) && (std::memcmp(name, ":path", 5) == 0)) {
+                    request->uri_.assign(value, value_len);
+                    has_path  = (value_len > 0);
+                    malformed = !has_path;
+                }
+                else if ((10 == name_len) && (std::memcmp(name, ":authority", 10) == 0)) {
+                    request->headers_.add("host", 4, value, value_len);
+                }
+                else if ((7 != name_len) || (std::memcmp(name, ":scheme", 7) != 0)) {
+                    malformed = true;
+                }
+                return;
+            }
+            regular = true;
+            for (uint_t i = 0; i < name_len; ++i) {
+                if (static_cast<unsigned char>(name[i] - 'A') < 26) {
+                    malformed = true;
+                    return;
+                }
+            }
+            if (is_connection_header(name, name_len) &&
+                ((2 != name_len) || (8 != value_len) || (std::memcmp(value, "trailers", 8) != 0))) {
+                malformed = true;
+                return;
+            }
+            request->headers_.add(name, name_len, value, value_len);
+        });
+
+        if (ret < 0) {
+            return -1;
+        }
+        if (nullptr == request) {
+            return 0;
+        }
+        return ((HpackDecoder::kOk != ret) || malformed || !has_method ||
+            (!has_path && (HttpMethodId::kCONNECT != request->method_id_))) ? 1 : 0;
+    }
+
+    Http2ErrorCode on_settings(const Http2FrameHeader &header, const char *payload, ByteBuffer &out)
+    {
+        if (0 != header.stream_id_) {
+            return Http2ErrorCode::kProtocolError;
+        }
+        if (header.flags_ & HTTP2_FLAG_ACK) {
+            if (0 != header.length_) {
+                return Http2ErrorCode::kFrameSizeError;
+            }
+            settings_acked_ = true;
+            return Http2ErrorCode::kNoError;
+        }
+        if (header.length_ % 6 != 0) {
+            return Http2ErrorCode::kFrameSizeError;
+        }
+        Http2ErrorCode error_code = apply_settings(payload, header.length_);
+        if (Http2ErrorCode::kNoError != error_code) {
+            return error_code;
+        }
+        settings_received_ = true;
+        Http2Frame::write_settings_ack(out);
+        write_all_stream_data(out);
+        return Http2ErrorCode::kNoError;
+    }
+
+    Http2ErrorCode apply_settings(const char *payload, uint_t len)
+    {
+        for (uint_t i = 0; i + 6 <= len; i += 6) {
+            uint_t id = (static_cast<uint8_t>(payload[i]) << 8) | static_cast<uint8_t>(payload[i + 1]);
+            uint32_t value = Http2Frame::read_u32(payload + i + 2);
+            switch (static_cast<Http2SettingsId>(id)) {
+            case Http2SettingsId::kHeaderTableSize:
+                hpack_encoder_.set_max_table_size(value);
+                break;
+            case Http2SettingsId::kEnablePush:
+                if (value > 1) {
+                    return Http2ErrorCode::kProtocolError;
+                }
+                break;
+            case Http2SettingsId::kInitialWindowSize:
+                {
+                    if (value > Http2Frame::MAX_WINDOW_SIZE) {
+                        return Http2ErrorCode::kFlowControlError;
+                    }
+                    //已有流的发送窗口按差值调整
+                    int64_t delta = static_cast<int64_t>(value) - peer_initial_window_;
+                    for (auto &iter : streams_) {
+                        iter.second->send_window_ += delta;
+                        if (iter.second->send_window_ > Http2Frame::MAX_WINDOW_SIZE) {
+                            return Http2ErrorCode::kFlowControlError;
+                        }
+                    }
+                    peer_initial_window_ = value;
+                }
+                break;
+            case Http2SettingsId::kMaxFrameSize:
+                if ((value < Http2Frame::DEFAULT_MAX_FRAME_SIZE) || (value > Http2Frame::MAX_MAX_FRAME_SIZE)) {
+                    return Http2ErrorCode::kProtocolError;
+                }
+                peer_max_frame_size_ = value;
+                break;
+            default:
+                break;
+            }
+        }
+        return Http2ErrorCode::kNoError;
+    }
+
+    Http2ErrorCode on_window_update(const Http2FrameHeader &header, const char *payload, ByteBuffer &out)
+    {
+        if (header.length_ != 4) {
+            return Http2ErrorCode::kFrameSizeError;
+        }
+        uint32_t increment = Http2Frame::read_u32(payload) & 0x7FFFFFFF;
+        if (0 == header.stream_id_) {
+            if (0 == increment) {
+                return Http2ErrorCode::kProtocolError;
+            }
+            send_window_ += increment;
+            if (send_window_ > Http2Frame::MAX_WINDOW_SIZE) {
+                return Http2ErrorCode::kFlowControlError;
+            }
+            write_all_stream_data(out);
+            return Http2ErrorCode::kNoError;
+        }
+
+        Http2Stream *stream = find_stream(header.stream_id_);
+        if (nullptr == stream) {
+            return (header.stream_id_ > last_stream_id_) ? Http2ErrorCode::kProtocolError : Http2ErrorCode::kNoError;
+        }
+        if (0 == increment) {
+            reset_stream(header.stream_id_, Http2ErrorCode::kProtocolError, out);
+            return Http2ErrorCode::kNoError;
+        }
+        stream->send_window_ += increment;
+        if (stream->send_window_ > Http2Frame::MAX_WINDOW_SIZE) {
+            reset_stream(header.stream_id_, Http2ErrorCode::kFlowControlError, out);
+            return Http2ErrorCode::kNoError;
+        }
+        write_stream_data(*stream, out);
+        return Http2ErrorCode::kNoError;
+    }
+
+    //请求接收完整: 填充context_后调用do_message
+    int receive_complete(Http2Stream &stream, ByteBuffer &out)
+    {
+        HttpRequest &request = super::context_.request_;
+        std::swap(request.headers_, stream.request_.headers_);
+        request.uri_.swap(stream.request_.uri_);
+        request.body_      = std::move(stream.request_.body_);
+        request.method_id_ = stream.request_.method_id_;
+        request.finish_body();
+        stream.request_.reset();
+
+        //Content-Length与DATA的总长度须一致
+        const HttpHeader *content_length = request.headers_.known(HttpKnownHeader::kContentLength);
+        uint_t length;
+        if ((nullptr != content_length) &&
+            ((HttpMessage::parse_content_length(content_length->value_, length) < 0) || (length != request.content_length_))) {
+            super::context_.reset();
+            reset_stream(stream.id_, Http2ErrorCode::kProtocolError, out);
+            return 0;
+        }
+        return dispatch(stream, out);
+    }
+
+    //调用do_message(context_已填充), 返回值 <0: 关闭连接
+    int dispatch(Http2Stream &stream, ByteBuffer &out)
+    {
+        HttpContext &context = super::context_;
+        uint32_t stream_id = stream.id_;
+        stream.head_ = (HttpMethodId::kHEAD == context.request_.method_id_);
+        context.response_.sequence_ = stream_id;
+
+        int ret = this->do_message();
+        BufferPool::instance().release(context.request_.body_);
+        if (ret < 0) {
+            return -1;
+        }
+
+        //do_message中可能已回复完成(流已关闭)
+        Http2Stream *current = find_stream(stream_id);
+        if ((0 == ret) && (nullptr != current) && !current->headers_sent_) {
+            write_response(*current, context, out);
+        }
+        if (0 == ret) {
+            context.reset();
+        }
+        else {
+            context.init();
+        }
+        return 0;
+    }
+
+    //回复: HEADERS(+CONTINUATION)后按窗口发送body
+    void write_response(Http2Stream &stream, HttpContext &context, ByteBuffer &out)
+    {
+        HttpResponse &response = context.response_;
+        uint_t body_size = response.body_.data_size();
+        int64_t content_length = -1;
+        if (!stream.head_) {
+            if (body_size > 0) {
+                content_length = body_size;
+            }
+            else if ((response.status_code_ >= HttpStatusCode::k200) &&
+                (response.status_code_ != HttpStatusCode::k204) &&
+                (response.status_code_ != HttpStatusCode::k304)) {
+                content_length = 0;
+            }
+        }
+        else {
+            uint_t real_body_size = std::max<uint_t>(body_size, response.content_length_);
+            if (real_body_size > 0) {
+                content_length = real_body_size;
+            }
+        }
+
+        bool body = !stream.head_ && (body_size > 0);
+        write_headers(stream, response, content_length, nullptr, 0, !body, out);
+        if (body) {
+            stream.data_ = std::move(response.body_);
+            stream.end_pending_ = true;
+            write_stream_data(stream, out);
+        }
+        else {
+            close_stream(&stream);
+        }
+    }
+
+    //HEADERS(+CONTINUATION)
+    //  extra: "Name: value\r\n"格式的附加header; content_length <0时不输出content-length
+    void write_headers(Http2Stream &stream, HttpResponse &response, int64_t content_length,
+        const char *extra, uint_t extra_len, bool end_stream, ByteBuffer &out)
+    {
+        Http2DecoderConfig *config = static_cast<Http2DecoderConfig *>(super::source_->message_decoder_config());
+        static thread_local ByteBuffer block(1024);
+        block.reset();
+        hpack_encoder_.begin(block);
+        hpack_encoder_.encode_status(block, static_cast<int>(response.status_code_));
+        if (config->date_header_ || !config->server_name_.empty()) {
+            HttpStringView date_server = HttpDateHeader::instance().header_block(config->date_header_, config->server_name_);
+            encode_header_lines(block, date_server.data_, date_server.len_);
+        }
+        for (auto &iter : response.headers_) {
+            if ((content_length >= 0) && iter.name_.equals_ignore_case("Content-Length", 14)) {
+                continue;
+            }
+            encode_header(block, iter.name_.data_, iter.name_.len_, iter.value_.data_, iter.value_.len_);
+        }
+        if (nullptr != extra) {
+            encode_header_lines(block, extra, extra_len);
+        }
+        if (content_length >= 0) {
+            char digits[24];
+            int len = std::snprintf(digits, sizeof(digits), "%lld", static_cast<long long>(content_length));
+            hpack_encoder_.encode(block, "content-length", 14, digits, static_cast<uint_t>(len));
+        }
+
+        //按对端的max_frame_size分为HEADERS与CONTINUATION
+        const char *data = block.data();
+        uint_t remain = block.data_size();
+        bool first = true;
+        do {
+            uint_t frame_len = std::min<uint_t>(remain, peer_max_frame_size_);
+            uint8_t flags = (frame_len == remain) ? HTTP2_FLAG_END_HEADERS : 0;
+            if (first && end_stream) {
+                flags |= HTTP2_FLAG_END_STREAM;
+            }
+            Http2Frame::write_header(out, frame_len, first ? Http2FrameType::kHeaders : Http2FrameType::kContinuation,
+                flags, stream.id_);
+            out.write(data, frame_len);
+            data   += frame_len;
+            remain -= frame_len;
+            first   = false;
+        } while (remain > 0);
+        stream.headers_sent_ = true;
+    }
+
+    //名称转为小写, 去掉HTTP/2禁止的连接相关header
+    void encode_header(ByteBuffer &block, const char *name, uint_t name_len, const char *value, uint_t value_len)
+    {
+        static thread_local std::string lower_name;
+        lower_name.resize(name_len);
+        for (uint_t i = 0; i < name_len; ++i) {
+            lower_name[i] = HttpStringView::to_lower(name[i]);
+        }
+        if (is_connection_header(lower_name.data(), name_len)) {
+            return;
+        }
+        hpack_encoder_.encode(block, lower_name.data(), name_len, value, value_len);
+    }
+
+    //"Name: value\r\n"格式的header行
+    void encode_header_lines(ByteBuffer &block, const char *data, uint_t len)
+    {
+        const char *end = data + len;
+        while (data < end) {
+            const char *line_end = static_cast<const char *>(std::memchr(data, '\n', end - data));
+            if (nullptr == line_end) {
+                line_end = end;
+            }
+            const char *colon = static_cast<const char *>(std::memchr(data, ':', line_end - data));
+            if (nullptr != colon) {
+                const char *value = colon + 1;
+                const char *value_end = line_end;
+                while ((value < value_end) && (' ' == *value)) {
+                    ++value;
+                }
+                while ((value_end > value) && (('\r' == value_end[-1]) || (' ' == value_end[-1]))) {
+                    --value_end;
+                }
+                encode_header(block, data, static_cast<uint_t>(colon - data), value, static_cast<uint_t>(value_end - value));
+            }
+            data = line_end + 1;
+        }
+    }
+
+    //按连接/流窗口输出待发送的body(DATA帧), 全部发送且end_pending_时结束流
+    void write_stream_data(Http2Stream &stream, ByteBuffer &out)
+    {
+        static thread_local std::vector<char> file_buffer;
+        for (;;) {
+            int64_t window = std::min<int64_t>(send_window_, stream.send_window_);
+            uint_t  data_size = stream.data_.data_size();
+            if (data_size > 0) {
+                if (window <= 0) {
+                    return;
+                }
+                uint_t frame_len = static_cast<uint_t>(std::min<int64_t>({ data_size, window, peer_max_frame_size_ }));
+                bool last = (frame_len == data_size) && stream.end_pending_ && (0 == stream.file_remain_);
+                Http2Frame::write_header(out, frame_len, Http2FrameType::kData, last ? HTTP2_FLAG_END_STREAM : 0, stream.id_);
+                out.write(stream.data_.data(), frame_len);
+                stream.data_.data_begin(stream.data_.data_begin() + frame_len);
+                send_window_        -= frame_len;
+                stream.send_window_ -= frame_len;
+                if (stream.data_.empty()) {
+                    BufferPool::instance().release(stream.data_);
+                }
+                if (last) {
+                    close_stream(&stream);
+                    return;
+                }
+                continue;
+            }
+
+            if (stream.file_remain_ > 0) {
+                if ((window <= 0) || (out.data_size() >= FILE_BATCH_SIZE)) {
+                    return;
+                }
+                uint_t frame_len = static_cast<uint_t>(std::min<int64_t>({
+                    static_cast<int64_t>(std::min<uint64_t>(stream.file_remain_, Http2Frame::MAX_MAX_FRAME_SIZE)),
+                    window, peer_max_frame_size_ }));
+                if (file_buffer.size() < frame_len) {
+                    file_buffer.resize(frame_len);
+                }
+                int read_len = OSApiFile::os_pread(stream.file_->fd_, file_buffer.data(), frame_len,
+                    static_cast<int64_t>(stream.file_offset_));
+                if (read_len <= 0) {
+                    //文件被截断等: 重置流
+                    reset_stream(stream.id_, Http2ErrorCode::kInternalError, out);
+                    return;
+                }
+                frame_len = static_cast<uint_t>(read_len);
+                bool last = (frame_len == stream.file_remain_) && stream.end_pending_;
+                Http2Frame::write_header(out, frame_len, Http2FrameType::kData, last ? HTTP2_FLAG_END_STREAM : 0, stream.id_);
+                out.write(file_buffer.data(), frame_len);
+                stream.file_offset_ += frame_len;
+                stream.file_remain_ -= frame_len;
+                send_window_        -= frame_len;
+                stream.send_window_ -= frame_len;
+                if (last) {
+                    close_stream(&stream);
+                    return;
+                }
+                continue;
+            }
+
+            if (stream.end_pending_) {
+                //body为空或已全部发送(流式回复结束): 空DATA帧结束流
+                Http2Frame::write_header(out, 0, Http2FrameType::kData, HTTP2_FLAG_END_STREAM, stream.id_);
+                close_stream(&stream);
+            }
+            return;
+        }
+    }
+
+    inline void write_all_stream_data(ByteBuffer &out)
+    {
+        for (auto iter = streams_.begin(); iter != streams_.end(); ) {
+            //write_stream_data可能关闭(删除)当前流
+            Http2Stream *stream = iter->second;
+            ++iter;
+            if (stream->headers_sent_) {
+                write_stream_data(*stream, out);
+            }
+        }
+    }
+
+    //非decode中的输出: 立即发送
+    inline void output(ByteBuffer &out)
+    {
+        if (nullptr == super::batch_out_) {
+            if (!out.empty()) {
+                super::message_handler::send(out.data(), out.data_size());
+                out.reset();
+            }
+            send_pending_data();
+        }
+    }
+
+    //socket发送队列为空时继续输出文件内容(每次不超过FILE_BATCH_SIZE), 直到窗口用完或socket缓冲区满
+    void send_pending_data()
+    {
+        while (super::send_queue_empty()) {
+            ByteBuffer &out = super::batch_buffer();
+            out.reset();
+            write_all_stream_data(out);
+            if (out.empty()) {
+                break;
+            }
+            int ret = super::message_handler::send(out.data(), out.data_size());
+            out.reset();
+            if (ret < 0) {
+                break;
+            }
+        }
+    }
+
+    //连接错误: 发送GOAWAY后关闭连接
+    int connection_error(ByteBuffer &out, Http2ErrorCode error_code)
+    {
+        Http2Frame::write_goaway(out, last_stream_id_, error_code);
+        super::message_handler::send(out.data(), out.data_size());
+        out.reset();
+        return -1;
+    }
+
+    //流错误: 发送RST_STREAM并关闭流
+    inline void reset_stream(uint32_t stream_id, Http2ErrorCode error_code, ByteBuffer &out)
+    {
+        Http2Frame::write_rst_stream(out, stream_id, error_code);
+        close_stream(find_stream(stream_id));
+    }
+
+    inline Http2Stream * find_stream(uint64_t stream_id)
+    {
+        auto iter = streams_.find(static_cast<uint32_t>(stream_id));
+        return (iter != streams_.end()) ? iter->second : nullptr;
+    }
+
+    Http2Stream * open_stream(uint32_t stream_id)
+    {
+        Http2Stream *stream;
+        if (!free_streams_.empty()) {
+            stream = free_streams_.back();
+            free_streams_.pop_back();
+        }
+        else {
+            stream = new Http2Stream();
+        }
+        stream->id_          = stream_id;
+        stream->send_window_ = peer_initial_window_;
+        streams_.emplace(stream_id, stream);
+        if (stream_id > last_stream_id_) {
+            last_stream_id_ = stream_id;
+        }
+        return stream;
+    }
+
+    //回复已结束(END_STREAM)或流被重置
+    void close_stream(Http2Stream *stream)
+    {
+        if (nullptr == stream) {
+            return;
+        }
+        streams_.erase(stream->id_);
+        release_stream(stream);
+    }
+
+    void release_stream(Http2Stream *stream)
+    {
+        BufferPool::instance().release(stream->data_);
+        BufferPool::instance().release(stream->request_.body_);
+        if (nullptr != stream->file_) {
+            HttpFileCache::instance().release(stream->file_);
+            stream->file_ = nullptr;
+        }
+        stream->request_.reset();
+        stream->send_window_  = 0;
+        stream->recv_unacked_ = 0;
+        stream->file_offset_  = 0;
+        stream->file_remain_  = 0;
+        stream->recv_closed_  = false;
+        stream->headers_sent_ = false;
+        stream->end_pending_  = false;
+        stream->streaming_    = false;
+        stream->head_         = false;
+        free_streams_.push_back(stream);
+    }
+
+    void clear_streams()
+    {
+        for (auto &iter : streams_) {
+            release_stream(iter.second);
+        }
+        streams_.clear();
+        super::message_handler::release_message_buffer();
+        header_block_.clear();
+        continuation_stream_id_ = 0;
+    }
+
+    //HTTP/2禁止的连接相关header(名称为小写); te只允许"trailers"
+    static inline bool is_connection_header(const char *name, uint_t name_len)
+    {
+        switch (name_len) {
+        case 2:
+            return std::memcmp(name, "te", 2) == 0;
+        case 7:
+            return std::memcmp(name, "upgrade", 7) == 0;
+        case 10:
+            return (std::memcmp(name, "connection", 10) == 0) || (std::memcmp(name, "keep-alive", 10) == 0);
+        case 16:
+            return std::memcmp(name, "proxy-connection", 16) == 0;
+        case 17:
+            return std::memcmp(name, "transfer-encoding", 17) == 0;
+        default:
+            return false;
+        }
+    }
+
+protected:
+    bool            h2_               = false;  //连接为HTTP/2
+    bool            protocol_checked_ = false;  //已根据连接的第一段数据判断协议
+    bool            settings_received_ = false;
+    bool            settings_acked_   = false;  //本端SETTINGS已被确认
+    uint_t          preface_remain_   = 0;      //待接收的客户端序言长度
+    uint32_t        last_stream_id_   = 0;      //对端发起的最大流ID
+    uint32_t        continuation_stream_id_ = 0;    //非0: 等待该流的CONTINUATION
+    uint8_t         headers_flags_    = 0;      //header块所属HEADERS帧的标志
+    std::string     header_block_;              //HEADERS+CONTINUATION拼接的header块
+
+    int64_t         send_window_         = Http2Frame::DEFAULT_WINDOW_SIZE; //对端的连接窗口
+    int64_t         recv_window_         = Http2Frame::DEFAULT_WINDOW_SIZE; //本端连接窗口的剩余
+    uint_t          peer_initial_window_ = Http2Frame::DEFAULT_WINDOW_SIZE;
+    uint_t          peer_max_frame_size_ = Http2Frame::DEFAULT_MAX_FRAME_SIZE;
+
+    HpackDecoder    hpack_decoder_;
+    HpackEncoder    hpack_encoder_;
+    std::unordered_map<uint32_t, Http2Stream *> streams_;
+    std::vector<Http2Stream *> free_streams_;   //复用的流对象
+};
+
+ZRSOCKET_NAMESPACE_END
+
+#endif
@@ -0,0 +1,250 @@
+﻿// Some compilers (e.g. VC++) benefit significantly from using this. 
+// We've measured 3-4% build speed improvements in apps as a result 
+#pragma once
+
+#ifndef ZRSOCKET_HTTP_CHUNKED_H
+#define ZRSOCKET_HTTP_CHUNKED_H
+#include "config.h"
+#include "base_type.h"
+#include "simd.h"
+
+ZRSOCKET_NAMESPACE_BEGIN
+
+//Transfer-Encoding: chunked 增量解码
+//  数据可以任意切分后多次输入; 每个chunk的数据直接以接收缓存中的指针返回(不拷贝)
+//  chunk-size行的扩展(chunk-ext)与结尾的trailer被忽略
+class HttpChunkedDecoder
+{
+public:
+    enum Result
+    {
+        kError      = -1,   //格式错误
+        kNeedMore   = 0,    //输入数据已用完
+        kData       = 1,    //返回一段chunk数据
+        kComplete   = 2,    //整个body结束(含trailer)
+    };
+
+    enum
+    {
+        MAX_LINE_LENGTH = 4096, //chunk-size行(含扩展)/trailer的最大长度
+    };
+
+    HttpChunkedDecoder() = default;
+    ~HttpChunkedDecoder() = default;
+
+    inline void reset()
+    {
+        state_      = State::kSize;
+        chunk_size_ = 0;
+        line_len_   = 0;
+        digits_     = 0;
+    }
+
+    //data: 输入起始位置, 返回时指向未处理数据
+    //返回kData时chunk/chunk_len为一段chunk数据(可能是一个chunk的一部分)
+    int decode(const char *&data, const char *end, const char *&chunk, uint_t &chunk_len)
+    {
+        char ch;
+        while (data < end) {
+            switch (state_) {
+            case State::kSize:
+                ch = *data;
+                if (hex_value(ch) >= 0) {
+                    if (++digits_ > 15) {
+                        return kError;
+                    }
+                    chunk_size_ = (chunk_size_ << 4) | static_cast<uint64_t>(hex_value(ch));
+                    ++data;
+                }
+                else if (0 == digits_) {
+                    return kError;
+                }
+                else if ('\r' == ch) {
+                    state_ = State::kSizeLF;
+                    ++data;
+                }
+                else if ((';' == ch) || (' ' == ch) || ('\t' == ch)) {
+                    state_ = State::kExtension;
+                    line_len_ = 0;
+                    ++data;
+                }
+                else {
+                    return kError;
+                }
+                break;
+            case State::kExtension:
+                {
+                    const char *cr = Simd::find_char(data, end, '\r');
+                    uint_t skip_len = static_cast<uint_t>(((nullptr != cr) ? cr : end) - data);
+                    line_len_ += skip_len;
+                    if (line_len_ > MAX_LINE_LENGTH) {
+                        return kError;
+                    }
+                    data += skip_len;
+                    if (nullptr != cr) {
+                        state_ = State::kSizeLF;
+                        ++data;
+                    }
+                }
+                break;
+            case State::kSizeLF:
+                if ('\n' != *data++) {
+                    return kError;
+                }
+                digits_ = 0;
+                if (chunk_size_ > 0) {
+                    state_ = State::kData;
+                }
+                else {
+                    state_ = State::kTrailer;
+                    line_len_ = 0;
+                }
+                break;
+            case State::kData:
+                {
+                    uint64_t remain_len = static_cast<uint64_t>(end - data);
+                    chunk     = data;
+                    chunk_len = static_cast<uint_t>((remain_len < chunk_size_) ? remain_len : chunk_size_);
+                    data        += chunk_len;
+                    chunk_size_ -= chunk_len;
+                    if (0 == chunk_size_) {
+                        state_ = State::kDataCR;
+                    }
+                    return kData;
+                }
+            case State::kDataCR:
+                if ('\r' != *data++) {
+                    return kError;
+                }
+                state_ = State::kDataLF;
+                break;
+            case State::kDataLF:
+                if ('\n' != *data++) {
+                    return kError;
+                }
+                state_ = State::kSize;
+                break;
+            case State::kTrailer:
+                //trailer行开始: 空行表示结束
+                if ('\r' == *data) {
+                    state_ = State::kTrailerEndLF;
+                    ++data;
+                }
+                else {
+                    state_ = State::kTrailerLine;
+                }
+                break;
+            case State::kTrailerLine:
+                {
+                    const char *lf = Simd::find_char(data, end, '\n');
+                    uint_t skip_len = static_cast<uint_t>(((nullptr != lf) ? lf : end) - data);
+                    line_len_ += skip_len;
+                    if (line_len_ > MAX_LINE_LENGTH) {
+                        return kError;
+                    }
+                    data += skip_len;
+                    if (nullptr != lf) {
+                        state_ = State::kTrailer;
+                        ++data;
+                    }
+                }
+                break;
+            case State::kTrailerEndLF:
+                if ('\n' != *data++) {
+                    return kError;
+                }
+                reset();
+                return kComplete;
+            default:
+                return kError;
+            }
+        }
+
+        return kNeedMore;
+    }
+
+private:
+    static inline int hex_value(char ch)
+    {
+        if ((ch >= '0') && (ch <= '9')) {
+            return ch - '0';
+        }
+        ch |= 0x20;
+        if ((ch >= 'a') && (ch <= 'f')) {
+            return ch - 'a' + 10;
+        }
+        return -1;
+    }
+
+private:
+    enum class State
+    {
+        kSize = 1,
+        kExtension,
+        kSizeLF,
+        kData,
+        kDataCR,
+        kDataLF,
+        kTrailer,
+        kTrailerLine,
+        kTrailerEndLF,
+    };
+
+    State       state_      = State::kSize;
+    uint64_t    chunk_size_ = 0;    //当前chunk剩余长度
+    uint_t      line_len_   = 0;    //当前扩展/trailer已跳过的长度
+    uint_t      digits_     = 0;    //chunk-size的16进制位数
+};
+
+//Transfer-Encoding: chunked 编码
+class HttpChunkedEncoder
+{
+public:
+    enum
+    {
+        MAX_CHUNK_HEADER_LENGTH = 16 + 2,   //16进制长度 + CRLF
+    };
+
+    //生成chunk头("<16进制长度>\r\n"), 返回长度
+    static inline uint_t chunk_header(uint_t chunk_len, char header[MAX_CHUNK_HEADER_LENGTH])
+    {
+        static const char hex_digits[] = "0123456789abcdef";
+        char digits[16];
+        uint_t count = 0;
+        do {
+            digits[count++] = hex_digits[chunk_len & 0x0F];
+            chunk_len >>= 4;
+        } while (chunk_len > 0);
+
+        uint_t len = 0;
+        while (count > 0) {
+            header[len++] = digits[--count];
+        }
+        header[len++] = '\r';
+        header[len++] = '\n';
+        return len;
+    }
+
+    //写入一个chunk(chunk_len为0时不写入: 0长度chunk表示结束)
+    template <class TBuffer>
+    static inline void write_chunk(TBuffer &out, const char *data, uint_t chunk_len)
+    {
+        if (chunk_len > 0) {
+            char header[MAX_CHUNK_HEADER_LENGTH];
+            out.write(header, chunk_header(chunk_len, header));
+            out.write(data, chunk_len);
+            out.write("\r\n", 2);
+        }
+    }
+
+    //写入结束chunk(无trailer)
+    template <class TBuffer>
+    static inline void write_last_chunk(TBuffer &out)
+    {
+        out.write("0\r\n\r\n", 5);
+    }
+};
+
+ZRSOCKET_NAMESPACE_END
+
+#endif
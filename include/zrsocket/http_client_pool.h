@@ -0,0 +1,612 @@
+﻿// Some compilers (e.g. VC++) benefit significantly from using this. 
+// We've measured 3-4% build speed improvements in apps as a result 
+#pragma once
+
+#ifndef ZRSOCKET_HTTP_CLIENT_POOL_H
+#define ZRSOCKET_HTTP_CLIENT_POOL_H
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "base_type.h"
+#include "atomic.h"
+#include "byte_buffer.h"
+#include "mutex.h"
+#include "os_api.h"
+#include "time.h"
+#include "timer.h"
+#include "tcpclient.h"
+#include "event_loop_group.h"
+#include "http_common.h"
+#include "http_response_handler.h"
+
+ZRSOCKET_NAMESPACE_BEGIN
+
+//请求结果
+enum class HttpClientResult
+{
+    kSuccess    = 0,    //成功
+    kClosed     = -1,   //连接断开(请求可能已被服务端处理)
+    kTimeout    = -2,   //超时(含排队时间)
+    kQueueFull  = -3,   //连接的等待队列已满
+    kInvalid    = -4,   //参数无效(upstream不存在/连接池未打开)
+};
+
+//请求回调: 在连接所属event_loop线程中调用
+//  result为kSuccess时response有效(回调返回后失效), 否则response为nullptr
+typedef void (* HttpClientCallbackProc)(void *context, HttpClientResult result, HttpResponse *response);
+
+struct HttpClientPoolConfig
+{
+    uint_t   connections_           = 4;        //每个upstream的连接数
+    uint_t   min_connections_       = 1;        //每个upstream不因空闲而关闭的连接数
+    uint_t   pipeline_depth_        = 1;        //每个连接最多已发送未回复的请求数(1: 不使用pipelining)
+    uint_t   max_queue_size_        = 1024;     //每个连接等待发送的最大请求数
+    uint64_t request_timeout_ms_    = 5000;     //请求超时(从提交开始计算)
+    uint64_t idle_timeout_ms_       = 60000;    //连接空闲超过此时间关闭(0: 不关闭)
+    uint64_t reconnect_interval_ms_ = 1000;     //连接断开/失败后的重连间隔
+    uint64_t check_interval_ms_     = 10;       //维护定时器间隔(超时/空闲/重连检查)
+};
+
+//已编码的请求
+struct HttpClientPendingRequest
+{
+    ByteBuffer              data_;
+    HttpClientCallbackProc  callback_   = nullptr;
+    void                   *context_    = nullptr;
+    uint64_t                expire_ms_  = 0;
+    bool                    head_       = false;
+};
+
+//连接池中的一个连接
+//  请求可在任意线程提交; 连接的建立/关闭/超时检查及回调都在所属event_loop线程中执行
+//  请求按提交顺序发送, HTTP/1.1回复与请求顺序一致, 回复按顺序与已发送的请求对应
+template <class TMutex>
+class HttpClientPoolHandler : public HttpResponseHandler<ByteBuffer, TMutex>
+{
+public:
+    using super = HttpResponseHandler<ByteBuffer, TMutex>;
+    using message_handler = MessageHandler<ByteBuffer, TMutex>;
+
+    HttpClientPoolHandler() = default;
+    virtual ~HttpClientPoolHandler() = default;
+
+    inline void pool_init(const HttpClientPoolConfig *config, uint_t index)
+    {
+        config_ = config;
+        index_  = index;
+        loop_task_.proc_    = &HttpClientPoolHandler::loop_call;
+        loop_task_.handler_ = this;
+    }
+
+    //已连接(无锁读取, 只用于选择连接)
+    inline bool connected() const
+    {
+        return connected_flag_.load(std::memory_order_relaxed);
+    }
+
+    //等待发送 + 已发送未回复的请求数(无锁读取, 只用于选择连接)
+    inline uint_t load() const
+    {
+        return load_.load(std::memory_order_relaxed);
+    }
+
+    //提交请求(任意线程), 返回值 <0: 提交失败(不会回调)
+    int submit(HttpClientPendingRequest &request)
+    {
+        int ret = static_cast<int>(SendResult::SUCCESS);
+        request_mutex_.lock();
+        if (connected_ && waiting_.empty() && (inflight_.size() < config_->pipeline_depth_)) {
+            ret = send_request(request.data_);
+            if (ret < 0) {
+                request_mutex_.unlock();
+                send_result(ret);
+                return static_cast<int>(HttpClientResult::kClosed);
+            }
+            inflight_.emplace_back(std::move(request));
+        }
+        else if (waiting_.size() < config_->max_queue_size_) {
+            waiting_.emplace_back(std::move(request));
+        }
+        else {
+            request_mutex_.unlock();
+            return static_cast<int>(HttpClientResult::kQueueFull);
+        }
+        load_.fetch_add(1, std::memory_order_relaxed);
+        request_mutex_.unlock();
+
+        send_result(ret);
+        return 0;
+    }
+
+    //维护(所属event_loop线程, 由HttpClientPool的定时器调用)
+    void check(uint64_t now_ms)
+    {
+        //记录所属event_loop线程: 在此线程中提交的请求直接注册写事件/关闭连接
+        loop_thread_id_.store(OSApi::this_thread_id(), std::memory_order_relaxed);
+
+        std::deque<HttpClientPendingRequest> expired;
+        request_mutex_.lock();
+        while (!waiting_.empty() && (waiting_.front().expire_ms_ <= now_ms)) {
+            expired.emplace_back(std::move(waiting_.front()));
+            waiting_.pop_front();
+        }
+        load_.fetch_sub(static_cast<uint_t>(expired.size()), std::memory_order_relaxed);
+        bool timeout = !inflight_.empty() && (inflight_.front().expire_ms_ <= now_ms);
+        bool idle    = connected_ && inflight_.empty() && waiting_.empty() &&
+            (index_ >= config_->min_connections_) && (config_->idle_timeout_ms_ > 0) &&
+            (now_ms - last_active_ms_ >= config_->idle_timeout_ms_);
+        bool need_connect = !waiting_.empty() || (index_ < config_->min_connections_);
+        request_mutex_.unlock();
+
+        for (auto &request : expired) {
+            request.callback_(request.context_, HttpClientResult::kTimeout, nullptr);
+        }
+
+        if (timeout || idle) {
+            //关闭连接: do_close中以close_result_回调所有已发送的请求
+            close_result_ = timeout ? HttpClientResult::kTimeout : HttpClientResult::kClosed;
+            super::event_loop_->delete_handler(this, 0);
+            if (idle) {
+                //空闲关闭的连接在有新请求时立即重连
+                reconnect_ms_ = 0;
+            }
+        }
+        else if (need_connect && (EventSource::STATE_CLOSED == super::source_->source_state()) && (now_ms >= reconnect_ms_)) {
+            reconnect_ms_ = now_ms + config_->reconnect_interval_ms_;
+            super::source_->connect();
+        }
+    }
+
+    //关闭连接池时: 回调所有未完成的请求(event_loop已停止)
+    void fail_all()
+    {
+        std::deque<HttpClientPendingRequest> requests;
+        request_mutex_.lock();
+        connected_ = false;
+        connected_flag_.store(false, std::memory_order_relaxed);
+        requests.swap(inflight_);
+        for (auto &request : waiting_) {
+            requests.emplace_back(std::move(request));
+        }
+        waiting_.clear();
+        load_.store(0, std::memory_order_relaxed);
+        request_mutex_.unlock();
+
+        for (auto &request : requests) {
+            request.callback_(request.context_, HttpClientResult::kClosed, nullptr);
+        }
+    }
+
+    int do_open()
+    {
+        if (EventHandler::STATE_CONNECTED == super::state()) {
+            return on_connected();
+        }
+        return 0;
+    }
+
+    int do_connect()
+    {
+        if (OSApi::socket_get_error(super::fd_) != 0) {
+            //非阻塞连接失败
+            super::event_loop_->delete_handler(this, 0);
+            return -1;
+        }
+        return on_connected();
+    }
+
+    int do_close()
+    {
+        std::deque<HttpClientPendingRequest> requests;
+        request_mutex_.lock();
+        connected_ = false;
+        connected_flag_.store(false, std::memory_order_relaxed);
+        requests.swap(inflight_);
+        load_.fetch_sub(static_cast<uint_t>(requests.size()), std::memory_order_relaxed);
+        request_mutex_.unlock();
+
+        HttpClientResult result = close_result_;
+        close_result_ = HttpClientResult::kClosed;
+        reconnect_ms_ = Time::instance().current_timestamp_ms() + config_->reconnect_interval_ms_;
+        for (auto &request : requests) {
+            request.callback_(request.context_, result, nullptr);
+        }
+        return 0;
+    }
+
+    int do_message()
+    {
+        HttpResponse &response = super::response_;
+        if ((response.status_code_ < HttpStatusCode::k200) && (response.status_code_ != HttpStatusCode::k101)) {
+            //1xx中间回复: 不对应请求
+            return 0;
+        }
+
+        HttpClientPendingRequest request;
+        int ret = static_cast<int>(SendResult::SUCCESS);
+        request_mutex_.lock();
+        if (inflight_.empty()) {
+            //没有对应的请求
+            request_mutex_.unlock();
+            return -1;
+        }
+        request = std::move(inflight_.front());
+        inflight_.pop_front();
+        load_.fetch_sub(1, std::memory_order_relaxed);
+        last_active_ms_ = Time::instance().current_timestamp_ms();
+        ret = send_waiting();
+        request_mutex_.unlock();
+
+        request.callback_(request.context_, HttpClientResult::kSuccess, &response);
+        send_result(ret);
+        return 0;
+    }
+
+    bool head_request()
+    {
+        //只在decode中(event_loop线程)调用, inflight_只在本线程出队
+        request_mutex_.lock();
+        bool head = !inflight_.empty() && inflight_.front().head_;
+        request_mutex_.unlock();
+        return head;
+    }
+
+protected:
+    inline int on_connected()
+    {
+        request_mutex_.lock();
+        connected_ = true;
+        connected_flag_.store(true, std::memory_order_relaxed);
+        last_active_ms_ = Time::instance().current_timestamp_ms();
+        int ret = send_waiting();
+        request_mutex_.unlock();
+        send_result(ret);
+        return 0;
+    }
+
+    //发送等待中的请求直到pipeline_depth_(已持有request_mutex_)
+    inline int send_waiting()
+    {
+        int result = static_cast<int>(SendResult::SUCCESS);
+        int ret;
+        while (connected_ && !waiting_.empty() && (inflight_.size() < config_->pipeline_depth_)) {
+            ret = send_request(waiting_.front().data_);
+            if (ret < 0) {
+                return ret;
+            }
+            if (static_cast<int>(SendResult::PUSH_QUEUE) == ret) {
+                result = ret;
+            }
+            inflight_.emplace_back(std::move(waiting_.front()));
+            waiting_.pop_front();
+        }
+        return result;
+    }
+
+    //发送(已持有request_mutex_): 只入发送队列, 注册写事件/关闭连接由send_result在释放request_mutex_后执行
+    //  (关闭连接会回调do_close, 不能在持有request_mutex_时执行)
+    inline int send_request(ByteBuffer &data)
+    {
+        message_handler::mutex_.lock();
+        int ret = message_handler::send_i(data);
+        message_handler::mutex_.unlock();
+        return ret;
+    }
+
+    //send_request的后续处理: PUSH_QUEUE时注册写事件, 失败时关闭连接
+    //  submit可在任意线程调用: 不在所属event_loop线程时投递到event_loop线程执行(EventLoop::push_loop_call)
+    //  任务执行前的多次投递合并为一次(只记录操作), 不分配内存
+    inline void send_result(int ret)
+    {
+        int op;
+        if (static_cast<int>(SendResult::PUSH_QUEUE) == ret) {
+            op = LOOP_OP_WRITE;
+        }
+        else if (ret < 0) {
+            op = LOOP_OP_CLOSE;
+        }
+        else {
+            return;
+        }
+
+        if (loop_thread_id_.load(std::memory_order_relaxed) == OSApi::this_thread_id()) {
+            loop_op(op);
+        }
+        else if (0 == loop_ops_.fetch_or(op, std::memory_order_acq_rel)) {
+            super::event_loop_->push_loop_call(&loop_task_);
+        }
+    }
+
+    //所属event_loop线程中执行
+    inline void loop_op(int ops)
+    {
+        if (ops & LOOP_OP_CLOSE) {
+            super::event_loop_->delete_handler(this, 0);
+        }
+        else if (ops & LOOP_OP_WRITE) {
+            super::event_loop_->add_event(this, EventHandler::WRITE_EVENT_MASK);
+        }
+    }
+
+    static void loop_call(LoopCallTask *task)
+    {
+        HttpClientPoolHandler *handler = static_cast<LoopTask *>(task)->handler_;
+        handler->loop_op(handler->loop_ops_.exchange(0, std::memory_order_acq_rel));
+    }
+
+    enum
+    {
+        LOOP_OP_WRITE = 1,  //注册写事件
+        LOOP_OP_CLOSE = 2,  //关闭连接
+    };
+
+    struct LoopTask : public LoopCallTask
+    {
+        HttpClientPoolHandler *handler_ = nullptr;
+    };
+
+protected:
+    const HttpClientPoolConfig *config_ = nullptr;
+    uint_t          index_          = 0;        //在upstream中的序号(小于min_connections_的连接不因空闲而关闭)
+
+    TMutex          request_mutex_;
+    bool            connected_      = false;
+    AtomicBool      connected_flag_ { false };
+    AtomicUInt      load_ { 0 };
+    std::deque<HttpClientPendingRequest> waiting_;     //等待发送
+    std::deque<HttpClientPendingRequest> inflight_;    //已发送未回复
+
+    //投递到所属event_loop线程的操作(send_result)
+    AtomicUInt64    loop_thread_id_ { 0 };
+    AtomicInt       loop_ops_ { 0 };
+    LoopTask        loop_task_;
+
+    //以下只在所属event_loop线程中访问
+    uint64_t        last_active_ms_ = 0;
+    uint64_t        reconnect_ms_   = 0;
+    HttpClientResult close_result_  = HttpClientResult::kClosed;
+};
+
+//keep-alive HTTP客户端连接池
+//  每个upstream(host:port)维持connections_个连接, 连接轮流分配到EventLoopGroup的各个event_loop
+//  请求提交到负载(等待 + 未回复请求数)最小的已连接连接; 所有连接都忙时优先启用已关闭的连接
+//  每个event_loop一个维护定时器: 请求超时、空闲连接关闭、断开连接的重连都在连接所属event_loop线程中完成
+//  使用: init -> add_upstream * n -> open -> (event_loop运行) request ... -> close(event_loop停止后)
+template <class TEventLoop, class TMutex = SpinMutex>
+class HttpClientPool
+{
+public:
+    typedef HttpClientPoolHandler<TMutex> Handler;
+    typedef TcpClient<Handler> Connection;
+
+    HttpClientPool() = default;
+
+    ~HttpClientPool()
+    {
+        close();
+    }
+
+    int init(EventLoopGroup<TEventLoop> *loop_group, HttpDecoderConfig *decoder_config, const HttpClientPoolConfig &config)
+    {
+        if ((nullptr == loop_group) || (loop_group->event_loop_size() < 1)) {
+            return -1;
+        }
+        loop_group_     = loop_group;
+        decoder_config_ = decoder_config;
+        config_         = config;
+        if (config_.connections_ < 1) {
+            config_.connections_ = 1;
+        }
+        if (config_.pipeline_depth_ < 1) {
+            config_.pipeline_depth_ = 1;
+        }
+        return 0;
+    }
+
+    //返回值: upstream id(>=0), 须在open之前调用
+    int add_upstream(const char *server_name, ushort_t server_port)
+    {
+        if ((nullptr == loop_group_) || opened_) {
+            return -1;
+        }
+        Upstream *upstream = new Upstream();
+        upstream->server_name_ = server_name;
+        upstream->server_port_ = server_port;
+        upstream->next_index_.store(0, std::memory_order_relaxed);
+        upstreams_.emplace_back(upstream);
+        return static_cast<int>(upstreams_.size() - 1);
+    }
+
+    int find_upstream(const char *server_name, ushort_t server_port) const
+    {
+        for (size_t i = 0; i < upstreams_.size(); ++i) {
+            if ((upstreams_[i]->server_port_ == server_port) && (upstreams_[i]->server_name_ == server_name)) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    //建立所有连接, 并在每个event_loop上启动维护定时器
+    int open()
+    {
+        if ((nullptr == loop_group_) || opened_) {
+            return -1;
+        }
+
+        uint_t loop_size = loop_group_->event_loop_size();
+        timers_.reserve(loop_size);
+        for (uint_t i = 0; i < loop_size; ++i) {
+            PoolTimer *timer = new PoolTimer();
+            timer->interval(static_cast<int64_t>(config_.check_interval_ms_ * 1000));
+            timers_.emplace_back(timer);
+        }
+
+        uint_t next_loop = 0;
+        for (auto &upstream : upstreams_) {
+            for (uint_t i = 0; i < config_.connections_; ++i) {
+                Connection *connection = new Connection();
+                connection->handler()->pool_init(&config_, i);
+                connection->set_config(false, false);
+                connection->set_interface(loop_group_->get_event_loop(next_loop), decoder_config_);
+                timers_[next_loop]->handlers_.emplace_back(connection->handler());
+                upstream->connections_.emplace_back(connection);
+                next_loop = (next_loop + 1) % loop_size;
+
+                //连接失败时由维护定时器重连
+                connection->open(upstream->server_name_.c_str(), upstream->server_port_);
+            }
+        }
+
+        for (uint_t i = 0; i < loop_size; ++i) {
+            loop_group_->get_event_loop(i)->add_timer(timers_[i]);
+        }
+        opened_ = true;
+        return 0;
+    }
+
+    //关闭所有连接(须在event_loop停止后调用), 未完成的请求以kClosed回调
+    int close()
+    {
+        for (auto &timer : timers_) {
+            timer->cancel_timer();
+            delete timer;
+        }
+        timers_.clear();
+
+        for (auto &upstream : upstreams_) {
+            for (auto &connection : upstream->connections_) {
+                connection->close();
+                connection->handler()->fail_all();
+                delete connection;
+            }
+            delete upstream;
+        }
+        upstreams_.clear();
+        opened_ = false;
+        return 0;
+    }
+
+    //提交请求(任意线程)
+    //  request中没有Host header时在编码后的请求中加入"Host: server_name"(不修改request的headers_)
+    //  返回值 == 0: 已提交, 完成/失败时回调callback
+    //          < 0: 提交失败(HttpClientResult), 不会回调
+    int request(int upstream_id, HttpRequest &request, HttpClientCallbackProc callback, void *context)
+    {
+        if ((upstream_id < 0) || (upstream_id >= static_cast<int>(upstreams_.size())) || !opened_) {
+            return static_cast<int>(HttpClientResult::kInvalid);
+        }
+        Upstream *upstream = upstreams_[upstream_id];
+        HttpClientPendingRequest pending;
+        pending.data_.reserve(256 + request.body_.data_size());
+        request.encode(pending.data_);
+        if (nullptr == request.headers_.known(HttpKnownHeader::kHost)) {
+            //Host写在末尾, 再移到request line之后
+            ByteBuffer &data = pending.data_;
+            uint_t size = data.data_size();
+            data.write("Host: ", 6);
+            data.write(upstream->server_name_.data(), static_cast<uint_t>(upstream->server_name_.length()));
+            data.write("\r\n", 2);
+            char *begin    = data.data();
+            char *line_end = static_cast<char *>(std::memchr(begin, '\n', size)) + 1;
+            std::rotate(line_end, begin + size, begin + data.data_size());
+        }
+        pending.head_ = (HttpMethodId::kHEAD == request.method_id_);
+        return submit(upstream, pending, callback, context);
+    }
+
+    //提交已编码的请求(任意线程), 返回值同上
+    int request(int upstream_id, const char *data, uint_t len, bool head, HttpClientCallbackProc callback, void *context)
+    {
+        if ((upstream_id < 0) || (upstream_id >= static_cast<int>(upstreams_.size())) || !opened_) {
+            return static_cast<int>(HttpClientResult::kInvalid);
+        }
+
+        HttpClientPendingRequest pending;
+        pending.data_.reserve(len);
+        pending.data_.write(data, len);
+        pending.head_ = head;
+        return submit(upstreams_[upstream_id], pending, callback, context);
+    }
+
+    inline const HttpClientPoolConfig & config() const
+    {
+        return config_;
+    }
+
+private:
+    struct Upstream
+    {
+        std::string                 server_name_;
+        ushort_t                    server_port_ = 0;
+        AtomicUInt                  next_index_;
+        std::vector<Connection *>   connections_;
+    };
+
+    class PoolTimer : public Timer
+    {
+    public:
+        int handle_timeout()
+        {
+            uint64_t now_ms = Time::instance().current_timestamp_ms();
+            for (auto &handler : handlers_) {
+                handler->check(now_ms);
+            }
+            return 0;
+        }
+
+        std::vector<Handler *> handlers_;   //本event_loop上的连接
+    };
+
+    int submit(Upstream *upstream, HttpClientPendingRequest &pending, HttpClientCallbackProc callback, void *context)
+    {
+        pending.callback_  = callback;
+        pending.context_   = context;
+        pending.expire_ms_ = Time::instance().current_timestamp_ms() + config_.request_timeout_ms_;
+
+        //从轮转位置开始: 第一个未满(负载小于pipeline_depth_)的已连接连接, 否则负载最小的连接;
+        //已连接的连接都已满时优先使用已关闭的连接(由维护定时器重新连接)
+        std::vector<Connection *> &connections = upstream->connections_;
+        uint_t size  = static_cast<uint_t>(connections.size());
+        uint_t start = upstream->next_index_.fetch_add(1, std::memory_order_relaxed) % size;
+        Handler *best   = nullptr;
+        Handler *closed = nullptr;
+        uint_t best_load = 0xFFFFFFFF;
+        for (uint_t i = 0; i < size; ++i) {
+            Handler *handler = connections[(start + i) % size]->handler();
+            if (!handler->connected()) {
+                if (nullptr == closed) {
+                    closed = handler;
+                }
+                continue;
+            }
+            uint_t load = handler->load();
+            if (load < best_load) {
+                best      = handler;
+                best_load = load;
+                if (load < config_.pipeline_depth_) {
+                    break;
+                }
+            }
+        }
+        if ((nullptr != closed) && ((nullptr == best) || (best_load >= config_.pipeline_depth_))) {
+            best = closed;
+        }
+        return best->submit(pending);
+    }
+
+private:
+    EventLoopGroup<TEventLoop> *loop_group_     = nullptr;
+    HttpDecoderConfig          *decoder_config_ = nullptr;
+    HttpClientPoolConfig        config_;
+    bool                        opened_ = false;
+    std::vector<Upstream *>     upstreams_;
+    std::vector<PoolTimer *>    timers_;
+};
+
+ZRSOCKET_NAMESPACE_END
+
+#endif
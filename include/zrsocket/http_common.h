@@ -5,12 +5,17 @@
 #ifndef ZRSOCKET_HTTP_COMMON_H
 #define ZRSOCKET_HTTP_COMMON_H
 #include <unordered_map>
-#include <map>
 #include <string>
 #include "config.h"
 #include "base_type.h"
 #include "byte_buffer.h"
 #include "event_handler.h"
+#include "http_headers.h"
+#include "http_chunked.h"
+#include "buffer_pool.h"
+#include "data_convert.h"
+#include "os_api.h"
+#include "time.h"
 
 ZRSOCKET_NAMESPACE_BEGIN
 
@@ -33,6 +38,7 @@ enum class HttpDecodeState
     kHeaderField,
     kHeaderValue,
     kBody,
+    kChunked,
 };
 
 enum class HttpLineState
@@ -105,6 +111,7 @@ enum class HttpStatusCode
     k415 = 415,     //Unsupported Media Type
     k416 = 416,     //Requested Range Not Satisfiable
     k417 = 417,     //Expectation Failed
+    k431 = 431,     //Request Header Fields Too Large
 
     k500 = 500,     //Internal Server Error
     k501 = 501,     //Not Implemented 
@@ -199,6 +206,7 @@ static const std::unordered_map<HttpStatusCode, std::string> http_status_code_de
     {HttpStatusCode::k415, "Unsupported Media Type"},
     {HttpStatusCode::k416, "Requested Range Not Satisfiable"},
     {HttpStatusCode::k417, "Expectation Failed"},
+    {HttpStatusCode::k431, "Request Header Fields Too Large"},
 
     {HttpStatusCode::k500, "Internal Server Error"},
     {HttpStatusCode::k501, "Not Implemented"},
@@ -208,6 +216,155 @@ static const std::unordered_map<HttpStatusCode, std::string> http_status_code_de
     {HttpStatusCode::k505, "HTTP Version Not Supported"},
 };
 
+//完整状态行(含CRLF), 按(version, status code)预先生成
+struct HttpStatusLine
+{
+    const char *data_;
+    uint_t      len_;
+};
+
+struct HttpStatusLines
+{
+    HttpStatusLine lines_[3];   //下标: HttpVersionId - 1 (HTTP/0.9, HTTP/1.0, HTTP/1.1)
+};
+
+#define ZRSOCKET_HTTP_STATUS_LINE_ITEM(version, code, desc) \
+    { version " " #code " " desc "\r\n", sizeof(version " " #code " " desc "\r\n") - 1 }
+#define ZRSOCKET_HTTP_STATUS_LINE(code, desc)                        \
+    { {                                                              \
+        ZRSOCKET_HTTP_STATUS_LINE_ITEM("HTTP/0.9", code, desc),      \
+        ZRSOCKET_HTTP_STATUS_LINE_ITEM("HTTP/1.0", code, desc),      \
+        ZRSOCKET_HTTP_STATUS_LINE_ITEM("HTTP/1.1", code, desc),      \
+    } }
+
+//下标: [status_code / 100][status_code % 100], 未定义的状态码为{nullptr, 0}
+static constexpr HttpStatusLines http_status_lines_[6][18] = {
+    {},
+    {
+        ZRSOCKET_HTTP_STATUS_LINE(100, "Continue"),
+        ZRSOCKET_HTTP_STATUS_LINE(101, "Switching Protocols"),
+    },
+    {
+        ZRSOCKET_HTTP_STATUS_LINE(200, "OK"),
+        ZRSOCKET_HTTP_STATUS_LINE(201, "Created"),
+        ZRSOCKET_HTTP_STATUS_LINE(202, "Accepted"),
+        ZRSOCKET_HTTP_STATUS_LINE(203, "Non-Authoritative Information"),
+        ZRSOCKET_HTTP_STATUS_LINE(204, "No Content"),
+        ZRSOCKET_HTTP_STATUS_LINE(205, "Reset Content"),
+        ZRSOCKET_HTTP_STATUS_LINE(206, "Partial Content"),
+    },
+    {
+        ZRSOCKET_HTTP_STATUS_LINE(300, "Multiple Choices"),
+        ZRSOCKET_HTTP_STATUS_LINE(301, "Moved Permanently"),
+        ZRSOCKET_HTTP_STATUS_LINE(302, "Found"),
+        ZRSOCKET_HTTP_STATUS_LINE(303, "See Other"),
+        ZRSOCKET_HTTP_STATUS_LINE(304, "Not Modified"),
+        ZRSOCKET_HTTP_STATUS_LINE(305, "Use Proxy"),
+        ZRSOCKET_HTTP_STATUS_LINE(306, "(Unused)"),
+        ZRSOCKET_HTTP_STATUS_LINE(307, "Temporary Redirect"),
+    },
+    {
+        ZRSOCKET_HTTP_STATUS_LINE(400, "Bad Request"),
+        ZRSOCKET_HTTP_STATUS_LINE(401, "Unauthorized"),
+        ZRSOCKET_HTTP_STATUS_LINE(402, "Payment Required"),
+        ZRSOCKET_HTTP_STATUS_LINE(403, "Forbidden"),
+        ZRSOCKET_HTTP_STATUS_LINE(404, "Not Found"),
+        ZRSOCKET_HTTP_STATUS_LINE(405, "Method Not Allowed"),
+        ZRSOCKET_HTTP_STATUS_LINE(406, "Not Acceptable"),
+        ZRSOCKET_HTTP_STATUS_LINE(407, "Proxy Authentication Required"),
+        ZRSOCKET_HTTP_STATUS_LINE(408, "Request Timeout"),
+        ZRSOCKET_HTTP_STATUS_LINE(409, "Conflict"),
+        ZRSOCKET_HTTP_STATUS_LINE(410, "Gone"),
+        ZRSOCKET_HTTP_STATUS_LINE(411, "Length Required"),
+        ZRSOCKET_HTTP_STATUS_LINE(412, "Precondition Failed"),
+        ZRSOCKET_HTTP_STATUS_LINE(413, "Request Entity Too Large"),
+        ZRSOCKET_HTTP_STATUS_LINE(414, "Request-URI Too Long"),
+        ZRSOCKET_HTTP_STATUS_LINE(415, "Unsupported Media Type"),
+        ZRSOCKET_HTTP_STATUS_LINE(416, "Requested Range Not Satisfiable"),
+        ZRSOCKET_HTTP_STATUS_LINE(417, "Expectation Failed"),
+    },
+    {
+        ZRSOCKET_HTTP_STATUS_LINE(500, "Internal Server Error"),
+        ZRSOCKET_HTTP_STATUS_LINE(501, "Not Implemented"),
+        ZRSOCKET_HTTP_STATUS_LINE(502, "Bad Gateway"),
+        ZRSOCKET_HTTP_STATUS_LINE(503, "Service Unavailable"),
+        ZRSOCKET_HTTP_STATUS_LINE(504, "Gateway Timeout"),
+        ZRSOCKET_HTTP_STATUS_LINE(505, "HTTP Version Not Supported"),
+    },
+};
+
+#undef ZRSOCKET_HTTP_STATUS_LINE
+#undef ZRSOCKET_HTTP_STATUS_LINE_ITEM
+
+//"Date: ...\r\nServer: ...\r\n" header块
+//  每个线程一份, 基于Time快照每秒最多重新生成一次(不调用系统时间函数)
+class HttpDateHeader
+{
+public:
+    static HttpDateHeader & instance()
+    {
+        static thread_local HttpDateHeader date_header;
+        return date_header;
+    }
+
+    //date: 是否包含Date header; server_name为空时不含Server header
+    inline HttpStringView header_block(bool date, const std::string &server_name)
+    {
+        uint64_t now_s = date ? Time::instance().current_time_s() : 0;
+        if ((now_s != last_time_s_) || (date != date_) || (server_name != server_name_)) {
+            update(now_s, date, server_name);
+        }
+        return HttpStringView(block_.data(), static_cast<uint_t>(block_.size()));
+    }
+
+    //HTTP日期格式(IMF-fixdate): "Sun, 06 Nov 1994 08:49:37 GMT", 返回长度(失败返回0)
+    static uint_t format_date(uint64_t time_s, char *buf, uint_t size)
+    {
+        static const char week_days[7][4] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+        static const char months[12][4]   = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+        time_t t = static_cast<time_t>(time_s);
+        struct tm tm_time;
+        if (nullptr == OSApi::gmtime_s(&t, &tm_time)) {
+            return 0;
+        }
+        int len = std::snprintf(buf, size, "%s, %02d %s %04d %02d:%02d:%02d GMT",
+            week_days[tm_time.tm_wday], tm_time.tm_mday, months[tm_time.tm_mon],
+            tm_time.tm_year + 1900, tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
+        return ((len > 0) && (static_cast<uint_t>(len) < size)) ? static_cast<uint_t>(len) : 0;
+    }
+
+private:
+    void update(uint64_t now_s, bool date, const std::string &server_name)
+    {
+        last_time_s_ = now_s;
+        date_        = date;
+        server_name_ = server_name;
+        block_.clear();
+
+        if (date) {
+            char date_str[64];
+            uint_t len = format_date(now_s, date_str, sizeof(date_str));
+            if (len > 0) {
+                block_.append("Date: ", 6);
+                block_.append(date_str, len);
+                block_.append("\r\n", 2);
+            }
+        }
+        if (!server_name.empty()) {
+            block_.append("Server: ", 8);
+            block_.append(server_name);
+            block_.append("\r\n", 2);
+        }
+    }
+
+private:
+    uint64_t    last_time_s_ = 0xFFFFFFFFFFFFFFFF;
+    bool        date_        = false;
+    std::string server_name_;
+    std::string block_;
+};
+
 struct HttpMessage
 {
     HttpMessage()
@@ -258,6 +415,53 @@ struct HttpMessage
         return http_null_string_;
     }
 
+    //预先生成的状态行, 未定义的(version, status code)返回nullptr
+    static inline const HttpStatusLine * find_http_status_line(HttpVersionId version_id, HttpStatusCode status_code)
+    {
+        uint_t code    = static_cast<uint_t>(status_code);
+        uint_t version = static_cast<uint_t>(version_id);
+        if ((code < 100) || (code >= 600) || (code % 100 >= 18) ||
+            (version < static_cast<uint_t>(HttpVersionId::kHTTP09)) || (version > static_cast<uint_t>(HttpVersionId::kHTTP11))) {
+            return nullptr;
+        }
+        const HttpStatusLine *line = &http_status_lines_[code / 100][code % 100].lines_[version - 1];
+        return (nullptr != line->data_) ? line : nullptr;
+    }
+
+    //写入状态行: 优先使用预先生成的状态行
+    template <class TBuffer>
+    static inline void write_status_line(TBuffer &out, HttpVersionId version_id, HttpStatusCode status_code)
+    {
+        const HttpStatusLine *status_line = find_http_status_line(version_id, status_code);
+        if (nullptr != status_line) {
+            out.write(status_line->data_, status_line->len_);
+            return;
+        }
+
+        char line[128];
+        int len = std::snprintf(line,
+            sizeof(line),
+            "%s %d %s\r\n",
+            find_http_version_name(version_id).c_str(),
+            static_cast<int>(status_code),
+            find_http_status_description(status_code).c_str());
+        if (len > 0) {
+            out.write(line, static_cast<uint_t>(len));
+        }
+    }
+
+    //写入"Content-Length: n\r\n\r\n"(含header结束的空行)
+    template <class TBuffer>
+    static inline void write_content_length(TBuffer &out, uint_t content_length)
+    {
+        static const uint_t prefix_len = sizeof("Content-Length: ") - 1;
+        char line[prefix_len + DataConvert::max_digits10_int32 + 4];
+        std::memcpy(line, "Content-Length: ", prefix_len);
+        int len = DataConvert::uitoa(content_length, line + prefix_len, DataConvert::max_digits10_int32);
+        std::memcpy(line + prefix_len + len, "\r\n\r\n", 4);
+        out.write(line, static_cast<uint_t>(prefix_len + len + 4));
+    }
+
     static const std::string& find_http_status_description(HttpStatusCode status_code)
     {
         auto iter = http_status_code_descriptions_.find(status_code);
@@ -271,48 +475,153 @@ struct HttpMessage
     virtual void init()
     {
         content_length_ = 0;
+        chunked_        = false;
         version_id_     = HttpVersionId::kHTTP11;
         headers_.clear();
-        body_.reset();
-        body_.reserve(2048);
+        reset_body();
     }
 
     virtual void reset()
     {
         content_length_ = 0;
+        chunked_        = false;
         version_id_     = HttpVersionId::kHTTP11;
         headers_.clear();
-        body_.reset();
+        reset_body();
+    }
+
+    //body按需分配(不预分配); 所有权已转移(如已整块发送)时丢弃指针
+    inline void reset_body()
+    {
+        if (body_.owner()) {
+            body_.reset();
+        }
+        else {
+            body_.clear();
+        }
     }
 
     virtual int update()
     {
-        auto iter = headers_.find("Content-Length");
-        if (iter != headers_.end()) {
-            auto tmp = std::atoi(iter->second.c_str());
-            if (tmp >= 0) {
-                content_length_ = tmp;
-                return 0;
+        const HttpHeader *transfer_encoding = headers_.known(HttpKnownHeader::kTransferEncoding);
+        const HttpHeader *header = headers_.known(HttpKnownHeader::kContentLength);
+        if (nullptr != transfer_encoding) {
+            //chunked必须是最后一个编码; 同时带Content-Length视为非法(防止请求走私)
+            //  多个Transfer-Encoding header时只索引了第一个, 无法确定最后的编码, 同样视为非法
+            if (!is_chunked(transfer_encoding->value_) || (nullptr != header) ||
+                headers_.repeated(HttpKnownHeader::kTransferEncoding)) {
+                return -1;
+            }
+            chunked_ = true;
+            return 0;
+        }
+        if (nullptr != header) {
+            if (parse_content_length(header->value_, content_length_) < 0) {
+                return -1;
+            }
+            if (headers_.repeated(HttpKnownHeader::kContentLength)) {
+                //多个Content-Length的值必须相同(RFC 9112 6.3), 否则视为非法(防止请求走私)
+                uint_t content_length;
+                for (auto &iter : headers_) {
+                    if (iter.name_.equals_ignore_case("Content-Length", sizeof("Content-Length") - 1) &&
+                        ((parse_content_length(iter.value_, content_length) < 0) || (content_length != content_length_))) {
+                        return -1;
+                    }
+                }
             }
-            return -1;
         }
 
         return 0;
     }
 
-    const std::string & header(const std::string &key)
+    //Transfer-Encoding的最后一个编码是否为chunked
+    static inline bool is_chunked(const HttpStringView &value)
     {
-        auto iter = headers_.find(key);
-        if (iter != headers_.end()) {
-            return iter->second;
+        uint_t len = value.len_;
+        while ((len > 0) && ((' ' == value.data_[len - 1]) || ('\t' == value.data_[len - 1]))) {
+            --len;
         }
+        if (len < 7) {
+            return false;
+        }
+        const char *coding = value.data_ + len - 7;
+        return HttpStringView::equals_ignore_case(coding, "chunked", 7) &&
+            ((7 == len) || (',' == coding[-1]) || (' ' == coding[-1]) || ('\t' == coding[-1]));
+    }
 
-        return http_null_string_;
+    //流式body的缺省处理: 追加到body_(不超过max_body_length), 返回值<0: 超过长度
+    inline int append_body(const char *data, uint_t len, uint_t max_body_length)
+    {
+        if (body_.data_size() + len > max_body_length) {
+            return -1;
+        }
+        if (nullptr == body_.buffer()) {
+            BufferPool::instance().acquire(body_, len);
+        }
+        return body_.write(data, len) ? 0 : -1;
+    }
+
+    //流式body结束: body_ptr_/content_length_指向append_body()拼接的body
+    inline void finish_body()
+    {
+        if (!body_.empty()) {
+            body_ptr_       = body_.data();
+            content_length_ = body_.data_size();
+        }
+    }
+
+    //写入"Transfer-Encoding: chunked"及header结束的空行
+    template <class TBuffer>
+    static inline void write_transfer_encoding(TBuffer &out)
+    {
+        out.write("Transfer-Encoding: chunked\r\n\r\n", sizeof("Transfer-Encoding: chunked\r\n\r\n") - 1);
+    }
+
+    //Content-Length: 只允许(前后空白 +)十进制数字, 溢出视为非法
+    static int parse_content_length(const HttpStringView &value, uint_t &content_length)
+    {
+        const char *p   = value.data_;
+        const char *end = p + value.len_;
+        while ((p < end) && ((' ' == *p) || ('\t' == *p))) {
+            ++p;
+        }
+        while ((end > p) && ((' ' == end[-1]) || ('\t' == end[-1]))) {
+            --end;
+        }
+        if (p == end) {
+            return -1;
+        }
+
+        uint64_t length = 0;
+        for (; p < end; ++p) {
+            uint_t digit = static_cast<uint_t>(*p - '0');
+            if (digit > 9) {
+                return -1;
+            }
+            length = length * 10 + digit;
+            if (length > 0xFFFFFFFF) {
+                return -1;
+            }
+        }
+        content_length = static_cast<uint_t>(length);
+        return 0;
+    }
+
+    //不区分大小写查找header, 不存在返回空视图
+    inline HttpStringView header(const char *key, uint_t key_len) const
+    {
+        return headers_.get(key, key_len);
+    }
+
+    inline HttpStringView header(const std::string &key) const
+    {
+        return headers_.get(key);
     }
 
     uint_t content_length_ = 0;
+    bool chunked_ = false;      //Transfer-Encoding: chunked
     HttpVersionId version_id_ = HttpVersionId::kHTTP11;
-    std::map<std::string, std::string> headers_;
+    HttpHeaders headers_;
     ByteBuffer body_;
     char *body_ptr_ = nullptr;
 };
@@ -334,7 +643,6 @@ struct HttpRequest : public HttpMessage
         method_id_ = HttpMethodId::kGET;
         body_ptr_  = nullptr;
         uri_.clear();
-        uri_.reserve(1024);
     }
 
     void reset()
@@ -366,22 +674,23 @@ struct HttpRequest : public HttpMessage
 
         //headers line
         for (auto &iter : headers_) {
-            out.write(iter.first.c_str(), iter.first.size());
+            out.write(iter.name_.data_, iter.name_.len_);
             out.write(": ", 2);
-            out.write(iter.second.c_str(), iter.second.size());
+            out.write(iter.value_.data_, iter.value_.len_);
             out.write("\r\n", 2);
         }
 
+        //header.Transfer-Encoding: body由调用方按chunk发送
+        if (chunked_) {
+            write_transfer_encoding(out);
+            return 0;
+        }
+
         //header.Content-Length
         if (method_id_ != HttpMethodId::kHEAD) {
             uint_t real_body_size = std::max<uint_t>(body_.data_size(), content_length_);
             if (real_body_size > 0) {
-                out.reserve(out.data_size() + 32);
-                ret = std::snprintf(out.data() + out.data_size(),
-                    out.free_size() - 1,
-                    "Content-Length: %u\r\n\r\n",
-                    real_body_size);
-                out.data_end(static_cast<uint_t>(out.data_size() + ret));
+                write_content_length(out, real_body_size);
                 return 0;
             }
         }
@@ -396,7 +705,7 @@ struct HttpRequest : public HttpMessage
     int encode(TBuffer &out)
     {
         int ret = encode_headers<TBuffer>(out);
-        if (ret >= 0) {
+        if ((ret >= 0) && !chunked_) {
             auto body_size = body_.data_size();
             if (body_size > 0) {
                 out.write(body_.data(), body_size);
@@ -424,19 +733,24 @@ struct HttpResponse : public HttpMessage
     {
         HttpMessage::init();
         status_code_   = HttpStatusCode::k200;
+        body_ptr_      = nullptr;
         event_handler_ = nullptr;
         type_ = 0;
+        sequence_ = 0;
+        cache_ttl_ms_ = 0;
         attach_data_.id = 0;
         reason_phrase_.clear();
-        reason_phrase_.reserve(64);
     }
 
     void reset()
     {
         HttpMessage::reset();
         status_code_   = HttpStatusCode::k200;
+        body_ptr_      = nullptr;
         event_handler_ = nullptr;
         type_ = 0;
+        sequence_ = 0;
+        cache_ttl_ms_ = 0;
         attach_data_.id = 0;
         reason_phrase_.clear();
     }
@@ -445,35 +759,29 @@ struct HttpResponse : public HttpMessage
     int encode_headers(TBuffer &out)
     {
         out.reserve(1024);
+        out.reset();
 
         //start line
-        const std::string &version     = find_http_version_name(version_id_);
-        const std::string &status_desc = find_http_status_description(status_code_);
-        int ret = std::snprintf(out.data(),
-            out.free_size() - 1,
-            "%s %d %s\r\n",
-            version.c_str(),
-            status_code_,
-            status_desc.c_str());
-        out.data_end(static_cast<uint_t>(ret));
+        write_status_line(out, version_id_, status_code_);
 
         //headers line 
         for (auto &iter : headers_) {
-            out.write(iter.first.c_str(), iter.first.size());
+            out.write(iter.name_.data_, iter.name_.len_);
             out.write(": ", 2);
-            out.write(iter.second.c_str(), iter.second.size());
+            out.write(iter.value_.data_, iter.value_.len_);
             out.write("\r\n", 2);
         }
 
+        //header.Transfer-Encoding: body由调用方按chunk发送
+        if (chunked_) {
+            write_transfer_encoding(out);
+            return 0;
+        }
+
         //header.Content-Length
         uint_t real_body_size = std::max<uint_t>(body_.data_size(), content_length_);
         if (real_body_size > 0) {
-            out.reserve(out.data_size() + 32);
-            int ret = std::snprintf(out.data() + out.data_size(),
-                out.free_size()-1,
-                "Content-Length: %u\r\n\r\n",
-                real_body_size);
-            out.data_end(static_cast<uint_t>(out.data_size() + ret));
+            write_content_length(out, real_body_size);
         }
         else {
             out.write("Content-Length: 0\r\n\r\n", sizeof("Content-Length: 0\r\n\r\n") - 1);
@@ -486,7 +794,7 @@ struct HttpResponse : public HttpMessage
     int encode(TBuffer &out)
     {
         int ret = encode_headers<TBuffer>(out);
-        if (ret >= 0) {
+        if ((ret >= 0) && !chunked_) {
             auto body_size = body_.data_size();
             if (body_size > 0) {
                 out.write(body_.data(), body_size);
@@ -506,6 +814,8 @@ struct HttpResponse : public HttpMessage
     std::string reason_phrase_;
     EventHandler *event_handler_ = nullptr;
     int type_ = 0;
+    uint64_t sequence_ = 0;     //所属请求在连接中的序号(服务端异步回复时按此顺序发送)
+    uint_t cache_ttl_ms_ = 0;   //>0: 自动回复写入回复缓存, 在此时间内相同的请求直接回复(需开启HttpDecoderConfig::response_cache_, 见HttpResponseCacheHandler)
     union Data
     {
         void   *ptr;
@@ -545,6 +855,8 @@ public:
     HttpResponse response_;
 };
 
+class HttpResponseCacheConfig;
+
 class HttpDecoderConfig : public MessageDecoderConfig
 {
 public:
@@ -561,6 +873,19 @@ public:
     uint_t max_header_length_   = 2048;
     uint_t max_body_length_     = 2048;
     uint_t max_message_length_  = 4096;
+    uint_t max_pending_responses_ = 1024;   //pipelining时未回复请求的最大数(超过时关闭连接)
+
+    //true: Content-Length的body也通过do_body_chunk()边接收边回调(不受max_body_length_限制, 缺省do_body_chunk仍受限)
+    //  Transfer-Encoding: chunked的body总是通过do_body_chunk()回调
+    bool stream_body_ = false;
+
+    //服务端回复是否自动加入Date header(每秒更新一次)
+    bool        date_header_ = false;
+    //服务端回复的Server header, 为空时不加入
+    std::string server_name_;
+
+    //服务端回复缓存(见HttpResponseCacheHandler), nullptr: 不缓存
+    HttpResponseCacheConfig *response_cache_ = nullptr;
 };
 
 ZRSOCKET_NAMESPACE_END
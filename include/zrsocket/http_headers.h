@@ -0,0 +1,408 @@
+﻿// Some compilers (e.g. VC++) benefit significantly from using this. 
+// We've measured 3-4% build speed improvements in apps as a result 
+#pragma once
+
+#ifndef ZRSOCKET_HTTP_HEADERS_H
+#define ZRSOCKET_HTTP_HEADERS_H
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "base_type.h"
+
+ZRSOCKET_NAMESPACE_BEGIN
+
+//只读字符串视图(不持有内存)
+struct HttpStringView
+{
+    const char *data_ = nullptr;
+    uint_t      len_  = 0;
+
+    HttpStringView() = default;
+
+    HttpStringView(const char *data, uint_t len)
+        : data_(data)
+        , len_(len)
+    {
+    }
+
+    inline const char * data() const
+    {
+        return data_;
+    }
+
+    inline uint_t size() const
+    {
+        return len_;
+    }
+
+    inline bool empty() const
+    {
+        return 0 == len_;
+    }
+
+    inline std::string to_string() const
+    {
+        return std::string(data_, len_);
+    }
+
+    inline bool equals(const char *str, uint_t len) const
+    {
+        return (len == len_) && (std::memcmp(data_, str, len) == 0);
+    }
+
+    inline bool equals_ignore_case(const char *str, uint_t len) const
+    {
+        return (len == len_) && equals_ignore_case(data_, str, len);
+    }
+
+    //逗号分隔的token列表(如Connection/Upgrade)中是否包含token(不区分大小写)
+    bool has_token(const char *token, uint_t token_len) const
+    {
+        const char *p   = data_;
+        const char *end = p + len_;
+        while (p < end) {
+            while ((p < end) && ((' ' == *p) || ('\t' == *p) || (',' == *p))) {
+                ++p;
+            }
+            const char *item = p;
+            while ((p < end) && (',' != *p) && (' ' != *p) && ('\t' != *p)) {
+                ++p;
+            }
+            if ((static_cast<uint_t>(p - item) == token_len) && equals_ignore_case(item, token, token_len)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static inline char to_lower(char c)
+    {
+        return (static_cast<unsigned char>(c - 'A') < 26) ? static_cast<char>(c | 0x20) : c;
+    }
+
+    static inline bool equals_ignore_case(const char *s1, const char *s2, uint_t len)
+    {
+        for (uint_t i = 0; i < len; ++i) {
+            if (to_lower(s1[i]) != to_lower(s2[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+//解析时建立索引的常用header
+enum class HttpKnownHeader
+{
+    kContentLength = 0,
+    kConnection,
+    kHost,
+    kTransferEncoding,
+    kUpgrade,
+    kCount,
+};
+
+struct HttpHeader
+{
+    HttpStringView  name_;
+    HttpStringView  value_;
+    bool            owned_;     //true: 指向本表的内部存储; false: 指向外部缓存(如接收缓存)
+};
+
+//扁平header表
+//  header以(name, value)视图连续存放: 少于INLINE_NUM个时存放在对象内部(不分配内存), 超过时整体转移到std::vector
+//  add_view()只记录外部缓存(如接收缓存)中的位置(零拷贝), 外部缓存释放前须调用promote()转为内部存储
+//  add()/emplace()将数据拷贝到内部存储, clear()后保留容量重复使用
+//  查找不区分大小写; Content-Length/Connection/Host/Transfer-Encoding/Upgrade在加入时建立索引, 读取无需查找
+class HttpHeaders
+{
+public:
+    enum
+    {
+        INLINE_NUM = 16,
+    };
+
+    HttpHeaders()
+    {
+        clear_known();
+    }
+
+    ~HttpHeaders() = default;
+
+    HttpHeaders(const HttpHeaders &other)
+    {
+        assign(other);
+    }
+
+    HttpHeaders & operator=(const HttpHeaders &other)
+    {
+        if (this != &other) {
+            assign(other);
+        }
+        return *this;
+    }
+
+    HttpHeaders(HttpHeaders &&) = default;
+    HttpHeaders & operator=(HttpHeaders &&) = default;
+
+    inline void clear()
+    {
+        count_ = 0;
+        overflow_.clear();
+        storage_.clear();
+        clear_known();
+    }
+
+    inline uint_t size() const
+    {
+        return count_;
+    }
+
+    inline bool empty() const
+    {
+        return 0 == count_;
+    }
+
+    inline const HttpHeader * begin() const
+    {
+        return entries();
+    }
+
+    inline const HttpHeader * end() const
+    {
+        return entries() + count_;
+    }
+
+    inline const HttpHeader & operator[](uint_t index) const
+    {
+        return entries()[index];
+    }
+
+    //零拷贝加入: name/value须在使用期间有效(或在释放前调用promote())
+    inline void add_view(const char *name, uint_t name_len, const char *value, uint_t value_len)
+    {
+        push(HttpHeader{ HttpStringView(name, name_len), HttpStringView(value, value_len), false });
+    }
+
+    //拷贝到内部存储后加入
+    void add(const char *name, uint_t name_len, const char *value, uint_t value_len)
+    {
+        reserve_storage(name_len + value_len);
+        const char *base = storage_.data() + storage_.size();
+        storage_.insert(storage_.end(), name, name + name_len);
+        storage_.insert(storage_.end(), value, value + value_len);
+        push(HttpHeader{ HttpStringView(base, name_len), HttpStringView(base + name_len, value_len), true });
+    }
+
+    inline void emplace(const char *name, const char *value)
+    {
+        add(name, static_cast<uint_t>(std::strlen(name)), value, static_cast<uint_t>(std::strlen(value)));
+    }
+
+    inline void emplace(const std::string &name, const std::string &value)
+    {
+        add(name.data(), static_cast<uint_t>(name.size()), value.data(), static_cast<uint_t>(value.size()));
+    }
+
+    //将所有外部视图拷贝到内部存储(外部缓存即将释放/复用时调用)
+    void promote()
+    {
+        uint_t need_size = 0;
+        HttpHeader *headers = entries();
+        for (uint_t i = 0; i < count_; ++i) {
+            if (!headers[i].owned_) {
+                need_size += headers[i].name_.len_ + headers[i].value_.len_;
+            }
+        }
+        if (0 == need_size) {
+            return;
+        }
+
+        reserve_storage(need_size);
+        for (uint_t i = 0; i < count_; ++i) {
+            HttpHeader &header = headers[i];
+            if (!header.owned_) {
+                const char *base = storage_.data() + storage_.size();
+                storage_.insert(storage_.end(), header.name_.data_, header.name_.data_ + header.name_.len_);
+                storage_.insert(storage_.end(), header.value_.data_, header.value_.data_ + header.value_.len_);
+                header.name_.data_  = base;
+                header.value_.data_ = base + header.name_.len_;
+                header.owned_       = true;
+            }
+        }
+    }
+
+    //不区分大小写查找, 未找到返回nullptr
+    const HttpHeader * find(const char *name, uint_t name_len) const
+    {
+        const HttpHeader *headers = entries();
+        for (uint_t i = 0; i < count_; ++i) {
+            if (headers[i].name_.equals_ignore_case(name, name_len)) {
+                return headers + i;
+            }
+        }
+        return nullptr;
+    }
+
+    inline const HttpHeader * find(const std::string &name) const
+    {
+        return find(name.data(), static_cast<uint_t>(name.size()));
+    }
+
+    inline HttpStringView get(const char *name, uint_t name_len) const
+    {
+        const HttpHeader *header = find(name, name_len);
+        return (nullptr != header) ? header->value_ : HttpStringView();
+    }
+
+    inline HttpStringView get(const std::string &name) const
+    {
+        return get(name.data(), static_cast<uint_t>(name.size()));
+    }
+
+    //常用header(加入时已建立索引), 不存在返回nullptr
+    inline const HttpHeader * known(HttpKnownHeader id) const
+    {
+        int index = known_[static_cast<int>(id)];
+        return (index >= 0) ? entries() + index : nullptr;
+    }
+
+    //常用header是否出现了多次(索引只指向第一个)
+    inline bool repeated(HttpKnownHeader id) const
+    {
+        return 0 != (repeated_known_ & (1u << static_cast<int>(id)));
+    }
+
+    //name对应的常用header, 不是常用header返回HttpKnownHeader::kCount
+    static inline HttpKnownHeader known_id(const char *name, uint_t name_len)
+    {
+        switch (name_len) {
+        case 4:
+            if (HttpStringView::equals_ignore_case(name, "Host", 4)) {
+                return HttpKnownHeader::kHost;
+            }
+            break;
+        case 7:
+            if (HttpStringView::equals_ignore_case(name, "Upgrade", 7)) {
+                return HttpKnownHeader::kUpgrade;
+            }
+            break;
+        case 10:
+            if (HttpStringView::equals_ignore_case(name, "Connection", 10)) {
+                return HttpKnownHeader::kConnection;
+            }
+            break;
+        case 14:
+            if (HttpStringView::equals_ignore_case(name, "Content-Length", 14)) {
+                return HttpKnownHeader::kContentLength;
+            }
+            break;
+        case 17:
+            if (HttpStringView::equals_ignore_case(name, "Transfer-Encoding", 17)) {
+                return HttpKnownHeader::kTransferEncoding;
+            }
+            break;
+        default:
+            break;
+        }
+        return HttpKnownHeader::kCount;
+    }
+
+private:
+    inline HttpHeader * entries()
+    {
+        return overflow_.empty() ? inline_ : overflow_.data();
+    }
+
+    inline const HttpHeader * entries() const
+    {
+        return overflow_.empty() ? inline_ : overflow_.data();
+    }
+
+    inline void clear_known()
+    {
+        for (auto &index : known_) {
+            index = -1;
+        }
+        repeated_known_ = 0;
+    }
+
+    inline void push(const HttpHeader &header)
+    {
+        HttpKnownHeader id = known_id(header.name_.data_, header.name_.len_);
+        if (HttpKnownHeader::kCount != id) {
+            if (known_[static_cast<int>(id)] < 0) {
+                known_[static_cast<int>(id)] = static_cast<int>(count_);
+            }
+            else {
+                repeated_known_ |= 1u << static_cast<int>(id);
+            }
+        }
+
+        if (count_ < INLINE_NUM) {
+            inline_[count_++] = header;
+            return;
+        }
+        if (overflow_.empty()) {
+            overflow_.reserve(INLINE_NUM * 2);
+            overflow_.assign(inline_, inline_ + INLINE_NUM);
+        }
+        overflow_.emplace_back(header);
+        ++count_;
+    }
+
+    //保证内部存储还能容纳size字节而不再重新分配; 存储地址变化时修正已有的内部视图
+    void reserve_storage(uint_t size)
+    {
+        if (storage_.capacity() - storage_.size() >= size) {
+            return;
+        }
+        const char *old_base = storage_.data();
+        storage_.reserve(std::max<size_t>({ storage_.size() + size, storage_.capacity() * 2, 256 }));
+        rebase(old_base, storage_.data());
+    }
+
+    void rebase(const char *old_base, const char *new_base)
+    {
+        if (old_base == new_base) {
+            return;
+        }
+        HttpHeader *headers = entries();
+        for (uint_t i = 0; i < count_; ++i) {
+            HttpHeader &header = headers[i];
+            if (header.owned_) {
+                header.name_.data_  = new_base + (header.name_.data_ - old_base);
+                header.value_.data_ = new_base + (header.value_.data_ - old_base);
+            }
+        }
+    }
+
+    void assign(const HttpHeaders &other)
+    {
+        count_    = other.count_;
+        overflow_ = other.overflow_;
+        storage_  = other.storage_;
+        for (uint_t i = 0; (i < other.count_) && (i < INLINE_NUM); ++i) {
+            inline_[i] = other.inline_[i];
+        }
+        for (int i = 0; i < static_cast<int>(HttpKnownHeader::kCount); ++i) {
+            known_[i] = other.known_[i];
+        }
+        repeated_known_ = other.repeated_known_;
+        rebase(other.storage_.data(), storage_.data());
+    }
+
+private:
+    HttpHeader          inline_[INLINE_NUM];
+    std::vector<HttpHeader> overflow_;
+    std::vector<char>   storage_;
+    uint_t              count_ = 0;
+    int                 known_[static_cast<int>(HttpKnownHeader::kCount)];
+    uint32_t            repeated_known_ = 0;    //出现多次的常用header(按HttpKnownHeader的位)
+};
+
+ZRSOCKET_NAMESPACE_END
+
+#endif
@@ -0,0 +1,203 @@
+﻿// Some compilers (e.g. VC++) benefit significantly from using this. 
+// We've measured 3-4% build speed improvements in apps as a result 
+#pragma once
+
+#ifndef ZRSOCKET_HTTP_OFFLOAD_H
+#define ZRSOCKET_HTTP_OFFLOAD_H
+#include <utility>
+#include "config.h"
+#include "base_type.h"
+#include "buffer_pool.h"
+#include "event_type.h"
+#include "event_handler.h"
+#include "event_loop.h"
+#include "send_event.h"
+#include "http_common.h"
+#include "http_request_handler.h"
+#include "seda_interface.h"
+#include "seda_stage_handler.h"
+
+ZRSOCKET_NAMESPACE_BEGIN
+
+//HTTP请求转交SEDA stage处理(I/O与计算分离)
+//  event_loop线程: HttpOffloadHandler::offload将解析完成的请求(context)移入任务, 投递到stage
+//  stage线程:      HttpOffloadStageHandler::do_request填写回复, 将任务投递回连接所属的event_loop
+//  event_loop线程: 连接未关闭(generation未变化)时由send_response按请求顺序回复, 之后释放任务
+struct HttpOffloadTask : public LoopCallTask
+{
+    HttpContext   context_;
+    EventHandler *handler_    = nullptr;
+    EventLoop    *event_loop_ = nullptr;    //连接所属的event_loop(完成后在其线程中回复)
+    uint64_t      generation_ = 0;          //投递时连接的generation, 不一致表示连接已关闭(或已被复用)
+    int           result_     = 0;          //do_request的返回值, <0: 关闭连接
+};
+
+//stage事件(只携带任务指针, SedaStage::open的event_len需>=sizeof(HttpOffloadEvent))
+struct HttpOffloadEvent : public FixedSizeEventBase<HttpOffloadEvent, EventTypeId::HTTP_OFFLOAD>
+{
+    inline HttpOffloadEvent(HttpOffloadTask *task)
+        : task_(task)
+    {
+    }
+
+    inline ~HttpOffloadEvent() = default;
+
+    HttpOffloadTask *task_;
+};
+
+class HttpOffload
+{
+public:
+    //将from移入to: header转为内部存储, 指向接收缓存的body拷贝为自有, 之后from可直接init()复用
+    static void detach(HttpContext &from, HttpContext &to)
+    {
+        HttpRequest &src_request = from.request_;
+        HttpRequest &dst_request = to.request_;
+        dst_request.method_id_ = src_request.method_id_;
+        dst_request.uri_.swap(src_request.uri_);
+        move_message(src_request, dst_request);
+
+        HttpResponse &src_response = from.response_;
+        HttpResponse &dst_response = to.response_;
+        dst_response.status_code_   = src_response.status_code_;
+        dst_response.event_handler_ = src_response.event_handler_;
+        dst_response.type_          = src_response.type_;
+        dst_response.sequence_      = src_response.sequence_;
+        dst_response.attach_data_   = src_response.attach_data_;
+        dst_response.reason_phrase_.swap(src_response.reason_phrase_);
+        move_message(src_response, dst_response);
+    }
+
+    //stage线程中处理完成: 投递回连接所属的event_loop, 由任务的proc_回复并释放任务
+    //  不阻塞stage线程: event_loop事件队列满时任务链入其溢出链表(EventLoop::push_loop_call), 回复与释放总在event_loop线程中进行
+    static int complete(HttpOffloadTask *task)
+    {
+        return task->event_loop_->push_loop_call(task);
+    }
+
+    //在event_loop线程中释放任务: body归还到本线程的BufferPool
+    static void release(HttpOffloadTask *task)
+    {
+        BufferPool::instance().release(task->context_.request_.body_);
+        BufferPool::instance().release(task->context_.response_.body_);
+        delete task;
+    }
+
+private:
+    static void move_message(HttpMessage &src, HttpMessage &dst)
+    {
+        dst.version_id_     = src.version_id_;
+        dst.chunked_        = src.chunked_;
+        dst.content_length_ = src.content_length_;
+        src.headers_.promote();
+        dst.headers_ = std::move(src.headers_);
+        src.headers_.clear();
+
+        BufferPool::instance().release(dst.body_);
+        if ((nullptr != src.body_ptr_) && (src.body_ptr_ != src.body_.data())) {
+            //body指向接收缓存: 拷贝
+            BufferPool::instance().acquire(dst.body_, src.content_length_);
+            dst.body_.write(src.body_ptr_, src.content_length_);
+        }
+        else if (src.body_.owner() && (nullptr != src.body_.buffer())) {
+            dst.body_ = std::move(src.body_);
+        }
+        dst.body_ptr_ = (nullptr != src.body_ptr_) ? dst.body_.data() : nullptr;
+        src.body_ptr_ = nullptr;
+    }
+};
+
+//处理HttpOffloadEvent的stage handler: 派生类实现do_request
+//  派生类重写handle_event处理其它事件时, HTTP_OFFLOAD事件转交handle_offload
+class HttpOffloadStageHandler : public SedaStageHandler
+{
+public:
+    HttpOffloadStageHandler() = default;
+    virtual ~HttpOffloadStageHandler() = default;
+
+    virtual int handle_event(const SedaEvent *event)
+    {
+        if (EventTypeId::HTTP_OFFLOAD == event->type()) {
+            return handle_offload(static_cast<const HttpOffloadEvent *>(event));
+        }
+        return 0;
+    }
+
+    //在stage线程中处理请求: 填写context.response_(状态码/header/body), 不能访问连接
+    //返回值 <0: 关闭连接(不回复)
+    virtual int do_request(HttpContext &context)
+    {
+        return 0;
+    }
+
+protected:
+    inline int handle_offload(const HttpOffloadEvent *event)
+    {
+        HttpOffloadTask *task = event->task_;
+        task->result_ = do_request(task->context_);
+        return HttpOffload::complete(task);
+    }
+};
+
+//SEDA offload分层: 在THandler(HttpRequestHandler或其派生类)之上增加offload
+//  例: class MyHandler : public HttpOffloadHandler<HttpRequestHandler<ByteBuffer, NullMutex> >
+template <class THandler>
+class HttpOffloadHandler : public THandler
+{
+public:
+    using super = THandler;
+
+    //将当前请求转交SEDA stage处理: 在do_message中调用并返回其返回值(return offload(stage);)
+    //  context_移入任务后由stage线程的HttpOffloadStageHandler::do_request填写回复, 完成后投递回本连接所属的event_loop,
+    //  由send_response按请求顺序回复(pipelining); 期间连接已关闭(generation()变化)则丢弃回复
+    //  stage的event_len须不小于sizeof(HttpOffloadEvent)
+    //  返回值
+    //  == 1: 已转交(异步回复)
+    //  == 0: 投递失败(stage队列满), response_已设置为503, 自动回复
+    //  <  0: 待回复的请求过多, 关闭连接
+    int offload(ISedaStage *stage, int thread_index = -1, int priority = SedaPriority::UNKNOWN_PRIOITY)
+    {
+        HttpDecoderConfig *config = static_cast<HttpDecoderConfig *>(super::source_->message_decoder_config());
+        if (super::pending_responses_.size() >= config->max_pending_responses_) {
+            return -1;
+        }
+
+        HttpOffloadTask *task = new HttpOffloadTask();
+        task->proc_       = &HttpOffloadHandler::offload_complete;
+        task->handler_    = this;
+        task->event_loop_ = super::event_loop_;
+        task->generation_ = EventHandler::generation();
+        HttpOffload::detach(super::context_, task->context_);
+
+        HttpOffloadEvent event(task);
+        if (stage->push_event(&event, thread_index, priority) >= 0) {
+            return 1;
+        }
+        HttpOffload::detach(task->context_, super::context_);
+        delete task;
+        super::context_.response_.status_code_ = HttpStatusCode::k503;
+        return 0;
+    }
+
+protected:
+    //offload的完成回调(在连接所属的event_loop线程中调用)
+    //  send_response为虚函数: THandler为Http2RequestHandler时按流回复
+    static void offload_complete(LoopCallTask *loop_task)
+    {
+        HttpOffloadTask *task = static_cast<HttpOffloadTask *>(loop_task);
+        HttpOffloadHandler *handler = static_cast<HttpOffloadHandler *>(task->handler_);
+        if (task->generation_ == handler->generation()) {
+            if (task->result_ < 0) {
+                task->event_loop_->delete_handler(handler, 0);
+            }
+            else {
+                handler->send_response(task->context_);
+            }
+        }
+        HttpOffload::release(task);
+    }
+};
+
+ZRSOCKET_NAMESPACE_END
+
+#endif
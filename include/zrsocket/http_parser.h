@@ -0,0 +1,342 @@
+﻿// Some compilers (e.g. VC++) benefit significantly from using this. 
+// We've measured 3-4% build speed improvements in apps as a result 
+#pragma once
+
+#ifndef ZRSOCKET_HTTP_PARSER_H
+#define ZRSOCKET_HTTP_PARSER_H
+#include <cstring>
+#include "config.h"
+#include "base_type.h"
+#include "simd.h"
+#include "http_common.h"
+
+ZRSOCKET_NAMESPACE_BEGIN
+
+//header在接收缓存中的位置(相对于请求头起始位置的偏移)
+struct HttpHeaderOffset
+{
+    uint_t name_offset_;
+    uint_t name_len_;
+    uint_t value_offset_;
+    uint_t value_len_;
+};
+
+//HTTP/1.x请求头解析
+//  一次解析完整的请求头(请求行 + header行 + 空行), 不逐字节拷贝:
+//  1.用SIMD(Simd::find_char)查找行结束符LF/空格/冒号等分隔位置
+//  2.method/version按长度 + 整数比较识别(不查表, 不构造std::string)
+//  3.uri与header只记录在缓存中的偏移, 由调用方决定是否拷贝
+class HttpParser
+{
+public:
+    enum
+    {
+        MAX_HEADER_NUM = 64,    //最多header数, 超过时返回HEADER_FIELDS_TOO_LARGE
+    };
+
+    //parse_request/parse_headers的错误返回值(对应的回复状态码见error_status)
+    enum
+    {
+        INVALID_REQUEST         = -1,   //非法请求(400)
+        URI_TOO_LONG            = -2,   //uri长度超过max_uri_length(414)
+        HEADER_FIELDS_TOO_LARGE = -3,   //header数超过MAX_HEADER_NUM(431)
+    };
+
+    HttpParser() = default;
+    ~HttpParser() = default;
+
+    inline void reset()
+    {
+        method_id_      = HttpMethodId::kUNKNOWN;
+        version_id_     = HttpVersionId::kUNKNOWN;
+        uri_offset_     = 0;
+        uri_len_        = 0;
+        header_count_   = 0;
+    }
+
+    //解析请求头
+    //  data: 请求起始位置(可包含请求头之后的body/下一个请求)
+    //  返回值 > 0: 请求头长度(含结尾空行)
+    //        == 0: 请求头不完整, 需要更多数据
+    //         < 0: 非法请求(INVALID_REQUEST/URI_TOO_LONG/HEADER_FIELDS_TOO_LARGE)
+    int parse_request(const char *data, uint_t len, uint_t max_uri_length = 0xFFFFFFFF)
+    {
+        reset();
+
+        const char *begin = data;
+        const char *end   = data + len;
+
+        //忽略请求行之前的空行(RFC 7230 3.5)
+        while ((end - data >= 2) && ('\r' == data[0]) && ('\n' == data[1])) {
+            data += 2;
+        }
+
+        //begin: request line
+        const char *line_end = find_line_end(data, end);
+        if (nullptr == line_end) {
+            return 0;
+        }
+        if (end == line_end) {
+            return -1;
+        }
+        const char *cr = line_end - 1;
+
+        const char *space = Simd::find_char(data, cr, ' ');
+        if (nullptr == space) {
+            return -1;
+        }
+        method_id_ = parse_method(data, static_cast<uint_t>(space - data));
+        if (HttpMethodId::kUNKNOWN == method_id_) {
+            return -1;
+        }
+
+        const char *uri = space + 1;
+        space = Simd::find_char(uri, cr, ' ');
+        if ((nullptr == space) || (space == uri)) {
+            return -1;
+        }
+        uri_offset_ = static_cast<uint_t>(uri - begin);
+        uri_len_    = static_cast<uint_t>(space - uri);
+        if (uri_len_ > max_uri_length) {
+            return URI_TOO_LONG;
+        }
+        //uri中不允许控制字符(含请求行中单独的CR)
+        if (nullptr != Simd::find_ctl(uri, space)) {
+            return -1;
+        }
+
+        ++space;
+        version_id_ = parse_version(space, static_cast<uint_t>(cr - space));
+        if (HttpVersionId::kUNKNOWN == version_id_) {
+            return -1;
+        }
+        data = line_end + 1;
+        //end: request line
+
+        return parse_headers(begin, data, end);
+    }
+
+    //解析header行直到空行
+    //  begin: 偏移的基准位置; data: 第一个header行
+    //  返回值同parse_request
+    int parse_headers(const char *begin, const char *data, const char *end)
+    {
+        const char *line_end;
+        const char *colon;
+        const char *value;
+        const char *value_end;
+        for (;;) {
+            if (end - data < 2) {
+                return 0;
+            }
+            if ('\r' == data[0]) {
+                if ('\n' != data[1]) {
+                    return -1;
+                }
+                return static_cast<int>(data + 2 - begin);
+            }
+
+            line_end = find_line_end(data, end);
+            if (nullptr == line_end) {
+                return 0;
+            }
+            if (end == line_end) {
+                return -1;
+            }
+
+            if (header_count_ >= MAX_HEADER_NUM) {
+                return HEADER_FIELDS_TOO_LARGE;
+            }
+            value_end = line_end - 1;
+            colon = Simd::find_char(data, value_end, ':');
+            if ((nullptr == colon) || (colon == data)) {
+                return -1;
+            }
+            //header名须为token(RFC 9112 5.1: 不允许冒号前有空白, 不允许控制字符)
+            if (!is_token(data, colon)) {
+                return -1;
+            }
+
+            //去掉value前后的空白(OWS)
+            value = colon + 1;
+            while ((value < value_end) && ((' ' == *value) || ('\t' == *value))) {
+                ++value;
+            }
+            while ((value_end > value) && ((' ' == value_end[-1]) || ('\t' == value_end[-1]))) {
+                --value_end;
+            }
+            //value中不允许HTAB以外的控制字符(RFC 9110 5.5)
+            if (nullptr != Simd::find_ctl(value, value_end)) {
+                return -1;
+            }
+
+            HttpHeaderOffset &header = headers_[header_count_++];
+            header.name_offset_  = static_cast<uint_t>(data - begin);
+            header.name_len_     = static_cast<uint_t>(colon - data);
+            header.value_offset_ = static_cast<uint_t>(value - begin);
+            header.value_len_    = static_cast<uint_t>(value_end - value);
+
+            data = line_end + 1;
+        }
+    }
+
+    //method: 按长度分支, 再与常量做整数比较
+    static inline HttpMethodId parse_method(const char *method, uint_t len)
+    {
+        switch (len) {
+        case 3:
+            if ((load_u16(method) == load_u16("GE")) && ('T' == method[2])) {
+                return HttpMethodId::kGET;
+            }
+            if ((load_u16(method) == load_u16("PU")) && ('T' == method[2])) {
+                return HttpMethodId::kPUT;
+            }
+            break;
+        case 4:
+            if (load_u32(method) == load_u32("POST")) {
+                return HttpMethodId::kPOST;
+            }
+            if (load_u32(method) == load_u32("HEAD")) {
+                return HttpMethodId::kHEAD;
+            }
+            break;
+        case 5:
+            if ((load_u32(method) == load_u32("TRAC")) && ('E' == method[4])) {
+                return HttpMethodId::kTRACE;
+            }
+            break;
+        case 6:
+            if ((load_u32(method) == load_u32("DELE")) && (load_u16(method + 4) == load_u16("TE"))) {
+                return HttpMethodId::kDELETE;
+            }
+            break;
+        case 7:
+            if ((load_u32(method) == load_u32("OPTI")) && (load_u32(method + 3) == load_u32("IONS"))) {
+                return HttpMethodId::kOPTIONS;
+            }
+            if ((load_u32(method) == load_u32("CONN")) && (load_u32(method + 3) == load_u32("NECT"))) {
+                return HttpMethodId::kCONNECT;
+            }
+            break;
+        default:
+            break;
+        }
+        return HttpMethodId::kUNKNOWN;
+    }
+
+    //version: 固定8字节, 一次64位比较
+    static inline HttpVersionId parse_version(const char *version, uint_t len)
+    {
+        if (8 == len) {
+            uint64_t v = load_u64(version);
+            if (v == load_u64("HTTP/1.1")) {
+                return HttpVersionId::kHTTP11;
+            }
+            if (v == load_u64("HTTP/1.0")) {
+                return HttpVersionId::kHTTP10;
+            }
+            if (v == load_u64("HTTP/0.9")) {
+                return HttpVersionId::kHTTP09;
+            }
+        }
+        return HttpVersionId::kUNKNOWN;
+    }
+
+    //查找行结束符LF, 要求其前一个字符为CR
+    //  返回值: LF的位置; 数据不完整返回nullptr; 行结束符非法(单独的LF)返回end
+    static inline const char * find_line_end(const char *data, const char *end)
+    {
+        const char *lf = Simd::find_char(data, end, '\n');
+        if ((nullptr != lf) && ((lf == data) || ('\r' != lf[-1]))) {
+            return end;
+        }
+        return lf;
+    }
+
+    //错误返回值对应的回复状态码
+    static inline HttpStatusCode error_status(int ret)
+    {
+        switch (ret) {
+        case URI_TOO_LONG:
+            return HttpStatusCode::k414;
+        case HEADER_FIELDS_TOO_LARGE:
+            return HttpStatusCode::k431;
+        default:
+            return HttpStatusCode::k400;
+        }
+    }
+
+    inline const char * uri(const char *begin) const
+    {
+        return begin + uri_offset_;
+    }
+
+    //[data, end)是否全部为tchar(RFC 9110 5.6.2)
+    static inline bool is_token(const char *data, const char *end)
+    {
+        const uint8_t *table = tchar_table();
+        for (; data < end; ++data) {
+            if (0 == table[static_cast<uint8_t>(*data)]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    static inline const uint8_t * tchar_table()
+    {
+        static const uint8_t table[256] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 1, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0,
+            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+            0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 1,
+            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 0, 1, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        };
+        return table;
+    }
+
+    static inline uint16_t load_u16(const char *p)
+    {
+        uint16_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static inline uint32_t load_u32(const char *p)
+    {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static inline uint64_t load_u64(const char *p)
+    {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+public:
+    HttpMethodId        method_id_      = HttpMethodId::kUNKNOWN;
+    HttpVersionId       version_id_     = HttpVersionId::kUNKNOWN;
+    uint_t              uri_offset_     = 0;
+    uint_t              uri_len_        = 0;
+    uint_t              header_count_   = 0;
+    HttpHeaderOffset    headers_[MAX_HEADER_NUM];
+};
+
+ZRSOCKET_NAMESPACE_END
+
+#endif
@@ -5,19 +5,25 @@
 #ifndef ZRSOCKET_HTTP_REQUEST_HANDLER_H
 #define ZRSOCKET_HTTP_REQUEST_HANDLER_H
 #include <algorithm>
+#include <deque>
 #include "config.h"
 #include "base_type.h"
 #include "byte_buffer.h"
 #include "message_handler.h"
 #include "http_common.h"
+#include "http_parser.h"
 
 ZRSOCKET_NAMESPACE_BEGIN
 
+//HTTP/1.x请求处理: 解析/pipelining/按序回复/流式回复
+//  静态文件(HttpStaticFileHandler), SEDA offload(HttpOffloadHandler), 回复缓存(HttpResponseCacheHandler)为可选的分层,
+//  以模板参数叠加在本类(或其派生类)之上, 不使用的连接不承担其开销
 template <class TBuffer, class TMutex>
 class HttpRequestHandler : public MessageHandler<TBuffer, TMutex>
 {
 public:
     using super = MessageHandler<ByteBuffer, TMutex>;
+    using message_handler = super;  //分层/派生类中访问MessageHandler(其super可能为另一分层)
 
     virtual int do_open()
     {
@@ -43,59 +49,327 @@ public:
         return 0;
     }
 
-    int send(HttpContext &context, ByteBuffer &out, bool out_owned = true)
+    //流式body回调: Transfer-Encoding: chunked的body(或HttpDecoderConfig::stream_body_时的所有body)边接收边回调
+    //  data指向接收缓存(回调返回后失效); 缺省拼接到request_.body_, 全部接收后调用do_message
+    //返回值 < 0: 出现异常关闭连接
+    virtual int do_body_chunk(const char *data, uint_t len)
+    {
+        HttpDecoderConfig *config = static_cast<HttpDecoderConfig *>(super::source_->message_decoder_config());
+        return context_.request_.append_body(data, len, config->max_body_length_);
+    }
+
+    //协议升级: 请求带Upgrade header且之前的请求都已回复时, 在do_message之前调用(context_为升级请求)
+    //返回值
+    // > 0: 已接管连接(已回复101等), 之后的数据(含本次接收中升级请求之后的数据)由decode_upgraded处理
+    //== 0: 不升级, 按普通请求处理
+    // < 0: 出现异常关闭连接
+    virtual int do_upgrade()
+    {
+        return 0;
+    }
+
+    //升级后的数据接收, 返回值 < 0: 出现异常关闭连接
+    virtual int decode_upgraded(const char *data, uint_t len)
+    {
+        return -1;
+    }
+
+    //回复接口为虚函数: 派生类(如Http2RequestHandler)按自己的协议回复, 分层(如HttpOffloadHandler)通过基类指针调用
+    virtual int send(HttpContext &context, ByteBuffer &out, bool out_owned = true)
+    {
+        out.reset();
+        if (encode_response(context, out, 1024) > 0) {
+            if (!out_owned) {
+                super::send(out.data(), out.data_size(), false);
+            }
+            else {
+                super::send(out, false);
+            }
+            super::send(context.response_.body_, false);
+        }
+        else {
+            if (!out_owned) {
+                super::send(out.data(), out.data_size());
+            }
+            else {
+                super::send(out);
+            }
+        }
+
+        return 0;
+    }
+
+    //异步回复: 用于do_message返回>0(手动回复)的请求, 须在所属event_loop线程中调用
+    //  context.response_.sequence_为请求的序号(do_message时设置), 回复按请求顺序发送:
+    //  前面还有未回复的请求时先缓存, 等前面的请求都回复后与其一起发送
+    //  返回值 <0: 序号无效(连接已重置/重复回复)
+    virtual int send_response(HttpContext &context)
+    {
+        uint64_t sequence = context.response_.sequence_;
+        if ((sequence < next_send_sequence_) || (sequence - next_send_sequence_ >= pending_responses_.size())) {
+            return -1;
+        }
+
+        PendingResponse &pending = pending_responses_[static_cast<size_t>(sequence - next_send_sequence_)];
+        if (pending.ready_) {
+            return -1;
+        }
+        BufferPool::instance().acquire(pending.buffer_, context.response_.body_.data_size() + 512);
+        encode_response(context, pending.buffer_, 0xFFFFFFFF);
+        pending.ready_ = true;
+
+        if (nullptr != batch_out_) {
+            //在decode中: 随本次接收的其它回复一起发送
+            append_ready_responses(*batch_out_);
+        }
+        else {
+            ByteBuffer &out = batch_buffer();
+            out.reset();
+            append_ready_responses(out);
+            if (flush(out) < 0) {
+                super::event_loop_->delete_handler(this, 0);
+            }
+        }
+        return 0;
+    }
+
+    //流式回复(Transfer-Encoding: chunked): send_chunked_begin -> send_chunk * n -> send_chunked_end
+    //  可在do_message中调用(当前请求), 也可在do_message返回>0后异步调用, 须在所属event_loop线程中调用
+    //  与send_response一样按请求顺序发送: 前面还有未回复的请求时先缓存, 轮到该回复时再输出
+    //  HEAD请求只发送header; HTTP/1.0请求不支持chunked, 返回-1(由调用方改用send_response)
+    //  返回值 <0: 序号无效(连接已重置/重复回复)
+    virtual int send_chunked_begin(HttpContext &context)
+    {
+        if (context.request_.version_id_ < HttpVersionId::kHTTP11) {
+            return -1;
+        }
+
+        uint64_t sequence = context.response_.sequence_;
+        if (sequence < next_send_sequence_) {
+            return -1;
+        }
+        size_t index = static_cast<size_t>(sequence - next_send_sequence_);
+        if (index == pending_responses_.size()) {
+            //do_message中的当前请求: 此时还没有回复位置
+            if (sequence + 1 != next_request_sequence_) {
+                return -1;
+            }
+            HttpDecoderConfig *config = static_cast<HttpDecoderConfig *>(super::source_->message_decoder_config());
+            if (pending_responses_.size() >= config->max_pending_responses_) {
+                return -1;
+            }
+            pending_responses_.emplace_back();
+        }
+        else if (index > pending_responses_.size()) {
+            return -1;
+        }
+
+        PendingResponse &pending = pending_responses_[index];
+        if (pending.ready_ || pending.streaming_) {
+            return -1;
+        }
+        pending.streaming_ = true;
+        pending.head_      = (context.request_.method_id_ == HttpMethodId::kHEAD);
+        context.response_.chunked_ = true;
+        if (0 == index) {
+            ByteBuffer &out = stream_out();
+            encode_response(context, out, 0xFFFFFFFF);
+            stream_flush(out);
+        }
+        else {
+            BufferPool::instance().acquire(pending.buffer_, 512);
+            encode_response(context, pending.buffer_, 0xFFFFFFFF);
+        }
+        return 0;
+    }
+
+    virtual int send_chunk(HttpContext &context, const char *data, uint_t len)
+    {
+        PendingResponse *pending = streaming_response(context.response_.sequence_);
+        if (nullptr == pending) {
+            return -1;
+        }
+        if (pending->head_) {
+            return 0;
+        }
+        if (pending == &pending_responses_.front()) {
+            ByteBuffer &out = stream_out();
+            HttpChunkedEncoder::write_chunk(out, data, len);
+            stream_flush(out);
+        }
+        else {
+            if (nullptr == pending->buffer_.buffer()) {
+                BufferPool::instance().acquire(pending->buffer_, len + HttpChunkedEncoder::MAX_CHUNK_HEADER_LENGTH + 2);
+            }
+            HttpChunkedEncoder::write_chunk(pending->buffer_, data, len);
+        }
+        return 0;
+    }
+
+    virtual int send_chunked_end(HttpContext &context)
+    {
+        PendingResponse *pending = streaming_response(context.response_.sequence_);
+        if (nullptr == pending) {
+            return -1;
+        }
+        if (pending == &pending_responses_.front()) {
+            ByteBuffer &out = stream_out();
+            if (!pending->head_) {
+                HttpChunkedEncoder::write_last_chunk(out);
+            }
+            BufferPool::instance().release(pending->buffer_);
+            pending_responses_.pop_front();
+            ++next_send_sequence_;
+            append_ready_responses(out);
+            stream_flush(out);
+        }
+        else {
+            if (!pending->head_) {
+                if (nullptr == pending->buffer_.buffer()) {
+                    BufferPool::instance().acquire(pending->buffer_, 8);
+                }
+                HttpChunkedEncoder::write_last_chunk(pending->buffer_);
+            }
+            pending->streaming_ = false;
+            pending->ready_     = true;
+        }
+        return 0;
+    }
+
+    int handle_open()
+    {
+        decode_state_ = HttpDecodeState::kMethod;
+        upgraded_     = false;
+        context_.init();
+        context_.response_.event_handler_ = this;
+        super::release_message_buffer();
+        clear_pending_responses();
+        super::queue1_.clear();
+        super::queue2_.clear();
+        return do_open();
+    }
+
+protected:
+    //待发送的回复(前面有未完成的异步请求时缓存)
+    struct PendingResponse
+    {
+        ByteBuffer  buffer_;
+        bool        ready_     = false;
+        bool        streaming_ = false; //流式回复已开始, 尚未结束
+        bool        head_      = false; //流式回复对应HEAD请求(不发送body)
+        bool        deferred_  = false; //buffer_之后的body由分层发送(send_deferred_body, 如文件内容)
+    };
+
+    //线程内共享的批量发送缓存: 一次接收中产生的所有回复连续编码到此缓存, decode结束时一次发送
+    static ByteBuffer & batch_buffer()
+    {
+        static thread_local ByteBuffer buffer;
+        return buffer;
+    }
+
+    //延迟发送的body随写事件继续发送
+    int handle_write()
+    {
+        if (!deferred_active_ || !send_queue_empty()) {
+            int ret = super::handle_write();
+            if ((EventHandler::WriteResult::WRITE_RESULT_SUCCESS != ret) || !deferred_active_ || !send_queue_empty()) {
+                return ret;
+            }
+        }
+        ByteBuffer &out = batch_buffer();
+        out.reset();
+        return send_deferred_body(out);
+    }
+
+    inline bool send_queue_empty()
+    {
+        super::mutex_.lock();
+        bool queue_empty = super::queue_active_->empty() && super::queue_standby_->empty();
+        super::mutex_.unlock();
+        return queue_empty;
+    }
+
+    int handle_close()
+    {
+        int ret = super::handle_close();
+        clear_pending_responses();
+        return ret;
+    }
+
+    //请求处理(decode中每个完整的请求调用一次), 返回值同do_message
+    //  分层可重写: 在do_message之前/之后处理(如HttpResponseCacheHandler命中缓存时直接回复, 不调用do_message)
+    virtual int handle_request()
+    {
+        return do_message();
+    }
+
+    //发送队首回复延迟发送的body(deferred_active_时调用, 之前的数据须已全部发送), 由使用deferred_的分层实现
+    //  socket缓冲区满时注册写事件返回WRITE_RESULT_PART; 发送完后调用finish_deferred_body
+    //  返回值 <0: 发送失败
+    virtual int send_deferred_body(ByteBuffer &out)
+    {
+        return EventHandler::WriteResult::WRITE_RESULT_SUCCESS;
+    }
+
+    //队首回复的延迟body已发送完: 出队并输出其后已完成的回复
+    //  返回false: 输出的数据未发送完且下一个回复也有延迟body(由handle_write继续)
+    inline bool finish_deferred_body(ByteBuffer &out)
+    {
+        BufferPool::instance().release(pending_responses_.front().buffer_);
+        pending_responses_.pop_front();
+        ++next_send_sequence_;
+        deferred_active_ = false;
+        append_ready_responses(out);
+        if (!out.empty()) {
+            super::send(out.data(), out.data_size());
+            out.reset();
+            if (deferred_active_ && !send_queue_empty()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //请求(序号sequence)是否已有回复位置(已回复/已开始流式回复/已缓存待发送)
+    inline bool replied(uint64_t sequence) const
+    {
+        return sequence < next_send_sequence_ + pending_responses_.size();
+    }
+
+    //将回复追加到out
+    //  body不小于copy_body_max时不拷贝body, 返回1(由调用方单独发送body); 否则返回0
+    int encode_response(HttpContext &context, ByteBuffer &out, uint_t copy_body_max)
     {
         HttpRequest  &request  = context.request_;
         HttpResponse &response = context.response_;
-        out.reset();
-        out.reserve(1024);
-
-        const std::string &http_version = HttpMessage::find_http_version_name(response.version_id_);
-        const std::string &status_desc  = HttpMessage::find_http_status_description(response.status_code_);
-        int ret = std::snprintf(out.data(), 
-            out.free_size()-1,
-            "%s %d %s\r\n",
-            http_version.c_str(),
-            response.status_code_,
-            status_desc.c_str());
-        out.data_end(static_cast<uint_t>(ret));
+        HttpDecoderConfig *config = static_cast<HttpDecoderConfig *>(super::source_->message_decoder_config());
+
+        HttpMessage::write_status_line(out, response.version_id_, response.status_code_);
+        if (config->date_header_ || !config->server_name_.empty()) {
+            HttpStringView block = HttpDateHeader::instance().header_block(config->date_header_, config->server_name_);
+            out.write(block.data_, block.len_);
+        }
 
         for (auto &iter : response.headers_) {
-            out.write(iter.first.c_str(), iter.first.size());
+            out.write(iter.name_.data_, iter.name_.len_);
             out.write(": ", 2);
-            out.write(iter.second.c_str(), iter.second.size());
+            out.write(iter.value_.data_, iter.value_.len_);
             out.write("\r\n", 2);
         }
 
+        if (response.chunked_) {
+            HttpMessage::write_transfer_encoding(out);
+            return 0;
+        }
+
         if (request.method_id_ != HttpMethodId::kHEAD) { // begin: HttpMethod != HEAD
             uint_t body_size = response.body_.data_size();
             if (body_size > 0) {
-                out.reserve(out.data_size() + 32);
-                ret = std::snprintf(out.data() + out.data_size(),
-                    out.free_size()-1,
-                    "Content-Length: %u\r\n\r\n",
-                    body_size);
-                out.data_end(static_cast<uint_t>(out.data_size() + ret));
-
-                if (body_size < 1024) {
-                    out.write(response.body_.data(), body_size);
-                    if (!out_owned) {
-                        super::send(out.data(), out.data_size());
-                    }
-                    else {
-                        super::send(out);
-                    }
-                }
-                else {
-                    if (!out_owned) {
-                        super::send(out.data(), out.data_size(), false);
-                        super::send(response.body_, false);
-                    }
-                    else {
-                        super::send(out, false);
-                        super::send(response.body_, false);
-                    }
+                HttpMessage::write_content_length(out, body_size);
+                if (body_size >= copy_body_max) {
+                    return 1;
                 }
+                out.write(response.body_.data(), body_size);
             }
             else {
                 if ((response.status_code_ < HttpStatusCode::k200) ||
@@ -106,280 +380,399 @@ public:
                 else {
                     out.write("Content-Length: 0\r\n\r\n", sizeof("Content-Length: 0\r\n\r\n")-1);
                 }
-                super::send(out.data(), out.data_size());
             }
-
         } // end: HttpMethod != HEAD
         else { //begin: HttpMethod == HEAD
-
             uint_t real_body_size = std::max<uint_t>(response.body_.data_size(), response.content_length_);
             if (real_body_size > 0) {
-                out.reserve(out.data_size() + 32);
-                ret = std::snprintf(out.data() + out.data_size(),
-                    out.free_size() - 1,
-                    "Content-Length: %u\r\n\r\n",
-                    real_body_size);
-                out.data_end(static_cast<uint_t>(out.data_size() + ret));
+                HttpMessage::write_content_length(out, real_body_size);
             }
             else {
                 out.write("\r\n", 2);
             }
-            super::send(out.data(), out.data_size());
-
         } //end: HttpMethod == HEAD
 
         return 0;
     }
 
-    int handle_open()
+    //decode中的自动回复: 追加到批量发送缓存
+    //  body较大时先发送已缓存的数据, 再转移body所有权单独发送(不拷贝)
+    //  返回值 <0: 发送失败(由调用方关闭连接)
+    inline int write_response(HttpContext &context, ByteBuffer &out)
     {
-        HttpDecoderConfig *config = static_cast<HttpDecoderConfig *>(super::source_->message_decoder_config());
-        header_length_  = 0;
-        decode_state_   = HttpDecodeState::kMethod;
-        line_state_     = HttpLineState::kNormal;
-        field1_.clear();
-        field2_.clear();
-        field1_.reserve(config->max_uri_length_);
-        field2_.reserve(config->max_uri_length_);
-        context_.init();
-        context_.response_.event_handler_ = this;
-        super::queue1_.clear();
-        super::queue2_.clear();
-        return do_open();
+        if (encode_response(context, out, 1024) > 0) {
+            if (flush(out) < 0) {
+                return -1;
+            }
+            super::send(context.response_.body_);
+        }
+        return 0;
+    }
+
+    //返回值 <0: 延迟的body发送失败(由调用方关闭连接)
+    inline int flush(ByteBuffer &out)
+    {
+        if (!out.empty()) {
+            super::send(out.data(), out.data_size());
+            out.reset();
+        }
+        if (deferred_active_ && send_queue_empty()) {
+            return send_deferred_body(out);
+        }
+        return 0;
+    }
+
+    //按请求顺序取出已完成的回复追加到out
+    //  队首为进行中的流式回复时, 输出其已缓存的部分, 之后的chunk直接输出
+    inline void append_ready_responses(ByteBuffer &out)
+    {
+        while (!pending_responses_.empty()) {
+            PendingResponse &pending = pending_responses_.front();
+            ByteBuffer &buffer = pending.buffer_;
+            if (!pending.ready_) {
+                if (pending.streaming_ && (buffer.data_size() > 0)) {
+                    out.write(buffer.data(), buffer.data_size());
+                    buffer.reset();
+                }
+                break;
+            }
+            out.write(buffer.data(), buffer.data_size());
+            if (pending.deferred_) {
+                //body在已输出的header之后由send_deferred_body发送
+                buffer.reset();
+                deferred_active_ = true;
+                break;
+            }
+            BufferPool::instance().release(buffer);
+            pending_responses_.pop_front();
+            ++next_send_sequence_;
+        }
+    }
+
+    //进行中的流式回复, 返回nullptr: 序号无效或未调用send_chunked_begin
+    inline PendingResponse * streaming_response(uint64_t sequence)
+    {
+        if ((sequence < next_send_sequence_) || (sequence - next_send_sequence_ >= pending_responses_.size())) {
+            return nullptr;
+        }
+        PendingResponse &pending = pending_responses_[static_cast<size_t>(sequence - next_send_sequence_)];
+        return pending.streaming_ ? &pending : nullptr;
+    }
+
+    //队首流式回复的输出缓存: decode中为批量发送缓存(decode结束时发送), 否则由stream_flush立即发送
+    inline ByteBuffer & stream_out()
+    {
+        if (nullptr != batch_out_) {
+            return *batch_out_;
+        }
+        ByteBuffer &out = batch_buffer();
+        out.reset();
+        return out;
+    }
+
+    inline void stream_flush(ByteBuffer &out)
+    {
+        if ((nullptr == batch_out_) && (flush(out) < 0)) {
+            super::event_loop_->delete_handler(this, 0);
+        }
+    }
+
+    inline void clear_pending_responses()
+    {
+        for (auto &pending : pending_responses_) {
+            BufferPool::instance().release(pending.buffer_);
+        }
+        pending_responses_.clear();
+        deferred_active_ = false;
+        //序号不归零: 连接重置前发起的异步回复不会被误认为新请求的回复
+        next_send_sequence_ = next_request_sequence_;
     }
 
-protected:
     inline int decode_reset()
     {
-        int ret = do_message();
+        if (pending_responses_.empty() && (nullptr != context_.request_.headers_.known(HttpKnownHeader::kUpgrade))) {
+            int ret = do_upgrade();
+            if (ret < 0) {
+                return -1;
+            }
+            if (ret > 0) {
+                //连接已由升级后的协议接管: 之后不再有HTTP/1.x请求
+                next_send_sequence_ = ++next_request_sequence_;
+                BufferPool::instance().release(context_.request_.body_);
+                super::release_message_buffer();
+                context_.init();
+                decode_state_ = HttpDecodeState::kMethod;
+                upgraded_     = true;
+                return 0;
+            }
+        }
+
+        //前面有未完成的异步请求时, 同步回复也要缓存到其后: 待回复的请求过多则关闭连接
+        HttpDecoderConfig *config = static_cast<HttpDecoderConfig *>(super::source_->message_decoder_config());
+        if (!pending_responses_.empty() && (pending_responses_.size() >= config->max_pending_responses_)) {
+            return -1;
+        }
+
+        uint64_t sequence = next_request_sequence_++;
+        context_.response_.sequence_ = sequence;
+        int ret = handle_request();
+        BufferPool::instance().release(context_.request_.body_);
+        super::release_message_buffer();
         if (ret >= 0) {
-            if (0 == ret) {
-                send(context_, *super::event_loop_->get_send_buffer(), false);
+            if (replied(sequence)) {
+                //已回复或已开始流式回复(send_chunked_begin等): 回复由相应接口完成
+                context_.init();
+            }
+            else if (0 == ret) {
+                if (pending_responses_.empty()) {
+                    ++next_send_sequence_;
+                    ret = write_response(context_, *batch_out_);
+                }
+                else {
+                    //前面有未完成的异步请求: 缓存到其后按序发送
+                    pending_responses_.emplace_back();
+                    PendingResponse &pending = pending_responses_.back();
+                    BufferPool::instance().acquire(pending.buffer_, context_.response_.body_.data_size() + 512);
+                    encode_response(context_, pending.buffer_, 0xFFFFFFFF);
+                    pending.ready_ = true;
+                }
                 context_.reset();
             }
             else {
+                if (pending_responses_.size() >= config->max_pending_responses_) {
+                    return -1;
+                }
+                pending_responses_.emplace_back();
                 context_.init();
             }
-
-            header_length_  = 0;
-            decode_state_   = HttpDecodeState::kMethod;
-            line_state_     = HttpLineState::kNormal;
-            field1_.clear();
-            field2_.clear();
+            decode_state_ = HttpDecodeState::kMethod;
         }
 
         return ret;
     }
 
+    //请求头解析完成: 填充request, 返回值<0: 非法请求
+    //  header以视图方式指向header所在缓存(接收缓存或消息缓存), 不拷贝
+    inline int decode_header(const char *header, HttpDecoderConfig *config)
+    {
+        HttpRequest &request = context_.request_;
+        request.method_id_   = parser_.method_id_;
+        request.version_id_  = parser_.version_id_;
+        context_.response_.version_id_ = parser_.version_id_;
+        request.uri_.assign(parser_.uri(header), parser_.uri_len_);
+        for (uint_t i = 0; i < parser_.header_count_; ++i) {
+            const HttpHeaderOffset &h = parser_.headers_[i];
+            request.headers_.add_view(header + h.name_offset_, h.name_len_, header + h.value_offset_, h.value_len_);
+        }
+
+        if (context_.update() < 0) {
+            return reject_request(HttpStatusCode::k400);
+        }
+        if (!config->stream_body_ && (request.content_length_ > config->max_body_length_)) {
+            return reject_request(HttpStatusCode::k413);
+        }
+        return 0;
+    }
+
+    //非法请求: 记录回复的状态码, 返回-1(由decode回复后关闭连接)
+    inline int reject_request(HttpStatusCode status_code)
+    {
+        reject_status_ = status_code;
+        return -1;
+    }
+
+    //非法请求的回复(Connection: close)
+    inline void write_reject(ByteBuffer &out)
+    {
+        HttpVersionId version_id = (HttpVersionId::kHTTP10 == parser_.version_id_) ? HttpVersionId::kHTTP10 : HttpVersionId::kHTTP11;
+        HttpMessage::write_status_line(out, version_id, reject_status_);
+        out.write("Connection: close\r\nContent-Length: 0\r\n\r\n", sizeof("Connection: close\r\nContent-Length: 0\r\n\r\n") - 1);
+    }
+
+    //一次接收中的所有请求(pipelining)的自动回复连续编码到批量发送缓存, 结束时一次发送
     int decode(const char *data, uint_t len)
     {
-        HttpRequest  &request  = context_.request_;
-        HttpResponse &response = context_.response_;
+        ByteBuffer &out = batch_buffer();
+        out.reset();
+        batch_out_ = &out;
+        int ret = upgraded_ ? decode_upgraded(data, len) : decode_i(data, len);
+        batch_out_ = nullptr;
+        if (ret >= 0) {
+            if (flush(out) < 0) {
+                ret = -1;
+            }
+        }
+        else if ((HttpStatusCode::k200 != reject_status_) && pending_responses_.empty()) {
+            //非法请求: 之前的请求都已回复(或在out中)时回复错误状态码, 之后关闭连接
+            write_reject(out);
+            flush(out);
+        }
+        else {
+            out.reset();
+        }
+        reject_status_ = HttpStatusCode::k200;
+        return ret;
+    }
+
+    int decode_i(const char *data, uint_t len)
+    {
+        HttpRequest &request = context_.request_;
         HttpDecoderConfig *config = static_cast<HttpDecoderConfig *>(super::source_->message_decoder_config());
         const char *data_end = data + len;
-        char ch;
         uint_t remain_len;
         uint_t need_len;
+        int header_len;
+        const char *chunk;
+        uint_t chunk_len;
 
-        do {
-            if (decode_state_ != HttpDecodeState::kBody) { //begin: parse header
-                for (; data < data_end; ++data) {
-                    if (++header_length_ >= config->max_header_length_) {
+        while (data < data_end) {
+            if (upgraded_) {
+                //本次接收中升级请求之后的数据
+                return decode_upgraded(data, static_cast<uint_t>(data_end - data));
+            }
+            if (HttpDecodeState::kChunked == decode_state_) { //begin: parse chunked body
+                switch (chunked_decoder_.decode(data, data_end, chunk, chunk_len)) {
+                case HttpChunkedDecoder::kData:
+                    if (do_body_chunk(chunk, chunk_len) < 0) {
                         return -1;
                     }
-
-                    ch = *data;
-                    switch (decode_state_) {
-                    case HttpDecodeState::kMethod:
-                        if (ch != ' ') {
-                            field1_.push_back(ch);
-                        }
-                        else {
-                            request.method_id_ = HttpMessage::find_http_method_id(field1_);
-                            if (HttpMethodId::kUNKNOWN != request.method_id_) {
-                                decode_state_ = HttpDecodeState::kUri;
-                                field1_.clear();
-                            }
-                            else {
-                                return -1;
-                            }
-                        }
-                        break;
-                    case HttpDecodeState::kUri:
-                        if (ch != ' ') {
-                            request.uri_.push_back(ch);
-                        }
-                        else {
-                            decode_state_ = HttpDecodeState::kVersion;
+                    break;
+                case HttpChunkedDecoder::kComplete:
+                    request.finish_body();
+                    if (decode_reset() < 0) {
+                        return -1;
+                    }
+                    break;
+                case HttpChunkedDecoder::kNeedMore:
+                    break;
+                default:
+                    return -1;
+                }
+            } //end: parse chunked body
+            else if (decode_state_ != HttpDecodeState::kBody) { //begin: parse header
+                ByteBuffer &message_buffer = super::message_buffer_;
+                remain_len = static_cast<uint_t>(data_end - data);
+                if (message_buffer.empty()) {
+                    //请求头完整落在本次接收数据中: 直接在接收缓存上解析
+                    header_len = parser_.parse_request(data, remain_len, config->max_uri_length_);
+                    if (header_len > 0) {
+                        if (static_cast<uint_t>(header_len) >= config->max_header_length_) {
+                            return reject_request(HttpStatusCode::k431);
                         }
-                        break;
-                    case HttpDecodeState::kVersion:
-                        switch (line_state_) {
-                        case HttpLineState::kNormal:
-                            if (ch != '\r') {
-                                field1_.push_back(ch);
-                            }
-                            else {
-                                request.version_id_ = HttpMessage::find_http_version_id(field1_);
-                                if (HttpVersionId::kUNKNOWN != request.version_id_) {
-                                    response.version_id_ = request.version_id_;
-                                    line_state_ = HttpLineState::kCR;
-                                    field1_.clear();
-                                }
-                                else {
-                                    return -1;
-                                }
-                            }
-                            break;
-                        case HttpLineState::kCR:
-                            if (ch == '\n') {
-                                line_state_ = HttpLineState::kCRLF;
-                            }
-                            else {
-                                return -1;
-                            }
-                            break;
-                        case HttpLineState::kCRLF:
-                            if (ch != '\r') {
-                                field1_.clear();
-                                field1_.push_back(ch);
-                                decode_state_ = HttpDecodeState::kHeaderField;
-                                line_state_   = HttpLineState::kNormal;
-                            }
-                            else {
-                                line_state_ = HttpLineState::kCRLFCR;
-                            }
-                            break;
-                        case HttpLineState::kCRLFCR:
-                            if (ch == '\n') {
-                                if (decode_reset() < 0) {
-                                    return -1;
-                                }
-                            }
-                            else {
-                                return -1;
-                            }
-                            break;
-                        default:
-                            break;
+                        if (decode_header(data, config) < 0) {
+                            return -1;
                         }
-                        break;
-                    case HttpDecodeState::kHeaderField:
-                        if (ch != ':') {
-                            field1_.push_back(ch);
+                        data += header_len;
+                    }
+                    else if (0 == header_len) {
+                        if (remain_len >= config->max_header_length_) {
+                            return reject_request(HttpStatusCode::k431);
                         }
-                        else {
-                            decode_state_ = HttpDecodeState::kHeaderValue;
-                            field2_.clear();
+                        super::write_message_buffer(data, remain_len, config->max_header_length_);
+                        return 1;
+                    }
+                    else {
+                        return reject_request(HttpParser::error_status(header_len));
+                    }
+                }
+                else {
+                    //请求头跨越多次接收: 追加到消息缓存(不超过max_header_length_)后重新解析
+                    uint_t last_len = message_buffer.data_size();
+                    need_len = std::min<uint_t>(remain_len, config->max_header_length_ - last_len);
+                    message_buffer.write(data, need_len);
+                    header_len = parser_.parse_request(message_buffer.data(), message_buffer.data_size(), config->max_uri_length_);
+                    if (header_len > 0) {
+                        message_buffer.data_end(message_buffer.data_begin() + header_len);
+                        if (decode_header(message_buffer.data(), config) < 0) {
+                            return -1;
                         }
-                        break;
-                    case HttpDecodeState::kHeaderValue:
-                        switch (line_state_) {
-                        case HttpLineState::kNormal:
-                            if (ch != '\r') {
-                                field2_.push_back(ch);
-                            }
-                            else {
-                                request.headers_.emplace(std::move(field1_), std::move(field2_));
-                                line_state_ = HttpLineState::kCR;
-                                field1_.reserve(config->max_uri_length_);
-                                field2_.reserve(config->max_uri_length_);
-                            }
-                            break;
-                        case HttpLineState::kCR:
-                            if (ch == '\n') {
-                                line_state_ = HttpLineState::kCRLF;
-                            }
-                            else {
-                                return -1;
-                            }
-                            break;
-                        case HttpLineState::kCRLF:
-                            if (ch != '\r') {
-                                field1_.push_back(ch);
-                                decode_state_   = HttpDecodeState::kHeaderField;
-                                line_state_     = HttpLineState::kNormal;
-                            }
-                            else {
-                                line_state_ = HttpLineState::kCRLFCR;
-                            }
-                            break;
-                        case HttpLineState::kCRLFCR:
-                            if (ch == '\n') {
-                                if (context_.update() < 0) {
-                                    return -1;
-                                }
-
-                                if (request.content_length_ > 0) {
-                                    if (request.content_length_ > config->max_body_length_) {
-                                        return -1;
-                                    }
-                                    decode_state_ = HttpDecodeState::kBody;
-                                    line_state_   = HttpLineState::kNormal;
-                                    ++data;
-                                    goto PARSE_BODY;
-                                }
-                                else { //request.content_length_ == 0
-                                    if (decode_reset() < 0) {
-                                        return -1;
-                                    }
-                                }
-                            }
-                            else {
-                                return -1;
-                            }
-                            break;
-                        default:
-                            break;
+                        data += header_len - last_len;
+                    }
+                    else if (0 == header_len) {
+                        if (message_buffer.data_size() >= config->max_header_length_) {
+                            return reject_request(HttpStatusCode::k431);
                         }
-                        break;
-                    default:
-                        break;
+                        return 1;
+                    }
+                    else {
+                        return reject_request(HttpParser::error_status(header_len));
                     }
+                }
 
+                if (request.chunked_) {
+                    decode_state_ = HttpDecodeState::kChunked;
+                    chunked_decoder_.reset();
+                }
+                else if (request.content_length_ > 0) {
+                    decode_state_ = HttpDecodeState::kBody;
+                    body_remain_  = request.content_length_;
+                }
+                else if (decode_reset() < 0) {
+                    return -1;
                 }
             } //end: parse header
             else { //begin: parse body
-
-        PARSE_BODY:
                 remain_len = static_cast<uint_t>(data_end - data);
-                if (remain_len > 0) {
-                    if (request.body_.empty() && remain_len >= request.content_length_) {
-                        request.body_ptr_ = const_cast<char *>(data);
-                        data += request.content_length_;
+                if (config->stream_body_) {
+                    need_len = std::min<uint_t>(remain_len, body_remain_);
+                    if (do_body_chunk(data, need_len) < 0) {
+                        return -1;
+                    }
+                    data += need_len;
+                    body_remain_ -= need_len;
+                    if (0 == body_remain_) {
+                        request.finish_body();
                         if (decode_reset() < 0) {
                             return -1;
                         }
                     }
-                    else {
-                        need_len = std::min<uint_t>(remain_len, (request.content_length_ - request.body_.data_size()));
-                        request.body_.write(data, need_len);
-                        data += need_len;
-                        if (request.body_.data_size() == request.content_length_) {
-                            request.body_ptr_ = request.body_.data();
-                            if (decode_reset() < 0) {
-                                return -1;
-                            }
-                        }
+                }
+                else if (request.body_.empty() && remain_len >= request.content_length_) {
+                    request.body_ptr_ = const_cast<char *>(data);
+                    data += request.content_length_;
+                    if (decode_reset() < 0) {
+                        return -1;
                     }
                 }
                 else {
-                    break;
+                    need_len = std::min<uint_t>(remain_len, (request.content_length_ - request.body_.data_size()));
+                    if (nullptr == request.body_.buffer()) {
+                        //body跨多次接收时才从BufferPool分配
+                        BufferPool::instance().acquire(request.body_, request.content_length_);
+                    }
+                    request.body_.write(data, need_len);
+                    data += need_len;
+                    if (request.body_.data_size() == request.content_length_) {
+                        request.body_ptr_ = request.body_.data();
+                        if (decode_reset() < 0) {
+                            return -1;
+                        }
+                    }
                 }
             } //end: parse body
+        }
 
-        } while (data < data_end);
-
+        if ((HttpDecodeState::kMethod != decode_state_) && super::message_buffer_.empty()) {
+            //body跨越多次接收: 接收缓存将被复用, header转为内部存储
+            request.headers_.promote();
+        }
         return 1;
     }
 
 protected:
-    uint_t          header_length_  = 0;
-    HttpDecodeState decode_state_   = HttpDecodeState::kMethod;
-    HttpLineState   line_state_     = HttpLineState::kNormal;
-    std::string     field1_;
-    std::string     field2_;
+    HttpDecodeState decode_state_ = HttpDecodeState::kMethod;
+    HttpParser      parser_;
     HttpContext     context_;
+    HttpChunkedDecoder chunked_decoder_;
+    uint_t          body_remain_ = 0;               //stream_body_时Content-Length的body剩余长度
+    bool            deferred_active_ = false;       //队首回复的header已输出, 正在发送延迟的body
+    bool            upgraded_    = false;           //连接已升级(do_upgrade返回>0)
+    HttpStatusCode  reject_status_ = HttpStatusCode::k200;  //非法请求回复的状态码(k200: 无)
+
+    ByteBuffer     *batch_out_ = nullptr;           //decode期间指向批量发送缓存
+    uint64_t        next_request_sequence_ = 0;     //下一个请求的序号
+    uint64_t        next_send_sequence_    = 0;     //下一个待发送回复的序号
+    std::deque<PendingResponse> pending_responses_; //[next_send_sequence_, next_request_sequence_)的回复
 };
 
 ZRSOCKET_NAMESPACE_END
@@ -0,0 +1,243 @@
+﻿// Some compilers (e.g. VC++) benefit significantly from using this. 
+// We've measured 3-4% build speed improvements in apps as a result 
+#pragma once
+
+#ifndef ZRSOCKET_HTTP_RESPONSE_CACHE_H
+#define ZRSOCKET_HTTP_RESPONSE_CACHE_H
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "config.h"
+#include "base_type.h"
+#include "byte_buffer.h"
+#include "http_common.h"
+#include "http_request_handler.h"
+
+ZRSOCKET_NAMESPACE_BEGIN
+
+//回复缓存配置(HttpDecoderConfig::response_cache_)
+class HttpResponseCacheConfig
+{
+public:
+    HttpResponseCacheConfig() = default;
+    ~HttpResponseCacheConfig() = default;
+
+    uint_t max_entries_    = 1024;          //每个event_loop线程最多缓存的回复数(超过时淘汰最久未使用的)
+    uint_t max_entry_size_ = 64 * 1024;     //body超过此长度的回复不缓存
+    bool   key_host_       = true;          //Host参与缓存key(同一监听端口上基于名称的虚拟主机互不命中), 只有一个站点时可关闭
+
+    //参与缓存key的请求header(如Accept-Encoding): 这些header的值不同的请求分别缓存
+    std::vector<std::string> key_headers_;
+};
+
+//HTTP回复缓存(microcache): 以方法 + 版本 + Host + URI + 指定header的值为key, 缓存编码好的完整回复(header + body)
+//  每个event_loop线程一个实例(thread_local), 无锁; 由HttpResponseCacheHandler使用, 命中时不调用do_message, 不编码, 按引用发送SharedBuffer
+//  过期时间按Time::instance()计算(需定时update_time, 如Application)
+//  只缓存无body的GET/HEAD请求的自动回复, 且须在do_message中设置response_.cache_ttl_ms_ > 0
+class HttpResponseCache
+{
+public:
+    static HttpResponseCache & instance()
+    {
+        static thread_local HttpResponseCache cache;
+        return cache;
+    }
+
+    //线程内共享的key缓存(生成key时不分配内存)
+    static std::string & key_buffer()
+    {
+        static thread_local std::string key;
+        return key;
+    }
+
+    HttpResponseCache() = default;
+    ~HttpResponseCache() = default;
+
+    //生成缓存key, 返回false: 请求不可缓存(非GET/HEAD或带body)
+    static bool make_key(const HttpRequest &request, const HttpResponseCacheConfig &config, std::string &key)
+    {
+        if (((request.method_id_ != HttpMethodId::kGET) && (request.method_id_ != HttpMethodId::kHEAD)) ||
+            (request.content_length_ > 0) || request.chunked_) {
+            return false;
+        }
+
+        key.clear();
+        key.push_back(static_cast<char>(request.method_id_));
+        key.push_back(static_cast<char>(request.version_id_));     //状态行的版本随请求
+        if (config.key_host_) {
+            const HttpHeader *host = request.headers_.known(HttpKnownHeader::kHost);
+            if (nullptr != host) {
+                key.append(host->value_.data_, host->value_.len_);
+            }
+            key.push_back('\0');
+        }
+        key.append(request.uri_);
+        for (auto &name : config.key_headers_) {
+            HttpStringView value = request.header(name);
+            key.push_back('\0');
+            key.append(value.data_, value.len_);
+        }
+        return true;
+    }
+
+    //查找未过期的回复, 未找到返回nullptr(已过期的同时删除)
+    SharedBuffer * find(const std::string &key, uint64_t now_ms)
+    {
+        auto iter = index_.find(key);
+        if (iter == index_.end()) {
+            return nullptr;
+        }
+        auto entry = iter->second;
+        if (now_ms >= entry->expire_ms_) {
+            entries_.erase(entry);
+            index_.erase(iter);
+            return nullptr;
+        }
+        if (entry != entries_.begin()) {
+            entries_.splice(entries_.begin(), entries_, entry);
+        }
+        return &entry->response_;
+    }
+
+    void put(const std::string &key, SharedBuffer &response, uint64_t expire_ms, uint_t max_entries)
+    {
+        auto iter = index_.find(key);
+        if (iter != index_.end()) {
+            auto entry = iter->second;
+            entry->response_  = response;
+            entry->expire_ms_ = expire_ms;
+            entries_.splice(entries_.begin(), entries_, entry);
+            return;
+        }
+
+        if (0 == max_entries) {
+            return;
+        }
+        while (index_.size() >= max_entries) {
+            index_.erase(entries_.back().key_);
+            entries_.pop_back();
+        }
+        entries_.emplace_front();
+        Entry &entry = entries_.front();
+        entry.key_        = key;
+        entry.response_   = response;
+        entry.expire_ms_  = expire_ms;
+        index_.emplace(key, entries_.begin());
+    }
+
+    void erase(const std::string &key)
+    {
+        auto iter = index_.find(key);
+        if (iter != index_.end()) {
+            entries_.erase(iter->second);
+            index_.erase(iter);
+        }
+    }
+
+    //清空本线程的缓存(其它event_loop线程的缓存须在各自线程中清空)
+    void clear()
+    {
+        index_.clear();
+        entries_.clear();
+    }
+
+    inline uint_t size() const
+    {
+        return static_cast<uint_t>(index_.size());
+    }
+
+private:
+    struct Entry
+    {
+        std::string  key_;
+        SharedBuffer response_;
+        uint64_t     expire_ms_ = 0;
+    };
+
+    std::list<Entry> entries_;  //按最近使用排序(队首最新)
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+};
+
+//回复缓存分层: 在THandler(HttpRequestHandler或其派生类)之上增加回复缓存(需设置HttpDecoderConfig::response_cache_)
+//  例: class MyHandler : public HttpResponseCacheHandler<HttpRequestHandler<ByteBuffer, NullMutex> >
+template <class THandler>
+class HttpResponseCacheHandler : public THandler
+{
+public:
+    using super = THandler;
+
+protected:
+    //命中缓存时直接回复(不调用do_message, 不编码); 否则处理请求, 自动回复且设置了response_.cache_ttl_ms_时写入缓存
+    int handle_request()
+    {
+        HttpContext &context = super::context_;
+        HttpDecoderConfig *config = static_cast<HttpDecoderConfig *>(super::source_->message_decoder_config());
+        HttpResponseCacheConfig *cache_config = config->response_cache_;
+        std::string &cache_key = HttpResponseCache::key_buffer();
+        bool cacheable = (nullptr != cache_config) && HttpResponseCache::make_key(context.request_, *cache_config, cache_key);
+        if (cacheable) {
+            SharedBuffer *cached = HttpResponseCache::instance().find(cache_key, Time::instance().current_timestamp_ms());
+            if (nullptr != cached) {
+                return send_cached(*cached);
+            }
+        }
+
+        uint64_t sequence = context.response_.sequence_;
+        int ret = super::handle_request();
+        if ((0 == ret) && cacheable && !super::replied(sequence) && (context.response_.cache_ttl_ms_ > 0) &&
+            !context.response_.chunked_ && (context.response_.body_.data_size() <= cache_config->max_entry_size_)) {
+            ret = cache_response(*cache_config, cache_key);
+        }
+        return ret;
+    }
+
+    //自动回复编码后写入回复缓存, 再按命中缓存的方式发送
+    inline int cache_response(const HttpResponseCacheConfig &config, const std::string &key)
+    {
+        HttpContext &context = super::context_;
+        ByteBuffer buffer;
+        buffer.reserve(context.response_.body_.data_size() + 512);
+        super::encode_response(context, buffer, 0xFFFFFFFF);
+        SharedBuffer response;
+        response = buffer;
+        HttpResponseCache::instance().put(key, response,
+            Time::instance().current_timestamp_ms() + context.response_.cache_ttl_ms_, config.max_entries_);
+        return send_cached(response);
+    }
+
+    //decode中发送缓存的回复(完整的回复)
+    //  较小的回复拷贝到批量发送缓存; 较大的先发送已缓存的数据, 再按引用发送SharedBuffer(不拷贝)
+    //  前面有未完成的异步请求时缓存到其后按序发送
+    //  返回值 <0: 发送失败或待回复的请求过多(由调用方关闭连接)
+    inline int send_cached(SharedBuffer &response)
+    {
+        if (!super::pending_responses_.empty()) {
+            HttpDecoderConfig *config = static_cast<HttpDecoderConfig *>(super::source_->message_decoder_config());
+            if (super::pending_responses_.size() >= config->max_pending_responses_) {
+                return -1;
+            }
+            super::pending_responses_.emplace_back();
+            auto &pending = super::pending_responses_.back();
+            BufferPool::instance().acquire(pending.buffer_, response.data_size());
+            pending.buffer_.write(response.data(), response.data_size());
+            pending.ready_ = true;
+            return 0;
+        }
+
+        ++super::next_send_sequence_;
+        ByteBuffer &out = *super::batch_out_;
+        if (response.data_size() < 1024) {
+            out.write(response.data(), response.data_size());
+            return 0;
+        }
+        if (super::flush(out) < 0) {
+            return -1;
+        }
+        return (super::message_handler::handle_send_buffers(&response, 1) < 0) ? -1 : 0;
+    }
+};
+
+ZRSOCKET_NAMESPACE_END
+
+#endif
@@ -42,16 +42,46 @@ public:
         return 0;
     }
 
-    int handle_open()
+    //当前回复是否对应HEAD请求(HEAD回复的Content-Length不代表有body)
+    //  连接上按顺序发送请求的调用方(如HttpClientPool)据此正确切分pipelining的回复
+    virtual bool head_request()
+    {
+        return false;
+    }
+
+    //流式body回调: Transfer-Encoding: chunked的body(或HttpDecoderConfig::stream_body_时的所有body)边接收边回调
+    //  data指向接收缓存(回调返回后失效); 缺省拼接到response_.body_, 全部接收后调用do_message
+    //返回值 < 0: 出现异常关闭连接
+    virtual int do_body_chunk(const char *data, uint_t len)
     {
         HttpDecoderConfig *config = static_cast<HttpDecoderConfig *>(super::source_->message_decoder_config());
+        return response_.append_body(data, len, config->max_body_length_);
+    }
+
+    //chunked请求: 先发送chunked_ = true的HttpRequest(只编码header), 再逐个发送chunk, 最后发送结束chunk
+    int send_chunk(const char *data, uint_t len)
+    {
+        if (len > 0) {
+            ByteBuffer &out = chunk_buffer();
+            out.reset();
+            HttpChunkedEncoder::write_chunk(out, data, len);
+            return super::send(out.data(), out.data_size());
+        }
+        return 0;
+    }
+
+    int send_last_chunk()
+    {
+        return super::send("0\r\n\r\n", 5);
+    }
+
+    int handle_open()
+    {
         header_length_ = 0;
         decode_state_ = HttpDecodeState::kVersion;
         line_state_   = HttpLineState::kNormal;
         field1_.clear();
         field2_.clear();
-        field1_.reserve(config->max_uri_length_);
-        field2_.reserve(config->max_uri_length_);
         response_.init();
         response_.event_handler_ = this;
         super::queue1_.clear();
@@ -60,9 +90,16 @@ public:
     }
 
 protected:
+    static ByteBuffer & chunk_buffer()
+    {
+        static thread_local ByteBuffer buffer;
+        return buffer;
+    }
+
     inline int decode_reset()
     {
         int ret = do_message();
+        BufferPool::instance().release(response_.body_);
         if (ret >= 0) {
             if (0 == ret) {
                 response_.reset();
@@ -89,9 +126,11 @@ protected:
         char ch;
         uint_t remain_len;
         uint_t need_len;
+        const char *chunk;
+        uint_t chunk_len;
 
         do {
-            if (decode_state_ != HttpDecodeState::kBody) { //begin: parse header
+            if ((decode_state_ != HttpDecodeState::kBody) && (decode_state_ != HttpDecodeState::kChunked)) { //begin: parse header
                 for (; data < data_end; ++data) {
                     if (++header_length_ >= config->max_header_length_) {
                         return -1;
@@ -179,13 +218,14 @@ protected:
                         switch (line_state_) {
                         case HttpLineState::kNormal:
                             if (ch != '\r') {
-                                field2_.push_back(ch);
+                                if (!field2_.empty() || ((ch != ' ') && (ch != '\t'))) {
+                                    field2_.push_back(ch);
+                                }
                             }
                             else {
-                                response.headers_.emplace(std::move(field1_), std::move(field2_));
+                                response.headers_.emplace(field1_, field2_);
+                                field1_.clear();
                                 line_state_ = HttpLineState::kCR;
-                                field1_.reserve(config->max_uri_length_);
-                                field2_.reserve(config->max_uri_length_);
                             }
                             break;
                         case HttpLineState::kCR:
@@ -212,10 +252,27 @@ protected:
                                     return -1;
                                 }
 
-                                if (response.content_length_ > 0) {
-                                    if (response.content_length_ > config->max_body_length_) {
+                                if (head_request() ||
+                                    (response.status_code_ < HttpStatusCode::k200) ||
+                                    (response.status_code_ == HttpStatusCode::k204) ||
+                                    (response.status_code_ == HttpStatusCode::k304)) {
+                                    //没有body的回复(RFC 7230 3.3.3)
+                                    if (decode_reset() < 0) {
+                                        return -1;
+                                    }
+                                }
+                                else if (response.chunked_) {
+                                    chunked_decoder_.reset();
+                                    decode_state_ = HttpDecodeState::kChunked;
+                                    line_state_   = HttpLineState::kNormal;
+                                    ++data;
+                                    goto PARSE_CHUNKED;
+                                }
+                                else if (response.content_length_ > 0) {
+                                    if (!config->stream_body_ && (response.content_length_ > config->max_body_length_)) {
                                         return -1;
                                     }
+                                    body_remain_  = response.content_length_;
                                     decode_state_ = HttpDecodeState::kBody;
                                     line_state_   = HttpLineState::kNormal;
                                     ++data;
@@ -241,12 +298,48 @@ protected:
 
                 }
             } //end: parse header
+            else if (HttpDecodeState::kChunked == decode_state_) { //begin: parse chunked body
+
+            PARSE_CHUNKED:
+                int result = chunked_decoder_.decode(data, data_end, chunk, chunk_len);
+                if (HttpChunkedDecoder::kData == result) {
+                    if (do_body_chunk(chunk, chunk_len) < 0) {
+                        return -1;
+                    }
+                }
+                else if (HttpChunkedDecoder::kComplete == result) {
+                    response.finish_body();
+                    if (decode_reset() < 0) {
+                        return -1;
+                    }
+                }
+                else if (HttpChunkedDecoder::kNeedMore == result) {
+                    break;
+                }
+                else {
+                    return -1;
+                }
+            } //end: parse chunked body
             else { //begin: parse body
 
             PARSE_BODY:
                 remain_len = static_cast<uint_t>(data_end - data);
                 if (remain_len > 0) {
-                    if (response.body_.empty() && remain_len >= response.content_length_) {
+                    if (config->stream_body_) {
+                        need_len = std::min<uint_t>(remain_len, body_remain_);
+                        if (do_body_chunk(data, need_len) < 0) {
+                            return -1;
+                        }
+                        data += need_len;
+                        body_remain_ -= need_len;
+                        if (0 == body_remain_) {
+                            response.finish_body();
+                            if (decode_reset() < 0) {
+                                return -1;
+                            }
+                        }
+                    }
+                    else if (response.body_.empty() && remain_len >= response.content_length_) {
                         response.body_ptr_ = const_cast<char *>(data);
                         data += response.content_length_;
                         if (decode_reset() < 0) {
@@ -255,6 +348,10 @@ protected:
                     }
                     else {
                         need_len = std::min<uint_t>(remain_len, (response.content_length_ - response.body_.data_size()));
+                        if (nullptr == response.body_.buffer()) {
+                            //body跨多次接收时才从BufferPool分配
+                            BufferPool::instance().acquire(response.body_, response.content_length_);
+                        }
                         response.body_.write(data, need_len);
                         data += need_len;
                         if (response.body_.data_size() == response.content_length_) {
@@ -282,6 +379,8 @@ protected:
     std::string     field1_;
     std::string     field2_;
     HttpResponse    response_;
+    HttpChunkedDecoder chunked_decoder_;
+    uint_t          body_remain_    = 0;    //stream_body_时Content-Length的body剩余长度
 };
 
 ZRSOCKET_NAMESPACE_END
@@ -0,0 +1,494 @@
+﻿// Some compilers (e.g. VC++) benefit significantly from using this. 
+// We've measured 3-4% build speed improvements in apps as a result 
+#pragma once
+
+#ifndef ZRSOCKET_HTTP_ROUTER_H
+#define ZRSOCKET_HTTP_ROUTER_H
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "base_type.h"
+#include "http_headers.h"
+#include "http_common.h"
+
+ZRSOCKET_NAMESPACE_BEGIN
+
+//路径参数(":name"/"*name"), 值为指向请求uri的视图(不拷贝)
+class HttpRouteParams
+{
+public:
+    enum
+    {
+        MAX_PARAMS = 8,
+    };
+
+    struct Param
+    {
+        HttpStringView name_;
+        HttpStringView value_;
+    };
+
+    inline uint_t size() const
+    {
+        return count_;
+    }
+
+    inline const Param & operator[](uint_t index) const
+    {
+        return params_[index];
+    }
+
+    //未找到返回空视图
+    inline HttpStringView get(const char *name, uint_t name_len) const
+    {
+        for (uint_t i = 0; i < count_; ++i) {
+            if (params_[i].name_.equals(name, name_len)) {
+                return params_[i].value_;
+            }
+        }
+        return HttpStringView();
+    }
+
+    inline HttpStringView get(const std::string &name) const
+    {
+        return get(name.data(), static_cast<uint_t>(name.size()));
+    }
+
+    inline void clear()
+    {
+        count_ = 0;
+    }
+
+    inline void push(const std::string &name, const char *value, uint_t value_len)
+    {
+        params_[count_].name_  = HttpStringView(name.data(), static_cast<uint_t>(name.size()));
+        params_[count_].value_ = HttpStringView(value, value_len);
+        ++count_;
+    }
+
+    inline void pop()
+    {
+        --count_;
+    }
+
+private:
+    Param   params_[MAX_PARAMS];
+    uint_t  count_ = 0;
+};
+
+enum class HttpRouteResult
+{
+    kFound = 0,
+    kNotFound,          //路径不存在
+    kMethodNotAllowed,  //路径存在, 但没有注册该method
+};
+
+//HTTP路由
+//  启动时add()注册全部路由后调用一次build(), 之后只读(可在多个event_loop线程中同时使用)
+//  路径模式:
+//      "/hello"                静态路由: 放入完美哈希表, 一次哈希 + 一次比较
+//      "/users/:id"            ":name"匹配一个非空路径段
+//      "/static/*path"         "*name"匹配剩余的全部路径(只能在末尾)
+//  含参数的路由放入基数树(radix tree), 匹配优先级: 静态 > 参数 > 通配
+//  method过滤为HttpMethodId下标的数组, 分发为直接的函数调用, 匹配过程不分配内存
+//  uri的query部分('?'之后)不参与匹配
+template <class THandler>
+class HttpRouter
+{
+public:
+    //路由处理函数: 返回值同do_message
+    typedef int (*RouteProc)(THandler &handler, HttpContext &context, const HttpRouteParams &params);
+
+    HttpRouter() = default;
+    ~HttpRouter() = default;
+
+    HttpRouter(const HttpRouter &) = delete;
+    HttpRouter & operator=(const HttpRouter &) = delete;
+
+    //注册路由, 返回值 <0: 模式非法(不以'/'开头/参数名为空/'*'不在末尾/参数过多)或与已有路由冲突
+    int add(HttpMethodId method, const std::string &pattern, RouteProc proc)
+    {
+        int method_index = static_cast<int>(method);
+        if ((method_index <= 0) || (method_index >= METHOD_COUNT) || (nullptr == proc) ||
+            pattern.empty() || ('/' != pattern[0])) {
+            return -1;
+        }
+
+        int route_index;
+        if (pattern.find_first_of(":*") == std::string::npos) {
+            route_index = find_static_route(pattern.data(), pattern.size());
+            if (route_index < 0) {
+                route_index = new_route(pattern, true);
+            }
+            built_ = false;
+        }
+        else {
+            Node *node = insert_pattern(pattern);
+            if (nullptr == node) {
+                return -1;
+            }
+            if (node->route_ < 0) {
+                node->route_ = new_route(pattern, false);
+            }
+            route_index = node->route_;
+        }
+
+        Route &route = routes_[route_index];
+        if (nullptr != route.procs_[method_index]) {
+            return -1;
+        }
+        route.procs_[method_index] = proc;
+        return 0;
+    }
+
+    //为静态路由生成完美哈希表: 选取使所有静态路由互不冲突的种子(必要时加大表)
+    int build()
+    {
+        std::vector<int> static_routes;
+        for (int i = 0; i < static_cast<int>(routes_.size()); ++i) {
+            if (routes_[i].static_) {
+                static_routes.emplace_back(i);
+            }
+        }
+
+        uint_t table_size = 1;
+        while (table_size < static_routes.size() * 2) {
+            table_size <<= 1;
+        }
+        for (;;) {
+            for (uint64_t seed = 1; seed <= MAX_SEED_TRIES; ++seed) {
+                table_.assign(table_size, -1);
+                bool ok = true;
+                for (int index : static_routes) {
+                    const std::string &pattern = routes_[index].pattern_;
+                    int &slot = table_[hash(pattern.data(), pattern.size(), seed) & (table_size - 1)];
+                    if (slot >= 0) {
+                        ok = false;
+                        break;
+                    }
+                    slot = index;
+                }
+                if (ok) {
+                    seed_  = seed;
+                    built_ = true;
+                    return 0;
+                }
+            }
+            table_size <<= 1;
+        }
+    }
+
+    //查找路由: 返回nullptr时result为kNotFound或kMethodNotAllowed
+    //  HEAD没有单独注册时使用GET的处理函数
+    RouteProc find(HttpMethodId method, const char *uri, uint_t uri_len, HttpRouteParams &params, HttpRouteResult &result) const
+    {
+        const char *end = static_cast<const char *>(std::memchr(uri, '?', uri_len));
+        if (nullptr == end) {
+            end = uri + uri_len;
+        }
+        int method_index = static_cast<int>(method);
+        if ((method_index < 0) || (method_index >= METHOD_COUNT)) {
+            method_index = 0;
+        }
+
+        params.clear();
+        result = HttpRouteResult::kNotFound;
+        size_t len = static_cast<size_t>(end - uri);
+        int index = -1;
+        if (built_) {
+            if (!table_.empty()) {
+                index = table_[hash(uri, len, seed_) & (table_.size() - 1)];
+            }
+        }
+        else {
+            //未调用build(): 逐个比较
+            index = find_static_route(uri, len);
+        }
+        if (index >= 0) {
+            const std::string &pattern = routes_[index].pattern_;
+            if ((pattern.size() == len) && (std::memcmp(pattern.data(), uri, len) == 0)) {
+                RouteProc proc = route_proc(routes_[index], method_index);
+                if (nullptr != proc) {
+                    result = HttpRouteResult::kFound;
+                    return proc;
+                }
+                result = HttpRouteResult::kMethodNotAllowed;
+            }
+        }
+
+        index = match(&root_, uri, end, params);
+        if (index >= 0) {
+            RouteProc proc = route_proc(routes_[index], method_index);
+            if (nullptr != proc) {
+                result = HttpRouteResult::kFound;
+                return proc;
+            }
+            result = HttpRouteResult::kMethodNotAllowed;
+        }
+        params.clear();
+        return nullptr;
+    }
+
+    //分发请求: 未找到时设置404/405(含Allow)后返回0(自动回复)
+    int dispatch(THandler &handler, HttpContext &context) const
+    {
+        HttpRequest &request = context.request_;
+        HttpRouteParams params;
+        HttpRouteResult result;
+        RouteProc proc = find(request.method_id_, request.uri_.data(), static_cast<uint_t>(request.uri_.size()), params, result);
+        if (nullptr != proc) {
+            return proc(handler, context, params);
+        }
+
+        if (HttpRouteResult::kMethodNotAllowed == result) {
+            context.response_.status_code_ = HttpStatusCode::k405;
+            std::string allow;
+            allowed_methods(request.uri_.data(), static_cast<uint_t>(request.uri_.size()), allow);
+            context.response_.headers_.emplace("Allow", allow);
+        }
+        else {
+            context.response_.status_code_ = HttpStatusCode::k404;
+        }
+        return 0;
+    }
+
+    inline size_t route_size() const
+    {
+        return routes_.size();
+    }
+
+private:
+    enum
+    {
+        METHOD_COUNT    = static_cast<int>(HttpMethodId::kCONNECT) + 1,
+        MAX_SEED_TRIES  = 64,
+    };
+
+    struct Route
+    {
+        std::string pattern_;
+        bool        static_ = false;
+        RouteProc   procs_[METHOD_COUNT] = {};
+    };
+
+    //基数树节点: prefix_为静态文本; 参数/通配节点的prefix_为空, param_name_为参数名
+    struct Node
+    {
+        std::string prefix_;
+        std::string indices_;           //各静态子节点prefix_的首字符
+        std::vector<Node *> children_;
+        Node       *param_    = nullptr;
+        Node       *wildcard_ = nullptr;
+        std::string param_name_;
+        int         route_    = -1;
+    };
+
+    static inline RouteProc route_proc(const Route &route, int method_index)
+    {
+        RouteProc proc = route.procs_[method_index];
+        if ((nullptr == proc) && (static_cast<int>(HttpMethodId::kHEAD) == method_index)) {
+            proc = route.procs_[static_cast<int>(HttpMethodId::kGET)];
+        }
+        return proc;
+    }
+
+    static inline uint64_t hash(const char *data, size_t len, uint64_t seed)
+    {
+        uint64_t h = 14695981039346656037ULL ^ (seed * 0x9E3779B97F4A7C15ULL);
+        for (size_t i = 0; i < len; ++i) {
+            h ^= static_cast<unsigned char>(data[i]);
+            h *= 1099511628211ULL;
+        }
+        return h ^ (h >> 32);
+    }
+
+    int new_route(const std::string &pattern, bool is_static)
+    {
+        routes_.emplace_back();
+        routes_.back().pattern_ = pattern;
+        routes_.back().static_  = is_static;
+        return static_cast<int>(routes_.size() - 1);
+    }
+
+    int find_static_route(const char *path, size_t len) const
+    {
+        for (int i = 0; i < static_cast<int>(routes_.size()); ++i) {
+            const std::string &pattern = routes_[i].pattern_;
+            if (routes_[i].static_ && (pattern.size() == len) && (std::memcmp(pattern.data(), path, len) == 0)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    Node * new_node()
+    {
+        nodes_.emplace_back(new Node());
+        return nodes_.back().get();
+    }
+
+    //在node之后插入静态文本, 返回文本结束处的节点
+    Node * insert_static(Node *node, const char *text, size_t len)
+    {
+        while (len > 0) {
+            size_t pos = node->indices_.find(text[0]);
+            if (std::string::npos == pos) {
+                Node *child = new_node();
+                child->prefix_.assign(text, len);
+                node->indices_.push_back(text[0]);
+                node->children_.emplace_back(child);
+                return child;
+            }
+
+            Node *child = node->children_[pos];
+            size_t common = 0;
+            size_t max_common = std::min(len, child->prefix_.size());
+            while ((common < max_common) && (child->prefix_[common] == text[common])) {
+                ++common;
+            }
+            if (common < child->prefix_.size()) {
+                //分裂子节点: 公共前缀成为新的中间节点
+                Node *middle = new_node();
+                middle->prefix_.assign(child->prefix_, 0, common);
+                child->prefix_.erase(0, common);
+                middle->indices_.push_back(child->prefix_[0]);
+                middle->children_.emplace_back(child);
+                node->children_[pos] = middle;
+                child = middle;
+            }
+            node  = child;
+            text += common;
+            len  -= common;
+        }
+        return node;
+    }
+
+    Node * insert_pattern(const std::string &pattern)
+    {
+        Node *node = &root_;
+        uint_t param_count = 0;
+        size_t pos = 0;
+        while (pos < pattern.size()) {
+            size_t special = pattern.find_first_of(":*", pos);
+            if (std::string::npos == special) {
+                special = pattern.size();
+            }
+            node = insert_static(node, pattern.data() + pos, special - pos);
+            if (special == pattern.size()) {
+                break;
+            }
+
+            //参数只能位于路径段开头
+            if ('/' != pattern[special - 1]) {
+                return nullptr;
+            }
+            size_t name_end = pattern.find('/', special);
+            if (std::string::npos == name_end) {
+                name_end = pattern.size();
+            }
+            if ((name_end == special + 1) || (++param_count > HttpRouteParams::MAX_PARAMS)) {
+                return nullptr;
+            }
+            std::string name(pattern, special + 1, name_end - special - 1);
+            if (name.find_first_of(":*") != std::string::npos) {
+                return nullptr;
+            }
+
+            Node *&child = (':' == pattern[special]) ? node->param_ : node->wildcard_;
+            if ('*' == pattern[special]) {
+                if (name_end != pattern.size()) {
+                    return nullptr;
+                }
+            }
+            if (nullptr == child) {
+                child = new_node();
+                child->param_name_ = name;
+            }
+            else if (child->param_name_ != name) {
+                //同一位置的参数名必须相同
+                return nullptr;
+            }
+            node = child;
+            pos  = name_end;
+        }
+        return node;
+    }
+
+    //node的prefix_已匹配, 从p开始匹配其子节点, 返回路由下标(未找到返回-1)
+    int match(const Node *node, const char *p, const char *end, HttpRouteParams &params) const
+    {
+        if ((p == end) && (node->route_ >= 0)) {
+            return node->route_;
+        }
+
+        if (p < end) {
+            const char *pos = static_cast<const char *>(std::memchr(node->indices_.data(), *p, node->indices_.size()));
+            if (nullptr != pos) {
+                const Node *child = node->children_[pos - node->indices_.data()];
+                size_t prefix_len = child->prefix_.size();
+                if ((static_cast<size_t>(end - p) >= prefix_len) && (std::memcmp(child->prefix_.data(), p, prefix_len) == 0)) {
+                    int index = match(child, p + prefix_len, end, params);
+                    if (index >= 0) {
+                        return index;
+                    }
+                }
+            }
+
+            if ((nullptr != node->param_) && ('/' != *p)) {
+                const char *segment_end = static_cast<const char *>(std::memchr(p, '/', end - p));
+                if (nullptr == segment_end) {
+                    segment_end = end;
+                }
+                params.push(node->param_->param_name_, p, static_cast<uint_t>(segment_end - p));
+                int index = match(node->param_, segment_end, end, params);
+                if (index >= 0) {
+                    return index;
+                }
+                params.pop();
+            }
+        }
+
+        if ((nullptr != node->wildcard_) && (node->wildcard_->route_ >= 0)) {
+            params.push(node->wildcard_->param_name_, p, static_cast<uint_t>(end - p));
+            return node->wildcard_->route_;
+        }
+        return -1;
+    }
+
+    //405回复的Allow
+    void allowed_methods(const char *uri, uint_t uri_len, std::string &allow) const
+    {
+        static const char *method_names[METHOD_COUNT] = {
+            "", "OPTIONS", "GET", "HEAD", "POST", "PUT", "DELETE", "TRACE", "CONNECT"
+        };
+
+        bool allowed[METHOD_COUNT] = {};
+        HttpRouteParams params;
+        HttpRouteResult result;
+        for (int i = 1; i < METHOD_COUNT; ++i) {
+            allowed[i] = (nullptr != find(static_cast<HttpMethodId>(i), uri, uri_len, params, result));
+        }
+        for (int i = 1; i < METHOD_COUNT; ++i) {
+            if (allowed[i]) {
+                if (!allow.empty()) {
+                    allow.append(", ");
+                }
+                allow.append(method_names[i]);
+            }
+        }
+    }
+
+private:
+    Node                    root_;
+    std::vector<std::unique_ptr<Node>> nodes_;
+    std::vector<Route>      routes_;
+    std::vector<int>        table_;             //静态路由的完美哈希表(路由下标, -1为空)
+    uint64_t                seed_  = 0;
+    bool                    built_ = false;
+};
+
+ZRSOCKET_NAMESPACE_END
+
+#endif
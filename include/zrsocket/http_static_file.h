@@ -0,0 +1,778 @@
+﻿// Some compilers (e.g. VC++) benefit significantly from using this. 
+// We've measured 3-4% build speed improvements in apps as a result 
+#pragma once
+
+#ifndef ZRSOCKET_HTTP_STATIC_FILE_H
+#define ZRSOCKET_HTTP_STATIC_FILE_H
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "config.h"
+#include "base_type.h"
+#include "os_api_file.h"
+#include "time.h"
+#include "http_headers.h"
+#include "http_common.h"
+#include "http_request_handler.h"
+
+ZRSOCKET_NAMESPACE_BEGIN
+
+struct HttpStaticFileConfig
+{
+    std::string document_root_;                     //文档根目录
+    std::string index_file_ = "index.html";         //uri以'/'结尾时的缺省文件
+    uint_t      max_cache_files_ = 1024;            //每个线程缓存的最大文件数(保持打开的fd), 0: 不缓存
+    uint64_t    revalidate_ms_   = 1000;            //缓存的文件超过此时间后重新stat检查是否变化
+    uint_t      memory_cache_file_size_ = 0;        //不超过此长度的文件内容缓存在内存中, 0: 不缓存内容
+    bool        follow_symlinks_ = false;           //false: 拒绝经符号链接指向document_root_之外的文件
+};
+
+struct HttpFileEntry;
+
+//静态文件请求的解析辅助函数
+class HttpStaticFile
+{
+public:
+    //按扩展名取Content-Type(不区分大小写), 未知类型为application/octet-stream
+    static const char * content_type(const std::string &path)
+    {
+        struct MimeType
+        {
+            const char *ext_;
+            const char *type_;
+        };
+        static const MimeType mime_types[] = {
+            { "html",  "text/html; charset=utf-8" },
+            { "htm",   "text/html; charset=utf-8" },
+            { "css",   "text/css; charset=utf-8" },
+            { "js",    "application/javascript; charset=utf-8" },
+            { "mjs",   "application/javascript; charset=utf-8" },
+            { "json",  "application/json; charset=utf-8" },
+            { "txt",   "text/plain; charset=utf-8" },
+            { "xml",   "text/xml; charset=utf-8" },
+            { "csv",   "text/csv; charset=utf-8" },
+            { "png",   "image/png" },
+            { "jpg",   "image/jpeg" },
+            { "jpeg",  "image/jpeg" },
+            { "gif",   "image/gif" },
+            { "svg",   "image/svg+xml" },
+            { "ico",   "image/x-icon" },
+            { "webp",  "image/webp" },
+            { "avif",  "image/avif" },
+            { "woff",  "font/woff" },
+            { "woff2", "font/woff2" },
+            { "ttf",   "font/ttf" },
+            { "wasm",  "application/wasm" },
+            { "pdf",   "application/pdf" },
+            { "zip",   "application/zip" },
+            { "gz",    "application/gzip" },
+            { "mp4",   "video/mp4" },
+            { "webm",  "video/webm" },
+            { "mp3",   "audio/mpeg" },
+        };
+
+        size_t dot = path.find_last_of("./");
+        if ((std::string::npos != dot) && ('.' == path[dot])) {
+            const char *ext = path.data() + dot + 1;
+            uint_t ext_len  = static_cast<uint_t>(path.size() - dot - 1);
+            for (auto &mime : mime_types) {
+                if ((std::strlen(mime.ext_) == ext_len) && HttpStringView::equals_ignore_case(ext, mime.ext_, ext_len)) {
+                    return mime.type_;
+                }
+            }
+        }
+        return "application/octet-stream";
+    }
+
+    //uri映射为document_root_下的文件路径
+    //  去掉query/fragment, 解码%xx, 以'/'结尾时加上index_file_
+    //  返回false: 非法路径(不以'/'开头/含'\\'或NUL/含"."或".."路径段)
+    //  只检查uri本身, 符号链接由HttpFileCache打开文件时检查(HttpStaticFileConfig::follow_symlinks_)
+    static bool resolve_path(const char *uri, uint_t uri_len, const HttpStaticFileConfig &config, std::string &path)
+    {
+        const char *end = uri + uri_len;
+        const char *query = static_cast<const char *>(std::memchr(uri, '?', uri_len));
+        if (nullptr != query) {
+            end = query;
+        }
+        const char *fragment = static_cast<const char *>(std::memchr(uri, '#', end - uri));
+        if (nullptr != fragment) {
+            end = fragment;
+        }
+        if ((uri == end) || ('/' != *uri)) {
+            return false;
+        }
+
+        path.assign(config.document_root_);
+        while (!path.empty() && ('/' == path.back())) {
+            path.pop_back();
+        }
+        size_t segment = path.size() + 1;
+        for (const char *p = uri; p < end; ++p) {
+            char ch = *p;
+            if ('%' == ch) {
+                int high, low;
+                if ((end - p < 3) || ((high = hex_value(p[1])) < 0) || ((low = hex_value(p[2])) < 0)) {
+                    return false;
+                }
+                ch = static_cast<char>((high << 4) | low);
+                p += 2;
+            }
+            if (('\0' == ch) || ('\\' == ch)) {
+                return false;
+            }
+            if ('/' == ch) {
+                if (dot_segment(path, segment)) {
+                    return false;
+                }
+                segment = path.size() + 1;
+            }
+            path.push_back(ch);
+        }
+        if (dot_segment(path, segment)) {
+            return false;
+        }
+        if ('/' == path.back()) {
+            path.append(config.index_file_);
+        }
+        return true;
+    }
+
+    //解析Range(只支持单个范围: "bytes=a-b", "bytes=a-", "bytes=-n")
+    //  返回值: 1 有效范围; 0 忽略Range(回复整个文件); -1 范围无法满足(416)
+    static int parse_range(HttpStringView range, uint64_t size, uint64_t &offset, uint64_t &length)
+    {
+        const char *p   = range.data_;
+        const char *end = p + range.len_;
+        if ((range.len_ < 6) || !HttpStringView::equals_ignore_case(p, "bytes=", 6)) {
+            return 0;
+        }
+        p += 6;
+        if (nullptr != std::memchr(p, ',', end - p)) {
+            //多个范围: 回复整个文件
+            return 0;
+        }
+
+        uint64_t first = 0, last = 0;
+        bool has_first = parse_number(p, end, first);
+        if ((p == end) || ('-' != *p++)) {
+            return 0;
+        }
+        bool has_last = parse_number(p, end, last);
+        if (p != end) {
+            return 0;
+        }
+
+        if (!has_first) {
+            //后缀范围: 最后last字节
+            if (!has_last) {
+                return 0;
+            }
+            if ((0 == last) || (0 == size)) {
+                return -1;
+            }
+            length = (last < size) ? last : size;
+            offset = size - length;
+            return 1;
+        }
+        if (first >= size) {
+            return -1;
+        }
+        if (!has_last || (last >= size)) {
+            last = size - 1;
+        }
+        else if (last < first) {
+            return 0;
+        }
+        offset = first;
+        length = last - first + 1;
+        return 1;
+    }
+
+    //If-None-Match是否与etag匹配(弱比较, "*"匹配任意etag)
+    static bool etag_match(HttpStringView value, const std::string &etag)
+    {
+        const char *p   = value.data_;
+        const char *end = p + value.len_;
+        while (p < end) {
+            while ((p < end) && ((' ' == *p) || ('\t' == *p) || (',' == *p))) {
+                ++p;
+            }
+            const char *tag = p;
+            while ((p < end) && (',' != *p)) {
+                ++p;
+            }
+            const char *tag_end = p;
+            while ((tag_end > tag) && ((' ' == tag_end[-1]) || ('\t' == tag_end[-1]))) {
+                --tag_end;
+            }
+            if ((tag_end - tag > 2) && ('W' == tag[0]) && ('/' == tag[1])) {
+                tag += 2;
+            }
+            size_t tag_len = static_cast<size_t>(tag_end - tag);
+            if (((1 == tag_len) && ('*' == *tag)) ||
+                ((tag_len == etag.size()) && (std::memcmp(tag, etag.data(), tag_len) == 0))) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //send_file的请求检查: 映射文件, 处理条件请求与Range(HttpStaticFileHandler与Http2RequestHandler共用)
+    //返回值
+    //== 0: entry为已获取的文件(调用方负责HttpFileCache::release), status_code/offset/length为回复的状态码与范围
+    //== 1: 不回复文件, response_已设置状态码(404/405/304/416等)
+    static int open_file(HttpContext &context, const HttpStaticFileConfig &config, HttpFileEntry *&entry,
+        HttpStatusCode &status_code, uint64_t &offset, uint64_t &length);
+
+private:
+    static inline int hex_value(char ch)
+    {
+        if ((ch >= '0') && (ch <= '9')) {
+            return ch - '0';
+        }
+        ch |= 0x20;
+        if ((ch >= 'a') && (ch <= 'f')) {
+            return ch - 'a' + 10;
+        }
+        return -1;
+    }
+
+    //path中从segment开始的最后一个路径段是否为"."或".."
+    static inline bool dot_segment(const std::string &path, size_t segment)
+    {
+        if (segment > path.size()) {
+            return false;
+        }
+        size_t len = path.size() - segment;
+        return ((1 == len) && ('.' == path[segment])) ||
+               ((2 == len) && ('.' == path[segment]) && ('.' == path[segment + 1]));
+    }
+
+    static inline bool parse_number(const char *&p, const char *end, uint64_t &value)
+    {
+        while ((p < end) && (' ' == *p)) {
+            ++p;
+        }
+        const char *begin = p;
+        value = 0;
+        while ((p < end) && (*p >= '0') && (*p <= '9')) {
+            if (p - begin >= 18) {
+                return false;
+            }
+            value = value * 10 + static_cast<uint64_t>(*p++ - '0');
+        }
+        bool has_value = (p > begin);
+        while ((p < end) && (' ' == *p)) {
+            ++p;
+        }
+        return has_value;
+    }
+};
+
+//缓存的文件: 打开的fd/文件属性/预先生成的回复header
+struct HttpFileEntry
+{
+    std::string key_;                   //缓存键(HttpFileCache::make_key)
+    std::string path_;
+    int         fd_ = -1;               //内容缓存在内存中时为-1
+    OSFileInfo  info_;
+    std::string etag_;                  //"<mtime>-<size>"(含引号)
+    std::string last_modified_;
+    std::string headers_;               //Content-Type/Last-Modified/ETag/Accept-Ranges
+    std::string full_headers_;          //headers_ + 整个文件的Content-Length + 空行
+    std::string content_;               //内存缓存的文件内容
+    bool        memory_   = false;      //内容是否缓存在内存中
+    bool        cached_   = false;      //是否在缓存表中
+    uint_t      refs_     = 0;          //引用计数(发送中的回复)
+    uint64_t    check_ms_ = 0;          //最后一次检查文件属性的时间
+    std::list<HttpFileEntry *>::iterator lru_iter_;
+};
+
+//线程内的打开文件缓存(LRU)
+//  同一文件的请求共用一个fd, 超过revalidate_ms_后重新stat, 文件变化时丢弃旧的缓存
+//  被引用的缓存项淘汰后延迟到最后一次release时关闭, acquire/release须在同一线程中调用
+//  缓存键包含影响加载结果的配置: 不同HttpStaticFileConfig访问同一文件时分别缓存
+class HttpFileCache
+{
+public:
+    static HttpFileCache & instance()
+    {
+        static thread_local HttpFileCache cache;
+        return cache;
+    }
+
+    HttpFileCache() = default;
+
+    ~HttpFileCache()
+    {
+        clear();
+    }
+
+    //返回nullptr: 文件不存在/不是普通文件/打开失败
+    HttpFileEntry * acquire(const std::string &path, const HttpStaticFileConfig &config)
+    {
+        uint64_t now_ms = Time::instance().current_timestamp_ms();
+        const std::string &key = make_key(path, config);
+        auto iter = entries_.find(key);
+        if (iter != entries_.end()) {
+            HttpFileEntry *entry = iter->second;
+            if (now_ms - entry->check_ms_ >= config.revalidate_ms_) {
+                OSFileInfo info;
+                if ((OSApiFile::os_stat(path.c_str(), info) != 0) ||
+                    !info.regular_ ||
+                    (info.size_ != entry->info_.size_) ||
+                    (info.mtime_ != entry->info_.mtime_)) {
+                    remove(entry);
+                    entry = nullptr;
+                }
+                else {
+                    entry->check_ms_ = now_ms;
+                }
+            }
+            if (nullptr != entry) {
+                lru_.splice(lru_.begin(), lru_, entry->lru_iter_);
+                ++entry->refs_;
+                return entry;
+            }
+        }
+
+        HttpFileEntry *entry = load(path, config, now_ms);
+        if (nullptr == entry) {
+            return nullptr;
+        }
+        entry->refs_ = 1;
+        entry->key_  = key;
+        if (config.max_cache_files_ > 0) {
+            while (entries_.size() >= config.max_cache_files_) {
+                remove(lru_.back());
+            }
+            entry->lru_iter_ = lru_.insert(lru_.begin(), entry);
+            entry->cached_   = true;
+            entries_.emplace(entry->key_, entry);
+        }
+        return entry;
+    }
+
+    inline void release(HttpFileEntry *entry)
+    {
+        if ((--entry->refs_ == 0) && !entry->cached_) {
+            destroy(entry);
+        }
+    }
+
+    void clear()
+    {
+        while (!lru_.empty()) {
+            remove(lru_.back());
+        }
+    }
+
+    inline size_t size() const
+    {
+        return entries_.size();
+    }
+
+private:
+    void remove(HttpFileEntry *entry)
+    {
+        entries_.erase(entry->key_);
+        lru_.erase(entry->lru_iter_);
+        entry->cached_ = false;
+        if (0 == entry->refs_) {
+            destroy(entry);
+        }
+    }
+
+    //缓存键: path + document_root_ + follow_symlinks_ + memory_cache_file_size_
+    static const std::string & make_key(const std::string &path, const HttpStaticFileConfig &config)
+    {
+        static thread_local std::string key;
+        char buf[32];
+        int len = std::snprintf(buf, sizeof(buf), "%c%c%u", '\0', config.follow_symlinks_ ? '1' : '0',
+            static_cast<unsigned int>(config.memory_cache_file_size_));
+        key.assign(path);
+        key.push_back('\0');
+        key.append(config.document_root_);
+        key.append(buf, len);
+        return key;
+    }
+
+    //path是否位于root之下(均为解析后的绝对路径)
+    static bool inside_root(const std::string &path, const std::string &root)
+    {
+        size_t root_len = root.size();
+        while ((root_len > 0) && (('/' == root[root_len - 1]) || ('\\' == root[root_len - 1]))) {
+            --root_len;
+        }
+        return (path.size() > root_len + 1) &&
+            (path.compare(0, root_len, root, 0, root_len) == 0) &&
+            (('/' == path[root_len]) || ('\\' == path[root_len]));
+    }
+
+    static void destroy(HttpFileEntry *entry)
+    {
+        if (entry->fd_ >= 0) {
+            OSApiFile::os_close(entry->fd_);
+        }
+        delete entry;
+    }
+
+    //不跟随符号链接时打开解析后的路径(须位于document_root_之下), 且最后一个路径段不能是符号链接(O_NOFOLLOW)
+    //  解析与打开之间中间目录被替换为符号链接的情况不检查(需要document_root_的写权限)
+    static HttpFileEntry * load(const std::string &path, const HttpStaticFileConfig &config, uint64_t now_ms)
+    {
+        const char *open_path = path.c_str();
+        std::string real_path;
+        if (!config.follow_symlinks_) {
+            std::string real_root;
+            if ((OSApiFile::os_realpath(path.c_str(), real_path) != 0) ||
+                (OSApiFile::os_realpath(config.document_root_.c_str(), real_root) != 0) ||
+                !inside_root(real_path, real_root)) {
+                return nullptr;
+            }
+            open_path = real_path.c_str();
+        }
+#ifdef ZRSOCKET_OS_WINDOWS
+        int fd = OSApiFile::os_open(open_path, O_RDONLY | O_BINARY, 0);
+#else
+        int fd = OSApiFile::os_open(open_path, O_RDONLY | O_CLOEXEC | (config.follow_symlinks_ ? 0 : O_NOFOLLOW), 0);
+#endif
+        if (fd < 0) {
+            return nullptr;
+        }
+        OSFileInfo info;
+        if ((OSApiFile::os_fstat(fd, info) != 0) || !info.regular_) {
+            OSApiFile::os_close(fd);
+            return nullptr;
+        }
+
+        HttpFileEntry *entry = new HttpFileEntry();
+        entry->path_     = path;
+        entry->fd_       = fd;
+        entry->info_     = info;
+        entry->check_ms_ = now_ms;
+
+        char buf[64];
+        int len = std::snprintf(buf, sizeof(buf), "\"%llx-%llx\"",
+            static_cast<unsigned long long>(info.mtime_), static_cast<unsigned long long>(info.size_));
+        entry->etag_.assign(buf, len);
+        uint_t date_len = HttpDateHeader::format_date(static_cast<uint64_t>(info.mtime_), buf, sizeof(buf));
+        entry->last_modified_.assign(buf, date_len);
+
+        std::string &headers = entry->headers_;
+        headers.reserve(160);
+        headers.append("Content-Type: ");
+        headers.append(HttpStaticFile::content_type(path));
+        headers.append("\r\nLast-Modified: ");
+        headers.append(entry->last_modified_);
+        headers.append("\r\nETag: ");
+        headers.append(entry->etag_);
+        headers.append("\r\nAccept-Ranges: bytes\r\n");
+        len = std::snprintf(buf, sizeof(buf), "Content-Length: %llu\r\n\r\n", static_cast<unsigned long long>(info.size_));
+        entry->full_headers_.reserve(headers.size() + len);
+        entry->full_headers_.append(headers);
+        entry->full_headers_.append(buf, len);
+
+        if (info.size_ <= config.memory_cache_file_size_) {
+            entry->content_.resize(static_cast<size_t>(info.size_));
+            uint64_t offset = 0;
+            while (offset < info.size_) {
+                int read_bytes = OSApiFile::os_pread(fd, &entry->content_[static_cast<size_t>(offset)],
+                    static_cast<uint_t>(info.size_ - offset), static_cast<int64_t>(offset));
+                if (read_bytes <= 0) {
+                    destroy(entry);
+                    return nullptr;
+                }
+                offset += read_bytes;
+            }
+            entry->memory_ = true;
+            entry->fd_     = -1;
+            OSApiFile::os_close(fd);
+        }
+        return entry;
+    }
+
+private:
+    std::unordered_map<std::string, HttpFileEntry *> entries_;
+    std::list<HttpFileEntry *> lru_;    //表头为最近使用
+};
+
+//HttpStaticFile::open_file: 使用HttpFileCache, 在其之后定义
+inline int HttpStaticFile::open_file(HttpContext &context, const HttpStaticFileConfig &config, HttpFileEntry *&entry,
+    HttpStatusCode &status_code, uint64_t &offset, uint64_t &length)
+{
+    HttpRequest  &request  = context.request_;
+    HttpResponse &response = context.response_;
+    bool head = (request.method_id_ == HttpMethodId::kHEAD);
+    if (!head && (request.method_id_ != HttpMethodId::kGET)) {
+        response.status_code_ = HttpStatusCode::k405;
+        response.headers_.emplace("Allow", "GET, HEAD");
+        return 1;
+    }
+
+    static thread_local std::string path;
+    entry = nullptr;
+    if (HttpStaticFile::resolve_path(request.uri_.data(), static_cast<uint_t>(request.uri_.size()), config, path)) {
+        entry = HttpFileCache::instance().acquire(path, config);
+    }
+    if (nullptr == entry) {
+        response.status_code_ = HttpStatusCode::k404;
+        return 1;
+    }
+
+    //条件请求
+    HttpStringView if_none_match = request.header("If-None-Match", sizeof("If-None-Match") - 1);
+    HttpStringView if_modified_since = request.header("If-Modified-Since", sizeof("If-Modified-Since") - 1);
+    if ((!if_none_match.empty() && HttpStaticFile::etag_match(if_none_match, entry->etag_)) ||
+        (if_none_match.empty() && if_modified_since.equals(entry->last_modified_.data(), static_cast<uint_t>(entry->last_modified_.size())))) {
+        response.status_code_ = HttpStatusCode::k304;
+        response.headers_.emplace("ETag", entry->etag_);
+        HttpFileCache::instance().release(entry);
+        return 1;
+    }
+
+    uint64_t file_size = entry->info_.size_;
+    offset      = 0;
+    length      = file_size;
+    status_code = HttpStatusCode::k200;
+    HttpStringView range = request.header("Range", sizeof("Range") - 1);
+    if (!range.empty()) {
+        HttpStringView if_range = request.header("If-Range", sizeof("If-Range") - 1);
+        if (if_range.empty() ||
+            if_range.equals(entry->etag_.data(), static_cast<uint_t>(entry->etag_.size())) ||
+            if_range.equals(entry->last_modified_.data(), static_cast<uint_t>(entry->last_modified_.size()))) {
+            int ret = HttpStaticFile::parse_range(range, file_size, offset, length);
+            if (ret < 0) {
+                char content_range[48];
+                std::snprintf(content_range, sizeof(content_range), "bytes */%llu", static_cast<unsigned long long>(file_size));
+                response.status_code_ = HttpStatusCode::k416;
+                response.headers_.emplace("Content-Range", content_range);
+                HttpFileCache::instance().release(entry);
+                return 1;
+            }
+            if (ret > 0) {
+                status_code = HttpStatusCode::k206;
+            }
+        }
+    }
+    return 0;
+}
+
+//静态文件回复分层(HTTP/1.x): 在THandler(HttpRequestHandler或其派生类)之上增加send_file
+//  文件内容作为回复的延迟body(PendingResponse::deferred_), 在header发送完后由sendfile发送
+//  例: class MyHandler : public HttpStaticFileHandler<HttpRequestHandler<ByteBuffer, NullMutex> >
+template <class THandler>
+class HttpStaticFileHandler : public THandler
+{
+public:
+    using super = THandler;
+
+    //静态文件回复: 将request_.uri_映射为config.document_root_下的文件并回复, 须在所属event_loop线程中调用
+    //  支持GET/HEAD, If-None-Match/If-Modified-Since(304), 单个Range(206/416)及If-Range
+    //  文件内容不经过用户态缓存, 由sendfile发送(linux); 不超过memory_cache_file_size_的文件从内存缓存发送
+    //  与send_response一样按请求顺序发送, 可在do_message中调用, 也可在do_message返回>0后异步调用
+    //  返回值
+    //  == 0: 已回复
+    //  == 1: 未回复, response_已设置状态码(404/405/304/416等), 由调用方回复(do_message中直接返回0即自动回复)
+    //  <  0: 序号无效(连接已重置/重复回复)
+    virtual int send_file(HttpContext &context, const HttpStaticFileConfig &config)
+    {
+        HttpFileEntry *entry;
+        HttpStatusCode status_code;
+        uint64_t offset;
+        uint64_t length;
+        if (HttpStaticFile::open_file(context, config, entry, status_code, offset, length) > 0) {
+            return 1;
+        }
+        HttpResponse &response = context.response_;
+        bool head = (context.request_.method_id_ == HttpMethodId::kHEAD);
+
+        //回复位置(同send_chunked_begin)
+        uint64_t sequence = response.sequence_;
+        size_t index = static_cast<size_t>(sequence - super::next_send_sequence_);
+        bool valid = (sequence >= super::next_send_sequence_) && (index <= super::pending_responses_.size());
+        if (valid && (index == super::pending_responses_.size())) {
+            HttpDecoderConfig *decoder_config = static_cast<HttpDecoderConfig *>(super::source_->message_decoder_config());
+            valid = (sequence + 1 == super::next_request_sequence_) && (super::pending_responses_.size() < decoder_config->max_pending_responses_);
+        }
+        else if (valid && (super::pending_responses_[index].ready_ || super::pending_responses_[index].streaming_)) {
+            valid = false;
+        }
+        if (!valid) {
+            HttpFileCache::instance().release(entry);
+            return -1;
+        }
+
+        bool file_body = !head && (length > 0) && !entry->memory_;
+        if (index == super::pending_responses_.size()) {
+            if ((index > 0) || file_body) {
+                super::pending_responses_.emplace_back();
+            }
+        }
+
+        ByteBuffer *out;
+        if (0 == index) {
+            out = &super::stream_out();
+        }
+        else {
+            out = &super::pending_responses_[index].buffer_;
+            BufferPool::instance().acquire(*out, ((!head && entry->memory_) ? static_cast<uint_t>(length) : 0) + 512);
+        }
+        encode_file_header(context, *entry, status_code, offset, length, *out);
+        if (!head && entry->memory_) {
+            out->write(entry->content_.data() + offset, static_cast<uint_t>(length));
+        }
+
+        if (file_body) {
+            add_file_body(sequence, entry, offset, length);
+            typename super::PendingResponse &pending = super::pending_responses_[index];
+            pending.deferred_ = true;
+            pending.ready_    = true;
+            if (0 == index) {
+                super::deferred_active_ = true;
+            }
+        }
+        else {
+            HttpFileCache::instance().release(entry);
+            if (0 == index) {
+                if (!super::pending_responses_.empty()) {
+                    //异步回复: 队首为本请求的位置
+                    super::pending_responses_.pop_front();
+                }
+                ++super::next_send_sequence_;
+                super::append_ready_responses(*out);
+            }
+            else {
+                super::pending_responses_[index].ready_ = true;
+            }
+        }
+        if (0 == index) {
+            super::stream_flush(*out);
+        }
+        return 0;
+    }
+
+    int handle_open()
+    {
+        release_file_bodies();
+        return super::handle_open();
+    }
+
+protected:
+    //待发送的文件内容, 按请求序号排列(与pending_responses_中deferred_的回复一一对应)
+    struct FileBody
+    {
+        uint64_t       sequence_ = 0;
+        HttpFileEntry *entry_    = nullptr;
+        uint64_t       offset_   = 0;
+        uint64_t       remain_   = 0;
+    };
+
+    int handle_close()
+    {
+        int ret = super::handle_close();
+        release_file_bodies();
+        return ret;
+    }
+
+    //文件回复的header(状态行/Date/Server/用户header/文件header/Content-Range/Content-Length)
+    void encode_file_header(HttpContext &context, const HttpFileEntry &entry, HttpStatusCode status_code,
+        uint64_t offset, uint64_t length, ByteBuffer &out)
+    {
+        HttpResponse &response = context.response_;
+        HttpDecoderConfig *config = static_cast<HttpDecoderConfig *>(super::source_->message_decoder_config());
+
+        response.status_code_ = status_code;
+        HttpMessage::write_status_line(out, response.version_id_, status_code);
+        if (config->date_header_ || !config->server_name_.empty()) {
+            HttpStringView block = HttpDateHeader::instance().header_block(config->date_header_, config->server_name_);
+            out.write(block.data_, block.len_);
+        }
+        for (auto &iter : response.headers_) {
+            out.write(iter.name_.data_, iter.name_.len_);
+            out.write(": ", 2);
+            out.write(iter.value_.data_, iter.value_.len_);
+            out.write("\r\n", 2);
+        }
+        if (HttpStatusCode::k200 == status_code) {
+            out.write(entry.full_headers_.data(), static_cast<uint_t>(entry.full_headers_.size()));
+            return;
+        }
+
+        out.write(entry.headers_.data(), static_cast<uint_t>(entry.headers_.size()));
+        char line[128];
+        int len = std::snprintf(line, sizeof(line), "Content-Range: bytes %llu-%llu/%llu\r\nContent-Length: %llu\r\n\r\n",
+            static_cast<unsigned long long>(offset),
+            static_cast<unsigned long long>(offset + length - 1),
+            static_cast<unsigned long long>(entry.info_.size_),
+            static_cast<unsigned long long>(length));
+        out.write(line, static_cast<uint_t>(len));
+    }
+
+    //发送队首回复的文件内容, 发送完后继续输出其后已完成的回复
+    int send_deferred_body(ByteBuffer &out)
+    {
+        while (super::deferred_active_) {
+            FileBody &body = file_bodies_.front();
+            while (body.remain_ > 0) {
+                int error = 0;
+                uint_t count = static_cast<uint_t>(std::min<uint64_t>(body.remain_, 0x40000000));
+                int send_bytes = OSApiFile::os_sendfile(super::fd_, body.entry_->fd_,
+                    static_cast<int64_t>(body.offset_), count, error);
+                if (send_bytes > 0) {
+                    body.offset_ += send_bytes;
+                    body.remain_ -= send_bytes;
+                }
+                else if ((ZRSOCKET_EAGAIN == error) || (ZRSOCKET_EWOULDBLOCK == error) || (ZRSOCKET_EINTR == error)) {
+                    super::event_loop_->add_event(this, EventHandler::WRITE_EVENT_MASK);
+                    return EventHandler::WriteResult::WRITE_RESULT_PART;
+                }
+                else {
+                    super::last_errno_ = -error;
+                    return EventHandler::WriteResult::WRITE_RESULT_FAILURE;
+                }
+            }
+
+            HttpFileCache::instance().release(body.entry_);
+            file_bodies_.erase(file_bodies_.begin());
+            if (!super::finish_deferred_body(out)) {
+                return EventHandler::WriteResult::WRITE_RESULT_PART;
+            }
+        }
+        return EventHandler::WriteResult::WRITE_RESULT_SUCCESS;
+    }
+
+    inline void add_file_body(uint64_t sequence, HttpFileEntry *entry, uint64_t offset, uint64_t length)
+    {
+        //异步回复可能先于前面的请求完成: 按序号插入
+        auto iter = file_bodies_.end();
+        while ((iter != file_bodies_.begin()) && ((iter - 1)->sequence_ > sequence)) {
+            --iter;
+        }
+        iter = file_bodies_.emplace(iter);
+        iter->sequence_ = sequence;
+        iter->entry_    = entry;
+        iter->offset_   = offset;
+        iter->remain_   = length;
+    }
+
+    inline void release_file_bodies()
+    {
+        for (auto &body : file_bodies_) {
+            HttpFileCache::instance().release(body.entry_);
+        }
+        file_bodies_.clear();
+    }
+
+protected:
+    std::vector<FileBody> file_bodies_;
+};
+
+ZRSOCKET_NAMESPACE_END
+
+#endif
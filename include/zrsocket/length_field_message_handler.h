@@ -4,6 +4,7 @@
 
 #ifndef ZRSOCKET_LENGTH_FIELD_MESSAGE_HANDLER
 #define ZRSOCKET_LENGTH_FIELD_MESSAGE_HANDLER
+#include <limits>
 #include "message_common.h"
 #include "message_handler.h"
 #include "os_api.h"
@@ -17,13 +18,23 @@ public:
     LengthFieldMessageDecoderConfig() = default;
     virtual ~LengthFieldMessageDecoderConfig() = default;
 
+    //length_field_length_取值: 1/2/4/8字节定长, LENGTH_FIELD_VARINT(0)为varint
+    //  定长: 长度值为整个消息长度(包含长度字段及其之前的数据)
+    //  varint: 长度值为长度字段之后的数据长度(与protobuf等delimited格式一致)
     int update()
     {
-        min_head_length_ = length_field_offset_ + length_field_length_;
+        if (LENGTH_FIELD_VARINT == length_field_length_) {
+            min_head_length_ = length_field_offset_ + 1;
+            max_head_length_ = length_field_offset_ + MessageCommon::VARINT_MAX_BYTES;
+            return 0;
+        }
 
+        min_head_length_ = length_field_offset_ + length_field_length_;
+        max_head_length_ = min_head_length_;
         if (ByteOrder::BYTE_ORDER_UNKNOWN_ENDIAN == byte_order_) {
             byte_order_ = OSConstant::instance().byte_order();
         }
+
         if (ByteOrder::BYTE_ORDER_BIG_ENDIAN == byte_order_) {
             switch (length_field_length_) {
             case 1:
@@ -35,6 +46,9 @@ public:
             case 4:
                 read_length_field_proc_ = MessageCommon::read_length_field_int32_network;
                 break;
+            case 8:
+                read_length_field_proc_ = MessageCommon::read_length_field_int64_network;
+                break;
             default:
                 read_length_field_proc_ = MessageCommon::read_length_field_int16_network;
                 break;
@@ -51,6 +65,9 @@ public:
             case 4:
                 read_length_field_proc_ = MessageCommon::read_length_field_int32_host;
                 break;
+            case 8:
+                read_length_field_proc_ = MessageCommon::read_length_field_int64_host;
+                break;
             default:
                 read_length_field_proc_ = MessageCommon::read_length_field_int16_host;
                 break;
@@ -60,6 +77,47 @@ public:
         return 0;
     }
 
+    //读消息长度
+    //返回值
+    // > 0: 消息长度
+    //== 0: 消息头不完整
+    // < 0: 消息长度非法
+    inline int read_message_length(const char *data, uint_t len) const
+    {
+        uint_t message_length;
+        if (LENGTH_FIELD_VARINT == length_field_length_) {
+            if (len < min_head_length_) {
+                return 0;
+            }
+            uint_t value = 0;
+            int field_length = MessageCommon::read_length_field_varint(data + length_field_offset_, len - length_field_offset_, value);
+            if (field_length <= 0) {
+                return field_length;
+            }
+            uint_t head_length = length_field_offset_ + field_length;
+            if (value > max_message_length_ - head_length) {
+                return -1;
+            }
+            message_length = head_length + value;
+        }
+        else {
+            if (len < min_head_length_) {
+                return 0;
+            }
+            message_length = read_length_field_proc_(data + length_field_offset_);
+            if ((message_length > max_message_length_) || (message_length < min_head_length_)) {
+                return -1;
+            }
+        }
+
+        if (message_length > static_cast<uint_t>(std::numeric_limits<int>::max())) {
+            return -1;
+        }
+        return static_cast<int>(message_length);
+    }
+
+    static constexpr uint_t LENGTH_FIELD_VARINT = 0;
+
 public:
     //长度字段偏移
     uint_t length_field_offset_ = 0;
@@ -73,9 +131,13 @@ public:
     MessageCommon::read_length_field_proc read_length_field_proc_ = MessageCommon::read_length_field_int16_host;
     //最小头长度
     uint_t min_head_length_     = 2;
+    //最大头长度(varint时长度字段不定长)
+    uint_t max_head_length_     = 2;
 };
 
-template <class TSendBuffer, class  TMutex>
+//TDerived: 为void时通过虚函数回调do_message(s);
+//  为派生类类型时(CRTP)直接调用TDerived::do_messages/do_message(非虚调用, 可内联)
+template <class TSendBuffer, class TMutex, class TDerived = void>
 class LengthFieldMessageHandler : public MessageHandler<TSendBuffer, TMutex>
 {
 public:
@@ -99,10 +161,22 @@ public:
         return 0;
     }
 
+    //批量回调: 一次接收中解码出的所有完整消息(每批最多MessageCommon::MESSAGE_BATCH_SIZE条)
+    //  缺省逐条调用do_message; 重载此函数可按批处理(如批量入队/批量回复)
+    //  返回值 <0: 出现异常关闭连接
+    virtual int do_messages(const MessageView *msgs, uint_t count)
+    {
+        for (uint_t i = 0; i < count; ++i) {
+            if (dispatch_message(msgs[i].data_, msgs[i].len_, std::is_void<TDerived>()) < 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
     int handle_open()
     {
-        super::message_buffer_.reset();
-        super::message_buffer_.reserve(static_cast<LengthFieldMessageDecoderConfig *>(super::source_->message_decoder_config())->max_message_length_);
+        super::release_message_buffer();
         super::queue1_.clear();
         super::queue2_.clear();
         message_length_ = 0;
@@ -110,92 +184,218 @@ public:
     }
 
 protected:
-    int decode(const char *data, uint_t len)
+    //接收: 已知消息长度且有半包时, 用readv将剩余部分直接读入消息缓存尾部(余下的读入event_loop接收缓冲区),
+    //  避免先读入接收缓冲区再拷贝到消息缓存的二次拷贝
+    int handle_read()
     {
-        LengthFieldMessageDecoderConfig *config = static_cast<LengthFieldMessageDecoderConfig *>(super::source_->message_decoder_config());
-        char   *remain     = const_cast<char *>(data);
-        uint_t  remain_len = len;
-        uint_t  last_len;
+        ByteBuffer *recv_buffer = super::event_loop_->get_recv_buffer();
+        char   *recv_buf        = recv_buffer->buffer();
+        uint_t  recv_buf_size   = recv_buffer->buffer_size();
+        ByteBuffer &message_buffer = super::message_buffer_;
+        ZRSOCKET_IOVEC iovecs[2];
+        int     iovecs_count;
         uint_t  need_len;
+        int     error_id = 0;
+        int     ret;
 
         do {
-            if (super::message_buffer_.empty()) {
-                if (0 == message_length_) {
-                    if (remain_len >= config->min_head_length_) {
-                        message_length_ = config->read_length_field_proc_(remain + config->length_field_offset_);
-                        if ((message_length_ > config->max_message_length_) || (0 == message_length_)) {
-                            super::last_errno_ = EventHandler::ERROR_CLOSE_ACTIVE;
-                            return -1;
-                        }
-                    }
-                    else {
-                        super::message_buffer_.write(remain, remain_len);
-                        return 0;
-                    }
+            need_len = 0;
+            if ((message_length_ > 0) && !message_buffer.empty()) {
+                need_len = message_length_ - message_buffer.data_size();
+                if (message_buffer.free_size() < need_len) {
+                    //扩展为恰好容纳整个消息的缓存
+                    ByteBuffer buf;
+                    BufferPool::instance().acquire(buf, message_length_);
+                    buf.write(message_buffer.data(), message_buffer.data_size());
+                    BufferPool::instance().release(message_buffer);
+                    message_buffer = std::move(buf);
                 }
+                iovecs[0].iov_base = message_buffer.buffer() + message_buffer.data_end();
+                iovecs[0].iov_len  = need_len;
+                iovecs[1].iov_base = recv_buf;
+                iovecs[1].iov_len  = recv_buf_size;
+                iovecs_count = 2;
+            }
+            else {
+                iovecs[0].iov_base = recv_buf;
+                iovecs[0].iov_len  = recv_buf_size;
+                iovecs_count = 1;
+            }
 
-                if (remain_len >= message_length_) {
-                    if (do_message(remain, message_length_) >= 0) {
-                        remain         += message_length_;
-                        remain_len     -= message_length_;
-                        message_length_ = 0;
+            ret = OSApi::socket_recvv(super::fd_, iovecs, iovecs_count, 0, nullptr, error_id);
+            if (ret > 0) {
+                if (need_len > 0) {
+                    if (static_cast<uint_t>(ret) < need_len) {
+                        message_buffer.data_end(message_buffer.data_end() + ret);
+                        return 1;
                     }
-                    else {
-                        super::last_errno_ = EventHandler::ERROR_CLOSE_ACTIVE;
+
+                    message_buffer.data_end(message_buffer.data_end() + need_len);
+                    MessageView view = { message_buffer.data(), message_length_ };
+                    if (dispatch_messages(&view, 1) < 0) {
                         return -1;
                     }
+                    message_length_ = 0;
+                    super::release_message_buffer();
+
+                    uint_t recv_len = ret - need_len;
+                    if ((recv_len > 0) && (decode(recv_buf, recv_len) < 0)) {
+                        return -1;
+                    }
+                }
+                else if (decode(recv_buf, ret) < 0) {
+                    return -1;
                 }
-                else {
-                    super::message_buffer_.write(remain, remain_len);
+            }
+            else if (0 == ret) {
+                //连接已关闭
+                super::last_errno_ = EventHandler::ERROR_CLOSE_PASSIVE;
+                return super::last_errno_;
+            }
+            else {
+                //ret < 0: 出现异常(如连接已关闭)
+                super::last_errno_ = -error_id;
+                if ((ZRSOCKET_EAGAIN == error_id) ||
+                    (ZRSOCKET_EWOULDBLOCK == error_id) ||
+                    (ZRSOCKET_EINTR == error_id)) {
+                    //非阻塞模式下正常情况
                     return 0;
                 }
+                return super::last_errno_;
             }
-            else { //begin: message_buffer_.data_size() > 0
-                last_len = super::message_buffer_.data_size();
-                if (message_length_ > 0) {
-                    need_len = message_length_ - last_len;
-                    if (remain_len >= need_len) {
-                        super::message_buffer_.write(remain, need_len);
-                        if (do_message(super::message_buffer_.data(), message_length_) >= 0) {
-                            remain         += need_len;
-                            remain_len     -= need_len;
-                            message_length_ = 0;
-                            super::message_buffer_.reset();
-                        }
-                        else {
-                            super::last_errno_ = EventHandler::ERROR_CLOSE_ACTIVE;
-                            return -1;
-                        }
-                    }
-                    else {
-                        super::message_buffer_.write(remain, remain_len);
-                        return 0;
-                    }                
+        } while (static_cast<uint_t>(ret) == need_len + recv_buf_size);
+
+        return 1;
+    }
+
+    int decode(const char *data, uint_t len)
+    {
+        LengthFieldMessageDecoderConfig *config = static_cast<LengthFieldMessageDecoderConfig *>(super::source_->message_decoder_config());
+        ByteBuffer &message_buffer = super::message_buffer_;
+        const char *remain  = data;
+        uint_t  remain_len  = len;
+        uint_t  last_len;
+        uint_t  need_len;
+        int     ret;
+
+        if (!message_buffer.empty()) { //begin: 有半包
+            if (0 == message_length_) {
+                //补齐消息头(最多补到max_head_length_)
+                last_len = message_buffer.data_size();
+                need_len = std::min<uint_t>(remain_len, config->max_head_length_ - last_len);
+                message_buffer.write(remain, need_len);
+                ret = config->read_message_length(message_buffer.data(), message_buffer.data_size());
+                if (ret < 0) {
+                    super::last_errno_ = EventHandler::ERROR_CLOSE_ACTIVE;
+                    return -1;
                 }
-                else { //begin: message_length_ == 0
-                    need_len = config->min_head_length_ - last_len;
-                    if (remain_len >= need_len) {
-                        super::message_buffer_.write(remain, need_len);
-                        message_length_ = config->read_length_field_proc_(super::message_buffer_.data() + config->length_field_offset_);
-                        if ((message_length_ > config->max_message_length_) || (0 == message_length_)) {
-                            super::last_errno_ = EventHandler::ERROR_CLOSE_ACTIVE;
-                            return -1;
-                        }
-
-                        remain     += need_len;
-                        remain_len -= need_len;
-                    }
-                    else {
-                        super::message_buffer_.write(remain, remain_len);
-                        return 0;
-                    }
-                } //end: message_length_ == 0
-            } //end: message_buffer_.data_size() > 0
-        } while (remain_len > 0);
+                if (0 == ret) {
+                    return 0;
+                }
+                message_length_ = ret;
+
+                //多补的数据(消息比最大头还短时)退回
+                if (message_buffer.data_size() > message_length_) {
+                    need_len -= message_buffer.data_size() - message_length_;
+                    message_buffer.data_end(message_buffer.data_begin() + message_length_);
+                }
+                remain     += need_len;
+                remain_len -= need_len;
+            }
+
+            need_len = message_length_ - message_buffer.data_size();
+            if (remain_len < need_len) {
+                message_buffer.write(remain, remain_len);
+                return 0;
+            }
+            message_buffer.write(remain, need_len);
+            MessageView view = { message_buffer.data(), message_length_ };
+            if (dispatch_messages(&view, 1) < 0) {
+                return -1;
+            }
+            remain         += need_len;
+            remain_len     -= need_len;
+            message_length_ = 0;
+            super::release_message_buffer();
+        } //end: 有半包
+
+        //直接在接收数据中解码完整的消息, 攒批后一次回调do_messages
+        MessageView views[MessageCommon::MESSAGE_BATCH_SIZE];
+        uint_t views_count = 0;
+        uint_t size_hint   = 0;
+        while (remain_len > 0) {
+            ret = config->read_message_length(remain, remain_len);
+            if (ret < 0) {
+                if (views_count > 0) {
+                    dispatch_messages(views, views_count);
+                }
+                super::last_errno_ = EventHandler::ERROR_CLOSE_ACTIVE;
+                return -1;
+            }
+            if (0 == ret) {
+                size_hint = config->max_head_length_;
+                break;
+            }
+
+            message_length_ = ret;
+            if (remain_len < message_length_) {
+                //按消息长度一次分配恰好大小的消息缓存
+                size_hint = message_length_;
+                break;
+            }
+
+            views[views_count].data_ = remain;
+            views[views_count].len_  = message_length_;
+            remain         += message_length_;
+            remain_len     -= message_length_;
+            message_length_ = 0;
+            if (++views_count == MessageCommon::MESSAGE_BATCH_SIZE) {
+                if (dispatch_messages(views, views_count) < 0) {
+                    return -1;
+                }
+                views_count = 0;
+            }
+        }
+
+        if ((views_count > 0) && (dispatch_messages(views, views_count) < 0)) {
+            return -1;
+        }
+        if (remain_len > 0) {
+            super::write_message_buffer(remain, remain_len, size_hint);
+        }
 
         return 0;
     }
 
+    inline int dispatch_messages(const MessageView *msgs, uint_t count)
+    {
+        if (dispatch_messages(msgs, count, std::is_void<TDerived>()) < 0) {
+            super::last_errno_ = EventHandler::ERROR_CLOSE_ACTIVE;
+            return -1;
+        }
+        return 0;
+    }
+
+    inline int dispatch_messages(const MessageView *msgs, uint_t count, std::true_type)
+    {
+        return do_messages(msgs, count);
+    }
+
+    inline int dispatch_messages(const MessageView *msgs, uint_t count, std::false_type)
+    {
+        return static_cast<TDerived *>(this)->TDerived::do_messages(msgs, count);
+    }
+
+    inline int dispatch_message(const char *message, uint_t len, std::true_type)
+    {
+        return do_message(message, len);
+    }
+
+    inline int dispatch_message(const char *message, uint_t len, std::false_type)
+    {
+        return static_cast<TDerived *>(this)->TDerived::do_message(message, len);
+    }
+
 protected:
     using super = MessageHandler<TSendBuffer, TMutex>;
     uint_t message_length_ = 0;
@@ -4,8 +4,10 @@
 
 #ifndef ZRSOCKET_MESSAGE_COMMON_H
 #define ZRSOCKET_MESSAGE_COMMON_H
+#include <limits>
 #include "config.h"
 #include "base_type.h"
+#include "os_api.h"
 
 ZRSOCKET_NAMESPACE_BEGIN
 
@@ -18,6 +20,13 @@ public:
     virtual int update() = 0;
 };
 
+//消息视图: 指向接收缓冲区或消息缓存中的一条完整消息(只在do_messages回调期间有效)
+struct MessageView
+{
+    const char *data_;
+    uint_t      len_;
+};
+
 class MessageCommon
 {
 public:
@@ -46,6 +55,48 @@ public:
         return ntohl(*((int32_t *)data));
     }
 
+    //64位长度字段: 超过uint_t范围时返回uint_t最大值(由max_message_length_拒绝)
+    static inline uint_t read_length_field_int64_host(const char *data)
+    {
+        uint64_t length = *((uint64_t *)data);
+        if (length > std::numeric_limits<uint_t>::max()) {
+            return std::numeric_limits<uint_t>::max();
+        }
+        return static_cast<uint_t>(length);
+    }
+
+    static inline uint_t read_length_field_int64_network(const char *data)
+    {
+        uint64_t length = static_cast<uint64_t>(OSApi::ntohll(*((int64_t *)data)));
+        if (length > std::numeric_limits<uint_t>::max()) {
+            return std::numeric_limits<uint_t>::max();
+        }
+        return static_cast<uint_t>(length);
+    }
+
+    //varint(LEB128)长度字段: 每字节低7位有效, 最高位为1表示后续还有字节
+    //返回值
+    // > 0: 长度字段所占字节数, value为长度值
+    //== 0: 数据不完整
+    // < 0: 超出uint_t范围(最多5字节)
+    static inline int read_length_field_varint(const char *data, uint_t len, uint_t &value)
+    {
+        uint_t result = 0;
+        uint_t max_bytes = (len < VARINT_MAX_BYTES) ? len : VARINT_MAX_BYTES;
+        for (uint_t i = 0; i < max_bytes; ++i) {
+            uint8_t byte = static_cast<uint8_t>(data[i]);
+            result |= static_cast<uint_t>(byte & 0x7F) << (7 * i);
+            if (byte < 0x80) {
+                if ((VARINT_MAX_BYTES - 1 == i) && (byte > 0x0F)) {
+                    return -1;
+                }
+                value = result;
+                return i + 1;
+            }
+        }
+        return (len < VARINT_MAX_BYTES) ? 0 : -1;
+    }
+
     static void write_length_field_int8(char *buf, uint_t message_length)
     {
         *buf = static_cast<char>(message_length);
@@ -71,6 +122,34 @@ public:
         *((int32_t *)buf) = htonl(message_length);
     }
 
+    static void write_length_field_int64_host(char *buf, uint_t message_length)
+    {
+        *((uint64_t *)buf) = message_length;
+    }
+
+    static void write_length_field_int64_network(char *buf, uint_t message_length)
+    {
+        *((int64_t *)buf) = OSApi::htonll(message_length);
+    }
+
+    //返回写入的字节数(buf至少VARINT_MAX_BYTES字节)
+    static int write_length_field_varint(char *buf, uint_t value)
+    {
+        int i = 0;
+        while (value >= 0x80) {
+            buf[i++] = static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        buf[i++] = static_cast<char>(value);
+        return i;
+    }
+
+    //do_messages每批最多消息数
+    static constexpr uint_t MESSAGE_BATCH_SIZE = 64;
+
+    //uint_t的varint编码最多字节数
+    static constexpr uint_t VARINT_MAX_BYTES = 5;
+
     typedef uint_t (* read_length_field_proc)(const char *data);
     typedef void (* write_length_field_proc)(char *buf, uint_t message_length);
 };
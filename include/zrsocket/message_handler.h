@@ -5,12 +5,16 @@
 #ifndef ZRSOCKET_MESSAGE_HANDLER_H
 #define ZRSOCKET_MESSAGE_HANDLER_H
 #include <deque>
+#include <type_traits>
+#include <algorithm>
 #include "config.h"
 #include "byte_buffer.h"
+#include "buffer_pool.h"
 #include "mutex.h"
 #include "os_api.h"
 #include "event_handler.h"
 #include "event_source.h"
+#include "send_event.h"
 
 ZRSOCKET_NAMESPACE_BEGIN
 
@@ -93,10 +97,42 @@ public:
         return ret;
     }
 
+    //跨线程发送: 将数据投递到所属event_loop的事件队列, 由event_loop线程完成发送
+    //  所有socket I/O及epoll_ctl都在event_loop线程中执行, 只使用post_send发送的handler可使用NullMutex
+    //  一批数据只投递一个事件(event_loop只唤醒一次)
+    //  执行前连接已关闭(含关闭后被对象池复用)的数据不发送
+    //  返回值: 0(SendResult::PUSH_QUEUE)投递成功, <0投递失败(事件队列满)
+    int post_send(SharedBuffer *buffers, uint_t count)
+    {
+        PostSendTask *task = new PostSendTask{ { this, EventHandler::generation() }, {} };
+        task->buffers_.reserve(count);
+        for (uint_t i = 0; i < count; ++i) {
+            task->buffers_.emplace_back(buffers[i]);
+        }
+
+        TcpPostSendEvent event(task);
+        if (event_loop_->push_event(&event) > 0) {
+            return static_cast<int>(SendResult::PUSH_QUEUE);
+        }
+        delete task;
+        return static_cast<int>(SendResult::FAILURE);
+    }
+
+    inline int post_send(SharedBuffer &buffer)
+    {
+        return post_send(&buffer, 1);
+    }
+
+    int post_send(const char *data, uint_t len)
+    {
+        SharedBuffer buffer(data, len);
+        return post_send(&buffer, 1);
+    }
+
     int handle_open()
     {
-        message_buffer_.reset();
-        message_buffer_.reserve(source_->recvbuffer_size());
+        //消息缓存按需从BufferPool获取(只有需要保留半包时才分配)
+        release_message_buffer();
         queue1_.clear();
         queue2_.clear();
         return do_open();
@@ -110,15 +146,119 @@ protected:
         queue1_.clear();
         queue2_.clear();
         mutex_.unlock();
+        release_message_buffer();
         close();
         return ret;
     }
 
+    //写入半包数据: 消息缓存未分配时按size_hint从BufferPool获取
+    inline bool write_message_buffer(const char *data, uint_t len, uint_t size_hint)
+    {
+        if (nullptr == message_buffer_.buffer()) {
+            BufferPool::instance().acquire(message_buffer_, std::max<uint_t>(len, size_hint));
+        }
+        return message_buffer_.write(data, len);
+    }
+
+    //消息完整处理后归还消息缓存
+    inline void release_message_buffer()
+    {
+        BufferPool::instance().release(message_buffer_);
+    }
+
     int handle_connect()
     {
         return do_connect();
     }
 
+    //在event_loop线程中执行
+    //  发送队列为空时直接从SharedBuffer writev(广播时各连接共用同一份数据, 不入队/不拷贝), 只有未发送完的部分入队
+    //  发送队列非空说明已注册写事件, 一批数据一次入队
+    int handle_send_buffers(SharedBuffer *buffers, uint_t count)
+    {
+        if (EventHandler::STATE_CONNECTED != state()) {
+            return static_cast<int>(SendResult::FAILURE);
+        }
+
+        mutex_.lock();
+        bool idle = queue_active_->empty() && queue_standby_->empty();
+        uint_t sent_count  = 0;     //已完整发送的buffer数
+        uint_t sent_offset = 0;     //第sent_count个buffer已发送的字节数
+        if (idle) {
+            int ret = send_shared_i(buffers, count, sent_count, sent_offset);
+            if (ret < 0) {
+                mutex_.unlock();
+                event_loop_->delete_handler(this, 0);
+                return ret;
+            }
+            if (sent_count == count) {
+                mutex_.unlock();
+                return static_cast<int>(SendResult::SUCCESS);
+            }
+        }
+        for (uint_t i = sent_count; i < count; ++i) {
+            push_shared_i(buffers[i], (i == sent_count) ? sent_offset : 0, std::is_same<TSendBuffer, SharedBuffer>());
+        }
+        mutex_.unlock();
+
+        if (idle) {
+            event_loop_->add_event(this, EventHandler::WRITE_EVENT_MASK);
+        }
+        return static_cast<int>(SendResult::PUSH_QUEUE);
+    }
+
+    //直接writev一批SharedBuffer, 返回值<0: 连接异常
+    int send_shared_i(SharedBuffer *buffers, uint_t count, uint_t &sent_count, uint_t &sent_offset)
+    {
+        int iovecs_count = 0;
+        ZRSOCKET_IOVEC *iovecs = event_loop_->iovecs(iovecs_count);
+        if (static_cast<uint_t>(iovecs_count) > count) {
+            iovecs_count = static_cast<int>(count);
+        }
+        for (int i = 0; i < iovecs_count; ++i) {
+            iovecs[i].iov_base = buffers[i].data();
+            iovecs[i].iov_len  = buffers[i].data_size();
+        }
+
+        int error_id = 0;
+        int send_bytes = OSApi::socket_sendv(fd_, iovecs, iovecs_count, 0, nullptr, error_id);
+        if (send_bytes < 0) {
+            if ((ZRSOCKET_EAGAIN == error_id) ||
+                (ZRSOCKET_EWOULDBLOCK == error_id) ||
+                (ZRSOCKET_IO_PENDING == error_id) ||
+                (ZRSOCKET_ENOBUFS == error_id)) {
+                //非阻塞模式下正常情况
+                return 0;
+            }
+            last_errno_ = -error_id;
+            return last_errno_;
+        }
+
+        uint_t remain_bytes = static_cast<uint_t>(send_bytes);
+        while ((sent_count < count) && (remain_bytes >= buffers[sent_count].data_size())) {
+            remain_bytes -= buffers[sent_count].data_size();
+            ++sent_count;
+        }
+        sent_offset = remain_bytes;
+        return 0;
+    }
+
+    //TSendBuffer为SharedBuffer: 只增加引用计数, 不拷贝数据
+    inline void push_shared_i(SharedBuffer &buffer, uint_t offset, std::true_type)
+    {
+        queue_standby_->emplace_back(buffer);
+        if (offset > 0) {
+            SharedBuffer &back = queue_standby_->back();
+            back.data_begin(back.data_begin() + offset);
+        }
+    }
+
+    //其他类型的TSendBuffer: 退化为拷贝(未发送的)数据
+    inline void push_shared_i(SharedBuffer &buffer, uint_t offset, std::false_type)
+    {
+        queue_standby_->emplace_back(buffer.data() + offset, buffer.data_size() - offset);
+    }
+
     int handle_read()
     {
         ByteBuffer *recv_buffer = event_loop_->get_recv_buffer();
@@ -384,7 +524,7 @@ protected:
     SEND_QUEUE      queue2_;
     TMutex          mutex_;
 
-    ByteBuffer      message_buffer_;        //消息缓存
+    ByteBuffer      message_buffer_;        //消息缓存(半包时才从BufferPool分配)
 };
 
 ZRSOCKET_NAMESPACE_END
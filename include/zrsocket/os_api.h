@@ -870,6 +870,18 @@ public:
 #endif
     }
 
+    //自旋等待提示(x86:pause/arm:yield): 降低自旋时的功耗及对超线程兄弟的影响
+    static inline void cpu_pause()
+    {
+#ifdef _MSC_VER
+        _mm_pause();
+#elif defined(__i386__) || defined(__x86_64__) || defined(__amd64__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__("yield");
+#endif
+    }
+
     //取得当前系统时间(自公元1970/1/1 00:00:00以来经过纳秒)
     static inline uint64_t time_ns()
     {
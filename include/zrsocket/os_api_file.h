@@ -26,13 +26,19 @@
 
 #ifndef ZRSOCKET_OS_API_FILE_H
 #define ZRSOCKET_OS_API_FILE_H
+#include <algorithm>
 #include <string>
 #include <cassert>
 #include <cstdio>
+#include <cstdlib>
 #include "config.h"
 #include "base_type.h"
 #include "os_api.h"
 
+#ifdef ZRSOCKET_OS_LINUX
+#include <sys/sendfile.h>
+#endif
+
 #ifdef ZRSOCKET_OS_WINDOWS
 #include <io.h>
 #include <fcntl.h>
@@ -53,6 +59,14 @@
 
 ZRSOCKET_NAMESPACE_BEGIN
 
+//文件属性(stat/fstat)
+struct OSFileInfo
+{
+    uint64_t    size_    = 0;       //文件长度
+    int64_t     mtime_   = 0;       //最后修改时间(秒)
+    bool        regular_ = false;   //是否普通文件
+};
+
 class OSApiFile
 {
 public:
@@ -137,6 +151,103 @@ public:
 #endif
     }
 
+    static int os_fstat(int fd, OSFileInfo &info)
+    {
+#ifdef ZRSOCKET_OS_WINDOWS
+        struct _stat64 st;
+        int ret = ::_fstat64(fd, &st);
+        if (0 == ret) {
+            info.regular_ = ((st.st_mode & _S_IFMT) == _S_IFREG);
+#else
+        struct stat st;
+        int ret = ::fstat(fd, &st);
+        if (0 == ret) {
+            info.regular_ = S_ISREG(st.st_mode);
+#endif
+            info.size_  = static_cast<uint64_t>(st.st_size);
+            info.mtime_ = static_cast<int64_t>(st.st_mtime);
+        }
+        return ret;
+    }
+
+    static int os_stat(const char *filename, OSFileInfo &info)
+    {
+#ifdef ZRSOCKET_OS_WINDOWS
+        struct _stat64 st;
+        int ret = ::_stat64(filename, &st);
+        if (0 == ret) {
+            info.regular_ = ((st.st_mode & _S_IFMT) == _S_IFREG);
+#else
+        struct stat st;
+        int ret = ::stat(filename, &st);
+        if (0 == ret) {
+            info.regular_ = S_ISREG(st.st_mode);
+#endif
+            info.size_  = static_cast<uint64_t>(st.st_size);
+            info.mtime_ = static_cast<int64_t>(st.st_mtime);
+        }
+        return ret;
+    }
+
+    //绝对路径(解析"."/".."), 返回值 0: 成功, -1: 失败(文件不存在等)
+    //  windows下不解析符号链接
+    static int os_realpath(const char *filename, std::string &path)
+    {
+#ifdef ZRSOCKET_OS_WINDOWS
+        char *resolved = ::_fullpath(nullptr, filename, 0);
+#else
+        char *resolved = ::realpath(filename, nullptr);
+#endif
+        if (nullptr == resolved) {
+            return -1;
+        }
+        path.assign(resolved);
+        std::free(resolved);
+        return 0;
+    }
+
+    //从offset处读取(不改变文件位置)
+    static inline int os_pread(int fd, char *buf, uint_t nbytes, int64_t offset)
+    {
+#ifdef ZRSOCKET_OS_WINDOWS
+        if (::_lseeki64(fd, offset, SEEK_SET) < 0) {
+            return -1;
+        }
+        return ::_read(fd, buf, nbytes);
+#else
+        return static_cast<int>(::pread(fd, buf, nbytes, static_cast<off_t>(offset)));
+#endif
+    }
+
+    //将文件fd从offset开始的count字节发送到socket
+    //  linux下使用sendfile(数据不经过用户态), 其它系统退化为pread + send
+    //  返回值: >0 发送的字节数; <0 出错, error为错误码(非阻塞socket缓冲区满时为ZRSOCKET_EAGAIN)
+    static int os_sendfile(ZRSOCKET_SOCKET sock, int fd, int64_t offset, uint_t count, int &error)
+    {
+#ifdef ZRSOCKET_OS_LINUX
+        off_t off = static_cast<off_t>(offset);
+        ssize_t ret = ::sendfile(sock, fd, &off, count);
+        if (ret < 0) {
+            error = errno;
+            return -1;
+        }
+        if (0 == ret) {
+            //文件被截断
+            error = ZRSOCKET_EINVAL;
+            return -1;
+        }
+        return static_cast<int>(ret);
+#else
+        static thread_local char buf[65536];
+        int read_bytes = os_pread(fd, buf, std::min<uint_t>(count, sizeof(buf)), offset);
+        if (read_bytes <= 0) {
+            error = ZRSOCKET_EINVAL;
+            return -1;
+        }
+        return OSApi::socket_send(sock, buf, read_bytes, 0, nullptr, &error);
+#endif
+    }
+
     static int readn(int fd, char *buf, uint_t nbytes)
     {
         assert(buf != nullptr);
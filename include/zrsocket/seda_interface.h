@@ -75,6 +75,26 @@ public:
     {
         return 0;
     }
+
+    //: һͬcount¼, طĸ(пռ䲻ʱֻǰ沿)
+    //  Ĭʵpush_event
+    virtual int     push_events(const SedaEvent * const *events, uint_t count, int thread_index = -1, int priority = SedaPriority::UNKNOWN_PRIOITY)
+    {
+        uint_t i = 0;
+        for (; i < count; ++i) {
+            if (push_event(events[i], thread_index, priority) < 0) {
+                break;
+            }
+        }
+        return static_cast<int>(i);
+    }
+
+    //: ͬkey¼ͬһ̴߳(һԹϣ),
+    //  ߳̿άkeyֵ״̬; ְ֧ɵstage-1
+    virtual int     push_event_by_key(const SedaEvent *event, uint64_t key, int priority = SedaPriority::UNKNOWN_PRIOITY)
+    {
+        return -1;
+    }
 };
 
 class ISedaStageThread
@@ -6,6 +6,7 @@
 #include "os_api.h"
 #include "mutex.h"
 #include "seda_stage_thread.h"
+#include "seda_key_dispatch.h"
 
 ZRSOCKET_NAMESPACE_BEGIN
 
@@ -43,30 +44,141 @@ public:
         timedwait_interval_us_ = timedwait_interval_us;
         stage_threads_.reserve(thread_number);
 
+        //ȴȫ߳: work stealingģʽֵ̻߳߳
         StageThread *stage_thread;
         for (uint_t i=0; i<thread_number; ++i) {
             stage_thread = new StageThread(this, i, queue_max_size, event_len, timedwait_interval_us, timedwait_signal);
-            stage_thread->start();
             stage_threads_.push_back(stage_thread);
         }
+        if ((idle_max_spin_us_ > 0) || (idle_yield_times_ > 0)) {
+            for (auto thread : stage_threads_) {
+                thread->set_idle_strategy(idle_max_spin_us_, idle_yield_times_);
+            }
+        }
+        if (work_stealing_) {
+            for (auto thread : stage_threads_) {
+                thread->set_work_stealing(&stage_threads_, queue_max_size, event_len, steal_batch_size_, local_batch_size_);
+            }
+        }
+        if (hot_key_top_k_ > 0) {
+            hot_key_detector_.init(thread_number, hot_key_top_k_, hot_key_sample_interval_);
+        }
+        if (event_age_.enabled()) {
+            for (auto thread : stage_threads_) {
+                thread->set_event_age(&event_age_);
+            }
+        }
+        for (auto thread : stage_threads_) {
+            thread->start();
+        }
         return 0;
     }
 
     int close()
     {
-        StageThread *stage_thread;
-        auto iter = stage_threads_.begin();
-        auto iter_end = stage_threads_.end();
-        for (; iter != iter_end; ++iter) {
-            stage_thread = *iter;
+        //ȫ߳˳ͷ: ˳е߳̿ȡ̵ֵ߳Ĺ
+        for (auto stage_thread : stage_threads_) {
             stage_thread->stop();
+        }
+        for (auto stage_thread : stage_threads_) {
             stage_thread->join();
+        }
+        for (auto stage_thread : stage_threads_) {
             delete stage_thread;
         }
         stage_threads_.clear();
         return 0;
     }
 
+    //work stealingģʽ(open֮ǰ)
+    //  push_eventδָthread_index(<0)¼̵߳Ĺ,
+    //  ߳ڵȴǰӻѹֵ߳ȡ; ָthread_index¼߳׺, ᱻȡ
+    int enable_work_stealing(uint_t steal_batch_size = 32, uint_t local_batch_size = 4)
+    {
+        if (!stage_threads_.empty()) {
+            return -1;
+        }
+        work_stealing_    = true;
+        steal_batch_size_ = steal_batch_size;
+        local_batch_size_ = local_batch_size;
+        return 0;
+    }
+
+    //ÿеȴ(open֮ǰ): Ϊʱ(ڰ¼Ӧ, max_spin_us),
+    //  yield(yield_times), ȴ; ֻ߳ѽȴʱŷ֪ͨ
+    //  ڶԶ༶stage份ӳеĳ(ռCPU)
+    int set_idle_strategy(uint_t max_spin_us = 50, uint_t yield_times = 4)
+    {
+        if (!stage_threads_.empty()) {
+            return -1;
+        }
+        idle_max_spin_us_ = max_spin_us;
+        idle_yield_times_ = yield_times;
+        return 0;
+    }
+
+    //ȵ(open֮ǰ): push_event_by_keyÿsample_interval¼һ
+    int enable_hot_key_detector(uint_t top_k = 16, uint_t sample_interval = 16)
+    {
+        if (!stage_threads_.empty() || (top_k < 1)) {
+            return -1;
+        }
+        hot_key_top_k_ = top_k;
+        hot_key_sample_interval_ = sample_interval;
+        return 0;
+    }
+
+    inline SedaHotKeyDetector & hot_key_detector()
+    {
+        return hot_key_detector_;
+    }
+
+    //¼͵Ľֹʱ(open֮ǰ), ɶεö
+    //  ͵¼TimestampEventType: ʱд뵱ǰTSC, ȡʱͳŶʱ,
+    //  Ŷӳdeadline_us¼handlerhandle_expired(ٵhandle_event)
+    //  deadline_usΪ0ʱֻͳʱ, 
+    int set_event_deadline(int event_type, uint_t deadline_us)
+    {
+        if (!stage_threads_.empty()) {
+            return -1;
+        }
+        return event_age_.set_deadline(event_type, deadline_us);
+    }
+
+    //̵ܸ߳Ŷʱӷֲhistogram
+    void delay_histogram(SedaDelayHistogram &histogram) const
+    {
+        histogram.reset();
+        for (auto stage_thread : stage_threads_) {
+            histogram.merge(stage_thread->delay_histogram());
+        }
+    }
+
+    //ֹʱ¼
+    uint64_t expired_count() const
+    {
+        uint64_t count = 0;
+        for (auto stage_thread : stage_threads_) {
+            count += stage_thread->expired_count();
+        }
+        return count;
+    }
+
+    inline bool work_stealing() const
+    {
+        return work_stealing_;
+    }
+
+    //ȡ¼
+    uint64_t stolen_count() const
+    {
+        uint64_t count = 0;
+        for (auto stage_thread : stage_threads_) {
+            count += stage_thread->stolen_count();
+        }
+        return count;
+    }
+
     int join()
     {
         auto iter = stage_threads_.begin();
@@ -80,6 +192,9 @@ public:
     inline int push_event(const SedaEvent *event, int thread_index = -1, int priority = SedaPriority::UNKNOWN_PRIOITY)
     {
         int thread_size = static_cast<int>(stage_threads_.size());
+        if (work_stealing_ && ((thread_index < 0) || (thread_index >= thread_size))) {
+            return push_shared_event(event, thread_size);
+        }
         if (thread_size < 2) {
             thread_index = 0;
         }
@@ -94,14 +209,65 @@ public:
         return -1;
     }
 
+    //: ͬһ̵߳Ķ(һμ/һη, һ֪ͨ), طĸ, stageδʱ-1
+    //  δָthread_indexʱת߳; work stealingģʽ·빲, ɿ̷ֵ߳
+    inline int push_events(const SedaEvent * const *events, uint_t count, int thread_index = -1, int priority = SedaPriority::UNKNOWN_PRIOITY)
+    {
+        int thread_size = static_cast<int>(stage_threads_.size());
+        if (0 == thread_size) {
+            return -1;
+        }
+        bool shared = work_stealing_ && ((thread_index < 0) || (thread_index >= thread_size));
+        if (thread_size < 2) {
+            thread_index = 0;
+        }
+        else if ((thread_index < 0) || (thread_index >= thread_size)) {
+            thread_index = next_thread_index_;
+            next_thread_index_ = (thread_index + 1) % thread_size;
+        }
+
+        StageThread *stage_thread = stage_threads_[thread_index];
+        if (!shared) {
+            return stage_thread->push_events(events, count);
+        }
+
+        int ret = stage_thread->push_shared_events(events, count);
+        if ((ret > 1) && stage_thread->timedwait_signal() && (thread_size > 1)) {
+            //ѹһ߳: ѵȴеֵ߳ȡ
+            for (int i = 1; i < thread_size; ++i) {
+                stage_threads_[(thread_index + i) % thread_size]->notify_if_parked();
+            }
+        }
+        return ret;
+    }
+
+    //߳ʱͬkeyǷɵͬһ߳; ߳仯ʱֻkeyǨ
+    //  work stealingģʽ°ɵ¼ͬ߳׺, ᱻȡ
+    inline int push_event_by_key(const SedaEvent *event, uint64_t key, int priority = SedaPriority::UNKNOWN_PRIOITY)
+    {
+        int thread_index = SedaKeyHash::thread_index(key, static_cast<int>(stage_threads_.size()));
+        if (hot_key_detector_.enabled()) {
+            hot_key_detector_.record(key, thread_index);
+        }
+        if (stage_threads_[thread_index]->push_event(event) > 0) {
+            return thread_index;
+        }
+        return -1;
+    }
+
     inline int type() const
     {
         return type_;
     }
 
+    //̶߳лѹ¼(ֵ)
     inline int event_count() const
     {
-        return 0;
+        uint64_t count = 0;
+        for (auto stage_thread : stage_threads_) {
+            count += stage_thread->event_count();
+        }
+        return static_cast<int>(count);
     }
 
     inline uint_t batch_size() const
@@ -119,6 +285,29 @@ public:
         return context_;
     }
 
+protected:
+    inline int push_shared_event(const SedaEvent *event, int thread_size)
+    {
+        int thread_index = next_thread_index_;
+        next_thread_index_ = (thread_index + 1) % thread_size;
+
+        StageThread *stage_thread = stage_threads_[thread_index];
+        if (stage_thread->push_shared_event(event) < 1) {
+            return -1;
+        }
+
+        //Ŀ߳æлѹʱ, һȴеֵ߳ȡ
+        if (stage_thread->timedwait_signal() && (thread_size > 1) &&
+            !stage_thread->is_parked() && (stage_thread->shared_event_count() > 1)) {
+            for (int i = 1; i < thread_size; ++i) {
+                if (stage_threads_[(thread_index + i) % thread_size]->notify_if_parked()) {
+                    break;
+                }
+            }
+        }
+        return thread_index;
+    }
+
 protected:
     using StageThread = SedaStageThread<TSedaStageHandler, TQueue>;
     std::vector<StageThread * > stage_threads_;
@@ -126,6 +315,23 @@ protected:
     uint_t  timedwait_interval_us_ = 10000;
     int     next_thread_index_ = 0;
 
+    //work stealing
+    bool    work_stealing_    = false;
+    uint_t  steal_batch_size_ = 32;
+    uint_t  local_batch_size_ = 4;
+
+    //еȴ
+    uint_t  idle_max_spin_us_ = 0;
+    uint_t  idle_yield_times_ = 0;
+
+    //ȵ
+    SedaHotKeyDetector  hot_key_detector_;
+    uint_t              hot_key_top_k_ = 0;
+    uint_t              hot_key_sample_interval_ = 16;
+
+    //¼ŶʱӸ
+    SedaEventAge        event_age_;
+
     //ֶʵʶ
     int     type_  = 0;
 
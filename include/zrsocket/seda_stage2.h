@@ -117,6 +117,31 @@ public:
         return ret;
     }
 
+    //: һμ빲, طĸ
+    inline int push_events(const SedaEvent * const *events, uint_t count, int thread_index = -1, int priority = SedaPriority::UNKNOWN_PRIOITY)
+    {
+        uint_t ret;
+        if (is_priority_ && (SedaPriority::HIGH_PRIORITY == priority)) {
+            high_priority_mutex_.lock();
+            ret = high_priority_queue_.push(events, count);
+            high_priority_mutex_.unlock();
+        }
+        else {
+            low_priority_mutex_.lock();
+            ret = low_priority_queue_.push(events, count);
+            low_priority_mutex_.unlock();
+        }
+        if (timedwait_signal_ && (ret > 0)) {
+            if (ret > 1) {
+                timedwait_condition_.notify_all();
+            }
+            else {
+                timedwait_condition_.notify_one();
+            }
+        }
+        return static_cast<int>(ret);
+    }
+
     inline int pop_event(void *push_queue, uint_t batch_size)
     {
         SedaEventQueue *push_queue_tmp = (SedaEventQueue *)push_queue;
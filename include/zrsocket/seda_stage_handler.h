@@ -25,6 +25,13 @@ public:
         return 0;
     }
 
+    //Ŷʱ䳬ֹʱ¼(SedaStage::set_event_deadline), ٵhandle_event
+    //  age_ns: ¼Ŷӵʱ; ĬֱӶ
+    virtual int handle_expired(const SedaEvent *event, uint64_t age_ns)
+    {
+        return 0;
+    }
+
     inline void set_stage_thread(ISedaStageThread *stage_thread)
     {
         stage_thread_ = stage_thread;
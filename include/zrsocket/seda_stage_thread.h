@@ -3,6 +3,7 @@
 
 #include <algorithm>
 #include <vector>
+#include <thread>
 #include "config.h"
 #include "base_type.h"
 #include "os_api.h"
@@ -13,6 +14,7 @@
 #include "seda_event.h"
 #include "seda_event_queue.h"
 #include "seda_timer_queue.h"
+#include "seda_event_age.h"
 
 ZRSOCKET_NAMESPACE_BEGIN
 
@@ -44,7 +46,7 @@ public:
     {
         SedaQuitEvent quit_event;
         event_queue_.push(&quit_event);
-        timedwait_condition_.notify_one();
+        notify_if_parked();
         return thread_.stop();
     }
 
@@ -55,14 +57,151 @@ public:
 
     inline int push_event(const SedaEvent *event)
     {
+        if (nullptr != event_age_) {
+            event = event_age_->stamp(event);
+        }
         int ret = event_queue_.push(event);
         if ((ret > 0) && timedwait_signal_) {
+            notify_if_parked();
+        }
+        return ret;
+    }
+
+    //˽ж, ֪ͨһ
+    inline int push_events(const SedaEvent * const *events, uint_t count)
+    {
+        if (nullptr != event_age_) {
+            events = event_age_->stamp(events, count);
+        }
+        int ret = static_cast<int>(event_queue_.push(events, count));
+        if ((ret > 0) && timedwait_signal_) {
+            notify_if_parked();
+        }
+        return ret;
+    }
+
+    //еȴ(start֮ǰ): Ϊʱ, óCPU, ȴ
+    //  max_spin_us: , ʵʴڰ۲⵽¼Ӧ(0: )
+    //  yield_times: yieldĴ
+    inline int set_idle_strategy(uint_t max_spin_us, uint_t yield_times)
+    {
+        max_spin_ns_ = static_cast<uint64_t>(max_spin_us) * 1000;
+        idle_gap_ns_ = max_spin_ns_;
+        yield_times_ = yield_times;
+        return 0;
+    }
+
+    //¼ŶʱӸ(start֮ǰ): event_agestage, ڲ߳
+    inline int set_event_age(const SedaEventAge *event_age)
+    {
+        event_age_ = (event_age->enabled()) ? event_age : nullptr;
+        return 0;
+    }
+
+    //work stealingģʽ(start֮ǰ)
+    //  siblings: ͬһstage߳()
+    //  steal_batch_size: ʱһæֵ߳ȡ¼(ȡѹһ)
+    //  local_batch_size: һȡ¼(ȡٱȡ,С)
+    inline int set_work_stealing(const std::vector<SedaStageThread *> *siblings,
+                                 uint_t queue_max_size,
+                                 uint_t event_len,
+                                 uint_t steal_batch_size,
+                                 uint_t local_batch_size)
+    {
+        if (steal_batch_size < 1) {
+            steal_batch_size = 1;
+        }
+        if (local_batch_size < 1) {
+            local_batch_size = 1;
+        }
+        if (shared_queue_.init(queue_max_size, event_len) < 1) {
+            return -1;
+        }
+        siblings_ = siblings;
+        steal_batch_size_ = steal_batch_size;
+        local_batch_size_ = std::min(local_batch_size, steal_batch_size);
+        steal_buffer_.resize(static_cast<std::size_t>(steal_batch_size) * shared_queue_.slot_len());
+        return 0;
+    }
+
+    //빲(ɱȡ): Ҫ߳׺Ե¼
+    inline int push_shared_event(const SedaEvent *event)
+    {
+        if (nullptr != event_age_) {
+            event = event_age_->stamp(event);
+        }
+        int ret = shared_queue_.push(event);
+        if ((ret > 0) && timedwait_signal_) {
+            notify_if_parked();
+        }
+        return ret;
+    }
+
+    inline int push_shared_events(const SedaEvent * const *events, uint_t count)
+    {
+        if (nullptr != event_age_) {
+            events = event_age_->stamp(events, count);
+        }
+        int ret = static_cast<int>(shared_queue_.push(events, count));
+        if ((ret > 0) && timedwait_signal_) {
+            notify_if_parked();
+        }
+        return ret;
+    }
+
+    //̴߳ȴʱ, Ƿѻ
+    //  /yield׶βtimedwait_flag_, ʱ֪ͨ(ʡȥfutexϵͳ)
+    inline bool notify_if_parked()
+    {
+        if (timedwait_flag_.load()) {
+            std::lock_guard<std::mutex> lock(timedwait_mutex_);
             if (timedwait_flag_.load()) {
                 timedwait_flag_.store(false);
                 timedwait_condition_.notify_one();
+                return true;
             }
         }
-        return ret;
+        return false;
+    }
+
+    inline bool is_parked() const
+    {
+        return timedwait_flag_.load(std::memory_order_relaxed);
+    }
+
+    inline bool timedwait_signal() const
+    {
+        return timedwait_signal_;
+    }
+
+    //лѹ¼(ֵ)
+    inline uint64_t shared_event_count() const
+    {
+        return shared_queue_.size();
+    }
+
+    //лѹ¼(ֵ)
+    inline uint64_t event_count() const
+    {
+        return event_queue_.size() + shared_queue_.size();
+    }
+
+    //ֵ߳ȡ¼
+    inline uint64_t stolen_count() const
+    {
+        return stolen_count_.load(std::memory_order_relaxed);
+    }
+
+    //¼Ŷʱӷֲ
+    inline const SedaDelayHistogram & delay_histogram() const
+    {
+        return delay_histogram_;
+    }
+
+    //ֹʱhandle_expired¼
+    inline uint64_t expired_count() const
+    {
+        return expired_count_.load(std::memory_order_relaxed);
     }
 
     inline SedaTimer * set_timer(uint_t interval_ms, SedaTimer::TimerParam param)
@@ -154,6 +293,164 @@ public:
     }
 
 private:
+    //¼еpop(handler)ɴ¼
+    struct EventDispatcher
+    {
+        SedaStageThread *stage_thread_;
+
+        inline int handle_event(const SedaEvent *event)
+        {
+            return stage_thread_->dispatch_event(event);
+        }
+    };
+
+    //ٵ¼ͳŶʱ, ֹʱʱhandle_expired
+    inline int dispatch_event(const SedaEvent *event)
+    {
+        if ((nullptr != event_age_) && event_age_->tracked(event)) {
+            uint64_t age_ns = event_age_->age_ns(event);
+            delay_histogram_.record(age_ns);
+            if (event_age_->expired(event, age_ns)) {
+                expired_count_.store(expired_count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return stage_handler_.handle_expired(event, age_ns);
+            }
+        }
+        return stage_handler_.handle_event(event);
+    }
+
+    //¼: ȡ, Ϊʱӻѹֵ߳ȡһ(steal_batch_size_)
+    //  ش¼
+    inline uint_t run_shared_events()
+    {
+        if (nullptr == siblings_) {
+            return 0;
+        }
+
+        char *buffer = steal_buffer_.data();
+        uint_t count = shared_queue_.pop(buffer, local_batch_size_);
+        if (0 == count) {
+            SedaStageThread *victim = nullptr;
+            uint64_t victim_size = 0;
+            uint64_t size;
+            for (auto sibling : *siblings_) {
+                if (sibling != this) {
+                    size = sibling->shared_queue_.size();
+                    if (size > victim_size) {
+                        victim_size = size;
+                        victim = sibling;
+                    }
+                }
+            }
+            if (nullptr == victim) {
+                return 0;
+            }
+            uint64_t steal_size = std::min<uint64_t>((victim_size + 1) / 2, steal_batch_size_);
+            count = victim->shared_queue_.pop(buffer, static_cast<uint_t>(steal_size));
+            if (count > 0) {
+                stolen_count_.fetch_add(count, std::memory_order_relaxed);
+            }
+        }
+
+        uint_t slot_len = shared_queue_.slot_len();
+        for (uint_t i = 0; i < count; ++i) {
+            dispatch_event(reinterpret_cast<SedaEvent *>(buffer + i * slot_len));
+        }
+        return count;
+    }
+
+    //˳ǰʣ¼(˽жеQUITڹб, ֵ߳Ҳ˳ȡ)
+    //  ش¼
+    inline uint_t drain_shared_events()
+    {
+        if (nullptr == siblings_) {
+            return 0;
+        }
+
+        char *buffer = steal_buffer_.data();
+        uint_t slot_len = shared_queue_.slot_len();
+        uint_t total = 0;
+        uint_t count;
+        while ((count = shared_queue_.pop(buffer, steal_batch_size_)) > 0) {
+            for (uint_t i = 0; i < count; ++i) {
+                dispatch_event(reinterpret_cast<SedaEvent *>(buffer + i * slot_len));
+            }
+            total += count;
+        }
+        return total;
+    }
+
+    //Ƿд¼(ֻڱ߳ҵǰactiveѴʱ)
+    inline bool has_events()
+    {
+        return event_queue_.swap_buffer() || !event_queue_.empty() ||
+            ((nullptr != siblings_) && !shared_queue_.empty());
+    }
+
+    //Ϊʱĵȴ:  -> yield -> ȴ
+    inline void idle_wait(uint_t timedwait_interval_us)
+    {
+        uint64_t idle_start = 0;
+        if (max_spin_ns_ > 0) {
+            idle_start = OSApi::steady_clock_counter();
+
+            //ȡ¼ƽ2, ʱ, ֱyield/ȴ
+            uint64_t spin_window_ns = 0;
+            if (idle_gap_ns_ <= max_spin_ns_) {
+                spin_window_ns = std::min(max_spin_ns_, std::max(idle_gap_ns_ * 2, max_spin_ns_ / 16));
+            }
+            if (spin_window_ns > 0) {
+                uint64_t deadline = idle_start + spin_window_ns;
+                do {
+                    for (int i = 0; i < 8; ++i) {
+                        OSApi::cpu_pause();
+                    }
+                    if (has_events()) {
+                        update_idle_gap(idle_start);
+                        return;
+                    }
+                } while (OSApi::steady_clock_counter() < deadline);
+            }
+        }
+
+        for (uint_t i = 0; i < yield_times_; ++i) {
+            std::this_thread::yield();
+            if (has_events()) {
+                if (max_spin_ns_ > 0) {
+                    update_idle_gap(idle_start);
+                }
+                return;
+            }
+        }
+
+        //timedwait_flag_ٴμ, notify_if_parkedϱⶪʧ
+        bool ready;
+        {
+            std::unique_lock<std::mutex> lock(timedwait_mutex_);
+            timedwait_flag_.store(true);
+            ready = has_events();
+            if (!ready) {
+                timedwait_condition_.wait_for(lock, std::chrono::microseconds(timedwait_interval_us));
+            }
+            timedwait_flag_.store(false);
+        }
+        if (!ready) {
+            //ȡȴڼ䵽¼
+            event_queue_.swap_buffer();
+        }
+
+        if (max_spin_ns_ > 0) {
+            update_idle_gap(idle_start);
+        }
+    }
+
+    //ʱ¼ָƶƽ(Ȩ1/8)
+    inline void update_idle_gap(uint64_t idle_start)
+    {
+        int64_t gap = static_cast<int64_t>(OSApi::steady_clock_counter() - idle_start);
+        int64_t avg = static_cast<int64_t>(idle_gap_ns_);
+        idle_gap_ns_ = static_cast<uint64_t>(avg + (gap - avg) / 8);
+    }
+
     inline void check_timers(uint64_t current_clock_ms, SedaTimerExpireEvent *event)
     {
         int timer_size = (int)lru_timer_managers_.size();
@@ -169,10 +466,8 @@ private:
     {
         SedaStageThread<TSedaStageHandler, TQueue> *stage_thread = static_cast<SedaStageThread<TSedaStageHandler, TQueue> *>(arg);
         TSedaStageHandler &stage_handler = stage_thread->stage_handler_;
-        AtomicInt &timedwait_flag = stage_thread->timedwait_flag_;
-        Mutex &timedwait_mutex = stage_thread->timedwait_mutex_;
-        Condition &timedwait_condition = stage_thread->timedwait_condition_;
         TQueue &event_queue = stage_thread->event_queue_;
+        EventDispatcher dispatcher = { stage_thread };
         stage_handler.handle_open();
 
         uint64_t current_clock_ms    = OSApi::timestamp_ms();
@@ -189,7 +484,7 @@ private:
 
         if (timer_event_flag) {
             for (;;) {
-                event = event_queue.pop(stage_handler);
+                event = event_queue.pop(dispatcher);
                 if (nullptr != event) {
                     if (SedaEventTypeId::QUIT_EVENT != event->type()) {
                         ++timer_event_count;
@@ -207,38 +502,31 @@ private:
                     stage_thread->check_timers(current_clock_ms, &timer_expire_event);
                     timer_event_count = 0;
 
-                    if (!event_queue.swap_buffer()) {
-                        timedwait_flag.store(true);
-                        {
-                            std::unique_lock<std::mutex> lock(stage_thread->timedwait_mutex_);
-                            timedwait_condition.wait_for(lock, std::chrono::microseconds(timedwait_interval_us));
-                        }
-                        timedwait_flag.store(false);
-                        event_queue.swap_buffer();
+                    uint_t shared_count = stage_thread->run_shared_events();
+                    if (!event_queue.swap_buffer() && (0 == shared_count)) {
+                        stage_thread->idle_wait(timedwait_interval_us);
                     }
                 }
             }
         }
         else { // timer_event_flag == false
             for (;;) {
-                event = event_queue.pop(stage_handler);
+                event = event_queue.pop(dispatcher);
                 if (nullptr != event) {
                     if (SedaEventTypeId::QUIT_EVENT == event->type()) {
                         break;
                     }
                 }
-                else if (!event_queue.swap_buffer()) {
-                    timedwait_flag.store(true);
-                    {
-                        std::unique_lock<std::mutex> lock(timedwait_mutex);
-                        timedwait_condition.wait_for(lock, std::chrono::microseconds(timedwait_interval_us));
+                else {
+                    uint_t shared_count = stage_thread->run_shared_events();
+                    if (!event_queue.swap_buffer() && (0 == shared_count)) {
+                        stage_thread->idle_wait(timedwait_interval_us);
                     }
-                    timedwait_flag.store(false);
-                    event_queue.swap_buffer();
                 }
             }
         }
 
+        stage_thread->drain_shared_events();
         stage_handler.handle_close();
         return 0;
     }
@@ -260,7 +548,25 @@ private:
     AtomicBool                      timedwait_flag_;        //ʶ
     bool                            timedwait_signal_;      //ڿǷ񴥷ź(򴥷źűȽϺʱ)
 
+    //Ӧеȴ
+    uint64_t                        max_spin_ns_ = 0;       //(0:)
+    uint64_t                        idle_gap_ns_ = 0;       //¼ƶƽ
+    uint_t                          yield_times_ = 0;       //yieldĴ
+
     TQueue                          event_queue_;
+
+    //work stealing
+    const std::vector<SedaStageThread *>       *siblings_ = nullptr;   //Ϊnullptrʱδ
+    StealableEventTypeQueue<SpinlockMutex>      shared_queue_;          //ɱȡĹ
+    std::vector<char>                           steal_buffer_;          //ȡ¼ݴ滺
+    uint_t                                      steal_batch_size_ = 32;
+    uint_t                                      local_batch_size_ = 4;
+    AtomicUInt64                                stolen_count_ = { 0 };
+
+    //¼ŶʱӸ
+    const SedaEventAge             *event_age_ = nullptr;   //Ϊnullptrʱδ
+    SedaDelayHistogram              delay_histogram_;
+    AtomicUInt64                    expired_count_ = { 0 };
 };
 
 ZRSOCKET_NAMESPACE_END
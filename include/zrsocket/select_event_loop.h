@@ -51,7 +51,7 @@ public:
     }
 
     int init(uint_t num = 1, uint_t max_events = 10000, int event_mode = 0, 
-        uint_t event_queue_max_size = 100000, uint_t event_type_len = 8)
+        uint_t event_queue_max_size = 100000, uint_t event_type_len = 16)
     {
         return event_queue_.init(event_queue_max_size, event_type_len);
     }
@@ -161,6 +161,9 @@ public:
         }
 #endif
 
+        //先设置再加入: 加入后event_loop线程可能立即回调handler(接入线程与event_loop线程不同时)
+        handler->in_event_loop_ = true;
+        handler->event_loop_    = this;
         int add_event_mask = EventHandler::NULL_EVENT_MASK;
         if (event_mask & EventHandler::READ_EVENT_MASK) {
             FD_SET(handler->fd_, &fd_set_in_.read);
@@ -183,8 +186,6 @@ public:
             max_fd_ = handler->fd_;
         }
 #endif
-        handler->in_event_loop_ = true;
-        handler->event_loop_    = this;
         handler->event_mask_    = add_event_mask;
         temp_handlers_standby_->emplace(handler, ADD_HANDLER);
         mutex_.unlock();
@@ -414,6 +415,13 @@ public:
         return 0;
     }
 
+    int push_loop_call(LoopCallTask *task)
+    {
+        event_queue_.push_loop_call(task);
+        loop_wakeup();
+        return 0;
+    }
+
     int loop(int64_t timeout_us = -1)
     {
         EventHandler *handler;
@@ -445,6 +453,7 @@ public:
                     break;
                 case OperateCode::DEL_HANDLER:
                     handlers_.erase(handler);
+                    handler->generation_.fetch_add(1, std::memory_order_release);
                     handler->handle_close();
                     handler->source_->free_handler(handler);
                     break;
@@ -462,8 +471,9 @@ public:
         }
 
         int64_t min_interval = timer_queue_.min_interval();
-        if (min_interval > 0) {
-            timeout_us = std::min<int64_t>(min_interval, timeout_us);
+        if ((min_interval > 0) && ((timeout_us < 0) || (min_interval < timeout_us))) {
+            //有定时器时等待时间不超过最小定时间隔(timeout_us < 0表示无限等待)
+            timeout_us = min_interval;
         }
 
 #ifdef ZRSOCKET_OS_WINDOWS
@@ -551,11 +561,11 @@ public:
             }
         }
 
-        event_queue_.loop(event_queue_.capacity());
-        timer_queue_.loop(Time::instance().current_timestamp_us());
 #ifndef ZRSOCKET_OS_WINDOWS
         wakeup_flag_.store(true, std::memory_order_relaxed);
 #endif
+        event_queue_.loop(event_queue_.capacity());
+        timer_queue_.loop(Time::instance().current_timestamp_us());
 
         return num_events;
     }
@@ -664,7 +674,7 @@ private:
     AtomicBool          wakeup_flag_;
 #endif
 
-    EventLoopQueue<TQueue, EventTypeHandler> event_queue_;
+    EventLoopQueue<TQueue, TEventTypeHandler> event_queue_;
     TLoopData loop_data_;
 };
 
@@ -0,0 +1,204 @@
+﻿// Some compilers (e.g. VC++) benefit significantly from using this. 
+// We've measured 3-4% build speed improvements in apps as a result 
+#pragma once
+
+#ifndef ZRSOCKET_SEND_EVENT_H
+#define ZRSOCKET_SEND_EVENT_H
+#include <atomic>
+#include <vector>
+#include "config.h"
+#include "base_type.h"
+#include "byte_buffer.h"
+#include "event_type.h"
+#include "event_handler.h"
+
+ZRSOCKET_NAMESPACE_BEGIN
+
+// 跨线程发送的目标连接: 记录投递时handler的代数, 执行时不一致(连接已关闭或已被复用)则不发送
+struct SendTarget
+{
+    EventHandler *handler_;
+    uint64_t      generation_;
+
+    inline bool valid() const
+    {
+        return handler_->generation() == generation_;
+    }
+};
+
+// 广播任务: 同一个event_loop上的一组handler共享同一个SharedBuffer
+//  由生产者线程new, 由所属event_loop线程处理完后delete
+struct BroadcastTask
+{
+    SharedBuffer                buffer_;
+    std::vector<SendTarget>     targets_;
+};
+
+// 跨线程发送任务: 一个handler的一批待发送数据
+//  由生产者线程new, 由所属event_loop线程处理完后delete
+struct PostSendTask
+{
+    SendTarget                  target_;
+    std::vector<SharedBuffer>   buffers_;
+};
+
+// event_loop线程回调任务: 由其它线程(如SEDA stage线程)new并填写proc_, 投递到所属event_loop后在其线程中调用proc_
+//  proc_负责释放任务(通常为派生类对象)
+struct LoopCallTask;
+typedef void (*LoopCallProc)(LoopCallTask *task);
+struct LoopCallTask
+{
+    LoopCallProc  proc_ = nullptr;
+    LoopCallTask *next_ = nullptr;  //事件队列满时链入LoopCallOverflow
+};
+
+// LoopCallTask的溢出链表(无锁, 多生产者/单消费者): 事件队列满时任务链入此表, 由event_loop线程处理事件队列时执行
+//  任务由投递方分配, 入表不分配内存也不会失败, 投递线程(如SEDA stage线程)不需要等待event_loop
+class LoopCallOverflow
+{
+public:
+    LoopCallOverflow() = default;
+    ~LoopCallOverflow() = default;
+
+    inline void push(LoopCallTask *task)
+    {
+        LoopCallTask *head = head_.load(std::memory_order_relaxed);
+        do {
+            task->next_ = head;
+        } while (!head_.compare_exchange_weak(head, task, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    //按投递顺序执行所有任务(proc_负责释放任务), 返回执行的任务数
+    inline int run()
+    {
+        if (nullptr == head_.load(std::memory_order_relaxed)) {
+            return 0;
+        }
+        LoopCallTask *task = head_.exchange(nullptr, std::memory_order_acquire);
+        LoopCallTask *ordered = nullptr;
+        while (nullptr != task) {
+            LoopCallTask *next = task->next_;
+            task->next_ = ordered;
+            ordered = task;
+            task = next;
+        }
+        int count = 0;
+        while (nullptr != ordered) {
+            LoopCallTask *next = ordered->next_;
+            ordered->proc_(ordered);
+            ordered = next;
+            ++count;
+        }
+        return count;
+    }
+
+private:
+    std::atomic<LoopCallTask *> head_ { nullptr };
+};
+
+// 广播事件(只携带任务指针, 事件槽长度event_type_len需>=sizeof(TcpBroadcastEvent))
+struct TcpBroadcastEvent : public FixedSizeEventBase<TcpBroadcastEvent, EventTypeId::TCP_BROADCAST>
+{
+    inline TcpBroadcastEvent(BroadcastTask *task)
+        : task_(task)
+    {
+    }
+
+    inline ~TcpBroadcastEvent() = default;
+
+    BroadcastTask *task_;
+};
+
+// 跨线程发送事件(只携带任务指针)
+struct TcpPostSendEvent : public FixedSizeEventBase<TcpPostSendEvent, EventTypeId::TCP_POST_SEND>
+{
+    inline TcpPostSendEvent(PostSendTask *task)
+        : task_(task)
+    {
+    }
+
+    inline ~TcpPostSendEvent() = default;
+
+    PostSendTask *task_;
+};
+
+// event_loop线程回调事件(只携带任务指针)
+struct LoopCallEvent : public FixedSizeEventBase<LoopCallEvent, EventTypeId::LOOP_CALL>
+{
+    inline LoopCallEvent(LoopCallTask *task)
+        : task_(task)
+    {
+    }
+
+    inline ~LoopCallEvent() = default;
+
+    LoopCallTask *task_;
+};
+
+// event_loop内置事件的分发器
+//  在event_loop线程中处理发送类事件, 其余事件转交给用户的TEventTypeHandler
+template <class TEventTypeHandler>
+class SendEventDispatcher
+{
+public:
+    SendEventDispatcher() = default;
+    ~SendEventDispatcher() = default;
+
+    inline int handle_event(const EventType *event)
+    {
+        switch (event->type()) {
+            case EventTypeId::TCP_BROADCAST:
+                return handle_broadcast(static_cast<const TcpBroadcastEvent *>(event));
+            case EventTypeId::TCP_POST_SEND:
+                return handle_post_send(static_cast<const TcpPostSendEvent *>(event));
+            case EventTypeId::LOOP_CALL:
+                return handle_loop_call(static_cast<const LoopCallEvent *>(event));
+            default:
+                return handler_.handle_event(event);
+        }
+    }
+
+    inline TEventTypeHandler & handler()
+    {
+        return handler_;
+    }
+
+private:
+    inline int handle_broadcast(const TcpBroadcastEvent *event)
+    {
+        BroadcastTask *task = event->task_;
+        int count = 0;
+        for (auto &target : task->targets_) {
+            if (target.valid() && (target.handler_->handle_send_buffers(&task->buffer_, 1) >= 0)) {
+                ++count;
+            }
+        }
+        delete task;
+        return count;
+    }
+
+    inline int handle_post_send(const TcpPostSendEvent *event)
+    {
+        PostSendTask *task = event->task_;
+        int ret = -1;
+        if (task->target_.valid()) {
+            ret = task->target_.handler_->handle_send_buffers(task->buffers_.data(), static_cast<uint_t>(task->buffers_.size()));
+        }
+        delete task;
+        return ret;
+    }
+
+    inline int handle_loop_call(const LoopCallEvent *event)
+    {
+        LoopCallTask *task = event->task_;
+        task->proc_(task);
+        return 0;
+    }
+
+private:
+    TEventTypeHandler handler_;
+};
+
+ZRSOCKET_NAMESPACE_END
+
+#endif
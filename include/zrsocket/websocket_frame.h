@@ -0,0 +1,377 @@
+﻿// Some compilers (e.g. VC++) benefit significantly from using this. 
+// We've measured 3-4% build speed improvements in apps as a result 
+#pragma once
+
+#ifndef ZRSOCKET_WEBSOCKET_FRAME_H
+#define ZRSOCKET_WEBSOCKET_FRAME_H
+#include <cstring>
+#include "config.h"
+#include "base_type.h"
+#include "byte_buffer.h"
+
+ZRSOCKET_NAMESPACE_BEGIN
+
+//WebSocket(RFC 6455)帧类型
+enum class WebSocketOpcode
+{
+    kContinuation = 0x0,
+    kText         = 0x1,
+    kBinary       = 0x2,
+    kClose        = 0x8,
+    kPing         = 0x9,
+    kPong         = 0xA,
+};
+
+//关闭码
+enum class WebSocketCloseCode
+{
+    kNormal          = 1000,
+    kGoingAway       = 1001,
+    kProtocolError   = 1002,
+    kUnsupportedData = 1003,
+    kNoStatus        = 1005,    //只用于本地回调: close帧没有关闭码
+    kAbnormal        = 1006,    //只用于本地回调: 连接异常断开
+    kInvalidPayload  = 1007,
+    kPolicyViolation = 1008,
+    kMessageTooBig   = 1009,
+    kInternalError   = 1011,
+};
+
+struct WebSocketFrameHeader
+{
+    bool            fin_;
+    bool            masked_;
+    uint8_t         rsv_;               //RSV1-3(未协商扩展时须为0)
+    uint8_t         opcode_;
+    uint32_t        mask_;              //masking-key的内存序值(见Simd::xor_mask)
+    uint64_t        payload_length_;
+};
+
+class WebSocketFrame
+{
+public:
+    enum
+    {
+        MAX_HEADER_LENGTH           = 14,   //2 + 8(扩展长度) + 4(masking-key)
+        MAX_CONTROL_PAYLOAD_LENGTH  = 125,
+        ACCEPT_LENGTH               = 28,   //Sec-WebSocket-Accept: base64(SHA-1)
+    };
+
+    static inline bool is_control(uint8_t opcode)
+    {
+        return (opcode & 0x8) != 0;
+    }
+
+    //解析帧头, 返回值 >0: 帧头长度; 0: 数据不足; <0: 非法长度(64位长度最高位为1)
+    static int parse_header(const char *data, uint_t len, WebSocketFrameHeader &header)
+    {
+        if (len < 2) {
+            return 0;
+        }
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+        header.fin_    = (p[0] & 0x80) != 0;
+        header.rsv_    = (p[0] >> 4) & 0x07;
+        header.opcode_ = p[0] & 0x0F;
+        header.masked_ = (p[1] & 0x80) != 0;
+        uint64_t payload_length = p[1] & 0x7F;
+        uint_t header_length = 2;
+        if (126 == payload_length) {
+            header_length += 2;
+            if (len < header_length) {
+                return 0;
+            }
+            payload_length = (static_cast<uint64_t>(p[2]) << 8) | p[3];
+        }
+        else if (127 == payload_length) {
+            header_length += 8;
+            if (len < header_length) {
+                return 0;
+            }
+            if (p[2] & 0x80) {
+                return -1;
+            }
+            payload_length = 0;
+            for (uint_t i = 2; i < 10; ++i) {
+                payload_length = (payload_length << 8) | p[i];
+            }
+        }
+        header.payload_length_ = payload_length;
+        header.mask_ = 0;
+        if (header.masked_) {
+            if (len < header_length + 4) {
+                return 0;
+            }
+            std::memcpy(&header.mask_, data + header_length, 4);
+            header_length += 4;
+        }
+        return static_cast<int>(header_length);
+    }
+
+    //服务端帧头(不带掩码)的长度
+    static inline uint_t header_length(uint64_t payload_length)
+    {
+        return (payload_length < 126) ? 2 : ((payload_length <= 0xFFFF) ? 4 : 10);
+    }
+
+    //写入服务端帧头(不带掩码), 返回帧头长度
+    static uint_t write_header(char *header, WebSocketOpcode opcode, bool fin, uint64_t payload_length)
+    {
+        unsigned char *p = reinterpret_cast<unsigned char *>(header);
+        p[0] = static_cast<unsigned char>((fin ? 0x80 : 0) | static_cast<uint8_t>(opcode));
+        if (payload_length < 126) {
+            p[1] = static_cast<unsigned char>(payload_length);
+            return 2;
+        }
+        if (payload_length <= 0xFFFF) {
+            p[1] = 126;
+            p[2] = static_cast<unsigned char>(payload_length >> 8);
+            p[3] = static_cast<unsigned char>(payload_length);
+            return 4;
+        }
+        p[1] = 127;
+        for (int i = 9; i >= 2; --i) {
+            p[i] = static_cast<unsigned char>(payload_length);
+            payload_length >>= 8;
+        }
+        return 10;
+    }
+
+    template <class TBuffer>
+    static inline void write_frame(TBuffer &out, WebSocketOpcode opcode, const char *data, uint_t len, bool fin = true)
+    {
+        char header[MAX_HEADER_LENGTH];
+        out.write(header, write_header(header, opcode, fin, len));
+        if (len > 0) {
+            out.write(data, len);
+        }
+    }
+
+    //close帧: code为0时不带关闭码(及原因)
+    template <class TBuffer>
+    static void write_close(TBuffer &out, uint16_t code, const char *reason = nullptr, uint_t reason_len = 0)
+    {
+        char payload[MAX_CONTROL_PAYLOAD_LENGTH];
+        uint_t len = 0;
+        if (0 != code) {
+            if (reason_len > MAX_CONTROL_PAYLOAD_LENGTH - 2) {
+                reason_len = MAX_CONTROL_PAYLOAD_LENGTH - 2;
+            }
+            payload[0] = static_cast<char>(code >> 8);
+            payload[1] = static_cast<char>(code);
+            if (reason_len > 0) {
+                std::memcpy(payload + 2, reason, reason_len);
+            }
+            len = 2 + reason_len;
+        }
+        write_frame(out, WebSocketOpcode::kClose, payload, len);
+    }
+
+    //生成一个完整的服务端帧(用于广播): 服务端帧不带掩码, 同一份数据可发送给任意多个连接
+    //  如: EventLoopGroup::broadcast(frame, handlers)
+    static void make_frame(SharedBuffer &frame, WebSocketOpcode opcode, const char *data, uint_t len)
+    {
+        frame.reset();
+        frame.reserve(header_length(len) + len);
+        write_frame(frame, opcode, data, len);
+    }
+
+    //对端close帧中的关闭码是否合法
+    static inline bool valid_close_code(uint16_t code)
+    {
+        if ((code >= 3000) && (code <= 4999)) {
+            return true;
+        }
+        switch (code) {
+        case 1000:
+        case 1001:
+        case 1002:
+        case 1003:
+        case 1007:
+        case 1008:
+        case 1009:
+        case 1010:
+        case 1011:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    //UTF-8校验(拒绝overlong/代理区/大于U+10FFFF), 8字节一组的ASCII快速路径
+    static bool valid_utf8(const char *data, uint_t len)
+    {
+        const unsigned char *p   = reinterpret_cast<const unsigned char *>(data);
+        const unsigned char *end = p + len;
+        uint64_t block;
+        while (p < end) {
+            if (end - p >= 8) {
+                std::memcpy(&block, p, 8);
+                if (0 == (block & 0x8080808080808080ULL)) {
+                    p += 8;
+                    continue;
+                }
+            }
+            unsigned char c = *p;
+            if (c < 0x80) {
+                ++p;
+                continue;
+            }
+            uint_t n;
+            unsigned char lower = 0x80;
+            unsigned char upper = 0xBF;
+            if ((c >= 0xC2) && (c <= 0xDF)) {
+                n = 1;
+            }
+            else if ((c >= 0xE0) && (c <= 0xEF)) {
+                n = 2;
+                if (0xE0 == c) {
+                    lower = 0xA0;
+                }
+                else if (0xED == c) {
+                    upper = 0x9F;
+                }
+            }
+            else if ((c >= 0xF0) && (c <= 0xF4)) {
+                n = 3;
+                if (0xF0 == c) {
+                    lower = 0x90;
+                }
+                else if (0xF4 == c) {
+                    upper = 0x8F;
+                }
+            }
+            else {
+                return false;
+            }
+            if (static_cast<uint_t>(end - p) <= n) {
+                return false;
+            }
+            if ((p[1] < lower) || (p[1] > upper)) {
+                return false;
+            }
+            for (uint_t i = 2; i <= n; ++i) {
+                if ((p[i] & 0xC0) != 0x80) {
+                    return false;
+                }
+            }
+            p += n + 1;
+        }
+        return true;
+    }
+
+    //握手: Sec-WebSocket-Accept = base64(SHA-1(Sec-WebSocket-Key + GUID))
+    static void accept_key(const char *key, uint_t key_len, char accept[ACCEPT_LENGTH])
+    {
+        static const char guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+        char input[128];
+        uint_t input_len = 0;
+        if (key_len > sizeof(input) - (sizeof(guid) - 1)) {
+            key_len = sizeof(input) - (sizeof(guid) - 1);
+        }
+        std::memcpy(input, key, key_len);
+        input_len = key_len;
+        std::memcpy(input + input_len, guid, sizeof(guid) - 1);
+        input_len += sizeof(guid) - 1;
+
+        unsigned char digest[20];
+        sha1(reinterpret_cast<const unsigned char *>(input), input_len, digest);
+
+        static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        char *out = accept;
+        uint_t i = 0;
+        for (; i + 3 <= 20; i += 3) {
+            uint32_t bits = (static_cast<uint32_t>(digest[i]) << 16) | (static_cast<uint32_t>(digest[i + 1]) << 8) | digest[i + 2];
+            *out++ = table[(bits >> 18) & 0x3F];
+            *out++ = table[(bits >> 12) & 0x3F];
+            *out++ = table[(bits >> 6) & 0x3F];
+            *out++ = table[bits & 0x3F];
+        }
+        //剩余2字节
+        uint32_t bits = (static_cast<uint32_t>(digest[i]) << 16) | (static_cast<uint32_t>(digest[i + 1]) << 8);
+        *out++ = table[(bits >> 18) & 0x3F];
+        *out++ = table[(bits >> 12) & 0x3F];
+        *out++ = table[(bits >> 6) & 0x3F];
+        *out++ = '=';
+    }
+
+private:
+    static inline uint32_t rotl(uint32_t value, uint_t bits)
+    {
+        return (value << bits) | (value >> (32 - bits));
+    }
+
+    //SHA-1(只用于握手, 输入很短)
+    static void sha1(const unsigned char *data, uint_t len, unsigned char digest[20])
+    {
+        uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+        uint64_t bit_len = static_cast<uint64_t>(len) * 8;
+        uint_t total = ((len + 8) / 64 + 1) * 64;
+        unsigned char block[64];
+        uint32_t w[80];
+        for (uint_t offset = 0; offset < total; offset += 64) {
+            for (uint_t i = 0; i < 64; ++i) {
+                uint_t pos = offset + i;
+                if (pos < len) {
+                    block[i] = data[pos];
+                }
+                else if (pos == len) {
+                    block[i] = 0x80;
+                }
+                else if (pos >= total - 8) {
+                    block[i] = static_cast<unsigned char>(bit_len >> ((total - 1 - pos) * 8));
+                }
+                else {
+                    block[i] = 0;
+                }
+            }
+            for (uint_t i = 0; i < 16; ++i) {
+                w[i] = (static_cast<uint32_t>(block[i * 4]) << 24) | (static_cast<uint32_t>(block[i * 4 + 1]) << 16) |
+                       (static_cast<uint32_t>(block[i * 4 + 2]) << 8) | block[i * 4 + 3];
+            }
+            for (uint_t i = 16; i < 80; ++i) {
+                w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+            }
+            uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+            for (uint_t i = 0; i < 80; ++i) {
+                uint32_t f, k;
+                if (i < 20) {
+                    f = (b & c) | (~b & d);
+                    k = 0x5A827999;
+                }
+                else if (i < 40) {
+                    f = b ^ c ^ d;
+                    k = 0x6ED9EBA1;
+                }
+                else if (i < 60) {
+                    f = (b & c) | (b & d) | (c & d);
+                    k = 0x8F1BBCDC;
+                }
+                else {
+                    f = b ^ c ^ d;
+                    k = 0xCA62C1D6;
+                }
+                uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = rotl(b, 30);
+                b = a;
+                a = temp;
+            }
+            h[0] += a;
+            h[1] += b;
+            h[2] += c;
+            h[3] += d;
+            h[4] += e;
+        }
+        for (uint_t i = 0; i < 5; ++i) {
+            digest[i * 4]     = static_cast<unsigned char>(h[i] >> 24);
+            digest[i * 4 + 1] = static_cast<unsigned char>(h[i] >> 16);
+            digest[i * 4 + 2] = static_cast<unsigned char>(h[i] >> 8);
+            digest[i * 4 + 3] = static_cast<unsigned char>(h[i]);
+        }
+    }
+};
+
+ZRSOCKET_NAMESPACE_END
+
+#endif
@@ -0,0 +1,437 @@
+﻿// Some compilers (e.g. VC++) benefit significantly from using this. 
+// We've measured 3-4% build speed improvements in apps as a result 
+#pragma once
+
+#ifndef ZRSOCKET_WEBSOCKET_HANDLER_H
+#define ZRSOCKET_WEBSOCKET_HANDLER_H
+#include <cstring>
+#include "config.h"
+#include "base_type.h"
+#include "byte_buffer.h"
+#include "buffer_pool.h"
+#include "simd.h"
+#include "http_common.h"
+#include "http_request_handler.h"
+#include "websocket_frame.h"
+
+ZRSOCKET_NAMESPACE_BEGIN
+
+class WebSocketDecoderConfig : public HttpDecoderConfig
+{
+public:
+    WebSocketDecoderConfig() = default;
+    virtual ~WebSocketDecoderConfig() = default;
+
+    //是否接受"Upgrade: websocket"请求
+    bool   websocket_enable_        = true;
+    uint_t max_ws_message_length_   = 1048576;  //一个消息(分片合并后)的最大长度, 超过时以1009关闭
+    bool   utf8_check_              = true;     //校验文本消息及关闭原因是否为UTF-8
+};
+
+//WebSocket服务端: 在HttpRequestHandler上增加WebSocket, 同一个handler同时服务普通HTTP请求
+//  "Upgrade: websocket"握手通过(do_handshake返回0)后回复101, 之后的数据按WebSocket帧处理
+//  客户端帧在接收缓存中原地去掩码(SIMD); 完整落在一次接收中的未分片消息直接以接收缓存回调do_ws_message(不拷贝),
+//  分片消息/跨接收的帧合并到消息缓存(BufferPool)后回调
+//  ping自动回复pong; 收到close时回复close后关闭连接
+//  广播: WebSocketFrame::make_frame生成一次帧(服务端帧不带掩码), EventLoopGroup::broadcast投递给各连接,
+//  各连接直接从同一个SharedBuffer发送
+//  需使用WebSocketDecoderConfig作为message_decoder_config
+//  TBase为普通HTTP请求的处理(HttpRequestHandler或叠加了分层的HttpRequestHandler, 如HttpOffloadHandler<HttpRequestHandler<...> >)
+template <class TBuffer, class TMutex, class TBase = HttpRequestHandler<TBuffer, TMutex> >
+class WebSocketHandler : public TBase
+{
+public:
+    using super = TBase;
+
+    WebSocketHandler() = default;
+    virtual ~WebSocketHandler() = default;
+
+    //握手: context_为升级请求, 可在context_.response_.headers_中加入101回复的header(如Sec-WebSocket-Protocol)
+    //返回值
+    // > 0: 不升级, 按普通请求由do_message处理
+    //== 0: 接受
+    // < 0: 出现异常关闭连接
+    virtual int do_handshake()
+    {
+        return 0;
+    }
+
+    //已升级为WebSocket(101已回复)
+    virtual int do_ws_open()
+    {
+        return 0;
+    }
+
+    //完整消息(kText/kBinary): data在回调返回后失效
+    //返回值 < 0: 出现异常关闭连接
+    virtual int do_ws_message(WebSocketOpcode opcode, const char *data, uint_t len)
+    {
+        return 0;
+    }
+
+    virtual int do_ws_pong(const char *data, uint_t len)
+    {
+        return 0;
+    }
+
+    //收到对端close(回调返回后回复close并关闭连接), 没有关闭码时code为1005
+    virtual int do_ws_close(uint16_t code, const char *reason, uint_t len)
+    {
+        return 0;
+    }
+
+    //连接是否已升级为WebSocket
+    inline bool websocket() const
+    {
+        return ws_;
+    }
+
+    //发送一个帧: 分片发送时第一帧为kText/kBinary, 之后为kContinuation, 最后一帧fin为true
+    //  须在所属event_loop线程中调用; 已发送close后返回-1
+    int send_frame(WebSocketOpcode opcode, const char *data, uint_t len, bool fin = true)
+    {
+        if (!ws_ || close_sent_) {
+            return -1;
+        }
+        ByteBuffer &out = super::stream_out();
+        WebSocketFrame::write_frame(out, opcode, data, len, fin);
+        output(out);
+        return 0;
+    }
+
+    inline int send_text(const char *data, uint_t len)
+    {
+        return send_frame(WebSocketOpcode::kText, data, len);
+    }
+
+    inline int send_binary(const char *data, uint_t len)
+    {
+        return send_frame(WebSocketOpcode::kBinary, data, len);
+    }
+
+    inline int send_ping(const char *data = nullptr, uint_t len = 0)
+    {
+        if (len > WebSocketFrame::MAX_CONTROL_PAYLOAD_LENGTH) {
+            return -1;
+        }
+        return send_frame(WebSocketOpcode::kPing, data, len);
+    }
+
+    //发送close, 收到对端的close后关闭连接
+    int send_close(uint16_t code = static_cast<uint16_t>(WebSocketCloseCode::kNormal), const char *reason = nullptr, uint_t reason_len = 0)
+    {
+        if (!ws_ || close_sent_) {
+            return -1;
+        }
+        ByteBuffer &out = super::stream_out();
+        WebSocketFrame::write_close(out, code, reason, reason_len);
+        close_sent_ = true;
+        output(out);
+        return 0;
+    }
+
+    int handle_open()
+    {
+        ws_ = false;
+        reset_ws();
+        return super::handle_open();
+    }
+
+protected:
+    //"Upgrade: websocket": 校验握手请求, 回复101
+    //  不合法的握手请求不升级(按普通请求处理)
+    int do_upgrade()
+    {
+        WebSocketDecoderConfig *config = static_cast<WebSocketDecoderConfig *>(super::source_->message_decoder_config());
+        HttpRequest &request = super::context_.request_;
+        const HttpHeader *upgrade    = request.headers_.known(HttpKnownHeader::kUpgrade);
+        const HttpHeader *connection = request.headers_.known(HttpKnownHeader::kConnection);
+        if (!config->websocket_enable_ || !upgrade->value_.has_token("websocket", 9) ||
+            (nullptr == connection) || !connection->value_.has_token("Upgrade", 7) ||
+            (HttpMethodId::kGET != request.method_id_) || (request.content_length_ > 0) || request.chunked_) {
+            return 0;
+        }
+        HttpStringView key = request.header("Sec-WebSocket-Key", sizeof("Sec-WebSocket-Key") - 1);
+        if ((24 != key.len_) || !request.header("Sec-WebSocket-Version", sizeof("Sec-WebSocket-Version") - 1).equals("13", 2)) {
+            return 0;
+        }
+
+        int ret = do_handshake();
+        if (ret != 0) {
+            return (ret < 0) ? -1 : 0;
+        }
+
+        char accept[WebSocketFrame::ACCEPT_LENGTH];
+        WebSocketFrame::accept_key(key.data_, key.len_, accept);
+        ByteBuffer &out = *super::batch_out_;
+        static const char switching[] = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: ";
+        out.write(switching, sizeof(switching) - 1);
+        out.write(accept, WebSocketFrame::ACCEPT_LENGTH);
+        out.write("\r\n", 2);
+        for (auto &header : super::context_.response_.headers_) {
+            out.write(header.name_.data_, header.name_.len_);
+            out.write(": ", 2);
+            out.write(header.value_.data_, header.value_.len_);
+            out.write("\r\n", 2);
+        }
+        out.write("\r\n", 2);
+
+        ws_ = true;
+        reset_ws();
+        return (do_ws_open() < 0) ? -1 : 1;
+    }
+
+    //WebSocket帧接收
+    //  data指向接收缓存(或本handler的缓存), 可写: payload原地去掩码
+    int decode_upgraded(const char *data, uint_t len)
+    {
+        if (!ws_) {
+            return -1;
+        }
+        WebSocketDecoderConfig *config = static_cast<WebSocketDecoderConfig *>(super::source_->message_decoder_config());
+        ByteBuffer &out = *super::batch_out_;
+        char *p   = const_cast<char *>(data);
+        char *end = p + len;
+        do {
+            if (!in_frame_) { //begin: parse header
+                int header_len;
+                if (0 == header_len_) {
+                    header_len = WebSocketFrame::parse_header(p, static_cast<uint_t>(end - p), frame_);
+                    if (0 == header_len) {
+                        //帧头跨越多次接收
+                        header_len_ = static_cast<uint_t>(end - p);
+                        std::memcpy(header_, p, header_len_);
+                        return 1;
+                    }
+                }
+                else {
+                    uint_t last_len = header_len_;
+                    uint_t need_len = std::min<uint_t>(static_cast<uint_t>(end - p), WebSocketFrame::MAX_HEADER_LENGTH - last_len);
+                    std::memcpy(header_ + last_len, p, need_len);
+                    header_len_ += need_len;
+                    header_len = WebSocketFrame::parse_header(header_, header_len_, frame_);
+                    if (0 == header_len) {
+                        return 1;
+                    }
+                    if (header_len > 0) {
+                        header_len -= static_cast<int>(last_len);
+                    }
+                    header_len_ = 0;
+                }
+                if (header_len < 0) {
+                    return fail(out, WebSocketCloseCode::kProtocolError);
+                }
+                p += header_len;
+
+                WebSocketCloseCode error_code = check_frame(config);
+                if (WebSocketCloseCode::kNormal != error_code) {
+                    return fail(out, error_code);
+                }
+                in_frame_     = true;
+                frame_offset_ = 0;
+            } //end: parse header
+
+            //begin: parse payload
+            uint64_t frame_remain = frame_.payload_length_ - frame_offset_;
+            uint_t payload_len = static_cast<uint_t>(std::min<uint64_t>(static_cast<uint64_t>(end - p), frame_remain));
+            Simd::xor_mask(p, payload_len, Simd::rotate_mask(frame_.mask_, frame_offset_));
+            const char *payload = p;
+            bool whole = (0 == frame_offset_) && (payload_len == frame_remain);
+            p += payload_len;
+            if (WebSocketFrame::is_control(frame_.opcode_)) {
+                if (!whole) {
+                    std::memcpy(control_ + frame_offset_, payload, payload_len);
+                    payload = control_;
+                }
+                frame_offset_ += payload_len;
+                if (frame_offset_ == frame_.payload_length_) {
+                    in_frame_ = false;
+                    int ret = process_control(config, out, payload, static_cast<uint_t>(frame_.payload_length_));
+                    if (ret < 0) {
+                        return ret;
+                    }
+                }
+            }
+            else {
+                frame_offset_ += payload_len;
+                ByteBuffer &message_buffer = super::message_handler::message_buffer_;
+                bool complete = (frame_offset_ == frame_.payload_length_);
+                if (complete && frame_.fin_ && whole && message_buffer.empty()) {
+                    //未分片且完整落在本次接收中: 直接回调
+                    in_frame_ = false;
+                    if (deliver(config, out, payload, payload_len) < 0) {
+                        return -1;
+                    }
+                }
+                else {
+                    if (payload_len > 0) {
+                        super::message_handler::write_message_buffer(payload, payload_len, static_cast<uint_t>(frame_.payload_length_));
+                    }
+                    if (complete) {
+                        in_frame_ = false;
+                        if (frame_.fin_) {
+                            int ret = deliver(config, out, message_buffer.data(), message_buffer.data_size());
+                            super::message_handler::release_message_buffer();
+                            if (ret < 0) {
+                                return -1;
+                            }
+                        }
+                    }
+                }
+            }
+            //end: parse payload
+        } while (p < end);
+
+        return 1;
+    }
+
+    //帧头校验, 返回kNormal: 合法
+    WebSocketCloseCode check_frame(WebSocketDecoderConfig *config)
+    {
+        if ((0 != frame_.rsv_) || !frame_.masked_) {
+            return WebSocketCloseCode::kProtocolError;
+        }
+        switch (static_cast<WebSocketOpcode>(frame_.opcode_)) {
+        case WebSocketOpcode::kContinuation:
+            if (!fragmented_) {
+                return WebSocketCloseCode::kProtocolError;
+            }
+            if (frame_.payload_length_ + super::message_handler::message_buffer_.data_size() > config->max_ws_message_length_) {
+                return WebSocketCloseCode::kMessageTooBig;
+            }
+            if (frame_.fin_) {
+                fragmented_ = false;
+            }
+            return WebSocketCloseCode::kNormal;
+        case WebSocketOpcode::kText:
+        case WebSocketOpcode::kBinary:
+            if (fragmented_) {
+                return WebSocketCloseCode::kProtocolError;
+            }
+            if (frame_.payload_length_ > config->max_ws_message_length_) {
+                return WebSocketCloseCode::kMessageTooBig;
+            }
+            message_opcode_ = static_cast<WebSocketOpcode>(frame_.opcode_);
+            fragmented_     = !frame_.fin_;
+            return WebSocketCloseCode::kNormal;
+        case WebSocketOpcode::kClose:
+        case WebSocketOpcode::kPing:
+        case WebSocketOpcode::kPong:
+            if (!frame_.fin_ || (frame_.payload_length_ > WebSocketFrame::MAX_CONTROL_PAYLOAD_LENGTH)) {
+                return WebSocketCloseCode::kProtocolError;
+            }
+            return WebSocketCloseCode::kNormal;
+        default:
+            return WebSocketCloseCode::kProtocolError;
+        }
+    }
+
+    //完整消息
+    int deliver(WebSocketDecoderConfig *config, ByteBuffer &out, const char *data, uint_t len)
+    {
+        if (close_sent_) {
+            //已发送close: 丢弃之后的消息
+            return 0;
+        }
+        if (config->utf8_check_ && (WebSocketOpcode::kText == message_opcode_) && !WebSocketFrame::valid_utf8(data, len)) {
+            return fail(out, WebSocketCloseCode::kInvalidPayload);
+        }
+        return (do_ws_message(message_opcode_, data, len) < 0) ? -1 : 0;
+    }
+
+    int process_control(WebSocketDecoderConfig *config, ByteBuffer &out, const char *data, uint_t len)
+    {
+        switch (static_cast<WebSocketOpcode>(frame_.opcode_)) {
+        case WebSocketOpcode::kPing:
+            if (!close_sent_) {
+                WebSocketFrame::write_frame(out, WebSocketOpcode::kPong, data, len);
+            }
+            return 0;
+        case WebSocketOpcode::kPong:
+            return (do_ws_pong(data, len) < 0) ? -1 : 0;
+        default:
+            break;
+        }
+
+        //close
+        uint16_t code = static_cast<uint16_t>(WebSocketCloseCode::kNoStatus);
+        if (1 == len) {
+            return fail(out, WebSocketCloseCode::kProtocolError);
+        }
+        if (len >= 2) {
+            code = static_cast<uint16_t>((static_cast<unsigned char>(data[0]) << 8) | static_cast<unsigned char>(data[1]));
+            if (!WebSocketFrame::valid_close_code(code)) {
+                return fail(out, WebSocketCloseCode::kProtocolError);
+            }
+            if (config->utf8_check_ && !WebSocketFrame::valid_utf8(data + 2, len - 2)) {
+                return fail(out, WebSocketCloseCode::kInvalidPayload);
+            }
+            do_ws_close(code, data + 2, len - 2);
+        }
+        else {
+            do_ws_close(code, nullptr, 0);
+        }
+
+        //关闭握手: 回复close(之前未发送时)后由服务端先关闭TCP连接
+        if (!close_sent_) {
+            close_sent_ = true;
+            WebSocketFrame::write_close(out, (len >= 2) ? code : 0);
+        }
+        return close_connection(out);
+    }
+
+    //连接错误: 发送close后关闭连接
+    int fail(ByteBuffer &out, WebSocketCloseCode code)
+    {
+        if (!close_sent_) {
+            close_sent_ = true;
+            WebSocketFrame::write_close(out, static_cast<uint16_t>(code));
+        }
+        return close_connection(out);
+    }
+
+    //decode返回<0时批量发送缓存被丢弃: 先直接发送
+    inline int close_connection(ByteBuffer &out)
+    {
+        if (!out.empty()) {
+            super::message_handler::send(out.data(), out.data_size());
+            out.reset();
+        }
+        return -1;
+    }
+
+    //decode中随本次接收的其它数据一起发送, 否则直接发送
+    inline void output(ByteBuffer &out)
+    {
+        if ((nullptr == super::batch_out_) && !out.empty()) {
+            super::message_handler::send(out.data(), out.data_size());
+            out.reset();
+        }
+    }
+
+    inline void reset_ws()
+    {
+        close_sent_     = false;
+        fragmented_     = false;
+        in_frame_       = false;
+        header_len_     = 0;
+        frame_offset_   = 0;
+        message_opcode_ = WebSocketOpcode::kText;
+    }
+
+protected:
+    bool            ws_         = false;        //连接已升级为WebSocket
+    bool            close_sent_ = false;        //已发送close
+    bool            fragmented_ = false;        //分片消息接收中(消息缓存中为已接收的分片)
+    bool            in_frame_   = false;        //帧头已解析, payload接收中
+    WebSocketOpcode message_opcode_ = WebSocketOpcode::kText;
+    WebSocketFrameHeader frame_;                //当前帧
+    uint64_t        frame_offset_ = 0;          //当前帧已接收的payload长度
+    uint_t          header_len_   = 0;          //跨接收的帧头已接收的长度
+    char            header_[WebSocketFrame::MAX_HEADER_LENGTH];
+    char            control_[WebSocketFrame::MAX_CONTROL_PAYLOAD_LENGTH];   //跨接收的控制帧payload
+};
+
+ZRSOCKET_NAMESPACE_END
+
+#endif
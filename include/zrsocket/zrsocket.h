@@ -8,9 +8,11 @@
 #include "config.h"
 #include "atomic.h"
 #include "byte_buffer.h"
+#include "buffer_pool.h"
 #include "base_type.h"
 #include "malloc.h"
 #include "memory.h"
+#include "simd.h"
 #include "object_pool.h"
 #include "mutex.h"
 #include "thread.h"
@@ -25,10 +27,12 @@
 #include "notify_handler.h"
 #include "fixed_length_message_handler.h"
 #include "length_field_message_handler.h"
+#include "delimiter_message_handler.h"
 #include "event_source.h"
 #include "event_loop.h"
 #include "event_loop_group.h"
 #include "event_loop_queue.h"
+#include "send_event.h"
 #include "select_event_loop.h"
 #include "epoll_event_loop.h"
 #include "wepoll_event_loop.h"
@@ -41,19 +45,35 @@
 #include "timer.h"
 #include "timer_queue.h"
 #include "tsc_clock.h"
+#include "http_headers.h"
+#include "http_chunked.h"
+#include "http_router.h"
 #include "http_common.h"
+#include "http_parser.h"
 #include "http_request_handler.h"
+#include "http_static_file.h"
+#include "http_offload.h"
+#include "http_response_cache.h"
+#include "http2_frame.h"
+#include "http2_hpack.h"
+#include "http2_request_handler.h"
+#include "websocket_frame.h"
+#include "websocket_handler.h"
 #include "http_response_handler.h"
+#include "http_client_pool.h"
 #include "seda_event.h"
 #include "seda_event_queue.h"
 #include "seda_timer.h"
 #include "seda_timer_queue.h"
 #include "seda_interface.h"
+#include "seda_key_dispatch.h"
+#include "seda_event_age.h"
 #include "seda_stage_handler.h"
 #include "seda_stage.h"
 #include "seda_stage_thread.h"
 #include "seda_stage2.h"
 #include "seda_stage2_thread.h"
+#include "seda_pipeline.h"
 #include "global.h"
 #include "measure_counter.h"
 #include "logging.h"
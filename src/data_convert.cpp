@@ -636,8 +636,8 @@ int DataConvert::uitoa(uint32_t value, char str[max_digits10_int32], int str_len
             str[next] = digits_[i + 1];
             str[next - 1] = digits_[i];
         }
-        str[len] = '\0';
-        return len;
+        str[need_len] = '\0';
+        return need_len;
     }
     else {
         return 0;
@@ -667,8 +667,8 @@ int DataConvert::ulltoa(uint64_t value, char str[max_digits10_int64], int str_le
             str[next] = digits_[i + 1];
             str[next - 1] = digits_[i];
         }
-        str[len] = '\0';
-        return len;
+        str[need_len] = '\0';
+        return need_len;
     }
     else {
         return 0;